@@ -231,7 +231,7 @@ const char *utfnshift(const char *s, long m) {
  * alpha ranges -
  *	only covers ranges not in lower||upper
  */
-static Rune __alpha2[] = {
+static const Rune __alpha2[] = {
     0x00d8, 0x00f6, /* Ø - ö */
     0x00f8, 0x01f5, /* ø - ǵ */
     0x0250, 0x02a8, /* ɐ - ʨ */
@@ -390,7 +390,7 @@ static Rune __alpha2[] = {
  * alpha singlets -
  *	only covers ranges not in lower||upper
  */
-static Rune __alpha1[] = {
+static const Rune __alpha1[] = {
     0x00aa, /* ª */
     0x00b5, /* µ */
     0x00ba, /* º */
@@ -428,7 +428,7 @@ static Rune __alpha1[] = {
 /*
  * space ranges
  */
-static Rune __space2[] = {
+static const Rune __space2[] = {
     0x0009, 0x000a, /* tab and newline */
     0x0020, 0x0020, /* space */
     0x00a0, 0x00a0, /*   */
@@ -442,7 +442,7 @@ static Rune __space2[] = {
  * lower case ranges
  *	3rd col is conversion excess 500
  */
-static Rune __toupper2[] = {
+static const Rune __toupper2[] = {
     0x0061, 0x007a, 468, /* a-z A-Z */
     0x00e0, 0x00f6, 468, /* à-ö À-Ö */
     0x00f8, 0x00fe, 468, /* ø-þ Ø-Þ */
@@ -484,7 +484,7 @@ static Rune __toupper2[] = {
  * lower case singlets
  *	2nd col is conversion excess 500
  */
-static Rune __toupper1[] = {
+static const Rune __toupper1[] = {
     0x00ff, 621, /* ÿ Ÿ */
     0x0101, 499, /* ā Ā */
     0x0103, 499, /* ă Ă */
@@ -831,7 +831,7 @@ static Rune __toupper1[] = {
  * upper case ranges
  *	3rd col is conversion excess 500
  */
-static Rune __tolower2[] = {
+static const Rune __tolower2[] = {
     0x0041, 0x005a, 532, /* A-Z a-z */
     0x00c0, 0x00d6, 532, /* À-Ö à-ö */
     0x00d8, 0x00de, 532, /* Ø-Þ ø-þ */
@@ -874,7 +874,7 @@ static Rune __tolower2[] = {
  * upper case singlets
  *	2nd col is conversion excess 500
  */
-static Rune __tolower1[] = {
+static const Rune __tolower1[] = {
     0x0100, 501, /* Ā ā */
     0x0102, 501, /* Ă ă */
     0x0104, 501, /* Ą ą */
@@ -1210,8 +1210,8 @@ static Rune __tolower1[] = {
     0x1ffc, 491, /* ῼ ῳ */
 };
 
-static Rune *rune_bsearch(Rune c, Rune *t, int n, int ne) {
-  Rune *p;
+static const Rune *rune_bsearch(Rune c, const Rune *t, int n, int ne) {
+  const Rune *p;
   int m;
 
   while (n > 1) {
@@ -1228,7 +1228,7 @@ static Rune *rune_bsearch(Rune c, Rune *t, int n, int ne) {
 }
 
 Rune tolowerrune(Rune c) {
-  Rune *p;
+  const Rune *p;
 
   p = rune_bsearch(c, __tolower2, nelem(__tolower2) / 3, 3);
   if (p && c >= p[0] && c <= p[1]) return c + p[2] - 500;
@@ -1238,7 +1238,7 @@ Rune tolowerrune(Rune c) {
 }
 
 Rune toupperrune(Rune c) {
-  Rune *p;
+  const Rune *p;
 
   p = rune_bsearch(c, __toupper2, nelem(__toupper2) / 3, 3);
   if (p && c >= p[0] && c <= p[1]) return c + p[2] - 500;
@@ -1248,7 +1248,7 @@ Rune toupperrune(Rune c) {
 }
 
 int islowerrune(Rune c) {
-  Rune *p;
+  const Rune *p;
 
   p = rune_bsearch(c, __toupper2, nelem(__toupper2) / 3, 3);
   if (p && c >= p[0] && c <= p[1]) return 1;
@@ -1258,7 +1258,7 @@ int islowerrune(Rune c) {
 }
 
 int isupperrune(Rune c) {
-  Rune *p;
+  const Rune *p;
 
   p = rune_bsearch(c, __tolower2, nelem(__tolower2) / 3, 3);
   if (p && c >= p[0] && c <= p[1]) return 1;
@@ -1281,7 +1281,7 @@ int iswordchar(Rune c) {
 }
 
 int isalpharune(Rune c) {
-  Rune *p;
+  const Rune *p;
 
   if (isupperrune(c) || islowerrune(c)) return 1;
   p = rune_bsearch(c, __alpha2, nelem(__alpha2) / 2, 2);
@@ -1292,7 +1292,7 @@ int isalpharune(Rune c) {
 }
 
 int isspacerune(Rune c) {
-  Rune *p;
+  const Rune *p;
 
   p = rune_bsearch(c, __space2, nelem(__space2) / 2, 2);
   if (p && c >= p[0] && c <= p[1]) return 1;
@@ -41,6 +41,8 @@
  * `fread()`, `fwrite()`, `rename()`, `remove()`.
  * Crypto API provides functions for base64, md5, and sha1 encoding/decoding.
  * Socket API provides low-level socket API.
+ * Timers and socket callbacks are invoked by the event loop, see
+ * `v7_loop_run_once()`.
  *
  * ==== File.eval(file_name)
  * Parse and run `file_name`.
@@ -132,6 +134,36 @@
  *    var s = Socket.connect("google.com", 80);
  *    s.send("GET / HTTP/1.0\n\n");
  *    var reply = s.recv();
+ *
+ * ==== socket_obj.on(event, callback) -> socket_obj
+ * Available if V7 is built with `V7_ENABLE_LOOP`. Switch the socket to
+ * non-blocking mode, and make the event loop invoke `callback` with the
+ * socket as `this` on the event `event`:
+ *
+ * - `data`: data has arrived, `callback` gets a data string;
+ * - `close`: peer has disconnected or an error has occurred; the socket is
+ *   closed already;
+ * - `accept`: a listening socket has got a new connection, `callback` gets an
+ *   accepted socket object.
+ *
+ * On a socket with callbacks, `send()` doesn't block: data which can't be
+ * sent right away is sent by the event loop. `recv()` returns `null` if there
+ * is no data yet. `close()` doesn't invoke the `close` callback.
+ * Simple echo server example:
+ *
+ *    Socket.listen(8000).on('accept', function(conn) {
+ *      conn.on('data', function(data) { this.send(data); });
+ *    });
+ *
+ * ==== setTimeout(callback, delay [, arg1 [, ...]]) -> id
+ * Available if V7 is built with `V7_ENABLE_LOOP`. Make the event loop invoke
+ * `callback` with the given arguments once, after `delay` milliseconds.
+ *
+ * ==== setInterval(callback, delay [, arg1 [, ...]]) -> id
+ * Same as `setTimeout()`, but invoke `callback` every `delay` milliseconds.
+ *
+ * ==== clearTimeout(id), clearInterval(id)
+ * Cancel the timer `id` made by `setTimeout()` or `setInterval()`.
  */
 
 #ifndef CS_V7_BUILTIN_BUILTIN_H_
@@ -9,6 +9,9 @@
 #include "v7/src/object.h"
 #include "v7/src/primitive.h"
 #include "v7/src/conversion.h"
+#include "v7/src/exceptions.h"
+#include "v7/src/gc.h"
+#include "v7/src/loop.h"
 #include "common/mbuf.h"
 #include "common/platform.h"
 
@@ -45,6 +48,17 @@ static enum v7_err s_fd_to_sock_obj(struct v7 *v7, sock_t fd, v7_val_t *res) {
   return rcode;
 }
 
+WARN_UNUSED_RESULT
+static enum v7_err s_accepted_sock_obj(struct v7 *v7, sock_t fd,
+                                       struct sockaddr_in *sin, v7_val_t *res) {
+  enum v7_err rcode = s_fd_to_sock_obj(v7, fd, res);
+  if (rcode == V7_OK) {
+    char *remote_host = inet_ntoa(sin->sin_addr);
+    v7_set(v7, *res, "remoteHost", ~0, v7_mk_string(v7, remote_host, ~0, 1));
+  }
+  return rcode;
+}
+
 /* Socket.connect(host, port [, is_udp]) -> socket_object */
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err Socket_connect(struct v7 *v7, v7_val_t *res) {
@@ -140,12 +154,7 @@ V7_PRIVATE enum v7_err Socket_accept(struct v7 *v7, v7_val_t *res) {
     sock_t sock = (sock_t) v7_get_double(v7, prop);
     sock_t fd = accept(sock, (struct sockaddr *) &sin, &len);
     if (fd != INVALID_SOCKET) {
-      rcode = s_fd_to_sock_obj(v7, fd, res);
-      if (rcode == V7_OK) {
-        char *remote_host = inet_ntoa(sin.sin_addr);
-        v7_set(v7, *res, "remoteHost", ~0,
-               v7_mk_string(v7, remote_host, ~0, 1));
-      }
+      rcode = s_accepted_sock_obj(v7, fd, &sin, res);
       goto clean;
     }
   }
@@ -161,6 +170,12 @@ V7_PRIVATE enum v7_err Socket_close(struct v7 *v7, v7_val_t *res) {
   enum v7_err rcode = V7_OK;
   v7_val_t this_obj = v7_get_this(v7);
   v7_val_t prop = v7_get(v7, this_obj, s_sock_prop, sizeof(s_sock_prop) - 1);
+#ifdef V7_ENABLE_LOOP
+  struct loop_sock *ls = loop_get_sock(v7, this_obj);
+  if (ls != NULL) {
+    loop_del_sock(v7, ls);
+  }
+#endif
   *res = v7_mk_number(v7, closesocket((sock_t) v7_get_double(v7, prop)));
 
   return rcode;
@@ -187,7 +202,20 @@ static enum v7_err s_recv(struct v7 *v7, int all, v7_val_t *res) {
       }
     }
 
+#ifdef V7_ENABLE_LOOP
+    /* Watched sockets are non-blocking: return what's available */
+    if (n < 0 && loop_would_block()) {
+      n = 1;
+    }
+#endif
+
     if (n <= 0) {
+#ifdef V7_ENABLE_LOOP
+      struct loop_sock *ls = loop_get_sock(v7, this_obj);
+      if (ls != NULL) {
+        loop_del_sock(v7, ls);
+      }
+#endif
       closesocket(sock);
       v7_def(v7, this_obj, s_sock_prop, sizeof(s_sock_prop) - 1,
              V7_DESC_ENUMERABLE(0), v7_mk_number(v7, INVALID_SOCKET));
@@ -229,6 +257,14 @@ V7_PRIVATE enum v7_err Socket_send(struct v7 *v7, v7_val_t *res) {
     sock_t sock = (sock_t) v7_get_double(v7, prop);
     int n;
 
+#ifdef V7_ENABLE_LOOP
+    struct loop_sock *ls = loop_get_sock(v7, this_obj);
+    if (ls != NULL) {
+      *res = v7_mk_number(v7, loop_send(v7, ls, s, len));
+      goto clean;
+    }
+#endif
+
     while (sent < len && (n = send(sock, s + sent, len - sent, 0)) > 0) {
       sent += n;
     }
@@ -236,9 +272,120 @@ V7_PRIVATE enum v7_err Socket_send(struct v7 *v7, v7_val_t *res) {
 
   *res = v7_mk_number(v7, sent);
 
+#ifdef V7_ENABLE_LOOP
+clean:
+#endif
+  return rcode;
+}
+
+#ifdef V7_ENABLE_LOOP
+/* Closes the watched socket on EOF or error, and emits `close` */
+WARN_UNUSED_RESULT
+static enum v7_err s_on_eof(struct v7 *v7, struct loop_sock *ls,
+                            v7_val_t *res) {
+  closesocket(ls->fd);
+  loop_del_sock(v7, ls);
+  v7_def(v7, ls->obj, s_sock_prop, sizeof(s_sock_prop) - 1,
+         V7_DESC_ENUMERABLE(0), v7_mk_number(v7, INVALID_SOCKET));
+  return loop_emit(v7, ls, "close", V7_UNDEFINED, res);
+}
+
+/* Reads the data available on the watched socket, and emits `data` */
+WARN_UNUSED_RESULT
+static enum v7_err s_on_data(struct v7 *v7, struct loop_sock *ls,
+                             v7_val_t *res) {
+  enum v7_err rcode = V7_OK;
+  char buf[RECV_BUF_SIZE];
+  struct mbuf m;
+  int n;
+
+  mbuf_init(&m, 0);
+  while ((n = recv(ls->fd, buf, sizeof(buf), 0)) > 0) {
+    mbuf_append(&m, buf, n);
+    if (n < (int) sizeof(buf)) {
+      break;
+    }
+  }
+
+  if (m.len > 0) {
+    rcode = loop_emit(v7, ls, "data", v7_mk_string(v7, m.buf, m.len, 1), res);
+    mbuf_free(&m);
+    if (rcode != V7_OK || ls->deleted) {
+      goto clean;
+    }
+  }
+
+  if (n == 0 || (n < 0 && !loop_would_block())) {
+    rcode = s_on_eof(v7, ls, res);
+  }
+
+clean:
   return rcode;
 }
 
+/* Accepts pending connections of the watched socket, and emits `accept` */
+WARN_UNUSED_RESULT
+static enum v7_err s_on_accept(struct v7 *v7, struct loop_sock *ls,
+                               v7_val_t *res) {
+  enum v7_err rcode = V7_OK;
+  v7_val_t sock_obj = V7_UNDEFINED;
+  struct gc_tmp_frame tf = new_tmp_frame(v7);
+
+  tmp_stack_push(&tf, &sock_obj);
+
+  while (!ls->deleted) {
+    struct sockaddr_in sin;
+    socklen_t len = sizeof(sin);
+    sock_t fd = accept(ls->fd, (struct sockaddr *) &sin, &len);
+    if (fd == INVALID_SOCKET) {
+      break;
+    }
+    V7_TRY(s_accepted_sock_obj(v7, fd, &sin, &sock_obj));
+    rcode = loop_emit(v7, ls, "accept", sock_obj, res);
+    if (rcode != V7_OK) {
+      goto clean;
+    }
+  }
+
+clean:
+  tmp_frame_cleanup(&tf);
+  return rcode;
+}
+
+/* sock.on(event, callback) -> sock */
+WARN_UNUSED_RESULT
+V7_PRIVATE enum v7_err Socket_on(struct v7 *v7, v7_val_t *res) {
+  enum v7_err rcode = V7_OK;
+  v7_val_t this_obj = v7_get_this(v7);
+  v7_val_t arg0 = v7_arg(v7, 0);
+  v7_val_t arg1 = v7_arg(v7, 1);
+  v7_val_t prop = v7_get(v7, this_obj, s_sock_prop, sizeof(s_sock_prop) - 1);
+
+  if (v7_is_number(prop) && v7_is_string(arg0)) {
+    sock_t sock = (sock_t) v7_get_double(v7, prop);
+    size_t n;
+    const char *event = v7_get_string(v7, &arg0, &n);
+    int is_accept = n == 6 && memcmp(event, "accept", 6) == 0;
+    struct loop_sock *ls;
+
+    if (sock == INVALID_SOCKET) {
+      goto clean;
+    }
+    ls = loop_add_sock(v7, sock, this_obj);
+    if (is_accept) {
+      ls->on_readable = s_on_accept;
+    } else if (ls->on_readable == NULL) {
+      ls->on_readable = s_on_data;
+    }
+    V7_TRY(set_property_v(v7, ls->handlers, arg0, arg1, NULL));
+  }
+
+clean:
+  *res = this_obj;
+  return rcode;
+}
+#endif
+
 void init_socket(struct v7 *v7) {
   v7_val_t socket_obj = v7_mk_object(v7), sock_proto = v7_mk_object(v7);
 
@@ -254,6 +401,9 @@ void init_socket(struct v7 *v7) {
   v7_set_method(v7, sock_proto, "recv", Socket_recv);
   v7_set_method(v7, sock_proto, "recvAll", Socket_recvAll);
   v7_set_method(v7, sock_proto, "close", Socket_close);
+#ifdef V7_ENABLE_LOOP
+  v7_set_method(v7, sock_proto, "on", Socket_on);
+#endif
 
 #ifdef _WIN32
   {
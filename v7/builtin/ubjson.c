@@ -162,6 +162,7 @@ static enum v7_err _ubjson_render_cont(struct v7 *v7, struct ubjson_ctx *ctx) {
     } else if (v7_is_object(obj)) {
       size_t n;
       v7_val_t name;
+      v7_prop_attr_t attrs;
       const char *s;
 
       if (obj_prototype_v(v7, obj) == gen_proto) {
@@ -188,13 +189,16 @@ static enum v7_err _ubjson_render_cont(struct v7 *v7, struct ubjson_ctx *ctx) {
         cs_ubjson_open_object(buf);
       }
 
-      cur->v.p = v7_next_prop(cur->v.p, obj, &name, NULL, NULL);
+      do {
+        cur->v.p = obj_next_prop(cur->v.p, obj, &name, NULL, &attrs);
+      } while (cur->v.p != NULL && (attrs & _V7_PROPERTY_HIDDEN));
 
       if (cur->v.p == NULL) {
         cs_ubjson_close_object(buf);
       } else {
         v7_val_t tmp = V7_UNDEFINED;
-        s = v7_get_string(v7, &name, &n);
+        char ibuf[V7_INDEX_BUF_SIZE];
+        s = prop_name_get_string(v7, &name, ibuf, &n);
         cs_ubjson_emit_object_key(buf, s, n);
 
         rcode = v7_get_throwing_v(v7, obj, name, &tmp);
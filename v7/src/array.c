@@ -108,9 +108,13 @@ val_t v7_array_get2(struct v7 *v7, val_t arr, unsigned long index, int *has) {
       }
     } else {
       struct v7_property *p;
-      char buf[20];
-      int n = v_sprintf_s(buf, sizeof(buf), "%lu", index);
-      p = v7_get_property(v7, arr, buf, n);
+      if (index <= V7_MAX_ARRAY_INDEX) {
+        p = v7_get_element_property(v7, arr, index);
+      } else {
+        char buf[20];
+        int n = v_sprintf_s(buf, sizeof(buf), "%lu", index);
+        p = v7_get_property(v7, arr, buf, n);
+      }
       if (has != NULL && p != NULL) *has = 1;
       V7_TRY(v7_property_value(v7, arr, p, &res));
       goto clean;
@@ -226,7 +230,6 @@ clean:
 /* TODO_V7_ERR */
 unsigned long v7_array_length(struct v7 *v7, val_t v) {
   enum v7_err rcode = V7_OK;
-  struct v7_property *p;
   unsigned long len = 0;
 
   if (!v7_is_object(v)) {
@@ -253,14 +256,7 @@ unsigned long v7_array_length(struct v7 *v7, val_t v) {
   }
 #endif
 
-  for (p = get_object_struct(v)->properties; p != NULL; p = p->next) {
-    int ok = 0;
-    unsigned long n = 0;
-    V7_TRY(str_to_ulong(v7, p->name, &ok, &n));
-    if (ok && n >= len && n < UINT32_MAX) {
-      len = n + 1;
-    }
-  }
+  len = obj_elements_length(v7, get_object_struct(v));
 
 clean:
   (void) rcode;
@@ -331,6 +327,13 @@ enum v7_err v7_array_set_throwing(struct v7 *v7, val_t arr, unsigned long index,
       } else {
         memcpy(abuf->buf + index * sizeof(val_t), &v, sizeof(val_t));
       }
+    } else if (index <= V7_MAX_ARRAY_INDEX) {
+      struct v7_property *tmp = NULL;
+      rcode = set_property_v(v7, arr, v7_mk_number(v7, index), v, &tmp);
+      ires = (tmp == NULL) ? -1 : 0;
+      if (rcode != V7_OK) {
+        goto clean;
+      }
     } else {
       char buf[20];
       int n = v_sprintf_s(buf, sizeof(buf), "%lu", index);
@@ -353,9 +356,56 @@ clean:
 }
 
 void v7_array_del(struct v7 *v7, val_t arr, unsigned long index) {
-  char buf[20];
-  int n = v_sprintf_s(buf, sizeof(buf), "%lu", index);
-  v7_del(v7, arr, buf, n);
+  if (index <= V7_MAX_ARRAY_INDEX) {
+    v7_del_element(v7, arr, index);
+  } else {
+    char buf[20];
+    int n = v_sprintf_s(buf, sizeof(buf), "%lu", index);
+    v7_del(v7, arr, buf, n);
+  }
+}
+
+V7_PRIVATE void v7_array_push_n(struct v7 *v7, val_t arr, const val_t *vals,
+                                size_t n) {
+  uint8_t saved_inhibit_gc = v7->inhibit_gc;
+  unsigned long len;
+  size_t i;
+
+  if (n == 0) {
+    return;
+  }
+
+#if V7_ENABLE_DENSE_ARRAYS
+  if (get_object_struct(arr)->attributes & V7_OBJ_DENSE_ARRAY) {
+    struct v7_property *p =
+        v7_get_own_property2(v7, arr, "", 0, _V7_PROPERTY_HIDDEN);
+    struct mbuf *abuf;
+    assert(p != NULL);
+    abuf = (struct mbuf *) v7_get_ptr(v7, p->value);
+    if (abuf == NULL) {
+      abuf = (struct mbuf *) malloc(sizeof(*abuf));
+      mbuf_init(abuf, 0);
+      p->value = v7_mk_foreign(v7, abuf);
+    }
+    mbuf_append(abuf, vals, n * sizeof(val_t));
+    return;
+  }
+#endif
+
+  /*
+   * `vals` are not reachable by the GC, which could otherwise run when the
+   * properties are allocated
+   */
+  v7->inhibit_gc = 1;
+  len = v7_array_length(v7, arr);
+  for (i = 0; i < n; i++) {
+    struct v7_property *p = v7_mk_property(v7);
+    p->name = v7_mk_number(v7, len + i);
+    p->value = vals[i];
+    p->attributes = 0;
+    obj_link_property(v7, arr, p);
+  }
+  v7->inhibit_gc = saved_inhibit_gc;
 }
 
 int v7_array_push(struct v7 *v7, v7_val_t arr, v7_val_t v) {
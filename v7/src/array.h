@@ -18,6 +18,15 @@ V7_PRIVATE v7_val_t v7_mk_dense_array(struct v7 *v7);
 V7_PRIVATE val_t
 v7_array_get2(struct v7 *v7, v7_val_t arr, unsigned long index, int *has);
 
+/*
+ * Appends `n` values to the array `arr` at once. New elements are defined
+ * directly, without looking them up or calling setters, so the array should
+ * be a fresh, extensible one made by the caller. For dense arrays, the backing
+ * buffer is grown just once.
+ */
+V7_PRIVATE void v7_array_push_n(struct v7 *v7, val_t arr, const val_t *vals,
+                                size_t n);
+
 #if defined(__cplusplus)
 }
 #endif /* __cplusplus */
@@ -11,13 +11,18 @@
 #include "v7/src/ast.h"
 #include "v7/src/core.h"
 #include "v7/src/string.h"
+#include "v7/src/conversion.h"
+#include "v7/src/eval.h"
 #include "common/str_util.h"
 
 #ifdef V7_LARGE_AST
-typedef uint32_t ast_skip_t;
+#define AST_SKIP_SIZE_DEFAULT AST_SKIP_SIZE_LARGE
 #else
-typedef uint16_t ast_skip_t;
-#define AST_SKIP_MAX UINT16_MAX
+#define AST_SKIP_SIZE_DEFAULT AST_SKIP_SIZE_SMALL
+#endif
+
+#if !defined(V7_DISABLE_AST_OPT) && defined(V7_TEMP_OFF)
+int double_to_str(char *buf, size_t buf_size, double val, int prec);
 #endif
 
 #ifndef V7_DISABLE_AST_TAG_NAMES
@@ -80,9 +85,10 @@ typedef uint16_t ast_skip_t;
  * - *skips*: as explained above, these are integer offsets, encoded in
  *   big-endian. The number of skips is determined by the node descriptor
  *   (`struct ast_node_def`). The size of each skip is either 16 or 32 bits,
- *   depending on whether the macro `V7_LARGE_AST` is set. The order of skips
- *   is determined by the `enum ast_which_skip`. See examples below for
- *   clarity.
+ *   the same for all the nodes of the AST: 16-bit skips are used unless the
+ *   AST doesn't fit in them (or the macro `V7_LARGE_AST` is set). The order
+ *   of skips is determined by the `enum ast_which_skip`. See examples below
+ *   for clarity.
  * - *subtrees*: child nodes. Some nodes have fixed number of child nodes; in
  *   this case, the descriptor has non-zero field `num_subtrees`.  Otherwise,
  *   `num_subtrees` is zero, and consumer handles child nodes one by one, until
@@ -111,15 +117,16 @@ typedef uint16_t ast_skip_t;
  *
  *    - 56 07 41 53 54 56 31 30 00
  *        Just a format prefix:
- *        Null-terminated string: `"V\007ASTV10"` (see `BIN_AST_SIGNATURE`)
+ *        Null-terminated string: `"V\007ASTV10"` (see `BIN_AST_SIGNATURE`);
+ *        for an AST with 32-bit skips, it's `"V\007ASTL10"`
  *    - 01
  *        AST tag: `AST_SCRIPT`. As you see in `ast_node_defs` below, node of
  *        this type has neither *varint* nor *inlined data* fields, but it has
  *        2 skips: `end` and `next`. `end` is a skip to the end of the current
  *        node (`SCRIPT`), and `next` will be explained below.
  *
- *        The size of each skip depends on whether `V7_LARGE_AST` is defined.
- *        If it is, then size is 32 bit, otherwise it's 16 bit. In this
+ *        The size of each skip depends on the size of the AST: it's 16 bit
+ *        unless the AST is too large for that, then it's 32 bit. In this
  *        example, we have 16-bit skips.
  *
  *        The order of skips is determined by the `enum ast_which_skip`. If you
@@ -624,25 +631,209 @@ static enum ast_tag uint8_to_tag(uint8_t t, uint8_t *lineno_present) {
   return (enum ast_tag) t;
 }
 
+static ast_off_t ast_read_skip(const struct ast *a, const char *p) {
+  const uint8_t *u = (const uint8_t *) p;
+  if (a->skip_size == AST_SKIP_SIZE_LARGE) {
+    return u[3] | u[2] << 8 | u[1] << 16 | (ast_off_t) u[0] << 24;
+  }
+  return u[1] | u[0] << 8;
+}
+
+/*
+ * Writes the skip `delta` at `p`; if it doesn't fit in the skips of the AST,
+ * `has_overflow` is set.
+ */
+static void ast_write_skip(struct ast *a, char *p, ast_off_t delta) {
+  uint8_t *u = (uint8_t *) p;
+  if (a->skip_size == AST_SKIP_SIZE_LARGE) {
+    u[0] = delta >> 24;
+    u[1] = delta >> 16 & 0xff;
+    u[2] = delta >> 8 & 0xff;
+    u[3] = delta & 0xff;
+  } else {
+    if (delta > UINT16_MAX) {
+      a->has_overflow = 1;
+    }
+    u[0] = delta >> 8;
+    u[1] = delta & 0xff;
+  }
+}
+
 V7_PRIVATE ast_off_t
 ast_insert_node(struct ast *a, ast_off_t pos, enum ast_tag tag) {
   uint8_t t = (uint8_t) tag;
   const struct ast_node_def *d = &ast_node_defs[tag];
-  ast_off_t cur = pos;
+  ast_off_t cur = a->mbuf.len;
 
   assert(tag < AST_MAX_TAG);
+  assert(pos <= cur);
+
+  if (pos != cur) {
+    /* The `end` skip is set by `ast_flush_inserts()` */
+    struct ast_insert ins;
+    ins.pos = pos;
+    ins.hdr = cur;
+    mbuf_append(&a->inserts, (char *) &ins, sizeof(ins));
+  }
+
+  mbuf_append(&a->mbuf, (char *) &t, sizeof(t));
+  mbuf_append(&a->mbuf, NULL, a->skip_size * d->num_skips);
+  memset(a->mbuf.buf + cur + 1, 0, a->skip_size * d->num_skips);
+
+  if (d->num_skips && pos == cur) {
+    ast_set_skip(a, cur + 1, AST_END_SKIP);
+  }
 
-  mbuf_insert(&a->mbuf, cur, (char *) &t, sizeof(t));
-  cur += sizeof(t);
+  return cur + 1;
+}
+
+/* Inserted node, as sorted by `ast_flush_inserts()` */
+struct ast_insert_ref {
+  ast_off_t pos;
+  size_t idx; /* Index in `struct ast_flush::ins` */
+};
+
+/* State of `ast_flush_inserts()` */
+struct ast_flush {
+  struct ast_insert *ins; /* In the order of insertion, i.e. by `hdr` */
+  struct ast_insert_ref *by_pos; /* Sorted by `pos`, outer nodes first */
+  ast_off_t *size;    /* Size of each inserted node, without children */
+  ast_off_t *hdr_sum; /* Total size of `ins[0 .. i - 1]` */
+  ast_off_t *pos_sum; /* Total size of `by_pos[0 .. i - 1]` */
+  size_t n;
+};
 
-  mbuf_insert(&a->mbuf, cur, NULL, sizeof(ast_skip_t) * d->num_skips);
-  cur += sizeof(ast_skip_t) * d->num_skips;
+static int ast_cmp_pos(const void *a, const void *b) {
+  const struct ast_insert_ref *x = (const struct ast_insert_ref *) a;
+  const struct ast_insert_ref *y = (const struct ast_insert_ref *) b;
+  if (x->pos != y->pos) return x->pos < y->pos ? -1 : 1;
+  /* Nodes inserted later at the same position wrap the earlier ones */
+  return x->idx < y->idx ? 1 : -1;
+}
 
-  if (d->num_skips) {
-    ast_set_skip(a, pos + 1, AST_END_SKIP);
+/*
+ * Maps an offset in the AST being built to the offset in the flushed AST. The
+ * offset should not be inside of an inserted node; if nodes are inserted
+ * right at it, the result is the offset of the outermost of them.
+ */
+static ast_off_t ast_flushed_off(struct ast_flush *f, ast_off_t off) {
+  size_t lo = 0, hi = f->n, mid, moved_from, moved_to;
+
+  /* Number of inserted nodes appended before `off` */
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (f->ins[mid].hdr < off) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  moved_from = lo;
+
+  /* Number of inserted nodes which belong before `off` */
+  lo = 0;
+  hi = f->n;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (f->by_pos[mid].pos < off) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
   }
+  moved_to = lo;
 
-  return pos + 1;
+  return off - f->hdr_sum[moved_from] + f->pos_sum[moved_to];
+}
+
+/*
+ * Copies node (without children) at `off` to `out`, fixing up skips. `ins` is
+ * the inserted node at `off`, or NULL.
+ */
+static void ast_flush_node(struct ast *a, struct ast_flush *f, ast_off_t off,
+                           ast_off_t size, struct ast_insert *ins,
+                           struct mbuf *out) {
+  enum ast_tag tag = uint8_to_tag(a->mbuf.buf[off], NULL);
+  const struct ast_node_def *d = &ast_node_defs[tag];
+  ast_off_t new_off = out->len, where;
+  int i;
+
+  mbuf_append(out, a->mbuf.buf + off, size);
+  for (i = 0; i < d->num_skips; i++) {
+    char *p = a->mbuf.buf + off + 1 + i * a->skip_size;
+    if (ins != NULL && i == AST_END_SKIP) {
+      /* End of the wrapped subtrees */
+      where = ast_flushed_off(f, ins->hdr);
+    } else {
+      where = ast_flushed_off(f, off + 1 + ast_read_skip(a, p));
+    }
+    ast_write_skip(a, out->buf + new_off + 1 + i * a->skip_size,
+                   where - (new_off + 1));
+  }
+}
+
+V7_PRIVATE void ast_flush_inserts(struct ast *a) {
+  struct ast_flush f;
+  struct mbuf out;
+  ast_off_t off, next;
+  size_t i, j;
+
+  f.ins = (struct ast_insert *) a->inserts.buf;
+  f.n = a->inserts.len / sizeof(struct ast_insert);
+  /* An overflown AST is not usable anyway, and its skips are truncated */
+  if (f.n == 0 || a->has_overflow) goto clean;
+
+  f.by_pos =
+      (struct ast_insert_ref *) malloc(f.n * sizeof(struct ast_insert_ref));
+  f.size = (ast_off_t *) malloc(f.n * sizeof(*f.size));
+  f.hdr_sum = (ast_off_t *) malloc((f.n + 1) * sizeof(*f.hdr_sum));
+  f.pos_sum = (ast_off_t *) malloc((f.n + 1) * sizeof(*f.pos_sum));
+  if (f.by_pos == NULL || f.size == NULL || f.hdr_sum == NULL ||
+      f.pos_sum == NULL) {
+    abort();
+  }
+
+  f.hdr_sum[0] = 0;
+  for (i = 0; i < f.n; i++) {
+    next = f.ins[i].hdr + 1;
+    ast_move_to_children(a, &next);
+    f.size[i] = next - f.ins[i].hdr;
+    f.hdr_sum[i + 1] = f.hdr_sum[i] + f.size[i];
+    f.by_pos[i].pos = f.ins[i].pos;
+    f.by_pos[i].idx = i;
+  }
+  qsort(f.by_pos, f.n, sizeof(*f.by_pos), ast_cmp_pos);
+  f.pos_sum[0] = 0;
+  for (i = 0; i < f.n; i++) {
+    f.pos_sum[i + 1] = f.pos_sum[i] + f.size[f.by_pos[i].idx];
+  }
+
+  /* Copy nodes one by one, putting inserted ones before what they wrap */
+  mbuf_init(&out, a->mbuf.len + 1);
+  for (off = 0, i = 0, j = 0; off < a->mbuf.len; off = next) {
+    for (; i < f.n && f.by_pos[i].pos == off; i++) {
+      struct ast_insert *ins = &f.ins[f.by_pos[i].idx];
+      ast_flush_node(a, &f, ins->hdr, f.size[f.by_pos[i].idx], ins, &out);
+    }
+    if (j < f.n && f.ins[j].hdr == off) {
+      next = off + f.size[j++];
+    } else {
+      next = off + 1;
+      ast_move_to_children(a, &next);
+      ast_flush_node(a, &f, off, next - off, NULL, &out);
+    }
+  }
+
+  mbuf_free(&a->mbuf);
+  a->mbuf = out;
+
+  free(f.by_pos);
+  free(f.size);
+  free(f.hdr_sum);
+  free(f.pos_sum);
+
+clean:
+  mbuf_free(&a->inserts);
 }
 
 V7_PRIVATE void ast_modify_tag(struct ast *a, ast_off_t tag_off,
@@ -672,47 +863,28 @@ ast_set_skip(struct ast *a, ast_off_t pos, enum ast_which_skip skip) {
 V7_PRIVATE ast_off_t ast_modify_skip(struct ast *a, ast_off_t pos,
                                      ast_off_t where,
                                      enum ast_which_skip skip) {
-  uint8_t *p = (uint8_t *) a->mbuf.buf + pos + skip * sizeof(ast_skip_t);
-  ast_skip_t delta = where - pos;
+  uint8_t *p = (uint8_t *) a->mbuf.buf + pos + skip * a->skip_size;
 #ifndef NDEBUG
   enum ast_tag tag = uint8_to_tag(*(a->mbuf.buf + pos - 1), NULL);
   const struct ast_node_def *def = &ast_node_defs[tag];
 #endif
   assert(pos <= where);
 
-#ifndef V7_LARGE_AST
-  /* the value of delta overflowed, therefore the ast is not useable */
-  if (where - pos > AST_SKIP_MAX) {
-    a->has_overflow = 1;
-  }
-#endif
-
   /* assertion, to be optimizable out */
   assert((int) skip < def->num_skips);
 
-#ifdef V7_LARGE_AST
-  p[0] = delta >> 24;
-  p[1] = delta >> 16 & 0xff;
-  p[2] = delta >> 8 & 0xff;
-  p[3] = delta & 0xff;
-#else
-  p[0] = delta >> 8;
-  p[1] = delta & 0xff;
-#endif
+  /* if the value of delta overflows, the ast is not useable */
+  ast_write_skip(a, (char *) p, where - pos);
   return where;
 }
 
 V7_PRIVATE ast_off_t
 ast_get_skip(struct ast *a, ast_off_t pos, enum ast_which_skip skip) {
   uint8_t *p;
-  assert(pos + skip * sizeof(ast_skip_t) < a->mbuf.len);
+  assert(pos + skip * a->skip_size < a->mbuf.len);
 
-  p = (uint8_t *) a->mbuf.buf + pos + skip * sizeof(ast_skip_t);
-#ifdef V7_LARGE_AST
-  return pos + (p[3] | p[2] << 8 | p[1] << 16 | p[0] << 24);
-#else
-  return pos + (p[1] | p[0] << 8);
-#endif
+  p = (uint8_t *) a->mbuf.buf + pos + skip * a->skip_size;
+  return pos + ast_read_skip(a, (char *) p);
 }
 
 V7_PRIVATE enum ast_tag ast_fetch_tag(struct ast *a, ast_off_t *ppos) {
@@ -751,7 +923,7 @@ V7_PRIVATE ast_off_t ast_insert_inlined_node(struct ast *a, ast_off_t pos,
 
   assert(d->has_inlined);
 
-  embed_string(&a->mbuf, offset + sizeof(ast_skip_t) * d->num_skips, name, len,
+  embed_string(&a->mbuf, offset + a->skip_size * d->num_skips, name, len,
                EMBSTR_UNESCAPE);
 
   return offset;
@@ -773,7 +945,7 @@ V7_PRIVATE int ast_get_line_no(struct ast *a, ast_off_t pos) {
     int llen;
 
     /* skip skips */
-    pos += ast_node_defs[tag].num_skips * sizeof(ast_skip_t);
+    pos += ast_node_defs[tag].num_skips * a->skip_size;
 
     /* get line number */
     ret = decode_varint((unsigned char *) a->mbuf.buf + pos, &llen);
@@ -793,7 +965,7 @@ V7_PRIVATE void ast_move_to_inlined_data(struct ast *a, ast_off_t *ppos) {
   assert(*ppos - 1 < a->mbuf.len);
 
   /* skip skips */
-  *ppos += def->num_skips * sizeof(ast_skip_t);
+  *ppos += def->num_skips * a->skip_size;
 
   /* skip line_no, if present */
   if (lineno_present) {
@@ -837,7 +1009,7 @@ V7_PRIVATE double ast_get_num(struct ast *a, ast_off_t pos) {
 #ifndef NO_LIBC
 static void comment_at_depth(FILE *fp, const char *fmt, int depth, ...) {
   int i;
-  STATIC char buf[256];
+  char buf[256];
   va_list ap;
   va_start(ap, depth);
 
@@ -928,13 +1100,843 @@ V7_PRIVATE void ast_dump_tree(FILE *fp, struct ast *a, ast_off_t *ppos,
 }
 #endif
 
+#ifndef V7_DISABLE_AST_OPT
+
+/*
+ * Constant folding: `ast_fold()` copies the AST to a new buffer node by node.
+ * Once all the operands of an operator are copied and turn out to be
+ * literals, the operator is evaluated, and the copied subtree is replaced
+ * with a single literal. Likewise, `if`, `?:`, `&&` and `||` whose condition
+ * is a literal are replaced with the branch which is taken.
+ *
+ * Only operations whose result doesn't depend on the runtime are folded: e.g.
+ * strings are never converted to numbers, and aren't compared with `<`.
+ *
+ * Nodes move while being copied, so skips are set when the whole tree is
+ * copied, using the offsets of the copied nodes.
+ */
+
+/* Value of a literal subtree */
+struct ast_const {
+  /*
+   * `AST_NUM`, `AST_STRING`, `AST_TRUE`, `AST_FALSE`, `AST_NULL`,
+   * `AST_UNDEFINED`, or `AST_NOP` if the subtree is not a literal
+   */
+  enum ast_tag tag;
+  double num;
+  /* Inlined data of `AST_NUM` and `AST_STRING`, in the new AST */
+  ast_off_t data;
+  size_t len;
+};
+
+/* Node copied from `from` in the original AST to `to` in the new one */
+struct ast_fold_node {
+  ast_off_t from;
+  ast_off_t to;
+};
+
+/* Skip to be set when the new AST is complete */
+struct ast_fold_skip {
+  ast_off_t at;     /* Offset of the skip in the new AST */
+  ast_off_t pos;    /* Offset of the node in the new AST, after tag */
+  ast_off_t from;   /* Offset of the node in the original AST, after tag */
+  ast_off_t target; /* Offset the skip points to in the original AST */
+  int is_var;       /* Whether it's a link of the var chain */
+};
+
+struct ast_fold {
+  struct ast *a;
+  struct mbuf out;
+  struct mbuf nodes; /* `struct ast_fold_node`, ordered by `from` */
+  struct mbuf skips; /* `struct ast_fold_skip` */
+  struct mbuf tmp;   /* Inlined data of the literal being emitted */
+  int line_no;       /* Line number in effect in the original AST */
+  int out_line_no;   /* Line number in effect in the new AST */
+};
+
+/* State of the new AST to roll back to, when a subtree gets replaced */
+struct ast_fold_mark {
+  size_t out_len;
+  size_t nodes_len;
+  size_t skips_len;
+  int out_line_no;
+};
+
+static void ast_fold_mark(struct ast_fold *f, struct ast_fold_mark *m) {
+  m->out_len = f->out.len;
+  m->nodes_len = f->nodes.len;
+  m->skips_len = f->skips.len;
+  m->out_line_no = f->out_line_no;
+}
+
+static void ast_fold_rollback(struct ast_fold *f,
+                              const struct ast_fold_mark *m) {
+  f->out.len = m->out_len;
+  f->nodes.len = m->nodes_len;
+  f->skips.len = m->skips_len;
+  f->out_line_no = m->out_line_no;
+}
+
+static void ast_fold_append_varint(struct mbuf *m, size_t n) {
+  int llen = calc_llen(n);
+  mbuf_append(m, NULL, llen);
+  encode_varint(n, (unsigned char *) m->buf + m->len - llen);
+}
+
+static int ast_fold_is_operator(enum ast_tag tag) {
+  switch (tag) {
+    case AST_IF:
+    case AST_COND:
+    case AST_LOGICAL_OR:
+    case AST_LOGICAL_AND:
+    case AST_OR:
+    case AST_XOR:
+    case AST_AND:
+    case AST_EQ:
+    case AST_EQ_EQ:
+    case AST_NE:
+    case AST_NE_NE:
+    case AST_LE:
+    case AST_LT:
+    case AST_GE:
+    case AST_GT:
+    case AST_LSHIFT:
+    case AST_RSHIFT:
+    case AST_URSHIFT:
+    case AST_ADD:
+    case AST_SUB:
+    case AST_REM:
+    case AST_MUL:
+    case AST_DIV:
+    case AST_POSITIVE:
+    case AST_NEGATIVE:
+    case AST_NOT:
+    case AST_LOGICAL_NOT:
+    case AST_VOID:
+    case AST_TYPEOF:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+static int ast_fold_is_literal(enum ast_tag tag) {
+  switch (tag) {
+    case AST_NUM:
+    case AST_STRING:
+    case AST_TRUE:
+    case AST_FALSE:
+    case AST_NULL:
+    case AST_UNDEFINED:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* Whether the node assigns to its first child, which should be a reference */
+static int ast_fold_is_assign(enum ast_tag tag) {
+  switch (tag) {
+    case AST_ASSIGN:
+    case AST_REM_ASSIGN:
+    case AST_MUL_ASSIGN:
+    case AST_DIV_ASSIGN:
+    case AST_XOR_ASSIGN:
+    case AST_PLUS_ASSIGN:
+    case AST_MINUS_ASSIGN:
+    case AST_OR_ASSIGN:
+    case AST_AND_ASSIGN:
+    case AST_LSHIFT_ASSIGN:
+    case AST_RSHIFT_ASSIGN:
+    case AST_URSHIFT_ASSIGN:
+    case AST_PREINC:
+    case AST_PREDEC:
+    case AST_POSTINC:
+    case AST_POSTDEC:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/*
+ * Whether the first child of the node is used as a reference rather than a
+ * value: it can't be replaced with a branch of `?:` (e.g. `(1 ? o.f : g)()`
+ * is not `o.f()`), or with `undefined` (`delete undefined` is `false`)
+ */
+static int ast_fold_is_ref(enum ast_tag tag) {
+  switch (tag) {
+    case AST_FOR_IN:
+    case AST_DELETE:
+    case AST_TYPEOF:
+    case AST_CALL:
+    case AST_NEW:
+      return 1;
+    default:
+      return ast_fold_is_assign(tag);
+  }
+}
+
+/* Whether there's anything to fold: an operator applied to a literal */
+static int ast_fold_is_worth(struct ast *a) {
+  ast_off_t pos = 0;
+  while (pos < a->mbuf.len) {
+    enum ast_tag tag = ast_fetch_tag(a, &pos);
+    ast_move_to_children(a, &pos);
+    if (ast_fold_is_operator(tag) && pos < a->mbuf.len &&
+        ast_fold_is_literal(uint8_to_tag(a->mbuf.buf[pos], NULL))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Whether the subtree(s) in the given range can be removed as dead code: it
+ * shouldn't contain declarations (they are hoisted anyway), nor assignments
+ * to something that isn't a reference (the compiler rejects them).
+ */
+static int ast_fold_can_drop(struct ast *a, ast_off_t pos, ast_off_t end) {
+  while (pos < end) {
+    enum ast_tag tag = ast_fetch_tag(a, &pos);
+    if (tag == AST_VAR || tag == AST_FUNC_DECL) {
+      return 0;
+    } else if (tag == AST_FUNC) {
+      pos = ast_get_skip(a, pos, AST_END_SKIP);
+    } else {
+      ast_move_to_children(a, &pos);
+      if (ast_fold_is_assign(tag)) {
+        enum ast_tag target = uint8_to_tag(a->mbuf.buf[pos], NULL);
+        if (target != AST_IDENT && target != AST_MEMBER &&
+            target != AST_INDEX) {
+          return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+/*
+ * Appends the tag and space for skips of a new node, which replaces the one
+ * at `from` in the original AST. Line number is added if the node had one, or
+ * if it's needed to keep line numbers of the following nodes.
+ *
+ * Returns the offset of the new node, after tag.
+ */
+static ast_off_t ast_fold_emit_tag(struct ast_fold *f, ast_off_t from,
+                                   enum ast_tag tag, int line_no,
+                                   int has_line_no) {
+  const struct ast_node_def *d = &ast_node_defs[tag];
+  struct ast_fold_node n;
+  uint8_t t = (uint8_t) tag;
+  ast_off_t pos;
+
+  n.from = from;
+  n.to = f->out.len;
+  mbuf_append(&f->nodes, (char *) &n, sizeof(n));
+
+#ifndef V7_DISABLE_LINE_NUMBERS
+  if (has_line_no || line_no != f->out_line_no) {
+    t |= AST_TAG_LINENO_PRESENT;
+  }
+#else
+  (void) line_no;
+  (void) has_line_no;
+#endif
+
+  mbuf_append(&f->out, (char *) &t, sizeof(t));
+  pos = f->out.len;
+  mbuf_append(&f->out, NULL, f->a->skip_size * d->num_skips);
+  memset(f->out.buf + pos, 0, f->a->skip_size * d->num_skips);
+
+#ifndef V7_DISABLE_LINE_NUMBERS
+  if (t & AST_TAG_LINENO_PRESENT) {
+    ast_fold_append_varint(&f->out, line_no);
+    f->out_line_no = line_no;
+  }
+#endif
+
+  return pos;
+}
+
+/*
+ * Copies the node at `*ppos` (without children) and moves `*ppos` to its
+ * children. If the node has inlined data, `*data` is set to its offset in the
+ * new AST.
+ */
+static void ast_fold_copy_node(struct ast_fold *f, ast_off_t *ppos,
+                               ast_off_t *data) {
+  struct ast *a = f->a;
+  ast_off_t from = *ppos, pos = from + 1, new_pos, inl = pos;
+  uint8_t lineno_present = 0;
+  enum ast_tag tag = uint8_to_tag(a->mbuf.buf[from], &lineno_present);
+  const struct ast_node_def *d = &ast_node_defs[tag];
+  int i;
+
+#ifndef V7_DISABLE_LINE_NUMBERS
+  if (lineno_present) {
+    f->line_no = ast_get_line_no(a, pos);
+  }
+#endif
+
+  new_pos = ast_fold_emit_tag(f, from, tag, f->line_no, lineno_present);
+  for (i = 0; i < d->num_skips; i++) {
+    struct ast_fold_skip s;
+    s.at = new_pos + i * a->skip_size;
+    s.pos = new_pos;
+    s.from = pos;
+    s.target = ast_get_skip(a, pos, (enum ast_which_skip) i);
+    s.is_var = i == AST_VAR_NEXT_SKIP &&
+               (tag == AST_SCRIPT || tag == AST_VAR || tag == AST_FUNC);
+    mbuf_append(&f->skips, (char *) &s, sizeof(s));
+  }
+
+  /* Varint and inlined data are copied as is */
+  ast_move_to_inlined_data(a, &inl);
+  *ppos = pos;
+  ast_move_to_children(a, ppos);
+  if (d->has_varint) {
+    int llen;
+    decode_varint((unsigned char *) a->mbuf.buf + inl, &llen);
+    *data = f->out.len + llen;
+  }
+  mbuf_append(&f->out, a->mbuf.buf + inl, *ppos - inl);
+}
+
+/*
+ * Appends a literal node which replaces the subtree at `from`; inlined data
+ * of `AST_NUM` and `AST_STRING` is taken from `f->tmp`.
+ */
+static void ast_fold_emit_literal(struct ast_fold *f, ast_off_t from,
+                                  int line_no, struct ast_const *c) {
+  ast_fold_emit_tag(f, from, c->tag, line_no, 0);
+  if (c->tag == AST_NUM || c->tag == AST_STRING) {
+    ast_fold_append_varint(&f->out, f->tmp.len);
+    c->data = f->out.len;
+    c->len = f->tmp.len;
+    mbuf_append(&f->out, f->tmp.buf, f->tmp.len);
+  }
+}
+
+static int ast_const_to_bool(const struct ast_const *c) {
+  switch (c->tag) {
+    case AST_NUM:
+      return !(c->num == 0 || isnan(c->num));
+    case AST_STRING:
+      return c->len > 0;
+    case AST_TRUE:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* Strings are not converted, since it's up to the runtime */
+static int ast_const_to_number(const struct ast_const *c, double *res) {
+  switch (c->tag) {
+    case AST_NUM:
+      *res = c->num;
+      return 1;
+    case AST_TRUE:
+      *res = 1;
+      return 1;
+    case AST_FALSE:
+    case AST_NULL:
+      *res = 0;
+      return 1;
+    case AST_UNDEFINED:
+      *res = NAN;
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* Appends the string value of the literal to `f->tmp` */
+static int ast_fold_append_str(struct ast_fold *f, const struct ast_const *c) {
+  const char *s;
+  char buf[25]; /* The same as `primitive_to_str()` uses */
+  int n;
+
+  switch (c->tag) {
+    case AST_STRING:
+      mbuf_append(&f->tmp, f->out.buf + c->data, c->len);
+      return 1;
+    case AST_NUM:
+      n = number_to_str(buf, sizeof(buf), c->num);
+      if (n < 0 || n >= (int) sizeof(buf)) return 0;
+      s = buf;
+      break;
+    case AST_TRUE:
+      s = "true";
+      break;
+    case AST_FALSE:
+      s = "false";
+      break;
+    case AST_NULL:
+      s = "null";
+      break;
+    case AST_UNDEFINED:
+      s = "undefined";
+      break;
+    default:
+      return 0;
+  }
+  mbuf_append(&f->tmp, s, strlen(s));
+  return 1;
+}
+
+/*
+ * Puts the number into `f->tmp` in the form the parser would produce; fails
+ * if it can't be parsed back exactly. `-0` is not a literal either.
+ */
+static int ast_fold_num(struct ast_fold *f, double num, struct ast_const *r) {
+  char buf[32];
+  int prec;
+
+  if (isnan(num) || isinf(num) || (num == 0 && signbit(num))) return 0;
+
+  for (prec = 15; prec <= 17; prec++) {
+#ifndef V7_TEMP_OFF
+    snprintf(buf, sizeof(buf), "%.*g", prec, num);
+#else
+    double_to_str(buf, sizeof(buf), num, prec);
+#endif
+    if (cs_strtod(buf, NULL) == num) {
+      mbuf_append(&f->tmp, buf, strlen(buf));
+      r->tag = AST_NUM;
+      r->num = num;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int ast_fold_bool(int v, struct ast_const *r) {
+  r->tag = v ? AST_TRUE : AST_FALSE;
+  return 1;
+}
+
+static int ast_fold_str_eq(struct ast_fold *f, const struct ast_const *a,
+                           const struct ast_const *b) {
+  return a->len == b->len &&
+         memcmp(f->out.buf + a->data, f->out.buf + b->data, a->len) == 0;
+}
+
+static enum opcode ast_fold_opcode(enum ast_tag tag) {
+  switch (tag) {
+    case AST_ADD:
+      return OP_ADD;
+    case AST_SUB:
+      return OP_SUB;
+    case AST_REM:
+      return OP_REM;
+    case AST_MUL:
+      return OP_MUL;
+    case AST_DIV:
+      return OP_DIV;
+    case AST_LSHIFT:
+      return OP_LSHIFT;
+    case AST_RSHIFT:
+      return OP_RSHIFT;
+    case AST_URSHIFT:
+      return OP_URSHIFT;
+    case AST_OR:
+      return OP_OR;
+    case AST_XOR:
+      return OP_XOR;
+    case AST_AND:
+      return OP_AND;
+    case AST_EQ:
+      return OP_EQ;
+    case AST_EQ_EQ:
+      return OP_EQ_EQ;
+    case AST_LT:
+      return OP_LT;
+    case AST_LE:
+      return OP_LE;
+    case AST_GT:
+      return OP_GT;
+    case AST_GE:
+      return OP_GE;
+    default:
+      assert(0);
+      return OP_MAX;
+  }
+}
+
+/*
+ * Evaluates the operator applied to literals `k`; the inlined data of the
+ * result, if any, is put to `f->tmp`. Returns 0 if the operator can't be
+ * evaluated.
+ */
+static int ast_fold_eval(struct ast_fold *f, enum ast_tag tag,
+                         const struct ast_const *k, struct ast_const *r) {
+  double a, b;
+  int eq;
+
+  f->tmp.len = 0;
+  if (!ast_fold_is_operator(tag) || k[0].tag == AST_NOP) return 0;
+
+  switch (tag) {
+    case AST_POSITIVE:
+    case AST_NEGATIVE:
+    case AST_NOT:
+      if (!ast_const_to_number(&k[0], &a)) return 0;
+      if (tag == AST_NEGATIVE) {
+        a = -a;
+      } else if (tag == AST_NOT) {
+        if (!(fabs(a) < 2147483648.0)) return 0;
+        a = ~(int32_t) a;
+      }
+      return ast_fold_num(f, a, r);
+    case AST_LOGICAL_NOT:
+      return ast_fold_bool(!ast_const_to_bool(&k[0]), r);
+    case AST_VOID:
+      r->tag = AST_UNDEFINED;
+      return 1;
+    case AST_TYPEOF: {
+      const char *s;
+      switch (k[0].tag) {
+        case AST_NUM:
+          s = "number";
+          break;
+        case AST_STRING:
+          s = "string";
+          break;
+        case AST_TRUE:
+        case AST_FALSE:
+          s = "boolean";
+          break;
+        case AST_NULL:
+          s = "object";
+          break;
+        default:
+          s = "undefined";
+          break;
+      }
+      mbuf_append(&f->tmp, s, strlen(s));
+      r->tag = AST_STRING;
+      return 1;
+    }
+    default:
+      break;
+  }
+
+  /* Binary operators */
+  if (k[1].tag == AST_NOP) return 0;
+
+  switch (tag) {
+    case AST_ADD:
+      if (k[0].tag == AST_STRING || k[1].tag == AST_STRING) {
+        r->tag = AST_STRING;
+        return ast_fold_append_str(f, &k[0]) && ast_fold_append_str(f, &k[1]);
+      }
+    /* fall through */
+    case AST_SUB:
+    case AST_REM:
+    case AST_MUL:
+    case AST_DIV:
+    case AST_LSHIFT:
+    case AST_RSHIFT:
+    case AST_URSHIFT:
+    case AST_OR:
+    case AST_XOR:
+    case AST_AND:
+      if (!ast_const_to_number(&k[0], &a) || !ast_const_to_number(&k[1], &b) ||
+          !b_num_bin_op_can_fold(ast_fold_opcode(tag), a, b)) {
+        return 0;
+      }
+      return ast_fold_num(f, b_num_bin_op(ast_fold_opcode(tag), a, b), r);
+    case AST_EQ:
+    case AST_NE:
+      if (k[0].tag == AST_NULL || k[0].tag == AST_UNDEFINED ||
+          k[1].tag == AST_NULL || k[1].tag == AST_UNDEFINED) {
+        eq = (k[0].tag == AST_NULL || k[0].tag == AST_UNDEFINED) &&
+             (k[1].tag == AST_NULL || k[1].tag == AST_UNDEFINED);
+      } else if (k[0].tag == AST_STRING && k[1].tag == AST_STRING) {
+        eq = ast_fold_str_eq(f, &k[0], &k[1]);
+      } else if (ast_const_to_number(&k[0], &a) &&
+                 ast_const_to_number(&k[1], &b)) {
+        eq = b_bool_bin_op(OP_EQ, a, b);
+      } else {
+        return 0;
+      }
+      return ast_fold_bool(eq == (tag == AST_EQ), r);
+    case AST_EQ_EQ:
+    case AST_NE_NE:
+      if (k[0].tag == AST_NUM && k[1].tag == AST_NUM) {
+        eq = b_bool_bin_op(OP_EQ_EQ, k[0].num, k[1].num);
+      } else if (k[0].tag == AST_STRING && k[1].tag == AST_STRING) {
+        eq = ast_fold_str_eq(f, &k[0], &k[1]);
+      } else {
+        /* `true` and `false` are different literals */
+        eq = k[0].tag == k[1].tag;
+      }
+      return ast_fold_bool(eq == (tag == AST_EQ_EQ), r);
+    case AST_LT:
+    case AST_LE:
+    case AST_GT:
+    case AST_GE:
+      if (!ast_const_to_number(&k[0], &a) || !ast_const_to_number(&k[1], &b)) {
+        return 0;
+      }
+      return ast_fold_bool(b_bool_bin_op(ast_fold_opcode(tag), a, b), r);
+    default:
+      return 0;
+  }
+}
+
+static void ast_fold_node(struct ast_fold *f, ast_off_t *ppos, int is_ref,
+                          struct ast_const *c);
+
+/*
+ * Replaces `if`, `?:`, `&&` or `||` at `from`, whose first child is the
+ * literal `cond`, with the branch which is taken. `*ppos` should be right
+ * after the condition. Returns 0 if the node should be kept.
+ */
+static int ast_fold_branch(struct ast_fold *f, const struct ast_fold_mark *m,
+                           ast_off_t from, int is_ref, ast_off_t *ppos,
+                           const struct ast_const *cond, struct ast_const *c) {
+  struct ast *a = f->a;
+  enum ast_tag tag = uint8_to_tag(a->mbuf.buf[from], NULL);
+  int truthy = ast_const_to_bool(cond);
+
+  switch (tag) {
+    case AST_IF: {
+      ast_off_t end = ast_get_skip(a, from + 1, AST_END_SKIP);
+      ast_off_t end_true = ast_get_skip(a, from + 1, AST_END_IF_TRUE_SKIP);
+      ast_off_t live = truthy ? *ppos : end_true;
+      ast_off_t live_end = truthy ? end_true : end;
+
+      if (truthy ? !ast_fold_can_drop(a, end_true, end)
+                 : !ast_fold_can_drop(a, *ppos, end_true)) {
+        return 0;
+      }
+
+      ast_fold_rollback(f, m);
+      for (*ppos = live; *ppos < live_end;) {
+        struct ast_const tmp;
+        ast_fold_node(f, ppos, 0, &tmp);
+      }
+      *ppos = end;
+      return 1;
+    }
+    case AST_COND: {
+      ast_off_t end_true = *ppos, end;
+      ast_skip_tree(a, &end_true);
+      end = end_true;
+      ast_skip_tree(a, &end);
+      if (is_ref || (truthy ? !ast_fold_can_drop(a, end_true, end)
+                            : !ast_fold_can_drop(a, *ppos, end_true))) {
+        return 0;
+      }
+      ast_fold_rollback(f, m);
+      if (truthy) {
+        ast_fold_node(f, ppos, 0, c);
+        *ppos = end;
+      } else {
+        *ppos = end_true;
+        ast_fold_node(f, ppos, 0, c);
+      }
+      return 1;
+    }
+    case AST_LOGICAL_AND:
+    case AST_LOGICAL_OR:
+      if (is_ref) return 0;
+      if (truthy == (tag == AST_LOGICAL_OR)) {
+        /* The result is the condition itself */
+        struct ast_const r = *cond;
+        ast_off_t end = *ppos;
+        ast_skip_tree(a, &end);
+        if (!ast_fold_can_drop(a, *ppos, end)) return 0;
+        f->tmp.len = 0;
+        if (r.tag == AST_NUM || r.tag == AST_STRING) {
+          mbuf_append(&f->tmp, f->out.buf + r.data, r.len);
+        }
+        ast_fold_rollback(f, m);
+        ast_fold_emit_literal(f, from, f->line_no, &r);
+        *ppos = end;
+        *c = r;
+      } else {
+        ast_fold_rollback(f, m);
+        ast_fold_node(f, ppos, 0, c);
+      }
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/*
+ * Copies the subtree at `*ppos` to the new AST, folding it if possible, and
+ * moves `*ppos` past it. If the resulting subtree is a literal, `c` describes
+ * it. `is_ref` tells whether the subtree is used as a reference, see
+ * `ast_fold_is_ref()`.
+ */
+static void ast_fold_node(struct ast_fold *f, ast_off_t *ppos, int is_ref,
+                          struct ast_const *c) {
+  struct ast *a = f->a;
+  ast_off_t from = *ppos, end = 0, data = 0;
+  enum ast_tag tag = uint8_to_tag(a->mbuf.buf[from], NULL);
+  const struct ast_node_def *d = &ast_node_defs[tag];
+  struct ast_fold_mark m;
+  struct ast_const k[3], r;
+  int line_no, out_line_no, i;
+
+  c->tag = AST_NOP;
+  ast_fold_mark(f, &m);
+  ast_fold_copy_node(f, ppos, &data);
+  line_no = f->line_no;
+  out_line_no = f->out_line_no;
+
+  switch (tag) {
+    case AST_NUM:
+    case AST_STRING:
+      c->tag = tag;
+      c->data = data;
+      c->len = f->out.len - data;
+      if (tag == AST_NUM) {
+        c->num = ast_get_num(a, from + 1);
+      }
+      return;
+    case AST_TRUE:
+    case AST_FALSE:
+    case AST_NULL:
+    case AST_UNDEFINED:
+      c->tag = tag;
+      return;
+    default:
+      break;
+  }
+
+  if (d->num_skips > 0) {
+    end = ast_get_skip(a, from + 1, AST_END_SKIP);
+  }
+  for (i = 0; i < d->num_subtrees; i++) {
+    ast_fold_node(f, ppos, i == 0 && ast_fold_is_ref(tag), &k[i]);
+    if (i == 0 && k[0].tag != AST_NOP &&
+        ast_fold_branch(f, &m, from, is_ref, ppos, &k[0], c)) {
+      return;
+    }
+  }
+  if (d->num_skips > 0) {
+    while (*ppos < end) {
+      struct ast_const tmp;
+      ast_fold_node(f, ppos, 0, &tmp);
+    }
+  }
+
+  if (tag == AST_FUNC) {
+    /* The compiler restores the line number after the function body */
+    f->line_no = line_no;
+    f->out_line_no = out_line_no;
+  } else if (ast_fold_eval(f, tag, k, &r) &&
+             !(is_ref && r.tag == AST_UNDEFINED)) {
+    /* Line number of the literal is the last one seen in the subtree */
+    ast_fold_rollback(f, &m);
+    ast_fold_emit_literal(f, from, f->line_no, &r);
+    *c = r;
+  }
+}
+
+/* Sets all the skips of the new AST; fails if any of them overflows */
+static int ast_fold_set_skips(struct ast_fold *f) {
+  struct ast_fold_node *nodes = (struct ast_fold_node *) f->nodes.buf;
+  struct ast_fold_skip *s = (struct ast_fold_skip *) f->skips.buf;
+  size_t n = f->nodes.len / sizeof(*nodes), lo, hi, mid;
+  size_t i, cnt = f->skips.len / sizeof(*s);
+
+  for (i = 0; i < cnt; i++, s++) {
+    /* Var chain links point right after the tag, others point to nodes */
+    ast_off_t target = s->is_var ? s->target - 1 : s->target, where;
+
+    if (s->target == s->from) {
+      /* Unset skip, or the end of the var chain */
+      where = s->pos;
+    } else {
+      /* First node at or after the target */
+      for (lo = 0, hi = n; lo < hi;) {
+        mid = (lo + hi) / 2;
+        if (nodes[mid].from < target) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      if (s->is_var) {
+        if (lo == n || nodes[lo].from != target) return 0;
+        where = nodes[lo].to + 1;
+      } else {
+        where = lo < n ? nodes[lo].to : f->out.len;
+      }
+    }
+
+    if (f->a->skip_size == AST_SKIP_SIZE_SMALL && where - s->pos > UINT16_MAX) {
+      return 0;
+    }
+    ast_write_skip(f->a, f->out.buf + s->at, where - s->pos);
+  }
+  return 1;
+}
+
+/*
+ * Folds constant expressions of the AST, see `struct ast_const`. The AST is
+ * left as is if there's nothing to fold.
+ */
+static void ast_fold(struct ast *a) {
+  struct ast_fold f;
+  ast_off_t pos = 0;
+
+  if (a->has_overflow || !ast_fold_is_worth(a)) return;
+
+  f.a = a;
+  mbuf_init(&f.out, a->mbuf.len + 1);
+  mbuf_init(&f.nodes, 0);
+  mbuf_init(&f.skips, 0);
+  mbuf_init(&f.tmp, 0);
+  f.line_no = f.out_line_no = 1;
+
+  while (pos < a->mbuf.len) {
+    struct ast_const c;
+    ast_fold_node(&f, &pos, 0, &c);
+  }
+
+  if (ast_fold_set_skips(&f)) {
+    mbuf_free(&a->mbuf);
+    a->mbuf = f.out;
+  } else {
+    mbuf_free(&f.out);
+  }
+
+  mbuf_free(&f.nodes);
+  mbuf_free(&f.skips);
+  mbuf_free(&f.tmp);
+}
+
+#endif /* V7_DISABLE_AST_OPT */
+
 V7_PRIVATE void ast_init(struct ast *ast, size_t len) {
   mbuf_init(&ast->mbuf, len);
+  mbuf_init(&ast->inserts, 0);
   ast->refcnt = 0;
+  ast->skip_size = AST_SKIP_SIZE_DEFAULT;
   ast->has_overflow = 0;
 }
 
+V7_PRIVATE void ast_use_large_skips(struct ast *a) {
+  a->mbuf.len = 0;
+  mbuf_free(&a->inserts);
+  a->skip_size = AST_SKIP_SIZE_LARGE;
+  a->has_overflow = 0;
+}
+
 V7_PRIVATE void ast_optimize(struct ast *ast) {
+#ifndef V7_DISABLE_AST_OPT
+  ast_fold(ast);
+#endif
+
   /*
    * leave one trailing byte so that literals can be
    * null terminated on the fly.
@@ -944,6 +1946,7 @@ V7_PRIVATE void ast_optimize(struct ast *ast) {
 
 V7_PRIVATE void ast_free(struct ast *ast) {
   mbuf_free(&ast->mbuf);
+  mbuf_free(&ast->inserts);
   ast->refcnt = 0;
   ast->has_overflow = 0;
 }
@@ -16,6 +16,15 @@ extern "C" {
 #endif /* __cplusplus */
 
 #define BIN_AST_SIGNATURE "V\007ASTV10"
+/* Same as `BIN_AST_SIGNATURE`, but the AST has large skips */
+#define BIN_AST_LARGE_SIGNATURE "V\007ASTL10"
+
+/*
+ * Size of skips, in bytes: small skips are enough for ASTs up to 64 KB; if an
+ * AST is larger than that, it's rebuilt with large skips (see `struct ast`).
+ */
+#define AST_SKIP_SIZE_SMALL 2
+#define AST_SKIP_SIZE_LARGE 4
 
 enum ast_tag {
   AST_NOP,
@@ -135,11 +144,34 @@ enum ast_tag {
 struct ast {
   struct mbuf mbuf;
   int refcnt;
+
+  /*
+   * Size of skips: `AST_SKIP_SIZE_SMALL`, unless v7 is built with
+   * `V7_LARGE_AST`. If some skip doesn't fit, `has_overflow` is set: the AST
+   * is not usable, and it should be built again after
+   * `ast_use_large_skips()`.
+   */
+  int skip_size;
   int has_overflow;
+
+  /*
+   * Nodes wrapped around already emitted nodes, which are not yet moved in
+   * place: array of `struct ast_insert`, see `ast_insert_node()`
+   */
+  struct mbuf inserts;
 };
 
 typedef unsigned long ast_off_t;
 
+/*
+ * Node which belongs at `pos`, i.e. before the subtrees it wraps, but was
+ * appended to the end of the AST at `hdr`; see `ast_flush_inserts()`
+ */
+struct ast_insert {
+  ast_off_t pos;
+  ast_off_t hdr;
+};
+
 #if __GNUC__ >= 4 && __GNUC_MINOR__ >= 8
 #define GCC_HAS_PRAGMA_DIAGNOSTIC
 #endif
@@ -187,12 +219,24 @@ V7_PRIVATE void ast_init(struct ast *, size_t);
 V7_PRIVATE void ast_optimize(struct ast *);
 V7_PRIVATE void ast_free(struct ast *);
 
+/*
+ * Empties the AST and makes it use large skips, so that an overflown AST can
+ * be built again.
+ */
+V7_PRIVATE void ast_use_large_skips(struct ast *a);
+
 /*
  * Begins an AST node by inserting a tag to the AST at the given offset.
  *
  * It also allocates space for the fixed_size payload and the space for
  * the skips.
  *
+ * If `pos` is not the end of the AST, the node wraps all the subtrees from
+ * `pos` to the end as its children: its `end` skip (if any) is set to the
+ * end of them. Such a node is still appended to the end, and only moved in
+ * place by `ast_flush_inserts()`, so that building the AST takes linear
+ * time; until then, offsets of all the nodes stay valid.
+ *
  * The caller is responsible for appending children.
  *
  * Returns the offset of the node payload (one byte after the tag).
@@ -201,6 +245,12 @@ V7_PRIVATE void ast_free(struct ast *);
 V7_PRIVATE ast_off_t
 ast_insert_node(struct ast *a, ast_off_t pos, enum ast_tag tag);
 
+/*
+ * Moves nodes inserted by `ast_insert_node()` in place and fixes up all the
+ * skips; should be called when the AST is complete, before reading it.
+ */
+V7_PRIVATE void ast_flush_inserts(struct ast *a);
+
 /*
  * Modify tag which is already added to buffer. Keeps `AST_TAG_LINENO_PRESENT`
  * flag.
@@ -213,7 +263,8 @@ V7_PRIVATE void ast_modify_tag(struct ast *a, ast_off_t tag_off,
  * Add line_no varint after all skips of the tag at the offset `tag_off`, and
  * marks the tag byte.
  *
- * Byte at the offset `tag_off` should be a valid tag.
+ * Byte at the offset `tag_off` should be a valid tag; the node is expected to
+ * be the last one, so that only its inlined data is moved.
  */
 V7_PRIVATE void ast_add_line_no(struct ast *a, ast_off_t tag_off, int line_no);
 #endif
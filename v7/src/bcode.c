@@ -10,9 +10,11 @@
 #include "v7/src/gc.h"
 #include "v7/src/core.h"
 #include "v7/src/regexp.h"
+#include "v7/src/slre.h"
 #include "v7/src/function.h"
 #include "v7/src/util.h"
 #include "v7/src/shdata.h"
+#include "v7/src/string.h"
 
 /*
  * TODO(dfrank): implement `bcode_serialize_*` more generically, so that they
@@ -24,7 +26,7 @@
 
 #if defined(V7_BCODE_DUMP) || defined(V7_BCODE_TRACE)
 /* clang-format off */
-static const char *op_names[] = {
+static const char *const op_names[] = {
   "DROP",
   "DUP",
   "2DUP",
@@ -97,6 +99,19 @@ static const char *op_names[] = {
   "CONTINUE",
   "ENTER_CATCH",
   "EXIT_CATCH",
+  "SWITCH_TABLE",
+  "GET_VAR_GET_PROP",
+  "PUSH_LIT_ADD",
+  "INC_VAR",
+  "DEC_VAR",
+  "LT_JMP_TRUE",
+  "LE_JMP_TRUE",
+  "GT_JMP_TRUE",
+  "GE_JMP_TRUE",
+  "LT_JMP_FALSE",
+  "LE_JMP_FALSE",
+  "GT_JMP_FALSE",
+  "GE_JMP_FALSE",
 };
 /* clang-format on */
 
@@ -156,22 +171,88 @@ V7_PRIVATE void bcode_builder_finalize(struct bcode_builder *bbuilder) {
 }
 
 #if defined(V7_BCODE_DUMP) || defined(V7_BCODE_TRACE)
+/*
+ * Prints the literal operand which follows `*ops`, and adjusts the pointer
+ * to point to the last byte of the literal (like `bcode_get_varint()` does)
+ */
+static void dump_lit(struct v7 *v7, FILE *f, struct bcode *bcode,
+                     char **ops) {
+  const unsigned char *lit = (const unsigned char *) *ops + 1;
+  int llen, slen;
+  size_t idx = decode_varint(lit, &llen), len;
+  val_t v;
+
+  switch (idx) {
+    case BCODE_INLINE_STRING_TYPE_TAG:
+      len = decode_varint(lit + llen, &slen);
+      fprintf(f, "(inline): \"%.*s\"", (int) len, lit + llen + slen);
+      break;
+    case BCODE_INLINE_NUMBER_TYPE_TAG:
+      memcpy(&v, lit + llen, sizeof(v));
+      fprintf(f, "(inline): ");
+      v7_fprint(f, v7, v);
+      break;
+    case BCODE_INLINE_FUNC_TYPE_TAG:
+      fprintf(f, "(inline): <function>");
+      break;
+    case BCODE_INLINE_REGEXP_TYPE_TAG:
+      len = decode_varint(lit + llen, &slen);
+      fprintf(f, "(inline): /%.*s/", (int) len, lit + llen + slen);
+      break;
+    default:
+      idx -= BCODE_MAX_INLINE_TYPE_TAG;
+      fprintf(f, "(%lu): ", (unsigned long) idx);
+      v = ((val_t *) bcode->lit.p)[idx];
+      if (is_js_function(v)) {
+        fprintf(f, "<function>");
+      } else {
+        v7_fprint(f, v7, v);
+      }
+      break;
+  }
+  *ops += bcode_lit_size((const char *) lit);
+}
+
 V7_PRIVATE void dump_op(struct v7 *v7, FILE *f, struct bcode *bcode,
                         char **ops) {
   char *p = *ops;
 
-  assert(*p < OP_MAX);
+#ifndef V7_DISABLE_LINE_NUMBERS
+  if ((uint8_t) *p >= _OP_LINE_NO) {
+    unsigned char buf[sizeof(size_t)];
+    size_t max_llen = sizeof(buf);
+    int len;
+
+    if (p + max_llen > bcode->ops.p + bcode->ops.len) {
+      max_llen = bcode->ops.p + bcode->ops.len - p;
+    }
+    memcpy(buf, p, max_llen);
+    buf[0] = msb_lsb_swap(buf[0]);
+    fprintf(f, "%zu: LINE_NO(%lu)\n", (size_t)(p - bcode->ops.p),
+            (unsigned long) (decode_varint(buf, &len) >> 1));
+    *ops = p + len - 1;
+    return;
+  }
+#endif
+
+  assert((uint8_t) *p < OP_MAX);
   fprintf(f, "%zu: %s", (size_t)(p - bcode->ops.p), op_names[(uint8_t) *p]);
   switch (*p) {
     case OP_PUSH_LIT:
     case OP_SAFE_GET_VAR:
     case OP_GET_VAR:
-    case OP_SET_VAR: {
-      size_t idx = bcode_get_varint(&p);
-      fprintf(f, "(%lu): ", (unsigned long) idx);
-      v7_fprint(f, v7, ((val_t *) bcode->lit.p)[idx]);
+    case OP_SET_VAR:
+    case OP_ENTER_CATCH:
+    case OP_PUSH_LIT_ADD:
+    case OP_INC_VAR:
+    case OP_DEC_VAR:
+      dump_lit(v7, f, bcode, &p);
+      break;
+    case OP_GET_VAR_GET_PROP:
+      dump_lit(v7, f, bcode, &p);
+      fprintf(f, ", ");
+      dump_lit(v7, f, bcode, &p);
       break;
-    }
     case OP_CALL:
     case OP_NEW:
       p++;
@@ -185,7 +266,15 @@ V7_PRIVATE void dump_op(struct v7 *v7, FILE *f, struct bcode *bcode,
     case OP_TRY_PUSH_CATCH:
     case OP_TRY_PUSH_FINALLY:
     case OP_TRY_PUSH_LOOP:
-    case OP_TRY_PUSH_SWITCH: {
+    case OP_TRY_PUSH_SWITCH:
+    case OP_LT_JMP_TRUE:
+    case OP_LE_JMP_TRUE:
+    case OP_GT_JMP_TRUE:
+    case OP_GE_JMP_TRUE:
+    case OP_LT_JMP_FALSE:
+    case OP_LE_JMP_FALSE:
+    case OP_GT_JMP_FALSE:
+    case OP_GE_JMP_FALSE: {
       bcode_off_t target;
       p++;
       memcpy(&target, p, sizeof(target));
@@ -193,6 +282,18 @@ V7_PRIVATE void dump_op(struct v7 *v7, FILE *f, struct bcode *bcode,
       p += sizeof(target) - 1;
       break;
     }
+    case OP_SWITCH_TABLE: {
+      bcode_off_t target, cnt;
+      p++;
+      memcpy(&target, p, sizeof(target));
+      p += sizeof(target);
+      memcpy(&cnt, p + 1, sizeof(cnt));
+      fprintf(f, "(%lu) %s[%lu]", (unsigned long) target,
+              *p == BCODE_SWITCH_TABLE_INDEX ? "INDEX" : "HASH",
+              (unsigned long) cnt);
+      p += bcode_switch_table_size(p) - 1;
+      break;
+    }
     default:
       break;
   }
@@ -226,7 +327,7 @@ V7_PRIVATE void bcode_init(struct bcode *bcode, uint8_t strict_mode,
 #endif
 }
 
-V7_PRIVATE void bcode_free(struct v7 *v7, struct bcode *bcode) {
+V7_PRIVATE void bcode_clear(struct v7 *v7, struct bcode *bcode) {
   (void) v7;
 #if V7_ENABLE__Memory__stats
   if (!bcode->ops_in_rom) {
@@ -237,6 +338,10 @@ V7_PRIVATE void bcode_free(struct v7 *v7, struct bcode *bcode) {
   if (bcode->deserialized) {
     v7->bcode_lit_deser_size -= bcode->lit.len;
   }
+
+  if (bcode->func_name_present) {
+    v7->bcode_funcs_compiled--;
+  }
 #endif
 
   if (!bcode->ops_in_rom) {
@@ -247,6 +352,24 @@ V7_PRIVATE void bcode_free(struct v7 *v7, struct bcode *bcode) {
   free(bcode->lit.p);
   memset(&bcode->lit, 0x00, sizeof(bcode->lit));
 
+  bcode->names_cnt = 0;
+  bcode->args_cnt = 0;
+  bcode->func_name_present = 0;
+}
+
+V7_PRIVATE void bcode_free(struct v7 *v7, struct bcode *bcode) {
+  bcode_clear(v7, bcode);
+
+#ifndef V7_DISABLE_LAZY_COMPILE
+  if (bcode->ast != NULL) {
+#if V7_ENABLE__Memory__stats
+    v7->bcode_funcs_pending--;
+#endif
+    release_ast(v7, bcode->ast);
+    bcode->ast = NULL;
+  }
+#endif
+
 #ifndef V7_DISABLE_FILENAMES
   if (!bcode->filename_in_rom && bcode->filename != NULL) {
     shdata_release((struct shdata *) bcode->filename);
@@ -461,8 +584,8 @@ bcode_decode_lit(struct v7 *v7, struct bcode *bcode, char **ops) {
 #if V7_ENABLE__RegExp
       enum v7_err rcode = V7_OK;
       val_t res;
-      size_t len_src, len_flags;
-      char *buf_src, *buf_flags;
+      size_t len_src, len_flags, len_prog;
+      char *buf_src, *buf_flags, *buf_prog;
 
       len_src = bcode_get_varint(ops);
       buf_src = *ops + 1;
@@ -472,7 +595,12 @@ bcode_decode_lit(struct v7 *v7, struct bcode *bcode, char **ops) {
       buf_flags = *ops + 1;
       *ops += len_flags + 1 /* nul term */;
 
-      rcode = v7_mk_regexp(v7, buf_src, len_src, buf_flags, len_flags, &res);
+      len_prog = bcode_get_varint(ops);
+      buf_prog = *ops + 1;
+      *ops += len_prog;
+
+      rcode = mk_regexp_from_image(v7, buf_src, len_src, buf_flags, len_flags,
+                                   buf_prog, len_prog, &res);
       assert(rcode == V7_OK);
       (void) rcode;
 
@@ -487,6 +615,50 @@ bcode_decode_lit(struct v7 *v7, struct bcode *bcode, char **ops) {
   }
 }
 
+V7_PRIVATE size_t bcode_lit_size(const char *ops) {
+  const unsigned char *p = (const unsigned char *) ops;
+  size_t tag, len;
+  int llen;
+
+  tag = decode_varint(p, &llen);
+  p += llen;
+
+  switch (tag) {
+    case BCODE_INLINE_STRING_TYPE_TAG:
+      len = decode_varint(p, &llen);
+      p += llen + len + 1 /* nul term */;
+      break;
+    case BCODE_INLINE_NUMBER_TYPE_TAG:
+      p += sizeof(val_t);
+      break;
+    case BCODE_INLINE_FUNC_TYPE_TAG:
+      /* args_cnt, names_cnt, func_name_present, ops length, ops */
+      decode_varint(p, &llen);
+      p += llen;
+      decode_varint(p, &llen);
+      p += llen;
+      decode_varint(p, &llen);
+      p += llen;
+      len = decode_varint(p, &llen);
+      p += llen + len;
+      break;
+    case BCODE_INLINE_REGEXP_TYPE_TAG:
+      /* source, flags, compiled program */
+      len = decode_varint(p, &llen);
+      p += llen + len + 1 /* nul term */;
+      len = decode_varint(p, &llen);
+      p += llen + len + 1 /* nul term */;
+      len = decode_varint(p, &llen);
+      p += llen + len;
+      break;
+    default:
+      /* index in the literal table */
+      break;
+  }
+
+  return (size_t)((const char *) p - ops);
+}
+
 V7_PRIVATE void bcode_op_lit(struct bcode_builder *bbuilder, enum opcode op,
                              lit_t lit) {
   bcode_op(bbuilder, op);
@@ -567,6 +739,16 @@ V7_PRIVATE void bcode_op_lit(struct bcode_builder *bbuilder, enum opcode op,
           bcode_add_varint(bbuilder, len);
           bcode_ops_append(bbuilder, buf, len + 1 /* nul term */);
         }
+
+        /* append compiled program, so that loading doesn't compile it again */
+        {
+          size_t len = slre_dump(rp->compiled_regexp, NULL, 0);
+          size_t offset;
+          bcode_add_varint(bbuilder, len);
+          offset = bbuilder->ops.len;
+          bcode_ops_append(bbuilder, NULL, len);
+          slre_dump(rp->compiled_regexp, bbuilder->ops.buf + offset, len);
+        }
 #else
         fprintf(stderr, "Firmware is built without -DV7_ENABLE__RegExp\n");
         abort();
@@ -615,6 +797,9 @@ V7_PRIVATE enum v7_err bcode_add_name(struct bcode_builder *bbuilder,
 
   /* reserve space in `ops` buffer */
   mbuf_insert(&bbuilder->ops, ops_index, NULL, llen + len + 1 /*null-term*/);
+#if V7_ENABLE__Memory__stats
+  bbuilder->v7->bcode_ops_size += llen + len + 1;
+#endif
 
   {
     char *ops = bbuilder->ops.buf + ops_index;
@@ -679,10 +864,15 @@ V7_PRIVATE char *bcode_next_name_v(struct v7 *v7, struct bcode *bcode,
   ops = bcode_next_name(ops, &name, &len);
 
   /*
-   * If `ops` is in RAM, we create owned string, since the string may outlive
-   * bcode. Otherwise (`ops` is in ROM), we create foreign string.
+   * If `ops` is in RAM, we create owned (interned, since names are used as
+   * property names) string, since the string may outlive bcode. Otherwise
+   * (`ops` is in ROM), we create foreign string.
    */
-  *res = v7_mk_string(v7, name, len, !bcode->ops_in_rom);
+  if (bcode->ops_in_rom) {
+    *res = v7_mk_string(v7, name, len, 0);
+  } else {
+    *res = v7_mk_interned_string(v7, name, len);
+  }
 
   return ops;
 }
@@ -715,6 +905,186 @@ V7_PRIVATE void bcode_patch_target(struct bcode_builder *bbuilder,
   memcpy(bbuilder->ops.buf + label, &target, sizeof(target));
 }
 
+struct bcode_switch_hash {
+  uint32_t hash;
+  uint32_t idx; /* index of the key */
+};
+
+static int bcode_switch_hash_cmp(const void *a, const void *b) {
+  const struct bcode_switch_hash *ha = (const struct bcode_switch_hash *) a;
+  const struct bcode_switch_hash *hb = (const struct bcode_switch_hash *) b;
+  if (ha->hash != hb->hash) {
+    return ha->hash < hb->hash ? -1 : 1;
+  }
+  /* keep the order of the keys with the same hash */
+  return ha->idx < hb->idx ? -1 : (ha->idx > hb->idx);
+}
+
+V7_PRIVATE bcode_off_t bcode_op_switch_table(struct bcode_builder *bbuilder,
+                                             enum bcode_switch_table_type type,
+                                             struct bcode_switch_key *keys,
+                                             size_t keys_cnt,
+                                             bcode_off_t *pcnt) {
+  struct mbuf data;
+  bcode_off_t label, cnt = 0, size;
+  uint8_t t = (uint8_t) type;
+  size_t i, j;
+
+  mbuf_init(&data, 0);
+
+  switch (type) {
+    case BCODE_SWITCH_TABLE_INDEX: {
+      int32_t min = keys[0].num, max = keys[0].num;
+      uint8_t *seen;
+
+      for (i = 1; i < keys_cnt; i++) {
+        if (keys[i].num < min) min = keys[i].num;
+        if (keys[i].num > max) max = keys[i].num;
+      }
+      cnt = (bcode_off_t)((int64_t) max - min + 1);
+      seen = (uint8_t *) calloc(cnt, 1);
+      if (seen == NULL) abort();
+      for (i = 0; i < keys_cnt; i++) {
+        bcode_off_t n = (bcode_off_t)((int64_t) keys[i].num - min);
+        keys[i].jmp = seen[n] ? 0 : n + 1;
+        seen[n] = 1;
+      }
+      free(seen);
+      mbuf_append(&data, &min, sizeof(min));
+      break;
+    }
+    case BCODE_SWITCH_TABLE_HASH: {
+      struct bcode_switch_hash *h = (struct bcode_switch_hash *) malloc(
+          keys_cnt * sizeof(*h));
+      if (h == NULL) abort();
+
+      for (i = 0; i < keys_cnt; i++) {
+        h[i].hash = str_hash(keys[i].str, keys[i].len);
+        h[i].idx = i;
+      }
+      qsort(h, keys_cnt, sizeof(*h), bcode_switch_hash_cmp);
+
+      /* mark duplicates: the first key wins */
+      for (i = 0; i < keys_cnt; i++) {
+        struct bcode_switch_key *k = &keys[h[i].idx];
+        k->jmp = 1;
+        for (j = i; j > 0 && h[j - 1].hash == h[i].hash; j--) {
+          struct bcode_switch_key *prev = &keys[h[j - 1].idx];
+          if (prev->len == k->len && memcmp(prev->str, k->str, k->len) == 0) {
+            k->jmp = 0;
+            break;
+          }
+        }
+      }
+      for (i = 0; i < keys_cnt; i++) {
+        struct bcode_switch_key *k = &keys[h[i].idx];
+        if (k->jmp != 0) {
+          h[cnt] = h[i];
+          k->jmp = ++cnt;
+        }
+      }
+
+      /* hashes and offsets, then the keys */
+      size = cnt * 2 * sizeof(uint32_t);
+      for (i = 0; i < cnt; i++) {
+        struct bcode_switch_key *k = &keys[h[i].idx];
+        uint32_t off = size;
+        mbuf_append(&data, &h[i].hash, sizeof(uint32_t));
+        mbuf_append(&data, &off, sizeof(off));
+        size += calc_llen(k->len) + k->len;
+      }
+      for (i = 0; i < cnt; i++) {
+        struct bcode_switch_key *k = &keys[h[i].idx];
+        size_t off = data.len;
+        mbuf_append(&data, NULL, calc_llen(k->len));
+        encode_varint(k->len, (unsigned char *) data.buf + off);
+        mbuf_append(&data, k->str, k->len);
+      }
+      free(h);
+      break;
+    }
+  }
+
+  label = bcode_op_target(bbuilder, OP_SWITCH_TABLE);
+  size = data.len;
+  bcode_ops_append(bbuilder, &t, 1);
+  bcode_ops_append(bbuilder, &cnt, sizeof(cnt));
+  bcode_ops_append(bbuilder, &size, sizeof(size));
+  bcode_ops_append(bbuilder, data.buf, data.len);
+  mbuf_free(&data);
+
+  *pcnt = cnt;
+  return label;
+}
+
+V7_PRIVATE size_t bcode_switch_table_size(const char *ops) {
+  bcode_off_t size;
+  memcpy(&size, ops + 1 + sizeof(bcode_off_t), sizeof(size));
+  return 1 + 2 * sizeof(bcode_off_t) + size;
+}
+
+V7_PRIVATE int bcode_switch_table_lookup(struct v7 *v7, const char *ops,
+                                         val_t v) {
+  const char *data = ops + 1 + 2 * sizeof(bcode_off_t);
+  bcode_off_t cnt;
+
+  memcpy(&cnt, ops + 1, sizeof(cnt));
+
+  switch ((enum bcode_switch_table_type) * ops) {
+    case BCODE_SWITCH_TABLE_INDEX: {
+      int32_t min;
+      double d;
+
+      if (!v7_is_number(v)) return -1;
+      memcpy(&min, data, sizeof(min));
+      d = v7_get_double(v7, v) - min;
+      /* NaN and non-integer values don't match, -0 matches 0 */
+      if (d >= 0 && d < cnt && d == (bcode_off_t) d) {
+        return (int) d + 1;
+      }
+      return 0;
+    }
+    case BCODE_SWITCH_TABLE_HASH: {
+      size_t len, lo = 0, hi = cnt;
+      const char *s;
+      uint32_t hash, h, off;
+
+      if (!v7_is_string(v)) return -1;
+      hash = s_hash(v7, v);
+      s = v7_get_string(v7, &v, &len);
+
+      /* find the first entry with the given hash */
+      while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        memcpy(&h, data + mid * 2 * sizeof(uint32_t), sizeof(h));
+        if (h < hash) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+
+      for (; lo < cnt; lo++) {
+        const unsigned char *key;
+        size_t key_len;
+        int llen;
+
+        memcpy(&h, data + lo * 2 * sizeof(uint32_t), sizeof(h));
+        if (h != hash) break;
+        memcpy(&off, data + lo * 2 * sizeof(uint32_t) + sizeof(h), sizeof(off));
+        key = (const unsigned char *) data + off;
+        key_len = decode_varint(key, &llen);
+        if (key_len == len && memcmp(key + llen, s, len) == 0) {
+          return (int) lo + 1;
+        }
+      }
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
 #ifndef V7_NO_FS
 
 static void bcode_serialize_varint(int n, FILE *out) {
@@ -796,6 +1166,11 @@ static const char *bcode_deserialize_func(struct v7 *v7, struct bcode *bcode,
 
   /* get whether the function name is present in `names` */
   bcode->func_name_present = bcode_deserialize_varint(&data);
+#if V7_ENABLE__Memory__stats
+  if (bcode->func_name_present) {
+    v7->bcode_funcs_compiled++;
+  }
+#endif
 
   /* get opcode size */
   size = bcode_deserialize_varint(&data);
@@ -16,6 +16,14 @@
 #define V7_ARGS_CNT_WIDTH 8
 #endif
 
+/*
+ * Frozen functions should contain the complete bcode, so they can't be
+ * compiled on the first call, see `compile_lazy_function()`
+ */
+#if defined(V7_FREEZE) && !defined(V7_DISABLE_LAZY_COMPILE)
+#define V7_DISABLE_LAZY_COMPILE
+#endif
+
 #define V7_NAMES_CNT_MAX ((1 << V7_NAMES_CNT_WIDTH) - 1)
 #define V7_ARGS_CNT_MAX ((1 << V7_ARGS_CNT_WIDTH) - 1)
 
@@ -25,6 +33,7 @@
 #include "v7/src/string.h"
 #include "v7/src/object.h"
 #include "v7/src/primitive.h"
+#include "v7/src/ast.h"
 #include "common/mbuf.h"
 
 enum bcode_inline_lit_type_tag {
@@ -73,8 +82,23 @@ struct bcode {
   void *filename;
 #endif
 
-  /* Reference count */
-  uint8_t refcnt;
+#ifndef V7_DISABLE_LAZY_COMPILE
+  /*
+   * For a function which is not compiled yet: the AST which contains it
+   * (retained by the bcode), the offset of the `AST_FUNC` node, and the line
+   * number the compiler was at. `ast` is `NULL` once the function is compiled,
+   * see `compile_lazy_function()`.
+   */
+  struct ast *ast;
+  ast_off_t ast_off;
+  int line_no;
+#endif
+
+  /*
+   * Reference count: the bcode is retained by each function object created
+   * from it, so it should be wide enough for any number of closures
+   */
+  uint32_t refcnt;
 
   /* Total number of null-terminated strings in the beginning of `ops` */
   unsigned int names_cnt : V7_NAMES_CNT_WIDTH;
@@ -137,6 +161,12 @@ V7_PRIVATE void bcode_builder_finalize(struct bcode_builder *bbuilder);
 V7_PRIVATE void bcode_init(struct bcode *bcode, uint8_t strict_mode,
                            void *filename, uint8_t filename_in_rom);
 V7_PRIVATE void bcode_free(struct v7 *v7, struct bcode *bcode);
+
+/*
+ * Frees ops and literals of the bcode, as well as the names it contains, so
+ * that it can be populated again
+ */
+V7_PRIVATE void bcode_clear(struct v7 *v7, struct bcode *bcode);
 V7_PRIVATE void release_bcode(struct v7 *v7, struct bcode *bcode);
 V7_PRIVATE void retain_bcode(struct v7 *v7, struct bcode *bcode);
 
@@ -306,6 +336,76 @@ V7_PRIVATE size_t bcode_get_varint(char **ops);
 V7_PRIVATE
 v7_val_t bcode_decode_lit(struct v7 *v7, struct bcode *bcode, char **ops);
 
+/*
+ * Returns the number of bytes taken by the literal operand which starts at
+ * `ops` (either an index in the literal table or an inlined literal)
+ */
+V7_PRIVATE size_t bcode_lit_size(const char *ops);
+
+/*
+ * Type of the `OP_SWITCH_TABLE` table. The table consists of:
+ *
+ * - type (1 byte);
+ * - `cnt`: number of keys (`bcode_off_t`);
+ * - `size`: size of the keys data which follows (`bcode_off_t`);
+ * - keys data, see below.
+ *
+ * Jump number `n` (from 1 to `cnt`) is taken for the key number `n - 1`.
+ */
+enum bcode_switch_table_type {
+  /*
+   * Integer keys from `min` to `min + cnt - 1`: the data is just `min`
+   * (`int32_t`). Used for dense integer cases.
+   */
+  BCODE_SWITCH_TABLE_INDEX,
+
+  /*
+   * String keys: the data is `cnt` pairs of `str_hash()` of the key and the
+   * offset of the key from the beginning of the data (both `uint32_t`),
+   * sorted by hash, followed by the keys themselves: varint length and
+   * string bytes.
+   */
+  BCODE_SWITCH_TABLE_HASH,
+};
+
+/* Case key given to `bcode_op_switch_table()` */
+struct bcode_switch_key {
+  int32_t num;     /* for `BCODE_SWITCH_TABLE_INDEX` */
+  const char *str; /* for `BCODE_SWITCH_TABLE_HASH` */
+  size_t len;
+  /*
+   * Set by `bcode_op_switch_table()`: jump number taken for the key, or 0 if
+   * the key is a duplicate of the previous one.
+   */
+  bcode_off_t jmp;
+};
+
+/*
+ * Emits `OP_SWITCH_TABLE` with the table built from the given keys, and
+ * returns the location of its jump target (see `bcode_op_target()`).
+ *
+ * The caller should emit `cnt + 1` `OP_JMP` instructions right after it,
+ * where `cnt` is stored to `*pcnt`.
+ */
+V7_PRIVATE bcode_off_t bcode_op_switch_table(struct bcode_builder *bbuilder,
+                                             enum bcode_switch_table_type type,
+                                             struct bcode_switch_key *keys,
+                                             size_t keys_cnt,
+                                             bcode_off_t *pcnt);
+
+/*
+ * Returns the number of bytes taken by the table of `OP_SWITCH_TABLE` which
+ * starts at `ops` (right after the jump target)
+ */
+V7_PRIVATE size_t bcode_switch_table_size(const char *ops);
+
+/*
+ * Looks up value `v` in the table of `OP_SWITCH_TABLE` which starts at `ops`.
+ * Returns the jump number to take, or -1 if `v` is not of the table's type.
+ */
+V7_PRIVATE int bcode_switch_table_lookup(struct v7 *v7, const char *ops,
+                                         val_t v);
+
 #if defined(V7_BCODE_DUMP) || defined(V7_BCODE_TRACE)
 V7_PRIVATE void dump_op(struct v7 *v7, FILE *f, struct bcode *bcode,
                         char **ops);
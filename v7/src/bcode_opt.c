@@ -0,0 +1,632 @@
+/*
+ * Copyright (c) 2014 Cesanta Software Limited
+ * All rights reserved
+ */
+
+#include "v7/src/internal.h"
+#include "v7/src/bcode_opt.h"
+#include "v7/src/varint.h"
+#include "v7/src/util.h"
+#include "v7/src/eval.h"
+#include "v7/src/primitive.h"
+#include "v7/src/conversion.h"
+
+#ifndef V7_DISABLE_BCODE_OPT
+
+/*
+ * The optimizer decodes the instructions into an array, rewrites the array
+ * and then encodes it back. While the array is being rewritten, jump targets
+ * are kept as instruction indices rather than byte offsets, so instructions
+ * can be removed or merged freely: a removed instruction which is a jump
+ * target passes the label to the instruction which follows it.
+ *
+ * Line numbers are kept in place, and no rewrite spans them.
+ */
+
+enum bopt_flag {
+  BOPT_LINE_NO = (1 << 0), /* line number, not an instruction */
+  BOPT_LABEL = (1 << 1),   /* target of a jump or of a try stack entry */
+  BOPT_DEAD = (1 << 2),    /* removed or merged into a preceding one */
+  BOPT_CONST = (1 << 3),   /* pushes a number or a boolean `val` */
+  BOPT_FOLDED = (1 << 4),  /* `val` is computed, and should be emitted */
+  BOPT_TABLE = (1 << 5),   /* jump of `OP_SWITCH_TABLE`, can't be removed */
+};
+
+struct bopt_insn {
+  bcode_off_t off; /* offset in the original `ops` */
+  bcode_off_t len; /* length in the original `ops`, including opcode */
+  int target;      /* index of the target instruction */
+  int aux;         /* index of the property name for OP_GET_VAR_GET_PROP */
+  val_t val;       /* valid if `BOPT_CONST` is set */
+  uint8_t op;
+  uint8_t flags;
+};
+
+struct bopt {
+  struct v7 *v7;
+  const char *ops;
+  struct bopt_insn *insns;
+  int cnt;
+  int changed;
+};
+
+static int bopt_has_target(uint8_t op) {
+  switch (op) {
+    case OP_JMP:
+    case OP_JMP_TRUE:
+    case OP_JMP_FALSE:
+    case OP_JMP_TRUE_DROP:
+    case OP_JMP_IF_CONTINUE:
+    case OP_TRY_PUSH_CATCH:
+    case OP_TRY_PUSH_FINALLY:
+    case OP_TRY_PUSH_LOOP:
+    case OP_TRY_PUSH_SWITCH:
+    case OP_SWITCH_TABLE:
+    case OP_LT_JMP_TRUE:
+    case OP_LE_JMP_TRUE:
+    case OP_GT_JMP_TRUE:
+    case OP_GE_JMP_TRUE:
+    case OP_LT_JMP_FALSE:
+    case OP_LE_JMP_FALSE:
+    case OP_GT_JMP_FALSE:
+    case OP_GE_JMP_FALSE:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* Whether the next instruction is unreachable unless it's a jump target */
+static int bopt_is_terminator(uint8_t op) {
+  switch (op) {
+    case OP_JMP:
+    case OP_RET:
+    case OP_THROW:
+    case OP_BREAK:
+    case OP_CONTINUE:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+static int bopt_find(struct bopt *o, bcode_off_t off, bcode_off_t end) {
+  int lo = 0, hi = o->cnt - 1;
+  if (off == end) return o->cnt;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (o->insns[mid].off == off) {
+      return mid;
+    } else if (o->insns[mid].off < off) {
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return -1;
+}
+
+/*
+ * Decodes instructions in `[start, end)`. Returns non-zero if the
+ * instructions can't be decoded (e.g. they contain superinstructions
+ * already), in which case bcode is left as is.
+ */
+static int bopt_decode(struct bopt *o, bcode_off_t start, bcode_off_t end) {
+  const char *p = o->ops + start;
+  int cap = 0, i;
+
+  while (p < o->ops + end) {
+    struct bopt_insn *in;
+    uint8_t op = (uint8_t) *p;
+
+    if (o->cnt == cap) {
+      cap = cap == 0 ? 64 : cap * 2;
+      in = (struct bopt_insn *) realloc(o->insns, cap * sizeof(*in));
+      if (in == NULL) return 1;
+      o->insns = in;
+    }
+
+    in = &o->insns[o->cnt++];
+    memset(in, 0, sizeof(*in));
+    in->off = p - o->ops;
+    in->op = op;
+
+    if (op >= _OP_LINE_NO) {
+#ifndef V7_DISABLE_LINE_NUMBERS
+      unsigned char buf[sizeof(size_t)];
+      size_t max_llen = sizeof(buf);
+      int len;
+
+      if (p + max_llen > o->ops + end) {
+        max_llen = o->ops + end - p;
+      }
+      memcpy(buf, p, max_llen);
+      buf[0] = msb_lsb_swap(buf[0]);
+      decode_varint(buf, &len);
+      in->len = len;
+      in->flags = BOPT_LINE_NO;
+#else
+      return 1;
+#endif
+    } else {
+      switch (op) {
+        case OP_PUSH_LIT:
+        case OP_GET_VAR:
+        case OP_SAFE_GET_VAR:
+        case OP_SET_VAR:
+        case OP_ENTER_CATCH:
+          in->len = 1 + bcode_lit_size(p + 1);
+          if (op == OP_PUSH_LIT && p[1] == BCODE_INLINE_NUMBER_TYPE_TAG) {
+            memcpy(&in->val, p + 2, sizeof(in->val));
+            in->flags = BOPT_CONST;
+          }
+          break;
+        case OP_CALL:
+        case OP_NEW:
+          in->len = 2;
+          break;
+        case OP_PUSH_ZERO:
+        case OP_PUSH_ONE:
+          in->len = 1;
+          in->val = v7_mk_number(o->v7, op == OP_PUSH_ONE);
+          in->flags = BOPT_CONST;
+          break;
+        case OP_PUSH_TRUE:
+        case OP_PUSH_FALSE:
+          in->len = 1;
+          in->val = v7_mk_boolean(o->v7, op == OP_PUSH_TRUE);
+          in->flags = BOPT_CONST;
+          break;
+        case OP_SWITCH_TABLE: {
+          bcode_off_t target;
+          memcpy(&target, p + 1, sizeof(target));
+          in->target = target;
+          in->len = 1 + sizeof(target) +
+                    bcode_switch_table_size(p + 1 + sizeof(target));
+          break;
+        }
+        default:
+          if (op >= OP_GET_VAR_GET_PROP) return 1;
+          if (bopt_has_target(op)) {
+            bcode_off_t target;
+            memcpy(&target, p + 1, sizeof(target));
+            in->target = target;
+            in->len = 1 + sizeof(target);
+          } else {
+            in->len = 1;
+          }
+          break;
+      }
+    }
+    p += in->len;
+  }
+
+  if (p != o->ops + end) return 1;
+
+  /* turn target offsets into instruction indices */
+  for (i = 0; i < o->cnt; i++) {
+    struct bopt_insn *in = &o->insns[i];
+    if (!(in->flags & BOPT_LINE_NO) && bopt_has_target(in->op)) {
+      in->target = bopt_find(o, (bcode_off_t) in->target, end);
+      if (in->target < 0) return 1;
+      if (in->target < o->cnt) o->insns[in->target].flags |= BOPT_LABEL;
+    }
+    if (!(in->flags & BOPT_LINE_NO) && in->op == OP_SWITCH_TABLE) {
+      /* the jumps which follow the table are kept in place */
+      bcode_off_t cnt;
+      int k;
+      memcpy(&cnt, o->ops + in->off + 1 + sizeof(bcode_off_t) + 1,
+             sizeof(cnt));
+      for (k = 1; k <= (int) cnt + 1; k++) {
+        if (i + k >= o->cnt ||
+            (o->insns[i + k].flags & BOPT_LINE_NO) ||
+            o->insns[i + k].op != OP_JMP) {
+          return 1;
+        }
+        o->insns[i + k].flags |= BOPT_TABLE;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static void bopt_kill(struct bopt *o, int i) {
+  o->insns[i].flags |= BOPT_DEAD;
+  o->changed = 1;
+}
+
+/* Returns the index of the first live instruction at or after `i` */
+static int bopt_live(struct bopt *o, int i) {
+  while (i < o->cnt && (o->insns[i].flags & BOPT_DEAD)) i++;
+  return i;
+}
+
+static int bopt_prev(struct bopt *o, int i) {
+  do {
+    i--;
+  } while (i >= 0 && (o->insns[i].flags & BOPT_DEAD));
+  return i;
+}
+
+/*
+ * Returns the index of the live instruction following `i`, if it can be
+ * merged into a preceding one: i.e. it's not a jump target, not a line
+ * number, and not a folded constant. Otherwise returns -1.
+ */
+static int bopt_next(struct bopt *o, int i) {
+  i = bopt_live(o, i + 1);
+  if (i >= o->cnt ||
+      (o->insns[i].flags &
+       (BOPT_LABEL | BOPT_LINE_NO | BOPT_FOLDED | BOPT_TABLE))) {
+    return -1;
+  }
+  return i;
+}
+
+static int bopt_next_op(struct bopt *o, int i, uint8_t op) {
+  i = bopt_next(o, i);
+  return (i >= 0 && o->insns[i].op == op) ? i : -1;
+}
+
+static void bopt_set_const(struct bopt *o, int i, val_t v) {
+  o->insns[i].val = v;
+  o->insns[i].flags |= BOPT_CONST | BOPT_FOLDED;
+  o->changed = 1;
+}
+
+static void bopt_fold(struct bopt *o) {
+  struct v7 *v7 = o->v7;
+  int i;
+
+  for (i = 0; i < o->cnt; i++) {
+    struct bopt_insn *in = &o->insns[i], *a, *b;
+    int ia, ib;
+    double da, db;
+
+    if (in->flags & (BOPT_DEAD | BOPT_LINE_NO | BOPT_LABEL)) continue;
+    ia = bopt_prev(o, i);
+    if (ia < 0 || !(o->insns[ia].flags & BOPT_CONST)) continue;
+    a = &o->insns[ia];
+
+    switch (in->op) {
+      case OP_NEG:
+        if (v7_is_number(a->val)) {
+          bopt_set_const(o, ia, v7_mk_number(v7, -v7_get_double(v7, a->val)));
+          bopt_kill(o, i);
+        }
+        break;
+      case OP_LOGICAL_NOT:
+        bopt_set_const(o, ia, v7_mk_boolean(v7, !v7_is_truthy(v7, a->val)));
+        bopt_kill(o, i);
+        break;
+      case OP_JMP_TRUE:
+      case OP_JMP_FALSE:
+        /* the jump is either always taken, or never */
+        if (v7_is_truthy(v7, a->val) == (in->op == OP_JMP_TRUE)) {
+          in->op = OP_JMP;
+        } else {
+          bopt_kill(o, i);
+        }
+        bopt_kill(o, ia);
+        break;
+      case OP_ADD:
+      case OP_SUB:
+      case OP_REM:
+      case OP_MUL:
+      case OP_DIV:
+      case OP_LSHIFT:
+      case OP_RSHIFT:
+      case OP_URSHIFT:
+      case OP_OR:
+      case OP_XOR:
+      case OP_AND:
+      case OP_LT:
+      case OP_LE:
+      case OP_GT:
+      case OP_GE:
+        ib = bopt_prev(o, ia);
+        if ((a->flags & BOPT_LABEL) || ib < 0 ||
+            !(o->insns[ib].flags & BOPT_CONST)) {
+          break;
+        }
+        b = &o->insns[ib];
+        if (!v7_is_number(a->val) || !v7_is_number(b->val)) break;
+        da = v7_get_double(v7, b->val);
+        db = v7_get_double(v7, a->val);
+        if (in->op >= OP_LT) {
+          bopt_set_const(
+              o, ib, v7_mk_boolean(v7, b_bool_bin_op((enum opcode) in->op,
+                                                     da, db)));
+        } else if (b_num_bin_op_can_fold((enum opcode) in->op, da, db)) {
+          bopt_set_const(
+              o, ib,
+              v7_mk_number(v7, b_num_bin_op((enum opcode) in->op, da, db)));
+        } else {
+          break;
+        }
+        bopt_kill(o, ia);
+        bopt_kill(o, i);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+/*
+ * Retargets jumps to unconditional jumps to the final destination, and
+ * recomputes labels for the live instructions.
+ */
+static void bopt_thread_jumps(struct bopt *o) {
+  int i;
+
+  for (i = 0; i < o->cnt; i++) {
+    o->insns[i].flags &= ~BOPT_LABEL;
+  }
+
+  for (i = 0; i < o->cnt; i++) {
+    struct bopt_insn *in = &o->insns[i];
+    int t, n;
+
+    if ((in->flags & (BOPT_DEAD | BOPT_LINE_NO)) || !bopt_has_target(in->op)) {
+      continue;
+    }
+
+    t = bopt_live(o, in->target);
+    if (in->op < OP_TRY_PUSH_CATCH || in->op > OP_TRY_PUSH_SWITCH) {
+      for (n = 0; t < o->cnt && n < o->cnt; n++) {
+        struct bopt_insn *tin = &o->insns[t];
+        if ((tin->flags & BOPT_LINE_NO) || tin->op != OP_JMP) break;
+        t = bopt_live(o, tin->target);
+      }
+    }
+
+    if (t != in->target) {
+      in->target = t;
+      o->changed = 1;
+    }
+    if (t < o->cnt) o->insns[t].flags |= BOPT_LABEL;
+  }
+}
+
+static void bopt_remove_dead_code(struct bopt *o) {
+  int i, j;
+
+  for (i = 0; i < o->cnt; i++) {
+    struct bopt_insn *in = &o->insns[i];
+    if ((in->flags & (BOPT_DEAD | BOPT_LINE_NO)) ||
+        !bopt_is_terminator(in->op)) {
+      continue;
+    }
+
+    for (j = i + 1;
+         j < o->cnt && !(o->insns[j].flags & (BOPT_LABEL | BOPT_TABLE)); j++) {
+      if (!(o->insns[j].flags & BOPT_DEAD)) bopt_kill(o, j);
+    }
+
+    /* jump to the next instruction */
+    if (in->op == OP_JMP && !(in->flags & BOPT_TABLE) &&
+        bopt_live(o, i + 1) == in->target) {
+      bopt_kill(o, i);
+    }
+  }
+}
+
+static int bopt_same_operand(struct bopt *o, int i, int j) {
+  struct bopt_insn *a = &o->insns[i], *b = &o->insns[j];
+  return a->len == b->len &&
+         memcmp(o->ops + a->off + 1, o->ops + b->off + 1, a->len - 1) == 0;
+}
+
+/*
+ * `GET_VAR a; [STASH;] PUSH_ONE; ADD; SET_VAR a; [UNSTASH; DROP]`
+ * becomes `INC_VAR a; [DROP]` (likewise with SUB). The postfix form is only
+ * merged when its value is dropped, since it differs from the prefix one.
+ */
+static int bopt_fuse_inc(struct bopt *o, int i) {
+  int stash = bopt_next_op(o, i, OP_STASH);
+  int one = bopt_next_op(o, stash >= 0 ? stash : i, OP_PUSH_ONE);
+  int add = one >= 0 ? bopt_next(o, one) : -1;
+  int set = add >= 0 ? bopt_next_op(o, add, OP_SET_VAR) : -1;
+  int unstash = -1;
+  uint8_t op;
+
+  if (set < 0 || !bopt_same_operand(o, i, set)) return 0;
+  if (o->insns[add].op == OP_ADD) {
+    op = OP_INC_VAR;
+  } else if (o->insns[add].op == OP_SUB) {
+    op = OP_DEC_VAR;
+  } else {
+    return 0;
+  }
+
+  if (stash >= 0) {
+    unstash = bopt_next_op(o, set, OP_UNSTASH);
+    if (unstash < 0 || bopt_next_op(o, unstash, OP_DROP) < 0) return 0;
+    bopt_kill(o, stash);
+    bopt_kill(o, unstash);
+  }
+
+  bopt_kill(o, one);
+  bopt_kill(o, add);
+  bopt_kill(o, set);
+  o->insns[i].op = op;
+  return 1;
+}
+
+static void bopt_fuse(struct bopt *o) {
+  int i, j, k;
+
+  for (i = 0; i < o->cnt; i++) {
+    struct bopt_insn *in = &o->insns[i];
+    if (in->flags & (BOPT_DEAD | BOPT_LINE_NO | BOPT_FOLDED)) continue;
+
+    switch (in->op) {
+      case OP_GET_VAR:
+        if (bopt_fuse_inc(o, i)) break;
+        /* `GET_VAR a; PUSH_LIT b; GET` */
+        if ((j = bopt_next_op(o, i, OP_PUSH_LIT)) >= 0 &&
+            (k = bopt_next_op(o, j, OP_GET)) >= 0) {
+          in->op = OP_GET_VAR_GET_PROP;
+          in->aux = j;
+          bopt_kill(o, j);
+          bopt_kill(o, k);
+        }
+        break;
+      case OP_PUSH_LIT:
+        if ((j = bopt_next_op(o, i, OP_ADD)) >= 0) {
+          in->op = OP_PUSH_LIT_ADD;
+          bopt_kill(o, j);
+        }
+        break;
+      case OP_LT:
+      case OP_LE:
+      case OP_GT:
+      case OP_GE:
+        if ((j = bopt_next(o, i)) >= 0 && (o->insns[j].op == OP_JMP_TRUE ||
+                                            o->insns[j].op == OP_JMP_FALSE)) {
+          in->op = (o->insns[j].op == OP_JMP_TRUE ? OP_LT_JMP_TRUE
+                                                   : OP_LT_JMP_FALSE) +
+                   (in->op - OP_LT);
+          in->target = o->insns[j].target;
+          bopt_kill(o, j);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+static size_t bopt_const_size(struct bopt *o, val_t v) {
+  if (v7_is_boolean(v) || v == v7_mk_number(o->v7, 0) ||
+      v == v7_mk_number(o->v7, 1)) {
+    return 1;
+  }
+  return 2 + sizeof(val_t);
+}
+
+static size_t bopt_size(struct bopt *o, struct bopt_insn *in) {
+  if (in->flags & BOPT_FOLDED) {
+    return bopt_const_size(o, in->val);
+  } else if (in->flags & BOPT_LINE_NO) {
+    return in->len;
+  } else if (in->op == OP_GET_VAR_GET_PROP) {
+    return in->len + o->insns[in->aux].len - 1;
+  } else if (in->op == OP_SWITCH_TABLE) {
+    return in->len;
+  } else if (bopt_has_target(in->op)) {
+    return 1 + sizeof(bcode_off_t);
+  }
+  return in->len;
+}
+
+static void bopt_emit_const(struct bopt *o, struct mbuf *m, val_t v) {
+  uint8_t op;
+  if (v7_is_boolean(v)) {
+    op = v7_get_bool(o->v7, v) ? OP_PUSH_TRUE : OP_PUSH_FALSE;
+  } else if (v == v7_mk_number(o->v7, 0)) {
+    op = OP_PUSH_ZERO;
+  } else if (v == v7_mk_number(o->v7, 1)) {
+    op = OP_PUSH_ONE;
+  } else {
+    uint8_t tag = BCODE_INLINE_NUMBER_TYPE_TAG;
+    op = OP_PUSH_LIT;
+    mbuf_append(m, &op, 1);
+    mbuf_append(m, &tag, 1);
+    mbuf_append(m, &v, sizeof(v));
+    return;
+  }
+  mbuf_append(m, &op, 1);
+}
+
+/* Encodes live instructions, preceded by the first `start` bytes of `ops` */
+static void bopt_encode(struct bopt *o, bcode_off_t start, struct mbuf *m) {
+  bcode_off_t *offs, off = start;
+  int i;
+
+  offs = (bcode_off_t *) malloc((o->cnt + 1) * sizeof(*offs));
+  if (offs == NULL) abort();
+  for (i = 0; i < o->cnt; i++) {
+    offs[i] = off;
+    if (!(o->insns[i].flags & BOPT_DEAD)) {
+      off += bopt_size(o, &o->insns[i]);
+    }
+  }
+  offs[o->cnt] = off;
+
+  mbuf_init(m, off);
+  mbuf_append(m, o->ops, start);
+
+  for (i = 0; i < o->cnt; i++) {
+    struct bopt_insn *in = &o->insns[i];
+    if (in->flags & BOPT_DEAD) continue;
+
+    if (in->flags & BOPT_FOLDED) {
+      bopt_emit_const(o, m, in->val);
+    } else if (in->flags & BOPT_LINE_NO) {
+      mbuf_append(m, o->ops + in->off, in->len);
+    } else {
+      mbuf_append(m, &in->op, 1);
+      if (bopt_has_target(in->op)) {
+        mbuf_append(m, &offs[in->target], sizeof(bcode_off_t));
+        if (in->op == OP_SWITCH_TABLE) {
+          /* the table itself */
+          mbuf_append(m, o->ops + in->off + 1 + sizeof(bcode_off_t),
+                      in->len - 1 - sizeof(bcode_off_t));
+        }
+      } else {
+        mbuf_append(m, o->ops + in->off + 1, in->len - 1);
+        if (in->op == OP_GET_VAR_GET_PROP) {
+          struct bopt_insn *name = &o->insns[in->aux];
+          mbuf_append(m, o->ops + name->off + 1, name->len - 1);
+        }
+      }
+    }
+  }
+
+  assert(m->len == off);
+  free(offs);
+}
+
+V7_PRIVATE void bcode_optimize(struct bcode_builder *bbuilder) {
+  struct bopt o;
+  bcode_off_t start, end = bbuilder->ops.len;
+  struct mbuf m;
+
+  if (end == 0) return;
+
+  memset(&o, 0, sizeof(o));
+  o.v7 = bbuilder->v7;
+  o.ops = bbuilder->ops.buf;
+  start = bcode_end_names(bbuilder->ops.buf, bbuilder->bcode->names_cnt) -
+          bbuilder->ops.buf;
+
+  if (bopt_decode(&o, start, end) == 0) {
+    bopt_fold(&o);
+    bopt_thread_jumps(&o);
+    bopt_remove_dead_code(&o);
+    bopt_fuse(&o);
+
+    if (o.changed) {
+      bopt_encode(&o, start, &m);
+#if V7_ENABLE__Memory__stats
+      bbuilder->v7->bcode_ops_size -= bbuilder->ops.len;
+      bbuilder->v7->bcode_ops_size += m.len;
+#endif
+      mbuf_free(&bbuilder->ops);
+      bbuilder->ops = m;
+    }
+  }
+
+  free(o.insns);
+}
+
+#else
+
+V7_PRIVATE void bcode_optimize(struct bcode_builder *bbuilder) {
+  (void) bbuilder;
+}
+
+#endif /* V7_DISABLE_BCODE_OPT */
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2014 Cesanta Software Limited
+ * All rights reserved
+ */
+
+#ifndef CS_V7_SRC_BCODE_OPT_H_
+#define CS_V7_SRC_BCODE_OPT_H_
+
+#include "v7/src/internal.h"
+#include "v7/src/bcode.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Peephole optimizer: rewrites the instructions collected by the builder
+ * before it's finalized. It folds constant expressions, threads jumps to
+ * jumps, removes unreachable code and replaces common instruction sequences
+ * with superinstructions (see `OP_GET_VAR_GET_PROP` and below).
+ *
+ * The rewritten bcode behaves exactly like the original one, including
+ * line numbers, and can be serialized and dumped as usual.
+ *
+ * Does nothing if v7 is built with `V7_DISABLE_BCODE_OPT`.
+ */
+V7_PRIVATE void bcode_optimize(struct bcode_builder *bbuilder);
+
+#if defined(__cplusplus)
+}
+#endif /* __cplusplus */
+
+#endif /* CS_V7_SRC_BCODE_OPT_H_ */
@@ -5,6 +5,7 @@
 
 #include "v7/src/internal.h"
 #include "v7/src/compiler.h"
+#include "v7/src/bcode_opt.h"
 #include "v7/src/std_error.h"
 #include "v7/src/core.h"
 #include "v7/src/function.h"
@@ -960,7 +961,26 @@ V7_PRIVATE enum v7_err compile_expr_builder(struct bcode_builder *bbuilder,
       flit = bcode_add_lit(bbuilder, funv);
 
       *ppos = pos_after_tag - 1;
-      V7_TRY(compile_function(v7, a, ppos, func->bcode));
+#ifndef V7_DISABLE_LAZY_COMPILE
+      if (a->refcnt > 0 && !v7->is_precompiling) {
+        /*
+         * The AST lifetime is managed by refcount, so the function can be
+         * compiled on its first call: just retain the AST and skip the
+         * function, see `compile_lazy_function()`
+         */
+        func->bcode->ast = a;
+        func->bcode->ast_off = *ppos;
+        func->bcode->line_no = v7->line_no;
+        a->refcnt++;
+#if V7_ENABLE__Memory__stats
+        v7->bcode_funcs_pending++;
+#endif
+        *ppos = ast_get_skip(a, pos_after_tag, AST_END_SKIP);
+      } else
+#endif
+      {
+        V7_TRY(compile_function(v7, a, ppos, func->bcode));
+      }
       bcode_push_lit(bbuilder, flit);
       bcode_op(bbuilder, OP_FUNC_LIT);
       break;
@@ -1046,6 +1066,84 @@ clean:
 V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
                                     struct ast *a, ast_off_t *ppos);
 
+/*
+ * Minimal number of cases a switch statement should have in order to be
+ * compiled with `OP_SWITCH_TABLE`
+ */
+#ifndef V7_SWITCH_TABLE_MIN_CASES
+#define V7_SWITCH_TABLE_MIN_CASES 4
+#endif
+
+/* Case of a switch statement compiled with `OP_SWITCH_TABLE` */
+struct switch_case {
+  bcode_off_t pos; /* offset of the case body */
+  int line_no;     /* line number after the case expression */
+};
+
+/*
+ * Checks whether the switch statement with the cases in `[pos, end)` can be
+ * compiled with `OP_SWITCH_TABLE`: all the case expressions should be either
+ * strings, or integers which are dense enough. If so, appends the key of
+ * each case to `keys` (`struct bcode_switch_key`), sets `*type` and returns
+ * non-zero.
+ */
+static int switch_table_keys(struct ast *a, ast_off_t pos, ast_off_t end,
+                             struct mbuf *keys,
+                             enum bcode_switch_table_type *type) {
+  int cases = 0, strings = 0;
+  int32_t min = 0, max = 0;
+
+  while (pos < end) {
+    enum ast_tag tag = ast_fetch_tag(a, &pos);
+    ast_off_t case_end = ast_get_skip(a, pos, AST_END_SKIP);
+
+    ast_move_to_children(a, &pos);
+    if (tag == AST_CASE) {
+      struct bcode_switch_key k;
+      memset(&k, 0, sizeof(k));
+
+      switch (ast_fetch_tag(a, &pos)) {
+        case AST_STRING:
+          k.str = ast_get_inlined_data(a, pos, &k.len);
+          strings++;
+          break;
+        case AST_NUM: {
+          double d = ast_get_num(a, pos);
+          if (!(d >= -2147483648.0 && d <= 2147483647.0) ||
+              d != (int32_t) d) {
+            return 0;
+          }
+          k.num = (int32_t) d;
+          if (cases == strings) {
+            min = max = k.num;
+          } else if (k.num < min) {
+            min = k.num;
+          } else if (k.num > max) {
+            max = k.num;
+          }
+          break;
+        }
+        default:
+          return 0;
+      }
+      mbuf_append(keys, &k, sizeof(k));
+      cases++;
+    }
+    pos = case_end;
+  }
+
+  if (cases < V7_SWITCH_TABLE_MIN_CASES) {
+    return 0;
+  } else if (strings == cases) {
+    *type = BCODE_SWITCH_TABLE_HASH;
+  } else if (strings == 0 && (int64_t) max - min < 2 * cases) {
+    *type = BCODE_SWITCH_TABLE_INDEX;
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
 V7_PRIVATE enum v7_err compile_stmts(struct bcode_builder *bbuilder,
                                      struct ast *a, ast_off_t *ppos,
                                      ast_off_t end) {
@@ -1070,13 +1168,15 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
   enum ast_tag tag;
   ast_off_t cond, pos_after_tag;
   bcode_off_t body_target, body_label, cond_label;
-  struct mbuf case_labels;
+  struct mbuf case_labels, switch_keys, switch_cases;
   enum v7_err rcode = V7_OK;
   struct v7 *v7 = bbuilder->v7;
 
   tag = fetch_tag(v7, bbuilder, a, ppos, &pos_after_tag);
 
   mbuf_init(&case_labels, 0);
+  mbuf_init(&switch_keys, 0);
+  mbuf_init(&switch_cases, 0);
 
   switch (tag) {
     /*
@@ -1399,12 +1499,35 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
      *
      * Before emitting a case/default block (except the first one) we have to
      * drop the TOS resulting from evaluating the last expression
+     *
+     * If all the cases are literals (see `switch_table_keys()`), the
+     * comparisons are preceded with a table lookup, which handles the values
+     * of the same type as the cases:
+     *
+     *   TRY_PUSH_SWITCH end
+     *   <E>
+     *   SWITCH_TABLE cmp, <table>
+     *   JMP miss
+     *   JMP l1
+     *   JMP l2
+     * cmp:
+     *   DUP
+     *   <C1>
+     *   ...
+     *   DROP
+     * miss:
+     *   JMP dfl
+     *
+     * Case bodies start with their line numbers, since the table lookup skips
+     * the ones of the comparisons.
      */
     case AST_SWITCH: {
-      bcode_off_t dfl_label, end_label;
+      bcode_off_t dfl_label, end_label, miss_pos, table_jmps = 0;
+      bcode_off_t table_cnt = 0, n;
       ast_off_t case_end, case_start;
       enum ast_tag case_tag;
-      int i, has_default = 0, cases = 0;
+      enum bcode_switch_table_type table_type;
+      int i, has_default = 0, cases = 0, use_table, table_line_no = 0;
 
       end = ast_get_skip(a, pos_after_tag, AST_END_SKIP);
 
@@ -1413,6 +1536,20 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
       V7_TRY(compile_expr_builder(bbuilder, a, ppos));
 
       case_start = *ppos;
+      use_table = switch_table_keys(a, case_start, end, &switch_keys,
+                                    &table_type);
+      if (use_table) {
+        bcode_off_t cmp_label = bcode_op_switch_table(
+            bbuilder, table_type, (struct bcode_switch_key *) switch_keys.buf,
+            switch_keys.len / sizeof(struct bcode_switch_key), &table_cnt);
+        table_jmps = bcode_op_target(bbuilder, OP_JMP);
+        for (n = 0; n < table_cnt; n++) {
+          bcode_op_target(bbuilder, OP_JMP);
+        }
+        bcode_patch_target(bbuilder, cmp_label, bcode_pos(bbuilder));
+        table_line_no = v7->line_no;
+      }
+
       /* first pass: evaluate case expression and generate jump table */
       while (*ppos < end) {
         case_tag = fetch_tag(v7, bbuilder, a, ppos, &pos_after_tag);
@@ -1432,6 +1569,12 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
             case_label = bcode_op_target(bbuilder, OP_JMP_TRUE_DROP);
             cases++;
             mbuf_append(&case_labels, &case_label, sizeof(case_label));
+            if (use_table) {
+              struct switch_case sc;
+              sc.pos = 0;
+              sc.line_no = v7->line_no;
+              mbuf_append(&switch_cases, &sc, sizeof(sc));
+            }
             break;
           }
           default:
@@ -1442,6 +1585,12 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
 
       /* jmp table epilogue: unconditional jump to default case */
       bcode_op(bbuilder, OP_DROP);
+      miss_pos = bcode_pos(bbuilder);
+      if (use_table && v7->line_no != table_line_no) {
+        int line_no = v7->line_no;
+        v7->line_no = 0;
+        append_lineno_if_changed(v7, bbuilder, line_no);
+      }
       dfl_label = bcode_op_target(bbuilder, OP_JMP);
 
       *ppos = case_start;
@@ -1463,6 +1612,15 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
           case AST_CASE: {
             bcode_off_t case_label = ((bcode_off_t *) case_labels.buf)[i++];
             bcode_patch_target(bbuilder, case_label, bcode_pos(bbuilder));
+            if (use_table) {
+              struct switch_case *sc =
+                  &((struct switch_case *) switch_cases.buf)[i - 1];
+              sc->pos = bcode_pos(bbuilder);
+              if (sc->line_no != table_line_no) {
+                v7->line_no = 0;
+                append_lineno_if_changed(v7, bbuilder, sc->line_no);
+              }
+            }
             ast_skip_tree(a, ppos);
             V7_TRY(compile_stmts(bbuilder, a, ppos, case_end));
             break;
@@ -1479,6 +1637,25 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
         bcode_patch_target(bbuilder, dfl_label, bcode_pos(bbuilder));
       }
 
+      if (use_table) {
+        /* jumps of the table: to the cases, or to the default one */
+        struct bcode_switch_key *keys =
+            (struct bcode_switch_key *) switch_keys.buf;
+        struct switch_case *sc = (struct switch_case *) switch_cases.buf;
+        const size_t jmp_size = 1 + sizeof(bcode_off_t);
+        for (n = 0; n <= table_cnt; n++) {
+          bcode_patch_target(bbuilder, table_jmps + n * jmp_size, miss_pos);
+        }
+        for (i = 0; i < cases; i++) {
+          if (keys[i].jmp != 0) {
+            bcode_patch_target(bbuilder, table_jmps + keys[i].jmp * jmp_size,
+                               sc[i].pos);
+          }
+        }
+        mbuf_free(&switch_keys);
+        mbuf_free(&switch_cases);
+      }
+
       bcode_patch_target(bbuilder, end_label, bcode_pos(bbuilder));
       bcode_op(bbuilder, OP_TRY_POP);
 
@@ -1833,6 +2010,8 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
 
 clean:
   mbuf_free(&case_labels);
+  mbuf_free(&switch_keys);
+  mbuf_free(&switch_cases);
   return rcode;
 }
 
@@ -1902,6 +2081,9 @@ V7_PRIVATE enum v7_err compile_script(struct v7 *v7, struct ast *a,
 
 clean:
 
+  if (rcode == V7_OK) {
+    bcode_optimize(&bbuilder);
+  }
   bcode_builder_finalize(&bbuilder);
 
 #ifdef V7_BCODE_DUMP
@@ -1971,10 +2153,16 @@ V7_PRIVATE enum v7_err compile_function(struct v7 *v7, struct ast *a,
 
   bcode->args_cnt = args_cnt;
   bcode->func_name_present = 1;
+#if V7_ENABLE__Memory__stats
+  v7->bcode_funcs_compiled++;
+#endif
 
   V7_TRY(compile_body(&bbuilder, a, start, end, body, fvar, ppos));
 
 clean:
+  if (rcode == V7_OK) {
+    bcode_optimize(&bbuilder);
+  }
   bcode_builder_finalize(&bbuilder);
 
 #ifdef V7_BCODE_DUMP
@@ -1987,6 +2175,135 @@ clean:
   return rcode;
 }
 
+V7_PRIVATE void compile_script_decls_init(struct v7 *v7,
+                                          struct bcode_builder *bbuilder,
+                                          struct bcode *bcode) {
+  bcode_builder_init(v7, bbuilder, bcode);
+
+  /* `compile_local_vars()` assumes that the stack contains `undefined` */
+  bcode_op(bbuilder, OP_PUSH_UNDEFINED);
+}
+
+V7_PRIVATE enum v7_err compile_script_decls(struct bcode_builder *bbuilder,
+                                            struct ast *a) {
+  ast_off_t pos_after_tag, fvar, pos = 0;
+  struct v7 *v7 = bbuilder->v7;
+  int saved_line_no = v7->line_no;
+  enum v7_err rcode = V7_OK;
+  enum ast_tag tag;
+
+  /* line numbers in the AST of each statement start from 1 */
+  v7->line_no = 1;
+
+  tag = fetch_tag(v7, bbuilder, a, &pos, &pos_after_tag);
+  assert(tag == AST_SCRIPT);
+  (void) tag;
+
+  fvar = ast_get_skip(a, pos_after_tag, AST_FUNC_FIRST_VAR_SKIP) - 1;
+  V7_TRY(compile_local_vars(bbuilder, a, pos_after_tag - 1, fvar));
+
+clean:
+  v7->line_no = saved_line_no;
+  return rcode;
+}
+
+V7_PRIVATE void compile_script_decls_finalize(struct bcode_builder *bbuilder) {
+  bcode_optimize(bbuilder);
+  bcode_builder_finalize(bbuilder);
+
+#ifdef V7_BCODE_DUMP
+  fprintf(stderr, "--- script declarations ---\n");
+  dump_bcode(bbuilder->v7, stderr, bbuilder->bcode);
+#endif
+}
+
+V7_PRIVATE enum v7_err compile_script_stmt(struct v7 *v7, struct ast *a,
+                                           struct bcode *bcode, val_t init) {
+  ast_off_t pos_after_tag, end, pos = 0, tmp_pos;
+  int saved_line_no = v7->line_no;
+  enum v7_err rcode = V7_OK;
+  struct bcode_builder bbuilder;
+  enum ast_tag tag;
+
+  bcode_builder_init(v7, &bbuilder, bcode);
+  v7->line_no = 1;
+
+  tag = fetch_tag(v7, &bbuilder, a, &pos, &pos_after_tag);
+  assert(tag == AST_SCRIPT);
+  (void) tag;
+
+  end = ast_get_skip(a, pos_after_tag, AST_END_SKIP);
+
+  /* strict mode is set by the caller for all the statements */
+  tmp_pos = pos;
+  if (pos < end &&
+      fetch_tag(v7, &bbuilder, a, &tmp_pos, NULL) == AST_USE_STRICT) {
+    pos = tmp_pos;
+  }
+
+  if (v7_is_undefined(init)) {
+    bcode_op(&bbuilder, OP_PUSH_UNDEFINED);
+  } else {
+    bcode_push_lit(&bbuilder, bcode_add_lit(&bbuilder, init));
+  }
+
+  /* declarations are compiled by `compile_script_decls()` */
+  V7_TRY(compile_stmts(&bbuilder, a, &pos, end));
+
+clean:
+  if (rcode == V7_OK) {
+    bcode_optimize(&bbuilder);
+  }
+  bcode_builder_finalize(&bbuilder);
+
+#ifdef V7_BCODE_DUMP
+  if (rcode == V7_OK) {
+    fprintf(stderr, "--- script statement ---\n");
+    dump_bcode(v7, stderr, bcode);
+  }
+#endif
+
+  v7->line_no = saved_line_no;
+
+  return rcode;
+}
+
+V7_PRIVATE enum v7_err compile_lazy_function(struct v7 *v7,
+                                             struct bcode *bcode) {
+  enum v7_err rcode = V7_OK;
+#ifndef V7_DISABLE_LAZY_COMPILE
+  struct ast *a = bcode->ast;
+  ast_off_t pos = bcode->ast_off;
+  int saved_line_no = v7->line_no;
+
+  if (a == NULL) {
+    /* Already compiled */
+    return V7_OK;
+  }
+
+  v7->line_no = bcode->line_no;
+  rcode = compile_function(v7, a, &pos, bcode);
+  v7->line_no = saved_line_no;
+
+  if (rcode != V7_OK) {
+    /* Leave the function pending, so that the next call throws again */
+    bcode_clear(v7, bcode);
+    return rcode;
+  }
+
+  bcode->ast = NULL;
+#if V7_ENABLE__Memory__stats
+  v7->bcode_funcs_pending--;
+#endif
+  release_ast(v7, a);
+#else
+  (void) v7;
+  (void) bcode;
+#endif
+
+  return rcode;
+}
+
 V7_PRIVATE enum v7_err compile_expr(struct v7 *v7, struct ast *a,
                                     ast_off_t *ppos, struct bcode *bcode) {
   enum v7_err rcode = V7_OK;
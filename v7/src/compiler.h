@@ -20,6 +20,42 @@ V7_PRIVATE enum v7_err compile_script(struct v7 *v7, struct ast *a,
 V7_PRIVATE enum v7_err compile_expr(struct v7 *v7, struct ast *a,
                                     ast_off_t *ppos, struct bcode *bcode);
 
+/*
+ * A script can also be compiled and evaluated statement by statement, see
+ * `parse_stmt()`. Declarations are hoisted the same way as in a script
+ * compiled as a whole: declarations of all the statements are compiled into
+ * the single bcode, which is evaluated first, and then each statement is
+ * compiled and evaluated in turn.
+ *
+ * `compile_script_decls()` appends the declarations of the statement `a` to
+ * the bcode being built: names of its `var`s and `function`s, and hoisted
+ * functions. The builder should be prepared with `compile_script_decls_init()`
+ * and finalized with `compile_script_decls_finalize()`.
+ */
+V7_PRIVATE void compile_script_decls_init(struct v7 *v7,
+                                          struct bcode_builder *bbuilder,
+                                          struct bcode *bcode);
+V7_PRIVATE enum v7_err compile_script_decls(struct bcode_builder *bbuilder,
+                                            struct ast *a);
+V7_PRIVATE void compile_script_decls_finalize(struct bcode_builder *bbuilder);
+
+/*
+ * Compiles the statement `a` without its declarations. The completion value
+ * of the bcode is `init` unless the statement yields some value, so `init`
+ * should be the completion value of the previous statement.
+ */
+V7_PRIVATE enum v7_err compile_script_stmt(struct v7 *v7, struct ast *a,
+                                           struct bcode *bcode, val_t init);
+
+/*
+ * Compiles a function whose compilation was deferred until its first call:
+ * functions are only skipped when the script is compiled, if the AST lifetime
+ * is managed by refcount (see `struct bcode::ast`). Does nothing if the
+ * function is already compiled.
+ */
+V7_PRIVATE enum v7_err compile_lazy_function(struct v7 *v7,
+                                             struct bcode *bcode);
+
 #if defined(__cplusplus)
 }
 #endif /* __cplusplus */
@@ -45,6 +45,26 @@ static void save_val(struct v7 *v7, const char *str, size_t str_len,
   }
 }
 
+V7_PRIVATE int number_to_str(char *buf, size_t buf_size, double num) {
+  if (isnan(num)) {
+    return c_snprintf(buf, buf_size, "NaN");
+  } else if (isinf(num)) {
+    return c_snprintf(buf, buf_size, num < 0.0 ? "-Infinity" : "Infinity");
+  } else {
+/*
+ * ESP8266's sprintf doesn't support double & float.
+ * TODO(alashkin): fix this
+ */
+#ifndef V7_TEMP_OFF
+    const char *fmt = num > 1e10 ? "%.21g" : "%.10g";
+    return snprintf(buf, buf_size, fmt, num);
+#else
+    const int prec = num > 1e10 ? 21 : 10;
+    return double_to_str(buf, buf_size, num, prec);
+#endif
+  }
+}
+
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err primitive_to_str(struct v7 *v7, val_t v, val_t *res,
                                         char *buf, size_t buf_size,
@@ -108,37 +128,11 @@ V7_PRIVATE enum v7_err primitive_to_str(struct v7 *v7, val_t v, val_t *res,
         goto clean;
       }
     case V7_TYPE_NUMBER:
-      if (v == V7_TAG_NAN) {
-        strncpy(tmp_buf, "NaN", sizeof(tmp_buf) - 1);
-        save_val(v7, tmp_buf, strlen(tmp_buf), res, buf, buf_size, -1, res_len);
-        goto clean;
-      }
       num = v7_get_double(v7, v);
-      if (isinf(num)) {
-        if (num < 0.0) {
-          strncpy(tmp_buf, "-Infinity", sizeof(tmp_buf) - 1);
-        } else {
-          strncpy(tmp_buf, "Infinity", sizeof(tmp_buf) - 1);
-        }
-        save_val(v7, tmp_buf, strlen(tmp_buf), res, buf, buf_size, -1, res_len);
-        goto clean;
-      }
-      {
-/*
- * ESP8266's sprintf doesn't support double & float.
- * TODO(alashkin): fix this
- */
-#ifndef V7_TEMP_OFF
-        const char *fmt = num > 1e10 ? "%.21g" : "%.10g";
-        wanted_len = snprintf(tmp_buf, sizeof(tmp_buf), fmt, num);
-#else
-        const int prec = num > 1e10 ? 21 : 10;
-        wanted_len = double_to_str(tmp_buf, sizeof(tmp_buf), num, prec);
-#endif
-        save_val(v7, tmp_buf, strlen(tmp_buf), res, buf, buf_size, wanted_len,
-                 res_len);
-        goto clean;
-      }
+      wanted_len = number_to_str(tmp_buf, sizeof(tmp_buf), num);
+      save_val(v7, tmp_buf, strlen(tmp_buf), res, buf, buf_size, wanted_len,
+               res_len);
+      goto clean;
     case V7_TYPE_CFUNCTION:
 #ifdef V7_UNIT_TEST
       wanted_len = c_snprintf(tmp_buf, sizeof(tmp_buf), "cfunc_xxxxxx");
@@ -613,9 +607,10 @@ V7_PRIVATE enum v7_err to_json_or_debug(struct v7 *v7, val_t v, char *buf,
 
       mbuf_append(&v7->json_visited_stack, (char *) &v, sizeof(v));
       b += c_snprintf(b, BUF_LEFT(size, b - buf), "{");
-      while ((h = v7_next_prop(h, v, &name, &val, &attrs)) != NULL) {
+      while ((h = obj_next_prop(h, v, &name, &val, &attrs)) != NULL) {
         size_t n;
         const char *s;
+        char ibuf[V7_INDEX_BUF_SIZE];
         if (attrs & (_V7_PROPERTY_HIDDEN | V7_PROPERTY_NON_ENUMERABLE)) {
           continue;
         }
@@ -625,7 +620,7 @@ V7_PRIVATE enum v7_err to_json_or_debug(struct v7 *v7, val_t v, char *buf,
         if (b - buf != 1) { /* Not the first property to be printed */
           b += c_snprintf(b, BUF_LEFT(size, b - buf), ",");
         }
-        s = v7_get_string(v7, &name, &n);
+        s = prop_name_get_string(v7, &name, ibuf, &n);
         b += c_snprintf(b, BUF_LEFT(size, b - buf), "\"%.*s\":", (int) n, s);
         {
           size_t tmp = 0;
@@ -185,6 +185,13 @@ V7_PRIVATE enum v7_err primitive_to_str(struct v7 *v7, val_t v, val_t *res,
                                         char *buf, size_t buf_size,
                                         size_t *res_len);
 
+/*
+ * Format number into the C buffer `buf` the way `primitive_to_str()` does.
+ * Returns the length of the whole string, like `snprintf()`: if it's not less
+ * than `buf_size`, the string is truncated.
+ */
+V7_PRIVATE int number_to_str(char *buf, size_t buf_size, double num);
+
 /*
  * Convert primitive value to number, using common JavaScript semantics. If you
  * need to convert any value to number (either object or primitive), see
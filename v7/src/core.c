@@ -15,21 +15,16 @@
 #include "v7/src/gc.h"
 #include "v7/src/heapusage.h"
 #include "v7/src/eval.h"
+#include "v7/src/string.h"
+#include "v7/src/regexp.h"
+#include "v7/src/loop.h"
 
 #ifdef V7_THAW
 extern struct v7_vals *fr_vals;
 #endif
 
-#ifdef HAS_V7_INFINITY
-double _v7_infinity;
-#endif
-
-#ifdef HAS_V7_NAN
-double _v7_nan;
-#endif
-
 #if defined(V7_CYG_PROFILE_ON)
-struct v7 *v7_head = NULL;
+V7_THREAD_LOCAL struct v7 *v7_head = NULL;
 #endif
 
 static void generic_object_destructor(struct v7 *v7, void *ptr) {
@@ -58,6 +53,8 @@ static void generic_object_destructor(struct v7 *v7, void *ptr) {
     }
   }
 
+  obj_free_prop_table(&o->base);
+
   if (o->base.attributes & V7_OBJ_HAS_DESTRUCTOR) {
     struct v7_property *p;
     for (p = o->base.properties; p != NULL; p = p->next) {
@@ -87,6 +84,8 @@ static void function_destructor(struct v7 *v7, void *ptr) {
     release_bcode(v7, f->bcode);
   }
 
+  obj_free_prop_table(&f->base);
+
 #if defined(V7_ENABLE_ENTITY_IDS)
   f->base.entity_id_base = V7_ENTITY_ID_PART_NONE;
   f->base.entity_id_spec = V7_ENTITY_ID_PART_NONE;
@@ -113,17 +112,6 @@ struct v7 *v7_create_opt(struct v7_create_opts opts) {
   struct v7 *v7 = NULL;
   char z = 0;
 
-#if defined(HAS_V7_INFINITY) || defined(HAS_V7_NAN)
-  double zero = 0.0;
-#endif
-
-#ifdef HAS_V7_INFINITY
-  _v7_infinity = 1.0 / zero;
-#endif
-#ifdef HAS_V7_NAN
-  _v7_nan = zero / zero;
-#endif
-
   if (opts.object_arena_size == 0) opts.object_arena_size = 200;
   if (opts.function_arena_size == 0) opts.function_arena_size = 100;
   if (opts.property_arena_size == 0) opts.property_arena_size = 400;
@@ -147,6 +135,18 @@ struct v7 *v7_create_opt(struct v7_create_opts opts) {
     v7->gc_min_asn = 0;
 #endif
 
+    dict_init(v7, opts.dictionary_strings);
+    str_index_reset(v7);
+
+#if V7_ENABLE__RegExp
+    v7->regexp_cache_size = opts.regexp_cache_size != 0
+                                ? opts.regexp_cache_size
+                                : V7_REGEXP_CACHE_SIZE;
+    v7->regexp_cache_max_len = opts.regexp_cache_max_len != 0
+                                   ? opts.regexp_cache_max_len
+                                   : V7_REGEXP_CACHE_MAX_LEN;
+#endif
+
     v7->cur_dense_prop =
         (struct v7_property *) calloc(1, sizeof(struct v7_property));
     gc_arena_init(&v7->generic_object_arena, sizeof(struct v7_generic_object),
@@ -193,6 +193,9 @@ struct v7 *v7_create_opt(struct v7_create_opts opts) {
     init_crypto(v7);
     init_socket(v7);
     init_ubjson(v7);
+#ifdef V7_ENABLE_LOOP
+    init_loop(v7);
+#endif
 #endif
 
     v7->inhibit_gc = 0;
@@ -207,11 +210,22 @@ val_t v7_get_global(struct v7 *v7) {
 
 void v7_destroy(struct v7 *v7) {
   if (v7 == NULL) return;
+  b_cancel_suspended(v7);
   gc_arena_destroy(v7, &v7->generic_object_arena);
   gc_arena_destroy(v7, &v7->function_arena);
   gc_arena_destroy(v7, &v7->property_arena);
 
   mbuf_free(&v7->owned_strings);
+  intern_table_free(v7);
+  dict_free(v7);
+  str_index_reset(v7);
+#if V7_ENABLE__RegExp
+  regexp_cache_free(v7);
+  regexp_matchers_free(v7);
+#endif
+#ifdef V7_ENABLE_LOOP
+  loop_free(v7);
+#endif
   mbuf_free(&v7->owned_values);
   mbuf_free(&v7->foreign_strings);
   mbuf_free(&v7->json_visited_stack);
@@ -13,6 +13,7 @@
 #include "v7/src/mm.h"
 #include "v7/src/parser.h"
 #include "v7/src/object_public.h"
+#include "v7/src/regexp_public.h"
 #include "v7/src/tokenizer.h"
 #include "v7/src/opcodes.h"
 
@@ -111,6 +112,7 @@ typedef unsigned char v7_obj_attr_t;
 #define V7_OBJ_FUNCTION (1 << 2)       /* function object */
 #define V7_OBJ_OFF_HEAP (1 << 3)       /* object not managed by V7 HEAP */
 #define V7_OBJ_HAS_DESTRUCTOR (1 << 4) /* has user data */
+#define V7_OBJ_PROP_TABLE (1 << 5)     /* first property holds prop table */
 
 /*
  * JavaScript value is either a primitive, or an object.
@@ -288,6 +290,80 @@ struct v7_vals {
   val_t call_check_ex;
 };
 
+/* Slot of the interned strings table, see `v7_intern_string()` */
+struct v7_interned_string {
+  val_t s; /* Owned string, or `V7_UNDEFINED` for an empty slot */
+  uint32_t hash;
+};
+
+/*
+ * Dictionary of read-only strings: the built-in ones, followed by the ones
+ * registered by the embedder, see `v7_create_opts::dictionary_strings`.
+ * Values of such strings (`V7_TAG_STRING_D`) hold an index in the dictionary.
+ *
+ * Strings are looked up with a perfect hash (hash and displace): the string
+ * hash selects a bucket, and the bucket's displacement selects a slot which
+ * is different for all strings.
+ */
+struct v7_dictionary {
+  const struct v7_vec_const *user; /* Strings registered by the embedder */
+  uint32_t user_cnt;
+  uint32_t buckets_cnt;
+  uint32_t slots_mask; /* Number of slots - 1 */
+  uint16_t *disp;      /* Displacement for each bucket */
+  uint16_t *slots;     /* Dictionary index + 1, or 0 for an empty slot */
+};
+
+/*
+ * Number of strings whose character index is cached, see `struct
+ * v7_str_index`
+ */
+#ifndef V7_STR_INDEX_CACHE_SIZE
+#define V7_STR_INDEX_CACHE_SIZE 4
+#endif
+
+/*
+ * Character index of a string, which allows to find the i-th character of a
+ * UTF-8 string without decoding all the preceding ones, see `s_char_ptr()`.
+ * Pure ASCII strings need no index at all, for others byte offsets of every
+ * `V7_STR_INDEX_STEP`-th character are recorded.
+ *
+ * Indices are built lazily for the strings being accessed, and cached by
+ * string value until the next GC, which can move the strings.
+ */
+struct v7_str_index {
+  val_t s; /* Indexed string, or `V7_UNDEFINED` for a free entry */
+  size_t char_len;
+  int is_ascii;
+  uint32_t *offsets; /* NULL for ASCII strings */
+};
+
+#if V7_ENABLE__RegExp
+/* Entry of the compiled regexp cache, see `struct v7::regexp_cache` */
+struct v7_regexp_cache_entry {
+  char *key; /* Source and flags, NUL-separated; NULL for a free entry */
+  size_t src_len;
+  size_t flags_len;
+  uint32_t hash;
+  unsigned long last_used;
+  struct slre_prog *prog; /* Holds a reference */
+};
+
+/* Native matcher, see `v7_register_regexp_matcher()` */
+struct v7_regexp_matcher {
+  char *src;
+  size_t src_len;
+  int flags; /* `SLRE_FLAG_I` and `SLRE_FLAG_M` */
+  v7_regexp_matcher_t fn;
+};
+#endif
+
+#ifdef V7_ENABLE_LOOP
+struct v7_loop;
+#endif
+
+struct eval_slice;
+
 struct v7 {
   struct v7_vals vals;
 
@@ -327,6 +403,40 @@ struct v7 {
   struct mbuf owned_strings;   /* Sequence of (varint len, char data[]) */
   struct mbuf foreign_strings; /* Sequence of (varint len, char *data) */
 
+  /*
+   * Weak open-addressing table of interned owned strings: GC drops the
+   * strings which are not referenced from anywhere else.
+   */
+  struct v7_interned_string *interned;
+  uint32_t interned_size; /* Number of slots, 0 or a power of 2 */
+  uint32_t interned_cnt;  /* Number of used slots */
+
+  struct v7_dictionary dict;
+
+  struct v7_str_index str_index[V7_STR_INDEX_CACHE_SIZE];
+  int str_index_next; /* Entry to be replaced next */
+
+  /*
+   * Incremented each time GC moves owned strings: string values and byte
+   * offsets cached along with them are valid only within the same epoch
+   */
+  unsigned long str_epoch;
+
+#if V7_ENABLE__RegExp
+  /* LRU cache of compiled regexps, allocated on first use */
+  struct v7_regexp_cache_entry *regexp_cache;
+  size_t regexp_cache_size;    /* Max number of entries */
+  size_t regexp_cache_max_len; /* Max length of cached sources */
+  unsigned long regexp_cache_clock;
+
+  struct v7_regexp_matcher *regexp_matchers;
+  size_t regexp_matchers_cnt;
+#endif
+
+#ifdef V7_ENABLE_LOOP
+  struct v7_loop *loop; /* Timers and watched sockets, see loop.c */
+#endif
+
   struct mbuf tmp_stack; /* Stack of val_t* elements, used as root set */
   int need_gc;           /* Set to true to trigger GC when safe */
 
@@ -338,6 +448,8 @@ struct v7 {
   size_t bcode_ops_size;
   size_t bcode_lit_total_size;
   size_t bcode_lit_deser_size;
+  size_t bcode_funcs_compiled; /* Number of compiled functions */
+  size_t bcode_funcs_pending;  /* Number of functions not compiled yet */
 #endif
   struct mbuf owned_values; /* buffer for GC roots owned by C code */
 
@@ -350,6 +462,9 @@ struct v7 {
    */
   struct mbuf act_bcodes;
 
+  /* Sliced execution which is running or suspended, see `v7_exec_sliced()` */
+  struct eval_slice *slice;
+
   char error_msg[80]; /* Exception message */
 
   struct mbuf json_visited_stack; /* Detecting cycle in to_json */
@@ -531,7 +646,20 @@ struct v7_js_function {
 struct v7_regexp {
   val_t regexp_string;
   struct slre_prog *compiled_regexp;
+  v7_regexp_matcher_t native; /* See `v7_register_regexp_matcher()` */
   long lastIndex;
+
+  /*
+   * Byte offset of `lastIndex` in the string matched last, so that global
+   * matching resumes without counting characters from the start of the
+   * string. Valid while the string (`last_str` in `last_str_epoch`) and
+   * `lastIndex` (`last_char_index`) are the same, see `rx_exec()`.
+   */
+  val_t last_str;
+  unsigned long last_str_epoch;
+  long last_char_index;
+  size_t last_byte_offset;
+  unsigned int last_str_ascii : 1;
 };
 
 /* Vector, describes some memory location pointed by `p` with length `len` */
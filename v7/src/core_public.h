@@ -76,6 +76,7 @@ enum v7_err {
   V7_EXEC_EXCEPTION,
   V7_AST_TOO_LARGE,
   V7_INTERNAL_ERROR,
+  V7_YIELDED, /* Sliced execution is suspended, see `v7_exec_sliced()` */
 };
 
 /* JavaScript -> C call interface */
@@ -99,6 +100,27 @@ struct v7_create_opts {
   /* if not NULL, dump JS heap after init */
   char *freeze_file;
 #endif
+  /*
+   * NULL-terminated list of strings to add to the dictionary of read-only
+   * strings, e.g. property names which the application uses a lot. Such
+   * strings don't take any heap when used as JS values.
+   *
+   * The strings are not copied, so they must stay valid until the instance
+   * is destroyed. Strings of 5 bytes or less are ignored, since those are
+   * stored inline in values anyway.
+   */
+  const char *const *dictionary_strings;
+
+  /*
+   * Max number of compiled regexps to cache by source and flags, so that
+   * regexp literals and string patterns (like in `s.split(",")`) executed
+   * over and over are compiled only once; least recently used ones are
+   * dropped. Regexps with sources longer than `regexp_cache_max_len` bytes
+   * are not cached. Zeros mean defaults, `V7_REGEXP_CACHE_SIZE` and
+   * `V7_REGEXP_CACHE_MAX_LEN`.
+   */
+  size_t regexp_cache_size;
+  size_t regexp_cache_max_len;
 };
 
 /*
@@ -30,7 +30,7 @@ typedef struct {
   void *addresses[CALL_TRACE_SIZE];
 } call_trace_t;
 
-static call_trace_t call_trace = {0};
+static V7_THREAD_LOCAL call_trace_t call_trace = {0};
 
 NOINSTR
 void call_trace_print(const char *prefix, const char *suffix, size_t skip_cnt,
@@ -80,7 +80,7 @@ IRAM NOINSTR void __cyg_profile_func_exit(void *this_fn, void *call_site);
 IRAM void __cyg_profile_func_enter(void *this_fn, void *call_site) {
 #if defined(V7_STACK_GUARD_MIN_SIZE)
   {
-    static int profile_enter = 0;
+    static V7_THREAD_LOCAL int profile_enter = 0;
     void *fp = __builtin_frame_address(0);
 
     (void) call_site;
@@ -116,9 +116,11 @@ IRAM void __cyg_profile_func_enter(void *this_fn, void *call_site) {
     (void) call_site;
 
     /*
-     * TODO(dfrank): it actually won't work for multiple instances of v7 running
-     * in parallel threads. We need to know the exact v7 instance for which
-     * current function is called, but so far I failed to find a way to do this.
+     * `v7_head` lists only the instances of the current thread, so instances
+     * running in parallel threads don't affect each other.
+     *
+     * TODO(dfrank): we need to know the exact v7 instance for which current
+     * function is called, but so far I failed to find a way to do this.
      */
     for (v7 = v7_head; v7 != NULL; v7 = v7->next_v7) {
       for (ctx = v7->stack_track_ctx; ctx != NULL; ctx = ctx->next) {
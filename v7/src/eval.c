@@ -6,6 +6,7 @@
 #include "common/str_util.h"
 #include "v7/src/internal.h"
 #include "v7/src/eval.h"
+#include "v7/src/exec.h"
 #include "v7/src/string.h"
 #include "v7/src/array.h"
 #include "v7/src/object.h"
@@ -227,7 +228,7 @@ static double b_int_bin_op(enum opcode op, double a, double b) {
   return 0;
 }
 
-static double b_num_bin_op(enum opcode op, double a, double b) {
+V7_PRIVATE double b_num_bin_op(enum opcode op, double a, double b) {
   /*
    * For certain operations, the result is always NaN if either of arguments
    * is NaN
@@ -277,7 +278,23 @@ static double b_num_bin_op(enum opcode op, double a, double b) {
   return 0;
 }
 
-static int b_bool_bin_op(enum opcode op, double a, double b) {
+V7_PRIVATE int b_num_bin_op_can_fold(enum opcode op, double a, double b) {
+  switch (op) {
+    case OP_REM:
+      return fabs(a) < 2147483648.0 && fabs(b) >= 1 && fabs(b) < 2147483648.0;
+    case OP_LSHIFT:
+    case OP_RSHIFT:
+    case OP_URSHIFT:
+    case OP_OR:
+    case OP_XOR:
+    case OP_AND:
+      return fabs(a) < 9007199254740992.0 && fabs(b) < 9007199254740992.0;
+    default:
+      return 1;
+  }
+}
+
+V7_PRIVATE int b_bool_bin_op(enum opcode op, double a, double b) {
 #ifdef V7_BROKEN_NAN
   if (isnan(a) || isnan(b)) return op == OP_NE || op == OP_NE_NE;
 #endif
@@ -976,6 +993,86 @@ clean:
   return rcode;
 }
 
+/*
+ * Adds two values like `OP_ADD` does. Values should be rooted by the caller,
+ * since they are converted in place.
+ */
+static enum v7_err eval_add(struct v7 *v7, val_t *v1, val_t *v2,
+                            val_t *res) {
+  enum v7_err rcode = V7_OK;
+
+  /*
+   * If either operand is an object, convert both of them to primitives
+   */
+  if (v7_is_object(*v1) || v7_is_object(*v2)) {
+    V7_TRY(to_primitive(v7, *v1, V7_TO_PRIMITIVE_HINT_AUTO, v1));
+    V7_TRY(to_primitive(v7, *v2, V7_TO_PRIMITIVE_HINT_AUTO, v2));
+  }
+
+  if (v7_is_string(*v1) || v7_is_string(*v2)) {
+    /* Convert both operands to strings, and concatenate */
+
+    V7_TRY(primitive_to_str(v7, *v1, v1, NULL, 0, NULL));
+    V7_TRY(primitive_to_str(v7, *v2, v2, NULL, 0, NULL));
+
+    *res = s_concat(v7, *v1, *v2);
+  } else {
+    /* Convert both operands to numbers, and sum */
+
+    V7_TRY(primitive_to_number(v7, *v1, v1));
+    V7_TRY(primitive_to_number(v7, *v2, v2));
+
+    *res = v7_mk_number(v7, b_num_bin_op(OP_ADD, v7_get_double(v7, *v1),
+                                         v7_get_double(v7, *v2)));
+  }
+
+clean:
+  return rcode;
+}
+
+/*
+ * Compares two values like `OP_LT`, `OP_LE`, `OP_GT` and `OP_GE` do. Values
+ * should be rooted by the caller, since they are converted in place.
+ */
+static enum v7_err eval_relational(struct v7 *v7, enum opcode op, val_t *v1,
+                                   val_t *v2, int *res) {
+  enum v7_err rcode = V7_OK;
+
+  V7_TRY(to_primitive(v7, *v1, V7_TO_PRIMITIVE_HINT_NUMBER, v1));
+  V7_TRY(to_primitive(v7, *v2, V7_TO_PRIMITIVE_HINT_NUMBER, v2));
+
+  if (v7_is_string(*v1) && v7_is_string(*v2)) {
+    int cmp = s_cmp(v7, *v1, *v2);
+    switch (op) {
+      case OP_LT:
+        *res = cmp < 0;
+        break;
+      case OP_LE:
+        *res = cmp <= 0;
+        break;
+      case OP_GT:
+        *res = cmp > 0;
+        break;
+      case OP_GE:
+        *res = cmp >= 0;
+        break;
+      default:
+        /* should never be here */
+        assert(0);
+    }
+  } else {
+    /* Convert both operands to numbers */
+
+    V7_TRY(to_number_v(v7, *v1, v1));
+    V7_TRY(to_number_v(v7, *v2, v2));
+
+    *res = b_bool_bin_op(op, v7_get_double(v7, *v1), v7_get_double(v7, *v2));
+  }
+
+clean:
+  return rcode;
+}
+
 /*
  * Evaluate `OP_TRY_PUSH_CATCH` or `OP_TRY_PUSH_FINALLY`: Take an offset (from
  * the parameter of opcode) and push it onto "try stack"
@@ -1094,6 +1191,51 @@ static void reset_last_name(struct v7 *v7) {
 }
 #endif
 
+/*
+ * Number of instructions between the clock checks of a sliced execution
+ * which has a time limit
+ */
+#ifndef V7_SLICE_CLOCK_INTERVAL
+#define V7_SLICE_CLOCK_INTERVAL 256
+#endif
+
+/* Current time in microseconds, used for the slice deadlines */
+static double slice_now(void) {
+#ifndef _WIN32
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double) tv.tv_sec * 1000000 + (double) tv.tv_usec;
+#else
+  return (double) GetTickCount64() * 1000;
+#endif
+}
+
+static void eval_slice_start(struct eval_slice *slice,
+                             const struct v7_slice_opts *opts) {
+  slice->max_ops = opts->max_ops;
+  slice->ops_cnt = 0;
+  slice->deadline = 0;
+  if (opts->max_usec != 0) {
+    slice->deadline = slice_now() + opts->max_usec;
+  }
+  slice->clock_countdown = V7_SLICE_CLOCK_INTERVAL;
+}
+
+/*
+ * Called before each instruction of a sliced execution; returns non-zero if
+ * the budget is exhausted. At least one instruction is executed per slice.
+ */
+static int eval_slice_expired(struct eval_slice *slice) {
+  if (slice->max_ops != 0 && slice->ops_cnt++ >= slice->max_ops) {
+    return 1;
+  }
+  if (slice->deadline != 0 && --slice->clock_countdown == 0) {
+    slice->clock_countdown = V7_SLICE_CLOCK_INTERVAL;
+    return slice_now() >= slice->deadline;
+  }
+  return 0;
+}
+
 /*
  * Evaluates given `bcode`. If `reset_line_no` is non-zero, the line number
  * is initially reset to 1; otherwise, it is inherited from the previous call
@@ -1102,7 +1244,7 @@ static void reset_last_name(struct v7 *v7) {
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err eval_bcode(struct v7 *v7, struct bcode *bcode,
                                   val_t this_object, uint8_t reset_line_no,
-                                  val_t *_res) {
+                                  struct eval_slice *slice, val_t *_res) {
   struct bcode_registers r;
   enum v7_err rcode = V7_OK;
   struct v7_call_frame_base *saved_bottom_call_frame = v7->bottom_call_frame;
@@ -1119,6 +1261,28 @@ V7_PRIVATE enum v7_err eval_bcode(struct v7 *v7, struct bcode *bcode,
         v3 = V7_UNDEFINED, v4 = V7_UNDEFINED, scope_frame = V7_UNDEFINED;
   struct gc_tmp_frame tf = new_tmp_frame(v7);
 
+  /* Nothing else can run on top of the suspended execution */
+  assert(v7->slice == NULL || !v7->slice->suspended || slice == v7->slice);
+
+  tmp_stack_push(&tf, &res);
+  tmp_stack_push(&tf, &v1);
+  tmp_stack_push(&tf, &v2);
+  tmp_stack_push(&tf, &v3);
+  tmp_stack_push(&tf, &v4);
+  tmp_stack_push(&tf, &scope_frame);
+
+  if (slice != NULL && slice->suspended) {
+    /*
+     * Resume the suspended execution: its call frames are still there, so
+     * just restore the registers of the top bcode frame
+     */
+    v7->bottom_call_frame = slice->bottom_call_frame;
+    bcode_restore_registers(v7, find_call_frame_bcode(v7)->bcode, &r);
+    r.ops = slice->ops;
+    slice->suspended = 0;
+    goto restart;
+  }
+
   append_call_frame_bcode(v7, NULL, bcode, this_object, get_scope(v7), 0);
 
   if (reset_line_no) {
@@ -1133,13 +1297,6 @@ V7_PRIVATE enum v7_err eval_bcode(struct v7 *v7, struct bcode *bcode,
 
   bcode_restore_registers(v7, bcode, &r);
 
-  tmp_stack_push(&tf, &res);
-  tmp_stack_push(&tf, &v1);
-  tmp_stack_push(&tf, &v2);
-  tmp_stack_push(&tf, &v3);
-  tmp_stack_push(&tf, &v4);
-  tmp_stack_push(&tf, &scope_frame);
-
   /*
    * populate local variables on current scope, making them undeletable
    * (since they're defined with `var`)
@@ -1187,6 +1344,15 @@ restart:
     }
 #endif
 
+    /*
+     * Instruction boundary is a consistent state to yield at, unless the
+     * stash register is in use: it's not preserved across the slices.
+     */
+    if (slice != NULL && !v7->is_stashed && eval_slice_expired(slice)) {
+      rcode = V7_YIELDED;
+      goto clean;
+    }
+
     push_bcode_history(v7, op);
 
     if (v7->need_gc) {
@@ -1303,35 +1469,28 @@ restart:
         PUSH(v1);
         break;
       }
-      case OP_ADD: {
-        v2 = POP();
-        v1 = POP();
-
-        /*
-         * If either operand is an object, convert both of them to primitives
-         */
-        if (v7_is_object(v1) || v7_is_object(v2)) {
-          BTRY(to_primitive(v7, v1, V7_TO_PRIMITIVE_HINT_AUTO, &v1));
-          BTRY(to_primitive(v7, v2, V7_TO_PRIMITIVE_HINT_AUTO, &v2));
+      case OP_PUSH_LIT_ADD:
+        v2 = bcode_decode_lit(v7, r.bcode, &r.ops);
+#ifndef V7_DISABLE_CALL_ERROR_CONTEXT
+        if (!v7_is_string(v2)) {
+          reset_last_name(v7);
         }
-
-        if (v7_is_string(v1) || v7_is_string(v2)) {
-          /* Convert both operands to strings, and concatenate */
-
-          BTRY(primitive_to_str(v7, v1, &v1, NULL, 0, NULL));
-          BTRY(primitive_to_str(v7, v2, &v2, NULL, 0, NULL));
-
-          PUSH(s_concat(v7, v1, v2));
-        } else {
-          /* Convert both operands to numbers, and sum */
-
-          BTRY(primitive_to_number(v7, v1, &v1));
-          BTRY(primitive_to_number(v7, v2, &v2));
-
-          PUSH(v7_mk_number(v7, b_num_bin_op(op, v7_get_double(v7, v1),
+#endif
+        v1 = POP();
+        if (v7_is_number(v1) && v7_is_number(v2)) {
+          PUSH(v7_mk_number(v7, b_num_bin_op(OP_ADD, v7_get_double(v7, v1),
                                              v7_get_double(v7, v2))));
+        } else {
+          BTRY(eval_add(v7, &v1, &v2, &res));
+          PUSH(res);
         }
         break;
+      case OP_ADD: {
+        v2 = POP();
+        v1 = POP();
+        BTRY(eval_add(v7, &v1, &v2, &res));
+        PUSH(res);
+        break;
       }
       case OP_SUB:
       case OP_REM:
@@ -1432,40 +1591,35 @@ restart:
       case OP_LE:
       case OP_GT:
       case OP_GE: {
+        int cmp;
         v2 = POP();
         v1 = POP();
-        BTRY(to_primitive(v7, v1, V7_TO_PRIMITIVE_HINT_NUMBER, &v1));
-        BTRY(to_primitive(v7, v2, V7_TO_PRIMITIVE_HINT_NUMBER, &v2));
-
-        if (v7_is_string(v1) && v7_is_string(v2)) {
-          int cmp = s_cmp(v7, v1, v2);
-          switch (op) {
-            case OP_LT:
-              res = v7_mk_boolean(v7, cmp < 0);
-              break;
-            case OP_LE:
-              res = v7_mk_boolean(v7, cmp <= 0);
-              break;
-            case OP_GT:
-              res = v7_mk_boolean(v7, cmp > 0);
-              break;
-            case OP_GE:
-              res = v7_mk_boolean(v7, cmp >= 0);
-              break;
-            default:
-              /* should never be here */
-              assert(0);
-          }
+        BTRY(eval_relational(v7, op, &v1, &v2, &cmp));
+        PUSH(v7_mk_boolean(v7, cmp));
+        break;
+      }
+      case OP_LT_JMP_TRUE:
+      case OP_LE_JMP_TRUE:
+      case OP_GT_JMP_TRUE:
+      case OP_GE_JMP_TRUE:
+      case OP_LT_JMP_FALSE:
+      case OP_LE_JMP_FALSE:
+      case OP_GT_JMP_FALSE:
+      case OP_GE_JMP_FALSE: {
+        enum opcode cmp_op = (enum opcode)(OP_LT + (op - OP_LT_JMP_TRUE) % 4);
+        bcode_off_t target = bcode_get_target(&r.ops);
+        int cmp;
+        v2 = POP();
+        v1 = POP();
+        if (v7_is_number(v1) && v7_is_number(v2)) {
+          cmp = b_bool_bin_op(cmp_op, v7_get_double(v7, v1),
+                              v7_get_double(v7, v2));
         } else {
-          /* Convert both operands to numbers */
-
-          BTRY(to_number_v(v7, v1, &v1));
-          BTRY(to_number_v(v7, v2, &v2));
-
-          res = v7_mk_boolean(v7, b_bool_bin_op(op, v7_get_double(v7, v1),
-                                                v7_get_double(v7, v2)));
+          BTRY(eval_relational(v7, cmp_op, &v1, &v2, &cmp));
+        }
+        if (cmp == (op < OP_LT_JMP_FALSE)) {
+          r.ops = r.bcode->ops.p + target - 1;
         }
-        PUSH(res);
         break;
       }
       case OP_INSTANCEOF: {
@@ -1516,6 +1670,7 @@ restart:
         PUSH(v7_mk_boolean(v7, prop != NULL));
       } break;
       case OP_GET:
+      op_get:
         v2 = POP();
         v1 = POP();
         BTRY(v7_get_throwing_v(v7, v1, v2, &v3));
@@ -1526,12 +1681,15 @@ restart:
 #endif
         break;
       case OP_SET: {
+        unsigned long idx;
         v3 = POP();
         v2 = POP();
         v1 = POP();
 
-        /* convert name to string, if it's not already */
-        BTRY(to_string(v7, v2, &v2, NULL, 0, NULL));
+        /* convert name to string, if it's not already an array index */
+        if (!v7_is_number(v2) || !val_to_index(v7, v2, &idx)) {
+          BTRY(to_string(v7, v2, &v2, NULL, 0, NULL));
+        }
 
         /* set value */
         BTRY(set_property_v(v7, v1, v2, v3, NULL));
@@ -1540,7 +1698,8 @@ restart:
         break;
       }
       case OP_GET_VAR:
-      case OP_SAFE_GET_VAR: {
+      case OP_SAFE_GET_VAR:
+      case OP_GET_VAR_GET_PROP: {
         struct v7_property *p = NULL;
         assert(r.ops < r.end - 1);
         v1 = bcode_decode_lit(v7, r.bcode, &r.ops);
@@ -1562,12 +1721,52 @@ restart:
         v7->vals.last_name[0] = v1;
         v7->vals.last_name[1] = V7_UNDEFINED;
 #endif
+        if (op == OP_GET_VAR_GET_PROP) {
+          /* property name follows the variable name */
+          PUSH(bcode_decode_lit(v7, r.bcode, &r.ops));
+          goto op_get;
+        }
         break;
       }
+      case OP_INC_VAR:
+      case OP_DEC_VAR: {
+        struct v7_property *p = NULL;
+        v2 = bcode_decode_lit(v7, r.bcode, &r.ops);
+        BTRY(v7_get_property_v(v7, get_scope(v7), v2, &p));
+        if (p == NULL) {
+          /* variable does not exist: Reference Error */
+          V7_TRY(bcode_throw_reference_error(v7, &r, v2));
+          goto op_done;
+        }
+        BTRY(v7_property_value(v7, get_scope(v7), p, &v1));
+        reset_last_name(v7);
+
+        if (v7_is_number(v1)) {
+          /* no code could run since the lookup, so `p` is still valid */
+          v3 = v7_mk_number(v7, b_num_bin_op(op == OP_INC_VAR ? OP_ADD : OP_SUB,
+                                             v7_get_double(v7, v1), 1));
+          if (!(p->attributes & V7_PROPERTY_NON_WRITABLE)) {
+            p->value = v3;
+          }
+          PUSH(v3);
+          break;
+        }
+
+        v3 = v7_mk_number(v7, 1);
+        if (op == OP_INC_VAR) {
+          BTRY(eval_add(v7, &v1, &v3, &res));
+          v3 = res;
+        } else {
+          BTRY(to_number_v(v7, v1, &v1));
+          v3 = v7_mk_number(v7, b_num_bin_op(OP_SUB, v7_get_double(v7, v1), 1));
+        }
+        goto op_set_var;
+      }
       case OP_SET_VAR: {
         struct v7_property *prop;
         v3 = POP();
         v2 = bcode_decode_lit(v7, r.bcode, &r.ops);
+      op_set_var:
         v1 = get_scope(v7);
 
         BTRY(to_string(v7, v2, NULL, buf, sizeof(buf), NULL));
@@ -1644,6 +1843,24 @@ restart:
         v7->is_continuing = 0;
         break;
       }
+      case OP_SWITCH_TABLE: {
+        bcode_off_t target = bcode_get_target(&r.ops);
+        const char *jmps = r.ops + 1 + bcode_switch_table_size(r.ops + 1);
+        int n = bcode_switch_table_lookup(v7, r.ops + 1, TOS());
+        if (n < 0) {
+          r.ops = r.bcode->ops.p + target - 1;
+          break;
+        }
+        v1 = POP();
+        if (n > 0) {
+          POP();
+          PUSH(v1);
+        }
+        /* take the jump number `n` right away */
+        memcpy(&target, jmps + n * (1 + sizeof(target)) + 1, sizeof(target));
+        r.ops = r.bcode->ops.p + target - 1;
+        break;
+      }
       case OP_CREATE_OBJ:
         PUSH(v7_mk_object(v7));
         break;
@@ -1664,7 +1881,7 @@ restart:
           do {
             /* iterate properties until we find a non-hidden enumerable one */
             do {
-              h = v7_next_prop(h, v2, &res, NULL, &attrs);
+              h = obj_next_prop(h, v2, &res, NULL, &attrs);
             } while (h != NULL && (attrs & (_V7_PROPERTY_HIDDEN |
                                             V7_PROPERTY_NON_ENUMERABLE)));
 
@@ -1680,7 +1897,7 @@ restart:
         } else {
           PUSH(v2);
           PUSH(v7_mk_foreign(v7, h));
-          PUSH(res);
+          PUSH(prop_name_to_string(v7, res));
           PUSH(v7_mk_boolean(v7, 1));
         }
         break;
@@ -1707,6 +1924,8 @@ restart:
            */
           if (v7->last_ops[0] == OP_GET_VAR) {
             arity = 1;
+          } else if (v7->last_ops[0] == OP_GET_VAR_GET_PROP) {
+            arity = 2;
           } else if (v7->last_ops[0] == OP_GET &&
                      v7->last_ops[1] == OP_PUSH_LIT) {
             /*
@@ -1832,6 +2051,9 @@ restart:
             char *ops;
             struct v7_js_function *func = get_js_function_struct(v1);
 
+            /* Compile the function if it's the first call */
+            BTRY(compile_lazy_function(v7, func->bcode));
+
             /*
              * In "function invocation pattern", the `this` value popped from
              * stack is an `undefined`. And in non-strict mode, we should change
@@ -2118,6 +2340,14 @@ restart:
 
 clean:
 
+  if (rcode == V7_YIELDED) {
+    /* Keep the call frames, see `v7_resume()` */
+    slice->ops = r.ops;
+    slice->bottom_call_frame = v7->bottom_call_frame;
+    slice->suspended = 1;
+    goto yielded;
+  }
+
   if (rcode == V7_OK) {
 /*
  * bcode evaluated successfully. Make sure try stack is empty.
@@ -2141,12 +2371,58 @@ clean:
   assert(v7->bottom_call_frame == v7->call_stack);
   unwind_stack_1level(v7, NULL);
 
+yielded:
   v7->bottom_call_frame = saved_bottom_call_frame;
 
   tmp_frame_cleanup(&tf);
   return rcode;
 }
 
+/*
+ * Disowns and releases the top-level `bcode` evaluated by `b_exec()` (or
+ * resumed by `b_resume()`), and, if it has thrown, sets `*_res` to the thrown
+ * value.
+ */
+static void b_exec_finish(struct v7 *v7, struct bcode *bcode,
+                          enum v7_err rcode, size_t saved_stack_len,
+                          val_t *_res) {
+  /* disown and release current bcode */
+  disown_bcode(v7, bcode);
+  release_bcode(v7, bcode);
+
+  if (rcode != V7_OK) {
+    /* some exception happened. */
+    *_res = v7->vals.thrown_error;
+
+    /*
+     * if this is a top-level bcode, clear thrown error from the v7 context
+     *
+     * TODO(dfrank): do we really need to do this?
+     *
+     * If we don't clear the error, then we should clear it manually after each
+     * call to v7_exec() or friends; otherwise, all the following calls will
+     * see this error.
+     *
+     * On the other hand, user would still need to clear the error if he calls
+     * v7_exec() from some cfunction. So, currently, sometimes we don't need
+     * to clear the error, and sometimes we do, which is confusing.
+     */
+    if (v7->act_bcodes.len == 0) {
+      v7->vals.thrown_error = V7_UNDEFINED;
+      v7->is_thrown = 0;
+    }
+  }
+
+  /*
+   * Data stack should have the same length as it was before evaluating script.
+   */
+  if (v7->stack.len != saved_stack_len) {
+    fprintf(stderr, "len=%d, saved=%d\n", (int) v7->stack.len,
+            (int) saved_stack_len);
+  }
+  assert(v7->stack.len == saved_stack_len);
+}
+
 /*
  * TODO(dfrank) this function is probably too overloaded: it handles both
  * `v7_exec` and `v7_apply`. Read below why it's written this way, but it's
@@ -2181,10 +2457,11 @@ clean:
  * functionality is baked in the single function, but it would be good to make
  * it suck less.
  */
-V7_PRIVATE enum v7_err b_exec(struct v7 *v7, const char *src, size_t src_len,
-                              const char *filename, val_t func, val_t args,
-                              val_t this_object, int is_json, int fr,
-                              uint8_t is_constructor, val_t *res) {
+static enum v7_err b_exec_impl(struct v7 *v7, const char *src, size_t src_len,
+                               const char *filename, val_t func, val_t args,
+                               val_t this_object, int is_json, int fr,
+                               uint8_t is_constructor, struct eval_slice *slice,
+                               val_t *res) {
 #if defined(V7_BCODE_TRACE_SRC)
   fprintf(stderr, "src:'%s'\n", src);
 #endif
@@ -2259,9 +2536,18 @@ V7_PRIVATE enum v7_err b_exec(struct v7 *v7, const char *src, size_t src_len,
       /* Maybe regular JavaScript source or binary AST data */
 
       if (src_len >= sizeof(BIN_AST_SIGNATURE) &&
-          strncmp(BIN_AST_SIGNATURE, src, sizeof(BIN_AST_SIGNATURE)) == 0) {
+          (strncmp(BIN_AST_SIGNATURE, src, sizeof(BIN_AST_SIGNATURE)) == 0 ||
+           strncmp(BIN_AST_LARGE_SIGNATURE, src,
+                   sizeof(BIN_AST_LARGE_SIGNATURE)) == 0)) {
         /* we have binary AST data */
 
+        if (strncmp(BIN_AST_LARGE_SIGNATURE, src,
+                    sizeof(BIN_AST_LARGE_SIGNATURE)) == 0) {
+          a->skip_size = AST_SKIP_SIZE_LARGE;
+        } else {
+          a->skip_size = AST_SKIP_SIZE_SMALL;
+        }
+
         if (fr == 0) {
           /* Unmanaged memory, usually rom or mmapped flash */
           mbuf_free(&a->mbuf);
@@ -2359,7 +2645,10 @@ V7_PRIVATE enum v7_err b_exec(struct v7 *v7, const char *src, size_t src_len,
   a = NULL;
 
   /* Evaluate bcode */
-  V7_TRY(eval_bcode(v7, bcode, this_object, flags.line_no_reset, &_res));
+  rcode = eval_bcode(v7, bcode, this_object, flags.line_no_reset, slice, &_res);
+  if (rcode != V7_YIELDED) {
+    V7_TRY(rcode);
+  }
 
 clean:
 
@@ -2372,43 +2661,6 @@ clean:
     free((void *) src);
   }
 
-  /* disown and release current bcode */
-  disown_bcode(v7, bcode);
-  release_bcode(v7, bcode);
-  bcode = NULL;
-
-  if (rcode != V7_OK) {
-    /* some exception happened. */
-    _res = v7->vals.thrown_error;
-
-    /*
-     * if this is a top-level bcode, clear thrown error from the v7 context
-     *
-     * TODO(dfrank): do we really need to do this?
-     *
-     * If we don't clear the error, then we should clear it manually after each
-     * call to v7_exec() or friends; otherwise, all the following calls will
-     * see this error.
-     *
-     * On the other hand, user would still need to clear the error if he calls
-     * v7_exec() from some cfunction. So, currently, sometimes we don't need
-     * to clear the error, and sometimes we do, which is confusing.
-     */
-    if (v7->act_bcodes.len == 0) {
-      v7->vals.thrown_error = V7_UNDEFINED;
-      v7->is_thrown = 0;
-    }
-  }
-
-  /*
-   * Data stack should have the same length as it was before evaluating script.
-   */
-  if (v7->stack.len != saved_stack_len) {
-    fprintf(stderr, "len=%d, saved=%d\n", (int) v7->stack.len,
-            (int) saved_stack_len);
-  }
-  assert(v7->stack.len == saved_stack_len);
-
   /*
    * release AST if needed (normally, it's already released above, before
    * bcode evaluation)
@@ -2418,6 +2670,16 @@ clean:
     a = NULL;
   }
 
+  if (rcode == V7_YIELDED) {
+    /* the bcode stays owned until the execution is finished */
+    slice->bcode = bcode;
+    slice->saved_stack_len = saved_stack_len;
+    _res = V7_UNDEFINED;
+  } else {
+    b_exec_finish(v7, bcode, rcode, saved_stack_len, &_res);
+  }
+  bcode = NULL;
+
   if (is_constructor && !v7_is_object(_res)) {
     /* constructor returned non-object: replace it with `this` */
     _res = v7_get_this(v7);
@@ -2441,6 +2703,151 @@ clean:
   return rcode;
 }
 
+/*
+ * Returns `V7_INTERNAL_ERROR` if there is a suspended execution: nothing else
+ * can run on top of it, see `v7_exec_sliced()`
+ */
+static enum v7_err b_check_not_suspended(struct v7 *v7, val_t *res) {
+  if (v7->slice != NULL && v7->slice->suspended) {
+    if (res != NULL) {
+      *res = V7_UNDEFINED;
+    }
+    return V7_INTERNAL_ERROR;
+  }
+  return V7_OK;
+}
+
+V7_PRIVATE enum v7_err b_exec(struct v7 *v7, const char *src, size_t src_len,
+                              const char *filename, val_t func, val_t args,
+                              val_t this_object, int is_json, int fr,
+                              uint8_t is_constructor, val_t *res) {
+  enum v7_err rcode = b_check_not_suspended(v7, res);
+  if (rcode != V7_OK) {
+    return rcode;
+  }
+
+  return b_exec_impl(v7, src, src_len, filename, func, args, this_object,
+                     is_json, fr, is_constructor, NULL, res);
+}
+
+/*
+ * Frees the slice after the sliced execution is finished, i.e. unless it is
+ * suspended
+ */
+static void b_slice_done(struct v7 *v7, enum v7_err rcode) {
+  if (rcode != V7_YIELDED) {
+    free(v7->slice);
+    v7->slice = NULL;
+  }
+}
+
+WARN_UNUSED_RESULT
+V7_PRIVATE enum v7_err b_exec_sliced(struct v7 *v7, const char *src,
+                                     size_t src_len, const char *filename,
+                                     val_t func, val_t args, val_t this_object,
+                                     int is_json,
+                                     const struct v7_slice_opts *opts,
+                                     val_t *res) {
+  enum v7_err rcode;
+
+  if (v7->slice != NULL || v7->act_bcodes.len != 0) {
+    /*
+     * Only one sliced execution at a time, and it can't be started from a C
+     * function called by some script: the slice could not be suspended on top
+     * of the frames of the outer execution.
+     */
+    if (res != NULL) {
+      *res = V7_UNDEFINED;
+    }
+    return V7_INTERNAL_ERROR;
+  }
+
+  v7->slice = (struct eval_slice *) calloc(1, sizeof(*v7->slice));
+  eval_slice_start(v7->slice, opts);
+
+  rcode = b_exec_impl(v7, src, src_len, filename, func, args, this_object,
+                      is_json, 0 /*fr*/, 0 /*is_constructor*/, v7->slice, res);
+
+  b_slice_done(v7, rcode);
+  return rcode;
+}
+
+WARN_UNUSED_RESULT
+V7_PRIVATE enum v7_err b_resume(struct v7 *v7, const struct v7_slice_opts *opts,
+                                val_t *res) {
+  enum v7_err rcode = V7_OK;
+  struct eval_slice *slice = v7->slice;
+  val_t _res = V7_UNDEFINED;
+  struct gc_tmp_frame tf = new_tmp_frame(v7);
+
+  tmp_stack_push(&tf, &_res);
+
+  if (slice == NULL || !slice->suspended) {
+    rcode = V7_INTERNAL_ERROR;
+    goto clean;
+  }
+
+  eval_slice_start(slice, opts);
+
+  rcode = eval_bcode(v7, slice->bcode, V7_UNDEFINED, 0, slice, &_res);
+  if (rcode == V7_YIELDED) {
+    _res = V7_UNDEFINED;
+  } else {
+    b_exec_finish(v7, slice->bcode, rcode, slice->saved_stack_len, &_res);
+  }
+
+  b_slice_done(v7, rcode);
+
+clean:
+  if (res != NULL) {
+    *res = _res;
+  }
+
+  tmp_frame_cleanup(&tf);
+  return rcode;
+}
+
+V7_PRIVATE void b_cancel_suspended(struct v7 *v7) {
+  struct eval_slice *slice = v7->slice;
+
+  if (slice == NULL || !slice->suspended) {
+    return;
+  }
+
+  /* unwind the call frames of the execution, including the bottom one */
+  while (v7->call_stack != slice->bottom_call_frame) {
+    unwind_stack_1level(v7, NULL);
+  }
+  unwind_stack_1level(v7, NULL);
+  v7->stack.len = slice->saved_stack_len;
+
+  disown_bcode(v7, slice->bcode);
+  release_bcode(v7, slice->bcode);
+
+  free(slice);
+  v7->slice = NULL;
+}
+
+WARN_UNUSED_RESULT
+V7_PRIVATE enum v7_err b_exec_bcode(struct v7 *v7, struct bcode *bcode,
+                                    val_t *res) {
+  enum v7_err rcode = b_check_not_suspended(v7, res);
+  if (rcode != V7_OK) {
+    return rcode;
+  }
+
+  retain_bcode(v7, bcode);
+  own_bcode(v7, bcode);
+
+  rcode = eval_bcode(v7, bcode, v7->vals.global_object, 1 /*reset_line_no*/,
+                     NULL, res);
+
+  disown_bcode(v7, bcode);
+  release_bcode(v7, bcode);
+
+  return rcode;
+}
+
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err b_apply(struct v7 *v7, v7_val_t func, v7_val_t this_obj,
                                v7_val_t args, uint8_t is_constructor,
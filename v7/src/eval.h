@@ -10,15 +10,45 @@
 #include "v7/src/bcode.h"
 
 struct v7_call_frame_base;
+struct v7_slice_opts;
 
 #if defined(__cplusplus)
 extern "C" {
 #endif /* __cplusplus */
 
+/*
+ * Sliced execution, see `v7_exec_sliced()`. While it is suspended, its call
+ * frames and data stack entries stay in `v7`, and its bcode stays in
+ * `act_bcodes`, so they are reachable by GC as usual.
+ */
+struct eval_slice {
+  /* Budget of the current slice, see `eval_slice_expired()` */
+  unsigned long max_ops;
+  unsigned long ops_cnt;
+  double deadline; /* In microseconds, or 0 if unlimited */
+  unsigned int clock_countdown;
+
+  /* State of the suspended `eval_bcode()` */
+  char *ops; /* Next instruction of the top bcode call frame */
+  struct v7_call_frame_base *bottom_call_frame;
+
+  /* State of the suspended `b_exec()` */
+  struct bcode *bcode;
+  size_t saved_stack_len;
+
+  unsigned int suspended : 1;
+};
+
+/*
+ * Evaluates given `bcode`. If `slice` is not `NULL`, the evaluation yields
+ * when the slice budget is exhausted, or, if `slice` is already suspended,
+ * resumes from where it has yielded; `bcode`, `this_object` and
+ * `reset_line_no` are ignored in the latter case.
+ */
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err eval_bcode(struct v7 *v7, struct bcode *bcode,
                                   val_t this_object, uint8_t reset_line_no,
-                                  val_t *_res);
+                                  struct eval_slice *slice, val_t *_res);
 
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err b_apply(struct v7 *v7, v7_val_t func, v7_val_t this_obj,
@@ -31,6 +61,49 @@ V7_PRIVATE enum v7_err b_exec(struct v7 *v7, const char *src, size_t src_len,
                               val_t this_object, int is_json, int fr,
                               uint8_t is_constructor, val_t *res);
 
+/*
+ * Like `b_exec()`, but suspends the execution when the `opts` budget is
+ * exhausted, see `v7_exec_sliced()`.
+ */
+WARN_UNUSED_RESULT
+V7_PRIVATE enum v7_err b_exec_sliced(struct v7 *v7, const char *src,
+                                     size_t src_len, const char *filename,
+                                     val_t func, val_t args, val_t this_object,
+                                     int is_json,
+                                     const struct v7_slice_opts *opts,
+                                     val_t *res);
+
+/* Continues the suspended execution, see `v7_resume()` */
+WARN_UNUSED_RESULT
+V7_PRIVATE enum v7_err b_resume(struct v7 *v7, const struct v7_slice_opts *opts,
+                                val_t *res);
+
+/* Drops the suspended execution, if any */
+V7_PRIVATE void b_cancel_suspended(struct v7 *v7);
+
+/*
+ * Evaluates the top-level `bcode` of a script with the Global Object as
+ * `this`, as `b_exec()` does. Unlike `b_exec()`, the thrown value (if any) is
+ * left in `v7`.
+ */
+WARN_UNUSED_RESULT
+V7_PRIVATE enum v7_err b_exec_bcode(struct v7 *v7, struct bcode *bcode,
+                                    val_t *res);
+
+/*
+ * Arithmetic and relational operators applied to numbers, exactly as
+ * `eval_bcode()` evaluates them; used by the optimizer to fold constants
+ */
+V7_PRIVATE double b_num_bin_op(enum opcode op, double a, double b);
+V7_PRIVATE int b_bool_bin_op(enum opcode op, double a, double b);
+
+/*
+ * Whether `b_num_bin_op()` is well-defined for the given arguments, i.e. it
+ * doesn't rely on conversions of out-of-range doubles to integers; only such
+ * operations are folded
+ */
+V7_PRIVATE int b_num_bin_op_can_fold(enum opcode op, double a, double b);
+
 /*
  * Try to find the call frame whose `type_mask` intersects with the given
  * `type_mask`.
@@ -12,6 +12,9 @@
 #include "v7/src/ast.h"
 #include "v7/src/compiler.h"
 #include "v7/src/exceptions.h"
+#include "v7/src/parser.h"
+#include "v7/src/gc.h"
+#include "v7/src/shdata.h"
 
 enum v7_err v7_exec(struct v7 *v7, const char *js_code, v7_val_t *res) {
   return b_exec(v7, js_code, strlen(js_code), NULL, V7_UNDEFINED, V7_UNDEFINED,
@@ -85,16 +88,289 @@ enum v7_err v7_exec_file(struct v7 *v7, const char *path, val_t *res) {
   return exec_file(v7, path, res, 0);
 }
 
+/*
+ * Size of chunks in which the file is read by `v7_exec_file_stream()`
+ */
+#ifndef V7_EXEC_STREAM_CHUNK_SIZE
+#define V7_EXEC_STREAM_CHUNK_SIZE 4096
+#endif
+
+/*
+ * Source file which is parsed statement by statement, see `parse_stmt()`
+ */
+struct exec_stream {
+  FILE *fp;
+  struct mbuf buf; /* Window of the source code */
+  struct v7_pstmt ps;
+};
+
+/*
+ * Appends up to `size` bytes read from the file to the window. The window is
+ * kept NUL-terminated, like the buffer returned by `cs_read_file()`: the
+ * parser relies on it when reporting errors.
+ */
+static void exec_stream_read(struct exec_stream *s, size_t size) {
+  size_t n;
+
+  if (mbuf_append(&s->buf, NULL, size + 1) != size + 1) {
+    abort();
+  }
+  n = fread(s->buf.buf + s->buf.len - size - 1, 1, size, s->fp);
+  s->buf.len -= size + 1 - n;
+  s->buf.buf[s->buf.len] = '\0';
+  if (n < size) {
+    s->ps.eof = 1;
+  }
+}
+
+/*
+ * Parses the next statement into a new AST, reading the file as needed. At
+ * the end of the script, `*pa` is set to `NULL`.
+ */
+static enum v7_err exec_stream_next(struct v7 *v7, struct exec_stream *s,
+                                    struct ast **pa) {
+  enum v7_err rcode = V7_OK;
+  struct ast *a = NULL;
+  size_t n;
+
+  /*
+   * Drop the source before the line of the next statement (the line is kept
+   * for error messages). To avoid moving the window after each statement,
+   * it's done only if more than a half of the window can be dropped.
+   */
+  for (n = s->ps.tok; n > 0 && s->buf.buf[n - 1] != '\n'; n--) {
+  }
+  if (n > s->buf.len / 2) {
+    mbuf_remove(&s->buf, n);
+    s->buf.buf[s->buf.len] = '\0';
+    s->ps.tok -= n;
+    s->ps.pc -= n;
+  }
+
+  for (;;) {
+    /* TODO(mkm): use GC pool */
+    a = (struct ast *) malloc(sizeof(*a));
+    ast_init(a, 0);
+    a->refcnt = 1;
+
+    s->ps.src = s->buf.buf;
+    s->ps.src_len = s->buf.len;
+    rcode = parse_stmt(v7, a, &s->ps);
+    if (rcode != V7_OK || !s->ps.need_more) {
+      break;
+    }
+
+    /* grow the window geometrically, so that long statements take linear time */
+    release_ast(v7, a);
+    exec_stream_read(s, s->buf.len > V7_EXEC_STREAM_CHUNK_SIZE
+                            ? s->buf.len
+                            : V7_EXEC_STREAM_CHUNK_SIZE);
+  }
+
+  if (rcode != V7_OK || s->ps.end) {
+    release_ast(v7, a);
+    a = NULL;
+  } else {
+    ast_optimize(a);
+  }
+
+  *pa = a;
+  return rcode;
+}
+
+/* Rewinds the stream to the beginning of the file */
+static void exec_stream_rewind(struct exec_stream *s) {
+  rewind(s->fp);
+  s->buf.len = 0;
+  memset(&s->ps, 0, sizeof(s->ps));
+  exec_stream_read(s, V7_EXEC_STREAM_CHUNK_SIZE);
+}
+
+static struct bcode *exec_stream_bcode(struct v7 *v7, const char *path,
+                                       uint8_t strict_mode) {
+  struct bcode *bcode = (struct bcode *) calloc(1, sizeof(*bcode));
+
+#ifdef V7_FORCE_STRICT_MODE
+  strict_mode = 1;
+#endif
+
+  bcode_init(bcode, strict_mode,
+#ifndef V7_DISABLE_FILENAMES
+             shdata_create_from_string(path),
+#else
+             NULL,
+#endif
+             0 /*filename not in ROM*/
+             );
+  (void) path;
+
+  retain_bcode(v7, bcode);
+  return bcode;
+}
+
+enum v7_err v7_exec_file_stream(struct v7 *v7, const char *path, val_t *res) {
+  enum v7_err rcode = V7_OK;
+  struct exec_stream s;
+  struct bcode_builder bbuilder;
+  struct bcode *bcode = NULL;
+  struct ast *a = NULL;
+  val_t _res = V7_UNDEFINED;
+  struct gc_tmp_frame tf;
+  uint8_t saved_inhibit_gc = v7->inhibit_gc;
+
+  memset(&s, 0, sizeof(s));
+  if ((s.fp = fopen(path, "rb")) == NULL) {
+    /* report the error just like `v7_exec_file()` does */
+    return exec_file(v7, path, res, 0);
+  }
+
+  mbuf_init(&s.buf, 0);
+  exec_stream_read(&s, V7_EXEC_STREAM_CHUNK_SIZE);
+  if ((s.buf.len >= sizeof(BIN_AST_SIGNATURE) &&
+       (strncmp(BIN_AST_SIGNATURE, s.buf.buf, sizeof(BIN_AST_SIGNATURE)) ==
+            0 ||
+        strncmp(BIN_AST_LARGE_SIGNATURE, s.buf.buf,
+                sizeof(BIN_AST_LARGE_SIGNATURE)) == 0)) ||
+      (s.buf.len >= sizeof(BIN_BCODE_SIGNATURE) &&
+       strncmp(BIN_BCODE_SIGNATURE, s.buf.buf, sizeof(BIN_BCODE_SIGNATURE)) ==
+           0)) {
+    /* precompiled file can't be executed statement by statement */
+    fclose(s.fp);
+    mbuf_free(&s.buf);
+    return exec_file(v7, path, res, 0);
+  }
+
+  tf = new_tmp_frame(v7);
+  tmp_stack_push(&tf, &_res);
+
+  /*
+   * First pass: collect declarations of all the statements. Literals of the
+   * bcode being built (e.g. hoisted functions) are not reachable by GC until
+   * the builder is finalized, so GC is inhibited while compiling.
+   */
+  bcode = exec_stream_bcode(v7, path, 0);
+  compile_script_decls_init(v7, &bbuilder, bcode);
+  v7->inhibit_gc = 1;
+  for (;;) {
+    rcode = exec_stream_next(v7, &s, &a);
+    if (rcode != V7_OK || a == NULL) {
+      break;
+    }
+    bcode->strict_mode |= s.ps.in_strict;
+    rcode = compile_script_decls(&bbuilder, a);
+    release_ast(v7, a);
+    if (rcode != V7_OK) {
+      break;
+    }
+  }
+  compile_script_decls_finalize(&bbuilder);
+  v7->inhibit_gc = saved_inhibit_gc;
+  if (rcode != V7_OK) {
+    goto clean;
+  }
+
+  V7_TRY(b_exec_bcode(v7, bcode, &_res));
+  release_bcode(v7, bcode);
+  bcode = NULL;
+
+  /* Second pass: compile and evaluate statements one by one */
+  exec_stream_rewind(&s);
+  for (;;) {
+    V7_TRY(exec_stream_next(v7, &s, &a));
+    if (a == NULL) {
+      break;
+    }
+
+    bcode = exec_stream_bcode(v7, path, s.ps.in_strict);
+    v7->inhibit_gc = 1;
+    rcode = compile_script_stmt(v7, a, bcode, _res);
+    v7->inhibit_gc = saved_inhibit_gc;
+    release_ast(v7, a);
+    if (rcode == V7_OK) {
+      rcode = b_exec_bcode(v7, bcode, &_res);
+    }
+    release_bcode(v7, bcode);
+    bcode = NULL;
+    if (rcode != V7_OK) {
+      goto clean;
+    }
+  }
+
+clean:
+  if (bcode != NULL) {
+    release_bcode(v7, bcode);
+  }
+  fclose(s.fp);
+  mbuf_free(&s.buf);
+
+  if (rcode != V7_OK) {
+    /* as in `b_exec()`, clear thrown error if this is a top-level script */
+    _res = v7->vals.thrown_error;
+    if (v7->act_bcodes.len == 0) {
+      v7->vals.thrown_error = V7_UNDEFINED;
+      v7->is_thrown = 0;
+    }
+  }
+
+  if (res != NULL) {
+    *res = _res;
+  }
+
+  tmp_frame_cleanup(&tf);
+  return rcode;
+}
+
 enum v7_err v7_parse_json_file(struct v7 *v7, const char *path, v7_val_t *res) {
   return exec_file(v7, path, res, 1);
 }
 #endif /* V7_NO_FS */
 
+enum v7_err v7_exec_compiled(struct v7 *v7, const char *code, size_t size,
+                             v7_val_t *res) {
+  return b_exec(v7, code, size, NULL, V7_UNDEFINED, V7_UNDEFINED, V7_UNDEFINED,
+                0, 0, 0, res);
+}
+
 enum v7_err v7_apply(struct v7 *v7, v7_val_t func, v7_val_t this_obj,
                      v7_val_t args, v7_val_t *res) {
   return b_apply(v7, func, this_obj, args, 0, res);
 }
 
+enum v7_err v7_exec_sliced(struct v7 *v7, const char *js_code,
+                           const struct v7_exec_opts *opts,
+                           const struct v7_slice_opts *slice, v7_val_t *res) {
+  struct v7_exec_opts default_opts;
+
+  if (opts == NULL) {
+    memset(&default_opts, 0, sizeof(default_opts));
+    opts = &default_opts;
+  }
+
+  return b_exec_sliced(v7, js_code, strlen(js_code), opts->filename,
+                       V7_UNDEFINED, V7_UNDEFINED,
+                       (opts->this_obj == 0 ? V7_UNDEFINED : opts->this_obj),
+                       opts->is_json, slice, res);
+}
+
+enum v7_err v7_apply_sliced(struct v7 *v7, v7_val_t func, v7_val_t this_obj,
+                            v7_val_t args, const struct v7_slice_opts *slice,
+                            v7_val_t *res) {
+  return b_exec_sliced(v7, NULL, 0, NULL, func, args, this_obj, 0, slice, res);
+}
+
+enum v7_err v7_resume(struct v7 *v7, const struct v7_slice_opts *slice,
+                      v7_val_t *res) {
+  return b_resume(v7, slice, res);
+}
+
+int v7_is_suspended(struct v7 *v7) {
+  return v7->slice != NULL && v7->slice->suspended;
+}
+
+void v7_cancel_suspended(struct v7 *v7) {
+  b_cancel_suspended(v7);
+}
+
 #ifndef NO_LIBC
 enum v7_err _v7_compile(const char *src, size_t js_code_size, int binary,
                         int use_bcode, FILE *fp) {
@@ -108,6 +384,7 @@ enum v7_err _v7_compile(const char *src, size_t js_code_size, int binary,
   ast_init(&ast, 0);
   err = parse(v7, &ast, src, js_code_size, 0);
   if (err == V7_OK) {
+    ast_optimize(&ast);
     if (use_bcode) {
       struct bcode bcode;
       /*
@@ -135,7 +412,12 @@ enum v7_err _v7_compile(const char *src, size_t js_code_size, int binary,
       bcode_free(v7, &bcode);
     } else {
       if (binary) {
-        fwrite(BIN_AST_SIGNATURE, sizeof(BIN_AST_SIGNATURE), 1, fp);
+        if (ast.skip_size == AST_SKIP_SIZE_LARGE) {
+          fwrite(BIN_AST_LARGE_SIGNATURE, sizeof(BIN_AST_LARGE_SIGNATURE), 1,
+                 fp);
+        } else {
+          fwrite(BIN_AST_SIGNATURE, sizeof(BIN_AST_SIGNATURE), 1, fp);
+        }
         fwrite(ast.mbuf.buf, ast.mbuf.len, 1, fp);
       } else {
         ast_dump_tree(fp, &ast, &pos, 0);
@@ -22,8 +22,8 @@
  *  - V7_SYNTAX_ERROR if `js_code` in not a valid code. `result` is undefined.
  *  - V7_EXEC_EXCEPTION if `js_code` threw an exception. `result` stores
  *    an exception object.
- *  - V7_AST_TOO_LARGE if `js_code` contains an AST segment longer than 16 bit.
- *    `result` is undefined. To avoid this error, build V7 with V7_LARGE_AST.
+ *  - V7_AST_TOO_LARGE if `js_code` contains an AST segment longer than 32 bit.
+ *    `result` is undefined.
  */
 WARN_UNUSED_RESULT
 enum v7_err v7_exec(struct v7 *v7, const char *js_code, v7_val_t *result);
@@ -61,6 +61,25 @@ enum v7_err v7_exec_opt(struct v7 *v7, const char *js_code,
 WARN_UNUSED_RESULT
 enum v7_err v7_exec_file(struct v7 *v7, const char *path, v7_val_t *result);
 
+/*
+ * Same as `v7_exec_file()`, but the file is never loaded in memory as a whole:
+ * it is read in chunks, and each top-level statement is parsed, compiled and
+ * executed in turn, so memory needed for the source code and the AST is
+ * bounded by the largest statement. Useful for huge "data as code" files.
+ *
+ * The file is read twice: first, declarations of all the statements are
+ * collected (so `var`s and `function`s are hoisted as usual, and syntax
+ * errors are reported before anything is executed); then statements are
+ * executed. Errors which are detected by the compiler (like `1 = 2;`) are
+ * thrown when the statement is reached, not before the script is executed.
+ *
+ * Precompiled files (binary AST or bcode) are executed as with
+ * `v7_exec_file()`.
+ */
+WARN_UNUSED_RESULT
+enum v7_err v7_exec_file_stream(struct v7 *v7, const char *path,
+                                v7_val_t *result);
+
 /*
  * Parse `str` and store corresponding JavaScript object in `res` variable.
  * String `str` should be '\0'-terminated.
@@ -86,6 +105,20 @@ WARN_UNUSED_RESULT
 enum v7_err v7_compile(const char *js_code, int generate_binary_output,
                        int use_bcode, FILE *fp);
 
+/*
+ * Same as `v7_exec()`, but executes `code` of `size` bytes generated by
+ * `v7_compile()` with `generate_binary_output` set. The code is not copied:
+ * instructions, names and string literals are used right from `code`, which
+ * is never written to. So a single copy of the compiled application (e.g. a
+ * mmapped file, or a constant array in ROM) can be executed by any number of
+ * instances, including instances running on different threads, while each
+ * instance keeps its own heap. `code` should stay valid and unchanged until
+ * all these instances are destroyed.
+ */
+WARN_UNUSED_RESULT
+enum v7_err v7_exec_compiled(struct v7 *v7, const char *code, size_t size,
+                             v7_val_t *res);
+
 /*
  * Call function `func` with arguments `args`, using `this_obj` as `this`.
  * `args` should be an array containing arguments or `undefined`.
@@ -96,4 +129,79 @@ WARN_UNUSED_RESULT
 enum v7_err v7_apply(struct v7 *v7, v7_val_t func, v7_val_t this_obj,
                      v7_val_t args, v7_val_t *res);
 
+/*
+ * Budget of a time slice, see `v7_exec_sliced()`. Zero means no limit.
+ */
+struct v7_slice_opts {
+  /* Max number of bytecode instructions to execute */
+  unsigned long max_ops;
+
+  /*
+   * Max time to run, in microseconds. The clock is checked once in
+   * `V7_SLICE_CLOCK_INTERVAL` instructions, so the slice may run a bit longer.
+   */
+  unsigned long max_usec;
+};
+
+/*
+ * Same as `v7_exec_opt()` (`opts` may be `NULL`), but the execution is
+ * suspended once the budget `slice` is exhausted: in this case, `V7_YIELDED`
+ * is returned, `res` is set to `undefined`, and the execution can be
+ * continued with `v7_resume()`. It allows to run many scripts on a single
+ * thread, giving each of them a fair share of time, e.g.:
+ *
+ *     struct v7_slice_opts slice = {10000, 0};
+ *     enum v7_err rcode = v7_exec_sliced(v7, code, NULL, &slice, &res);
+ *     while (rcode == V7_YIELDED) {
+ *       ... let the other instances run ...
+ *       rcode = v7_resume(v7, &slice, &res);
+ *     }
+ *
+ * The execution can be suspended only while it runs JavaScript code: if a
+ * C function calls back into JavaScript (like `Array.prototype.forEach()`
+ * does), the callback runs to completion.
+ *
+ * An instance can have only one suspended execution at a time. While it is
+ * suspended, the instance may be used to create and inspect values, but it
+ * must not execute any other code (including `v7_exec()`, `v7_apply()` and
+ * the event loop) until the execution is finished or cancelled with
+ * `v7_cancel_suspended()`; otherwise, `V7_INTERNAL_ERROR` is returned.
+ * Different instances are independent of each other.
+ *
+ * A sliced execution can only be started at the top level, not from a C
+ * function called by a running script: in that case, `V7_INTERNAL_ERROR` is
+ * returned as well.
+ */
+WARN_UNUSED_RESULT
+enum v7_err v7_exec_sliced(struct v7 *v7, const char *js_code,
+                           const struct v7_exec_opts *opts,
+                           const struct v7_slice_opts *slice, v7_val_t *res);
+
+/*
+ * Same as `v7_apply()`, but can be suspended like `v7_exec_sliced()`.
+ */
+WARN_UNUSED_RESULT
+enum v7_err v7_apply_sliced(struct v7 *v7, v7_val_t func, v7_val_t this_obj,
+                            v7_val_t args, const struct v7_slice_opts *slice,
+                            v7_val_t *res);
+
+/*
+ * Continues the suspended execution for one more time slice. Return value and
+ * semantic is the same as for `v7_exec_sliced()`. If there is no suspended
+ * execution, `V7_INTERNAL_ERROR` is returned.
+ */
+WARN_UNUSED_RESULT
+enum v7_err v7_resume(struct v7 *v7, const struct v7_slice_opts *slice,
+                      v7_val_t *res);
+
+/* Returns non-zero if the instance has a suspended execution */
+int v7_is_suspended(struct v7 *v7);
+
+/*
+ * Drops the suspended execution, if any, without running it any further.
+ * `finally` blocks of the suspended code are not executed. `v7_destroy()`
+ * does this automatically.
+ */
+void v7_cancel_suspended(struct v7 *v7);
+
 #endif /* CS_V7_SRC_EXEC_PUBLIC_H_ */
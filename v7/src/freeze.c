@@ -80,7 +80,8 @@ V7_PRIVATE void freeze_obj(struct v7 *v7, FILE *f, v7_val_t v) {
             "}\n",
             (void *) obj_base,
             (void *) ((uintptr_t) obj_base->properties & ~0x1),
-            obj_base->attributes | attrs, (void *) func->scope, (void *) bcode
+            (obj_base->attributes & ~V7_OBJ_PROP_TABLE) | attrs,
+            (void *) func->scope, (void *) bcode
 #if defined(V7_ENABLE_ENTITY_IDS)
             ,
             obj_base->entity_id_base, obj_base->entity_id_spec
@@ -123,7 +124,8 @@ V7_PRIVATE void freeze_obj(struct v7 *v7, FILE *f, v7_val_t v) {
             "}\n",
             (void *) obj_base,
             (void *) ((uintptr_t) obj_base->properties & ~0x1),
-            obj_base->attributes | attrs, (void *) gob->prototype
+            (obj_base->attributes & ~V7_OBJ_PROP_TABLE) | attrs,
+            (void *) gob->prototype
 #if defined(V7_ENABLE_ENTITY_IDS)
             ,
             obj_base->entity_id_base, obj_base->entity_id_spec
@@ -16,11 +16,12 @@
 #include "v7/src/util.h"
 #include "v7/src/primitive.h"
 #include "v7/src/heapusage.h"
+#include "v7/src/loop.h"
 
 #include <stdio.h>
 
 #ifdef V7_STACK_GUARD_MIN_SIZE
-void *v7_sp_limit = NULL;
+V7_THREAD_LOCAL void *v7_sp_limit = NULL;
 #endif
 
 void gc_mark_string(struct v7 *, val_t *);
@@ -451,6 +452,10 @@ int v7_heap_stat(struct v7 *v7, enum v7_heap_stat_what what) {
       return v7->owned_values.len / sizeof(val_t *);
     case V7_HEAP_STAT_FUNC_OWNED_MAX:
       return v7->owned_values.size / sizeof(val_t *);
+    case V7_HEAP_STAT_FUNC_COMPILED:
+      return v7->bcode_funcs_compiled;
+    case V7_HEAP_STAT_FUNC_PENDING:
+      return v7->bcode_funcs_pending;
   }
 
   return -1;
@@ -658,7 +663,7 @@ void gc_compact_strings(struct v7 *v7) {
        * the actual string.
        */
       len = decode_varint((unsigned char *) &h, &llen);
-      len += llen + 1;
+      len += llen + V7_STR_HDR_SIZE + 1;
 
       /*
        * restore the saved 6 bytes
@@ -672,14 +677,15 @@ void gc_compact_strings(struct v7 *v7) {
       memmove(v7->owned_strings.buf + head, p, len);
       v7->owned_strings.buf[head - 1] = 0x0;
 #if defined(V7_GC_VERBOSE) && !defined(V7_DISABLE_STR_ALLOC_SEQ)
-      fprintf(stderr, "GC updated ASN %d: \"%.*s\"\n", asn, len - llen - 1,
-              v7->owned_strings.buf + head + llen);
+      fprintf(stderr, "GC updated ASN %d: \"%.*s\"\n", asn,
+              len - llen - V7_STR_HDR_SIZE - 1,
+              v7->owned_strings.buf + head + llen + V7_STR_HDR_SIZE);
 #endif
       p += len;
       head += len;
     } else {
       len = decode_varint((unsigned char *) p, &llen);
-      len += llen + 1;
+      len += llen + V7_STR_HDR_SIZE + 1;
 
       p += len;
     }
@@ -729,7 +735,7 @@ V7_PRIVATE void maybe_gc(struct v7 *v7) {
   }
 }
 #if defined(V7_GC_VERBOSE)
-static int gc_pass = 0;
+static V7_THREAD_LOCAL int gc_pass = 0;
 #endif
 
 /*
@@ -768,6 +774,30 @@ static void gc_mark_vec_val(struct v7 *v7, const struct v7_vec *vec) {
   gc_mark_val_array(v7, (val_t *) vec->p, vec->len / sizeof(val_t));
 }
 
+/*
+ * Interned strings are weak references: the ones which weren't marked from
+ * the root set are dropped from the table, and the rest are marked so that
+ * the table gets updated when strings are compacted.
+ *
+ * Should be called after everything else is marked; the table should be
+ * rebuilt with `intern_table_rehash()` after strings are compacted.
+ */
+static void gc_mark_interned_strings(struct v7 *v7) {
+  uint32_t i;
+  for (i = 0; i < v7->interned_size; i++) {
+    struct v7_interned_string *e = &v7->interned[i];
+    if (e->s != V7_UNDEFINED) {
+      char *s = v7->owned_strings.buf + gc_string_val_to_offset(e->s);
+      if (s[-1] == 1) {
+        gc_mark_string(v7, &e->s);
+      } else {
+        e->s = V7_UNDEFINED;
+        v7->interned_cnt--;
+      }
+    }
+  }
+}
+
 /*
  * mark an mbuf containing foreign pointers to `struct bcode`
  */
@@ -847,9 +877,28 @@ void v7_gc(struct v7 *v7, int full) {
 
   gc_mark_mbuf_pt(v7, &v7->tmp_stack);
   gc_mark_mbuf_pt(v7, &v7->owned_values);
+#ifdef V7_ENABLE_LOOP
+  loop_gc_mark(v7);
+#endif
+
+  gc_mark_interned_strings(v7);
 
   gc_compact_strings(v7);
 
+  /*
+   * If almost all owned strings are alive, make room for new ones: otherwise
+   * each new string would trigger GC again, see `compute_need_gc()`
+   */
+  if (v7->owned_strings.len > v7->owned_strings.size / 10 * 9) {
+    heapusage_dont_count(1);
+    mbuf_resize(&v7->owned_strings, v7->owned_strings.len * 2);
+    heapusage_dont_count(0);
+  }
+
+  intern_table_rehash(v7);
+  str_index_reset(v7);
+  v7->str_epoch++;
+
 #ifdef V7_MALLOC_GC
   gc_sweep_malloc(v7);
 #else
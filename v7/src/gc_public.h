@@ -38,7 +38,9 @@ enum v7_heap_stat_what {
   V7_HEAP_STAT_BCODE_LIT_TOTAL_SIZE,
   V7_HEAP_STAT_BCODE_LIT_DESER_SIZE,
   V7_HEAP_STAT_FUNC_OWNED,
-  V7_HEAP_STAT_FUNC_OWNED_MAX
+  V7_HEAP_STAT_FUNC_OWNED_MAX,
+  V7_HEAP_STAT_FUNC_COMPILED,
+  V7_HEAP_STAT_FUNC_PENDING
 };
 
 /* Returns a given heap statistics */
@@ -17,10 +17,6 @@
 #define FAST
 #endif
 
-#ifndef STATIC
-#define STATIC
-#endif
-
 #ifndef ENDL
 #define ENDL "\n"
 #endif
@@ -119,16 +115,17 @@ typedef unsigned long uintptr_t;
 #define M_SQRT1_2 0.707106781186547524400844362104849039
 #endif
 
-#ifndef NAN
-extern double _v7_nan;
-#define HAS_V7_NAN
-#define NAN (_v7_nan)
+/*
+ * Fallbacks for the compilers which lack C99 `INFINITY` and `NAN`. They are
+ * computed at runtime (some compilers reject division by zero in constant
+ * expressions), but without any global state.
+ */
+#ifndef INFINITY
+#define INFINITY (HUGE_VAL)
 #endif
 
-#ifndef INFINITY
-extern double _v7_infinity;
-#define HAS_V7_INFINITY
-#define INFINITY (_v7_infinity)
+#ifndef NAN
+#define NAN (INFINITY - INFINITY)
 #endif
 
 #ifndef EXIT_SUCCESS
@@ -145,11 +142,26 @@ extern double _v7_infinity;
 #define V7_CYG_PROFILE_ON
 #endif
 
+/*
+ * Storage class of the few variables which are needed by debug facilities
+ * that have no instance at hand, like instrumentation callbacks. They are
+ * per thread, so that instances running on different threads don't interfere.
+ * Can be defined empty on platforms without threads.
+ */
+#ifndef V7_THREAD_LOCAL
+#ifdef _MSC_VER
+#define V7_THREAD_LOCAL __declspec(thread)
+#else
+#define V7_THREAD_LOCAL __thread
+#endif
+#endif
+
 #if defined(V7_CYG_PROFILE_ON)
-extern struct v7 *v7_head;
+/* List of instances created on the current thread */
+extern V7_THREAD_LOCAL struct v7 *v7_head;
 
 #if defined(V7_STACK_GUARD_MIN_SIZE)
-extern void *v7_sp_limit;
+extern V7_THREAD_LOCAL void *v7_sp_limit;
 #endif
 #endif
 
@@ -0,0 +1,594 @@
+/*
+ * Copyright (c) 2014 Cesanta Software Limited
+ * All rights reserved
+ */
+
+#include "v7/src/internal.h"
+#include "v7/src/core.h"
+#include "v7/src/gc.h"
+#include "v7/src/eval.h"
+#include "v7/src/conversion.h"
+#include "v7/src/function.h"
+#include "v7/src/array.h"
+#include "v7/src/object.h"
+#include "v7/src/primitive.h"
+#include "v7/src/exceptions.h"
+#include "v7/src/loop.h"
+
+#ifdef V7_ENABLE_LOOP
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+/* Timer made by `setTimeout()` or `setInterval()` */
+struct loop_timer {
+  double due;      /* Time of the next run, see `loop_now()` */
+  double interval; /* Period in ms, or negative for one-shot timers */
+  unsigned long id;
+  val_t cb;
+  val_t args; /* Array of the arguments for `cb` */
+};
+
+struct v7_loop {
+  /* Binary min-heap of `struct loop_timer *`, see `timer_before()` */
+  struct mbuf timers;
+  unsigned long last_timer_id;
+
+  /* Timer whose callback is running, it's not in the heap meanwhile */
+  struct loop_timer *cur_timer;
+  unsigned int cur_timer_cleared : 1;
+
+#ifdef V7_ENABLE_SOCKET
+  struct mbuf socks;    /* `struct loop_sock *`, including deleted ones */
+  size_t socks_deleted; /* Number of deleted entries in `socks` */
+  struct mbuf pollfds;  /* `struct pollfd` for each entry in `socks` */
+#endif
+};
+
+#ifdef V7_ENABLE_SOCKET
+static const char s_loop_sock_prop[] = "__loop";
+#endif
+
+static struct v7_loop *loop_get(struct v7 *v7) {
+  if (v7->loop == NULL) {
+    v7->loop = (struct v7_loop *) calloc(1, sizeof(*v7->loop));
+  }
+  return v7->loop;
+}
+
+/* Returns monotonic time in milliseconds */
+static double loop_now(void) {
+#ifndef _WIN32
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double) tv.tv_sec * 1000 + (double) tv.tv_usec / 1000;
+#else
+  return (double) GetTickCount64();
+#endif
+}
+
+/*
+ * Timers {{{
+ */
+
+/* Timers which are due at the same time run in the order of creation */
+static int timer_before(const struct loop_timer *a,
+                        const struct loop_timer *b) {
+  return a->due < b->due || (a->due == b->due && a->id < b->id);
+}
+
+static void timers_sift_up(struct loop_timer **h, size_t i) {
+  while (i > 0 && timer_before(h[i], h[(i - 1) / 2])) {
+    struct loop_timer *tmp = h[i];
+    h[i] = h[(i - 1) / 2];
+    h[(i - 1) / 2] = tmp;
+    i = (i - 1) / 2;
+  }
+}
+
+static void timers_sift_down(struct loop_timer **h, size_t n, size_t i) {
+  for (;;) {
+    size_t min = i, l = 2 * i + 1, r = 2 * i + 2;
+    struct loop_timer *tmp;
+    if (l < n && timer_before(h[l], h[min])) min = l;
+    if (r < n && timer_before(h[r], h[min])) min = r;
+    if (min == i) break;
+    tmp = h[i];
+    h[i] = h[min];
+    h[min] = tmp;
+    i = min;
+  }
+}
+
+static size_t timers_cnt(struct v7_loop *l) {
+  return l->timers.len / sizeof(struct loop_timer *);
+}
+
+static void timers_push(struct v7_loop *l, struct loop_timer *t) {
+  mbuf_append(&l->timers, &t, sizeof(t));
+  timers_sift_up((struct loop_timer **) l->timers.buf, timers_cnt(l) - 1);
+}
+
+static void timers_remove(struct v7_loop *l, size_t i) {
+  struct loop_timer **h = (struct loop_timer **) l->timers.buf;
+  size_t n = timers_cnt(l) - 1;
+
+  h[i] = h[n];
+  l->timers.len -= sizeof(*h);
+  if (i < n) {
+    timers_sift_up(h, i);
+    timers_sift_down(h, n, i);
+  }
+}
+
+WARN_UNUSED_RESULT
+static enum v7_err loop_add_timer(struct v7 *v7, int repeat, val_t *res) {
+  enum v7_err rcode = V7_OK;
+  struct v7_loop *l = loop_get(v7);
+  val_t cb = v7_arg(v7, 0);
+  val_t args = V7_UNDEFINED;
+  struct loop_timer *t;
+  unsigned long i, argc = v7_argc(v7);
+  long delay = 0;
+  struct gc_tmp_frame tf = new_tmp_frame(v7);
+
+  tmp_stack_push(&tf, &args);
+
+  if (!v7_is_callable(v7, cb)) {
+    rcode = v7_throwf(v7, TYPE_ERROR, "Function expected");
+    goto clean;
+  }
+  V7_TRY(to_long(v7, v7_arg(v7, 1), 0, &delay));
+
+  /* Like in browsers, zero delay is 1 ms, so the loop can't starve */
+  if (delay < 1) delay = 1;
+
+  args = v7_mk_array(v7);
+  for (i = 2; i < argc; i++) {
+    v7_array_push(v7, args, v7_arg(v7, i));
+  }
+
+  t = (struct loop_timer *) calloc(1, sizeof(*t));
+  t->due = loop_now() + delay;
+  t->interval = repeat ? delay : -1;
+  t->id = ++l->last_timer_id;
+  t->cb = cb;
+  t->args = args;
+  timers_push(l, t);
+
+  *res = v7_mk_number(v7, t->id);
+
+clean:
+  tmp_frame_cleanup(&tf);
+  return rcode;
+}
+
+static void loop_clear_timer(struct v7 *v7) {
+  struct v7_loop *l = v7->loop;
+  val_t arg = v7_arg(v7, 0);
+  unsigned long id;
+  size_t i;
+
+  if (l == NULL || !v7_is_number(arg)) return;
+  id = (unsigned long) v7_get_double(v7, arg);
+
+  if (l->cur_timer != NULL && l->cur_timer->id == id) {
+    l->cur_timer_cleared = 1;
+    return;
+  }
+
+  for (i = 0; i < timers_cnt(l); i++) {
+    struct loop_timer *t = ((struct loop_timer **) l->timers.buf)[i];
+    if (t->id == id) {
+      timers_remove(l, i);
+      free(t);
+      return;
+    }
+  }
+}
+
+/* setTimeout(cb, delay [, arg1 [, ...]]) -> id */
+WARN_UNUSED_RESULT
+static enum v7_err Loop_setTimeout(struct v7 *v7, v7_val_t *res) {
+  return loop_add_timer(v7, 0, res);
+}
+
+/* setInterval(cb, delay [, arg1 [, ...]]) -> id */
+WARN_UNUSED_RESULT
+static enum v7_err Loop_setInterval(struct v7 *v7, v7_val_t *res) {
+  return loop_add_timer(v7, 1, res);
+}
+
+/* clearTimeout(id), clearInterval(id) */
+WARN_UNUSED_RESULT
+static enum v7_err Loop_clearTimer(struct v7 *v7, v7_val_t *res) {
+  loop_clear_timer(v7);
+  *res = V7_UNDEFINED;
+  return V7_OK;
+}
+
+/*
+ * Runs callbacks of the timers which are due at `now`. Timers made by the
+ * callbacks are due later, so they run on the next iteration.
+ */
+WARN_UNUSED_RESULT
+static enum v7_err loop_run_timers(struct v7 *v7, double now, val_t *res) {
+  enum v7_err rcode = V7_OK;
+  struct v7_loop *l = v7->loop;
+
+  while (timers_cnt(l) > 0) {
+    struct loop_timer *t = *(struct loop_timer **) l->timers.buf;
+    if (t->due > now) break;
+
+    timers_remove(l, 0);
+    l->cur_timer = t;
+    l->cur_timer_cleared = 0;
+    rcode = b_apply(v7, t->cb, v7_get_global(v7), t->args, 0, res);
+    l->cur_timer = NULL;
+
+    if (t->interval >= 0 && !l->cur_timer_cleared) {
+      t->due = loop_now() + t->interval;
+      timers_push(l, t);
+    } else {
+      free(t);
+    }
+
+    if (rcode != V7_OK) {
+      goto clean;
+    }
+  }
+
+clean:
+  return rcode;
+}
+
+/* }}} */
+
+#ifdef V7_ENABLE_SOCKET
+
+/*
+ * Sockets {{{
+ */
+
+static size_t socks_cnt(struct v7_loop *l) {
+  return l->socks.len / sizeof(struct loop_sock *);
+}
+
+static struct loop_sock *sock_at(struct v7_loop *l, size_t i) {
+  return ((struct loop_sock **) l->socks.buf)[i];
+}
+
+V7_PRIVATE int loop_would_block(void) {
+#ifdef _WIN32
+  return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+  return errno == EWOULDBLOCK || errno == EAGAIN || errno == EINTR;
+#endif
+}
+
+static void set_non_blocking(sock_t fd) {
+#ifdef _WIN32
+  unsigned long on = 1;
+  ioctlsocket(fd, FIONBIO, &on);
+#else
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+V7_PRIVATE struct loop_sock *loop_add_sock(struct v7 *v7, sock_t fd,
+                                           val_t obj) {
+  struct v7_loop *l = loop_get(v7);
+  struct loop_sock *ls = loop_get_sock(v7, obj);
+
+  if (ls != NULL) return ls;
+
+  ls = (struct loop_sock *) calloc(1, sizeof(*ls));
+  ls->fd = fd;
+  ls->obj = obj;
+  ls->handlers = v7_mk_object(v7);
+  mbuf_init(&ls->out, 0);
+  mbuf_append(&l->socks, &ls, sizeof(ls));
+
+  set_non_blocking(fd);
+  v7_def(v7, obj, s_loop_sock_prop, sizeof(s_loop_sock_prop) - 1,
+         V7_DESC_ENUMERABLE(0), v7_mk_foreign(v7, ls));
+
+  return ls;
+}
+
+V7_PRIVATE struct loop_sock *loop_get_sock(struct v7 *v7, val_t obj) {
+  val_t v;
+
+  if (v7->loop == NULL || !v7_is_object(obj)) return NULL;
+  v = v7_get(v7, obj, s_loop_sock_prop, sizeof(s_loop_sock_prop) - 1);
+  return v7_is_foreign(v) ? (struct loop_sock *) v7_get_ptr(v7, v) : NULL;
+}
+
+V7_PRIVATE void loop_del_sock(struct v7 *v7, struct loop_sock *ls) {
+  if (ls->deleted) return;
+
+  ls->deleted = 1;
+  mbuf_free(&ls->out);
+  v7->loop->socks_deleted++;
+  v7_def(v7, ls->obj, s_loop_sock_prop, sizeof(s_loop_sock_prop) - 1,
+         V7_DESC_ENUMERABLE(0), V7_UNDEFINED);
+}
+
+/* Sends the queued output, until the socket would block */
+static void loop_flush(struct loop_sock *ls) {
+  size_t sent = 0;
+  int n;
+
+  while (sent < ls->out.len &&
+         (n = send(ls->fd, ls->out.buf + sent, ls->out.len - sent, 0)) > 0) {
+    sent += n;
+  }
+
+  if (sent < ls->out.len && !loop_would_block()) {
+    /* The error is reported by `recv()` when the loop polls the socket */
+    sent = ls->out.len;
+  }
+  mbuf_remove(&ls->out, sent);
+}
+
+V7_PRIVATE size_t loop_send(struct v7 *v7, struct loop_sock *ls,
+                            const char *buf, size_t len) {
+  size_t sent = 0;
+  int n;
+  (void) v7;
+
+  if (ls->deleted) return 0;
+
+  if (ls->out.len == 0) {
+    while (sent < len && (n = send(ls->fd, buf + sent, len - sent, 0)) > 0) {
+      sent += n;
+    }
+    if (sent < len && !loop_would_block()) {
+      return sent;
+    }
+  }
+
+  mbuf_append(&ls->out, buf + sent, len - sent);
+  return len;
+}
+
+V7_PRIVATE enum v7_err loop_emit(struct v7 *v7, struct loop_sock *ls,
+                                 const char *event, val_t arg, val_t *res) {
+  enum v7_err rcode = V7_OK;
+  val_t cb = v7_get(v7, ls->handlers, event, ~0);
+  val_t args = V7_UNDEFINED;
+  struct gc_tmp_frame tf = new_tmp_frame(v7);
+
+  tmp_stack_push(&tf, &arg);
+  tmp_stack_push(&tf, &cb);
+  tmp_stack_push(&tf, &args);
+
+  if (v7_is_callable(v7, cb)) {
+    args = v7_mk_array(v7);
+    v7_array_push(v7, args, arg);
+    rcode = b_apply(v7, cb, ls->obj, args, 0, res);
+    if (rcode != V7_OK) {
+      goto clean;
+    }
+  }
+
+clean:
+  tmp_frame_cleanup(&tf);
+  return rcode;
+}
+
+static void loop_free_sock(struct loop_sock *ls) {
+  mbuf_free(&ls->out);
+  free(ls);
+}
+
+/* Frees deleted watchers, and prepares `pollfds` for the rest */
+static void loop_sweep_socks(struct v7_loop *l) {
+  size_t i, n = 0;
+  struct pollfd *pfd;
+
+  if (l->socks_deleted > 0) {
+    for (i = 0; i < socks_cnt(l); i++) {
+      struct loop_sock *ls = sock_at(l, i);
+      if (ls->deleted) {
+        loop_free_sock(ls);
+      } else {
+        ((struct loop_sock **) l->socks.buf)[n++] = ls;
+      }
+    }
+    l->socks.len = n * sizeof(struct loop_sock *);
+    l->socks_deleted = 0;
+  }
+
+  n = socks_cnt(l);
+  l->pollfds.len = 0;
+  mbuf_append(&l->pollfds, NULL, n * sizeof(*pfd));
+  pfd = (struct pollfd *) l->pollfds.buf;
+  for (i = 0; i < n; i++) {
+    struct loop_sock *ls = sock_at(l, i);
+    pfd[i].fd = ls->fd;
+    pfd[i].events = POLLIN | (ls->out.len > 0 ? POLLOUT : 0);
+    pfd[i].revents = 0;
+  }
+}
+
+/*
+ * Handles events of the first `n` sockets, as reported by the last poll.
+ * Sockets watched meanwhile are at the end of `socks`, so they are not
+ * affected.
+ */
+WARN_UNUSED_RESULT
+static enum v7_err loop_run_socks(struct v7 *v7, size_t n, val_t *res) {
+  enum v7_err rcode = V7_OK;
+  struct v7_loop *l = v7->loop;
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    struct pollfd *pfd = &((struct pollfd *) l->pollfds.buf)[i];
+    struct loop_sock *ls = sock_at(l, i);
+    short revents = pfd->revents;
+
+    pfd->revents = 0;
+    if (ls->deleted || revents == 0) continue;
+
+    if (revents & POLLOUT) {
+      loop_flush(ls);
+    }
+    if ((revents & (POLLIN | POLLHUP | POLLERR)) && ls->on_readable != NULL) {
+      rcode = ls->on_readable(v7, ls, res);
+      if (rcode != V7_OK) {
+        goto clean;
+      }
+    }
+  }
+
+clean:
+  return rcode;
+}
+
+/* }}} */
+
+#endif /* V7_ENABLE_SOCKET */
+
+/* Waits for socket events for at most `timeout_ms` */
+static void loop_wait(struct v7_loop *l, int timeout_ms) {
+#ifdef V7_ENABLE_SOCKET
+  size_t n = l->pollfds.len / sizeof(struct pollfd);
+  if (n > 0) {
+#ifdef _WIN32
+    WSAPoll((struct pollfd *) l->pollfds.buf, (ULONG) n, timeout_ms);
+#else
+    poll((struct pollfd *) l->pollfds.buf, (nfds_t) n, timeout_ms);
+#endif
+    return;
+  }
+#else
+  (void) l;
+#endif
+
+  if (timeout_ms > 0) {
+#ifdef _WIN32
+    Sleep(timeout_ms);
+#else
+    poll(NULL, 0, timeout_ms);
+#endif
+  }
+}
+
+enum v7_err v7_loop_run_once(struct v7 *v7, int timeout_ms, v7_val_t *res) {
+  enum v7_err rcode = V7_OK;
+  struct v7_loop *l = v7->loop;
+  size_t npoll = 0;
+
+  *res = V7_UNDEFINED;
+  if (v7_loop_pending(v7) == 0) goto clean;
+
+#ifdef V7_ENABLE_SOCKET
+  loop_sweep_socks(l);
+  npoll = socks_cnt(l);
+#endif
+
+  if (timers_cnt(l) > 0) {
+    double wait = (*(struct loop_timer **) l->timers.buf)->due - loop_now();
+    if (wait < 0) wait = 0;
+    if (timeout_ms < 0 || wait < timeout_ms) {
+      timeout_ms = (int) wait + (wait > (int) wait);
+    }
+  }
+
+  loop_wait(l, timeout_ms);
+
+#ifdef V7_ENABLE_SOCKET
+  rcode = loop_run_socks(v7, npoll, res);
+  if (rcode != V7_OK) {
+    goto clean;
+  }
+#else
+  (void) npoll;
+#endif
+  rcode = loop_run_timers(v7, loop_now(), res);
+  if (rcode != V7_OK) {
+    goto clean;
+  }
+
+  *res = V7_UNDEFINED;
+
+clean:
+  return rcode;
+}
+
+size_t v7_loop_pending(struct v7 *v7) {
+  struct v7_loop *l = v7->loop;
+  size_t n;
+
+  if (l == NULL) return 0;
+  n = timers_cnt(l);
+#ifdef V7_ENABLE_SOCKET
+  n += socks_cnt(l) - l->socks_deleted;
+#endif
+  return n;
+}
+
+V7_PRIVATE void loop_gc_mark(struct v7 *v7) {
+  struct v7_loop *l = v7->loop;
+  size_t i;
+
+  if (l == NULL) return;
+
+  for (i = 0; i < timers_cnt(l); i++) {
+    struct loop_timer *t = ((struct loop_timer **) l->timers.buf)[i];
+    gc_mark(v7, t->cb);
+    gc_mark(v7, t->args);
+  }
+  if (l->cur_timer != NULL) {
+    gc_mark(v7, l->cur_timer->cb);
+    gc_mark(v7, l->cur_timer->args);
+  }
+
+#ifdef V7_ENABLE_SOCKET
+  for (i = 0; i < socks_cnt(l); i++) {
+    struct loop_sock *ls = sock_at(l, i);
+    gc_mark(v7, ls->obj);
+    gc_mark(v7, ls->handlers);
+  }
+#endif
+}
+
+V7_PRIVATE void loop_free(struct v7 *v7) {
+  struct v7_loop *l = v7->loop;
+  size_t i;
+
+  if (l == NULL) return;
+
+  for (i = 0; i < timers_cnt(l); i++) {
+    free(((struct loop_timer **) l->timers.buf)[i]);
+  }
+  mbuf_free(&l->timers);
+
+#ifdef V7_ENABLE_SOCKET
+  for (i = 0; i < socks_cnt(l); i++) {
+    struct loop_sock *ls = sock_at(l, i);
+    if (!ls->deleted) {
+      closesocket(ls->fd);
+    }
+    loop_free_sock(ls);
+  }
+  mbuf_free(&l->socks);
+  mbuf_free(&l->pollfds);
+#endif
+
+  free(l);
+  v7->loop = NULL;
+}
+
+V7_PRIVATE void init_loop(struct v7 *v7) {
+  val_t global = v7_get_global(v7);
+
+  v7_set_method(v7, global, "setTimeout", Loop_setTimeout);
+  v7_set_method(v7, global, "setInterval", Loop_setInterval);
+  v7_set_method(v7, global, "clearTimeout", Loop_clearTimer);
+  v7_set_method(v7, global, "clearInterval", Loop_clearTimer);
+}
+
+#endif /* V7_ENABLE_LOOP */
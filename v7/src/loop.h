@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2014 Cesanta Software Limited
+ * All rights reserved
+ */
+
+#ifndef CS_V7_SRC_LOOP_H_
+#define CS_V7_SRC_LOOP_H_
+
+#include "v7/src/loop_public.h"
+
+#include "v7/src/core.h"
+#include "common/mbuf.h"
+#include "common/platform.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+#ifdef V7_ENABLE_LOOP
+
+#if defined(V7_ENABLE_SOCKET)
+struct loop_sock;
+
+/*
+ * Called by the loop when the socket is readable, or has got an error or a
+ * hangup. Normally it reads from the socket and emits events; should close
+ * the socket with `loop_del_sock()` on EOF and errors.
+ */
+typedef enum v7_err (*loop_sock_handler_t)(struct v7 *v7, struct loop_sock *ls,
+                                           val_t *res);
+
+/* Socket watched by the loop, see `loop_add_sock()` */
+struct loop_sock {
+  sock_t fd;
+  val_t obj;      /* Socket object, `this` of the callbacks */
+  val_t handlers; /* Object which maps event names to callbacks */
+  loop_sock_handler_t on_readable;
+  struct mbuf out; /* Data queued by `loop_send()` which is not sent yet */
+  unsigned int deleted : 1;
+};
+
+/*
+ * Starts watching the socket `fd` represented by the JS object `obj`, and
+ * switches it to non-blocking mode. If it's already watched, returns the
+ * existing watcher.
+ */
+V7_PRIVATE struct loop_sock *loop_add_sock(struct v7 *v7, sock_t fd, val_t obj);
+
+/* Returns the watcher of the socket object `obj`, or NULL */
+V7_PRIVATE struct loop_sock *loop_get_sock(struct v7 *v7, val_t obj);
+
+/*
+ * Stops watching the socket and drops the queued output. The socket itself is
+ * not closed. The watcher is freed by the loop later, so it's safe to call
+ * from callbacks.
+ */
+V7_PRIVATE void loop_del_sock(struct v7 *v7, struct loop_sock *ls);
+
+/*
+ * Sends as much of the data as the socket accepts without blocking, and
+ * queues the rest to be sent by the loop. Returns the number of bytes sent
+ * or queued, which is less than `len` only on errors.
+ */
+V7_PRIVATE size_t loop_send(struct v7 *v7, struct loop_sock *ls,
+                            const char *buf, size_t len);
+
+/*
+ * Invokes the callback of the event `event` of the socket, if any, with the
+ * socket object as `this` and `arg` as the only argument.
+ */
+WARN_UNUSED_RESULT
+V7_PRIVATE enum v7_err loop_emit(struct v7 *v7, struct loop_sock *ls,
+                                 const char *event, val_t arg, val_t *res);
+
+/* Returns true if the last socket operation failed with EWOULDBLOCK */
+V7_PRIVATE int loop_would_block(void);
+#endif /* V7_ENABLE_SOCKET */
+
+/* Defines `setTimeout()` and friends on the Global Object */
+V7_PRIVATE void init_loop(struct v7 *v7);
+
+/* Marks the values held by timers and watched sockets */
+V7_PRIVATE void loop_gc_mark(struct v7 *v7);
+
+/* Frees the loop state, and closes the watched sockets */
+V7_PRIVATE void loop_free(struct v7 *v7);
+
+#endif /* V7_ENABLE_LOOP */
+
+#if defined(__cplusplus)
+}
+#endif /* __cplusplus */
+
+#endif /* CS_V7_SRC_LOOP_H_ */
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2014 Cesanta Software Limited
+ * All rights reserved
+ */
+
+/*
+ * === Event loop
+ *
+ * If v7 is built with `V7_ENABLE_LOOP`, scripts can schedule callbacks with
+ * `setTimeout()` and `setInterval()`, and, if also built with
+ * `V7_ENABLE_SOCKET`, subscribe to socket events with `sock.on()`. The
+ * callbacks are invoked by the event loop, which is driven by the embedder:
+ *
+ *     while (v7_loop_pending(v7) > 0) {
+ *       if (v7_loop_run_once(v7, -1, &res) != V7_OK) {
+ *         v7_print_error(stderr, v7, "callback", res);
+ *       }
+ *     }
+ *
+ * An embedder which has a loop of its own can call `v7_loop_run_once()` with
+ * zero timeout on each iteration of it instead.
+ *
+ * Each watched socket keeps a few objects alive, so a server which handles
+ * many connections should create v7 with larger arenas (see
+ * `struct v7_create_opts`), otherwise GC runs too often.
+ */
+
+#ifndef CS_V7_SRC_LOOP_PUBLIC_H_
+#define CS_V7_SRC_LOOP_PUBLIC_H_
+
+#include "v7/src/core_public.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+#ifdef V7_ENABLE_LOOP
+
+/*
+ * Runs one iteration of the event loop: waits until a watched socket is ready
+ * or the nearest timer expires, but no longer than `timeout_ms` milliseconds
+ * (negative value means no limit), then invokes the callbacks of the ready
+ * sockets and expired timers. Returns immediately if there are no active
+ * timers and watched sockets.
+ *
+ * If a callback throws, the rest of the callbacks are left for the next
+ * iteration, the error is returned and `res` is populated with the thrown
+ * value. Otherwise, `V7_OK` is returned and `res` is set to `undefined`.
+ */
+WARN_UNUSED_RESULT
+enum v7_err v7_loop_run_once(struct v7 *v7, int timeout_ms, v7_val_t *res);
+
+/* Returns the number of active timers and watched sockets */
+size_t v7_loop_pending(struct v7 *v7);
+
+#endif /* V7_ENABLE_LOOP */
+
+#if defined(__cplusplus)
+}
+#endif /* __cplusplus */
+
+#endif /* CS_V7_SRC_LOOP_PUBLIC_H_ */
@@ -9,6 +9,7 @@
 #include "v7/src/main.h"
 #include "v7/src/primitive.h"
 #include "v7/src/exec.h"
+#include "v7/src/loop.h"
 #include "v7/src/util.h"
 #include "v7/src/conversion.h"
 #include "common/platform.h"
@@ -35,6 +36,8 @@ static void show_usage(char *argv[]) {
   fprintf(stderr, "%s\n", "  -t                   dump generated text AST");
   fprintf(stderr, "%s\n", "  -b                   dump generated binary AST");
   fprintf(stderr, "%s\n", "  -c                   dump compiled binary bcode");
+  fprintf(stderr, "%s\n",
+          "  -s                   execute files statement by statement");
   fprintf(stderr, "%s\n", "  -mm                  dump memory stats");
   fprintf(stderr, "%s\n", "  -vo <n>              object arena size");
   fprintf(stderr, "%s\n", "  -vf <n>              function arena size");
@@ -78,6 +81,7 @@ int v7_main(int argc, char *argv[], void (*pre_freeze_init)(struct v7 *),
   struct v7_create_opts opts;
   int as_json = 0;
   int i, j, show_ast = 0, binary_ast = 0, dump_bcode = 0, dump_stats = 0;
+  int stream = 0;
   val_t res;
   int nexprs = 0;
   const char *exprs[16];
@@ -97,6 +101,8 @@ int v7_main(int argc, char *argv[], void (*pre_freeze_init)(struct v7 *),
     } else if (strcmp(argv[i], "-c") == 0) {
       binary_ast = 1;
       dump_bcode = 1;
+    } else if (strcmp(argv[i], "-s") == 0) {
+      stream = 1;
     } else if (strcmp(argv[i], "-h") == 0) {
       show_usage(argv);
     } else if (strcmp(argv[i], "-j") == 0) {
@@ -198,7 +204,8 @@ int v7_main(int argc, char *argv[], void (*pre_freeze_init)(struct v7 *),
         }
         free(source_code);
       }
-    } else if (v7_exec_file(v7, argv[i], &res) != V7_OK) {
+    } else if ((stream ? v7_exec_file_stream(v7, argv[i], &res)
+                       : v7_exec_file(v7, argv[i], &res)) != V7_OK) {
       v7_print_error(stderr, v7, argv[i], res);
       res = V7_UNDEFINED;
     }
@@ -221,6 +228,17 @@ int v7_main(int argc, char *argv[], void (*pre_freeze_init)(struct v7 *),
     }
   }
 
+#ifdef V7_ENABLE_LOOP
+  /* Run the callbacks scheduled by the scripts */
+  if (!(show_ast || dump_bcode)) {
+    while (v7_loop_pending(v7) > 0) {
+      if (v7_loop_run_once(v7, -1, &res) != V7_OK) {
+        v7_print_error(stderr, v7, "callback", res);
+      }
+    }
+  }
+#endif
+
   if (post_init != NULL) {
     post_init(v7);
   }
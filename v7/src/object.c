@@ -3,6 +3,7 @@
  * All rights reserved
  */
 
+#include "common/str_util.h"
 #include "v7/src/internal.h"
 #include "v7/src/core.h"
 #include "v7/src/primitive.h"
@@ -14,6 +15,7 @@
 #include "v7/src/eval.h"
 #include "v7/src/exceptions.h"
 #include "v7/src/conversion.h"
+#include "v7/src/prop_table.h"
 
 /*
  * Default property attributes (see `v7_prop_attr_t`)
@@ -97,6 +99,302 @@ V7_PRIVATE int v7_is_generic_object(val_t v) {
 
 /* Object properties {{{ */
 
+V7_PRIVATE int cstr_to_index(const char *s, size_t len, unsigned long *idx) {
+  unsigned long res = 0;
+  size_t i;
+
+  /* No sign, no leading zeros, at most 10 digits */
+  if (len == 0 || len > 10 || (s[0] == '0' && len > 1)) {
+    return 0;
+  }
+  for (i = 0; i < len; i++) {
+    if (s[i] < '0' || s[i] > '9') {
+      return 0;
+    }
+    res = res * 10 + (s[i] - '0');
+  }
+  if (res > V7_MAX_ARRAY_INDEX) {
+    return 0;
+  }
+  *idx = res;
+  return 1;
+}
+
+V7_PRIVATE int val_to_index(struct v7 *v7, val_t v, unsigned long *idx) {
+  if (v7_is_number(v)) {
+    double d = v7_get_double(v7, v);
+    if (d >= 0 && d <= V7_MAX_ARRAY_INDEX && d == (double) (unsigned long) d) {
+      *idx = (unsigned long) d;
+      return 1;
+    }
+  } else if (v7_is_string(v)) {
+    size_t len;
+    const char *s = v7_get_string(v7, &v, &len);
+    return cstr_to_index(s, len, idx);
+  }
+  return 0;
+}
+
+V7_PRIVATE const char *prop_name_get_string(struct v7 *v7, val_t *name,
+                                            char *buf, size_t *len) {
+  if (v7_is_number(*name)) {
+    *len = c_snprintf(buf, V7_INDEX_BUF_SIZE, "%lu",
+                      (unsigned long) v7_get_double(v7, *name));
+    return buf;
+  }
+  return v7_get_string(v7, name, len);
+}
+
+V7_PRIVATE val_t prop_name_to_string(struct v7 *v7, val_t name) {
+  if (v7_is_number(name)) {
+    char buf[V7_INDEX_BUF_SIZE];
+    size_t len;
+    prop_name_get_string(v7, &name, buf, &len);
+    return v7_mk_string(v7, buf, len, 1);
+  }
+  return name;
+}
+
+/*
+ * Returns the property table of the object, or `NULL` if the object doesn't
+ * have one.
+ */
+static struct v7_prop_table *obj_prop_table(struct v7_object *o) {
+  if (o->attributes & V7_OBJ_PROP_TABLE) {
+    return (struct v7_prop_table *) get_ptr(o->properties->value);
+  }
+  return NULL;
+}
+
+/*
+ * Returns whether the property should be in the property table: only the
+ * properties named by strings or array indices are.
+ */
+static int prop_is_indexed(struct v7_property *p) {
+  return v7_is_number(p->name) || v7_is_string(p->name);
+}
+
+static uint32_t prop_hash(struct v7 *v7, struct v7_property *p) {
+  if (v7_is_number(p->name)) {
+    return (uint32_t) v7_get_double(v7, p->name);
+  } else {
+    return s_hash(v7, p->name);
+  }
+}
+
+/*
+ * Creates a property table for the object, and indexes all the properties the
+ * object has so far.
+ */
+static void obj_create_prop_table(struct v7 *v7, val_t obj) {
+  struct v7_object *o;
+  struct v7_property *holder, *prev, *p;
+  struct v7_prop_table *t;
+
+  v7_own(v7, &obj);
+  holder = v7_mk_property(v7);
+  v7_disown(v7, &obj);
+
+  o = get_object_struct(obj);
+  t = ptab_new();
+  /* The holder is going to precede the current first property */
+  for (prev = holder, p = o->properties; p != NULL; prev = p, p = p->next) {
+    if (prop_is_indexed(p)) {
+      ptab_add(t, prop_hash(v7, p), p, prev);
+    }
+  }
+
+  holder->attributes = _V7_PROPERTY_HIDDEN | V7_PROPERTY_NON_ENUMERABLE |
+                       V7_PROPERTY_NON_CONFIGURABLE | V7_PROPERTY_NON_WRITABLE;
+  holder->value = v7_mk_foreign(v7, t);
+  holder->next = o->properties;
+  o->properties = holder;
+  o->attributes |= V7_OBJ_PROP_TABLE;
+}
+
+V7_PRIVATE void obj_link_property(struct v7 *v7, val_t obj,
+                                  struct v7_property *p) {
+  struct v7_object *o = get_object_struct(obj);
+  struct v7_prop_table *t = obj_prop_table(o);
+
+  if (t != NULL) {
+    /* The table holder must remain the first property */
+    struct v7_property *holder = o->properties, *next = holder->next;
+    p->next = next;
+    holder->next = p;
+    if (prop_is_indexed(p)) {
+      ptab_add(t, prop_hash(v7, p), p, holder);
+    }
+    if (next != NULL && prop_is_indexed(next)) {
+      ptab_set_prev(t, prop_hash(v7, next), next, p);
+    }
+    return;
+  }
+
+  p->next = o->properties;
+  o->properties = p;
+
+  if (prop_is_indexed(p) && !(o->attributes & V7_OBJ_OFF_HEAP)) {
+    int n = 0;
+    for (; p != NULL && n < V7_PROP_TABLE_MIN_PROPS; p = p->next) {
+      n++;
+    }
+    if (n >= V7_PROP_TABLE_MIN_PROPS) {
+      obj_create_prop_table(v7, obj);
+    }
+  }
+}
+
+/*
+ * Unlinks and destroys property `*pp`, whose entry (if any) is already removed
+ * from the property table `t`.
+ */
+static void obj_unlink(struct v7 *v7, struct v7_prop_table *t,
+                       struct v7_property **pp) {
+  struct v7_property *p = *pp, *next = p->next;
+
+  *pp = next;
+  if (t != NULL && next != NULL && prop_is_indexed(next)) {
+    /*
+     * The table holder is always the first property, so `pp` points to the
+     * `next` field of some property.
+     */
+    char *prev = (char *) pp - offsetof(struct v7_property, next);
+    ptab_set_prev(t, prop_hash(v7, next), next, (struct v7_property *) prev);
+  }
+  v7_destroy_property(&p);
+}
+
+V7_PRIVATE void obj_unlink_property(struct v7 *v7, struct v7_object *o,
+                                    struct v7_property **pp) {
+  struct v7_prop_table *t = obj_prop_table(o);
+  if (t != NULL && prop_is_indexed(*pp)) {
+    ptab_del(t, prop_hash(v7, *pp), *pp);
+  }
+  obj_unlink(v7, t, pp);
+}
+
+/*
+ * Removes the given property from the object. With the property table, the
+ * previous property is taken from the table; otherwise the list is short, and
+ * it's just walked.
+ */
+static void obj_del_property(struct v7 *v7, struct v7_object *o,
+                             struct v7_property *p, uint32_t hash) {
+  struct v7_prop_table *t = obj_prop_table(o);
+  struct v7_property **pp, *prev;
+
+  if (t != NULL && (prev = ptab_del(t, hash, p)) != NULL) {
+    pp = &prev->next;
+  } else {
+    for (pp = &o->properties; *pp != p; pp = &pp[0]->next) {
+    }
+  }
+  obj_unlink(v7, t, pp);
+}
+
+V7_PRIVATE void obj_set_element_index(struct v7 *v7, struct v7_object *o,
+                                      struct v7_property *p,
+                                      unsigned long idx) {
+  struct v7_prop_table *t = obj_prop_table(o);
+  struct v7_property *prev = NULL;
+  if (t != NULL && prop_is_indexed(p)) {
+    prev = ptab_del(t, prop_hash(v7, p), p);
+  }
+  p->name = v7_mk_number(v7, idx);
+  if (t != NULL) {
+    ptab_add(t, prop_hash(v7, p), p, prev);
+  }
+}
+
+V7_PRIVATE void obj_free_prop_table(struct v7_object *o) {
+  struct v7_prop_table *t = obj_prop_table(o);
+  if (t != NULL) {
+    ptab_free(t);
+    o->attributes &= ~V7_OBJ_PROP_TABLE;
+  }
+}
+
+V7_PRIVATE unsigned long obj_elements_length(struct v7 *v7,
+                                             struct v7_object *o) {
+  struct v7_prop_table *t = obj_prop_table(o);
+  struct v7_property *p;
+  unsigned long len = 0;
+
+  if (t != NULL) {
+    return ptab_length(t);
+  }
+  for (p = o->properties; p != NULL; p = p->next) {
+    if (v7_is_number(p->name) && prop_hash(v7, p) >= len) {
+      len = prop_hash(v7, p) + 1;
+    }
+  }
+  return len;
+}
+
+V7_PRIVATE struct v7_property *v7_get_own_element(struct v7 *v7, val_t obj,
+                                                  unsigned long idx,
+                                                  v7_prop_attr_t attrs) {
+  struct v7_object *o;
+  struct v7_prop_table *t;
+  struct v7_property *p;
+
+  if (!v7_is_object(obj)) {
+    return NULL;
+  }
+  o = get_object_struct(obj);
+
+  if (o->attributes & V7_OBJ_DENSE_ARRAY) {
+    int has;
+    v7->cur_dense_prop->value = v7_array_get2(v7, obj, idx, &has);
+    return has ? v7->cur_dense_prop : NULL;
+  }
+
+  if ((t = obj_prop_table(o)) != NULL) {
+    p = ptab_find_element(v7, t, idx);
+  } else {
+    val_t name = v7_mk_number(v7, idx);
+    for (p = o->properties; p != NULL && p->name != name; p = p->next) {
+    }
+  }
+
+  if (p != NULL && (attrs == 0 || (p->attributes & attrs))) {
+    return p;
+  }
+  return NULL;
+}
+
+V7_PRIVATE struct v7_property *v7_get_element_property(struct v7 *v7,
+                                                       val_t obj,
+                                                       unsigned long idx) {
+  if (!v7_is_object(obj)) {
+    return NULL;
+  }
+  for (; obj != V7_NULL; obj = obj_prototype_v(v7, obj)) {
+    struct v7_property *prop;
+    if ((prop = v7_get_own_element(v7, obj, idx, 0)) != NULL) {
+      return prop;
+    }
+  }
+  return NULL;
+}
+
+V7_PRIVATE int v7_del_element(struct v7 *v7, val_t obj, unsigned long idx) {
+  struct v7_property *prop;
+  struct v7_object *o;
+
+  if (!v7_is_object(obj)) {
+    return -1;
+  }
+  o = get_object_struct(obj);
+  if ((o->attributes & V7_OBJ_DENSE_ARRAY) ||
+      (prop = v7_get_own_element(v7, obj, idx, 0)) == NULL) {
+    return -1;
+  }
+  obj_del_property(v7, o, prop, (uint32_t) idx);
+  return 0;
+}
+
 V7_PRIVATE struct v7_property *v7_mk_property(struct v7 *v7) {
   struct v7_property *p = new_property(v7);
 #if defined(V7_ENABLE_ENTITY_IDS)
@@ -109,13 +407,21 @@ V7_PRIVATE struct v7_property *v7_mk_property(struct v7 *v7) {
   return p;
 }
 
-V7_PRIVATE struct v7_property *v7_get_own_property2(struct v7 *v7, val_t obj,
-                                                    const char *name,
-                                                    size_t len,
-                                                    v7_prop_attr_t attrs) {
+/*
+ * Like `v7_get_own_property2()`. `str` is the string value of the name if
+ * there's one, or `V7_UNDEFINED`; `*hash` is `str_hash()` of the name, or zero
+ * if it's not computed yet, so that it's computed once when looking up the
+ * prototype chain.
+ */
+static struct v7_property *get_own_property(struct v7 *v7, val_t obj,
+                                            const char *name, size_t len,
+                                            val_t str, uint32_t *hash,
+                                            v7_prop_attr_t attrs) {
   struct v7_property *p;
   struct v7_object *o;
+  struct v7_prop_table *t;
   val_t ss;
+  unsigned long idx;
   if (!v7_is_object(obj)) {
     return NULL;
   }
@@ -138,6 +444,21 @@ V7_PRIVATE struct v7_property *v7_get_own_property2(struct v7 *v7, val_t obj,
     }
   }
 
+  if (cstr_to_index(name, len, &idx)) {
+    return v7_get_own_element(v7, obj, idx, attrs);
+  }
+
+  if ((t = obj_prop_table(o)) != NULL) {
+    if (*hash == 0) {
+      *hash = v7_is_string(str) ? s_hash(v7, str) : str_hash(name, len);
+    }
+    p = ptab_find_str(v7, t, *hash, name, len, str);
+    if (p != NULL && (attrs == 0 || (p->attributes & attrs))) {
+      return p;
+    }
+    return NULL;
+  }
+
   if (len <= 5) {
     ss = v7_mk_string(v7, name, len, 1);
     for (p = o->properties; p != NULL; p = p->next) {
@@ -152,17 +473,26 @@ V7_PRIVATE struct v7_property *v7_get_own_property2(struct v7 *v7, val_t obj,
       }
     }
   } else {
+    int interned = s_is_interned(v7, str);
     for (p = o->properties; p != NULL; p = p->next) {
       size_t n;
-      const char *s = v7_get_string(v7, &p->name, &n);
+      const char *s;
 #if defined(V7_ENABLE_ENTITY_IDS)
       if (p->entity_id != V7_ENTITY_ID_PROP) {
         fprintf(stderr, "not a prop!=0x%x\n", p->entity_id);
         abort();
       }
 #endif
-      if (n == len && strncmp(s, name, len) == 0 &&
-          (attrs == 0 || (p->attributes & attrs))) {
+      if (attrs != 0 && !(p->attributes & attrs)) {
+        continue;
+      } else if (p->name == str) {
+        return p;
+      } else if (interned && s_is_interned(v7, p->name)) {
+        /* Distinct interned names differ */
+        continue;
+      }
+      s = v7_get_string(v7, &p->name, &n);
+      if (n == len && (s == name || strncmp(s, name, len) == 0)) {
         return p;
       }
     }
@@ -170,37 +500,61 @@ V7_PRIVATE struct v7_property *v7_get_own_property2(struct v7 *v7, val_t obj,
   return NULL;
 }
 
+V7_PRIVATE struct v7_property *v7_get_own_property2(struct v7 *v7, val_t obj,
+                                                    const char *name,
+                                                    size_t len,
+                                                    v7_prop_attr_t attrs) {
+  uint32_t hash = 0;
+  return get_own_property(v7, obj, name, len, V7_UNDEFINED, &hash, attrs);
+}
+
 V7_PRIVATE struct v7_property *v7_get_own_property(struct v7 *v7, val_t obj,
                                                    const char *name,
                                                    size_t len) {
   return v7_get_own_property2(v7, obj, name, len, 0);
 }
 
-V7_PRIVATE struct v7_property *v7_get_property(struct v7 *v7, val_t obj,
-                                               const char *name, size_t len) {
+/* Like `v7_get_property()`, `str` is as in `get_own_property()` */
+static struct v7_property *get_property(struct v7 *v7, val_t obj,
+                                        const char *name, size_t len,
+                                        val_t str) {
+  uint32_t hash = 0;
   if (!v7_is_object(obj)) {
     return NULL;
   }
+  if (len == (size_t) ~0) {
+    len = strlen(name);
+  }
   for (; obj != V7_NULL; obj = obj_prototype_v(v7, obj)) {
     struct v7_property *prop;
-    if ((prop = v7_get_own_property(v7, obj, name, len)) != NULL) {
+    if ((prop = get_own_property(v7, obj, name, len, str, &hash, 0)) !=
+        NULL) {
       return prop;
     }
   }
   return NULL;
 }
 
+V7_PRIVATE struct v7_property *v7_get_property(struct v7 *v7, val_t obj,
+                                               const char *name, size_t len) {
+  return get_property(v7, obj, name, len, V7_UNDEFINED);
+}
+
 V7_PRIVATE enum v7_err v7_get_property_v(struct v7 *v7, val_t obj,
                                          v7_val_t name,
                                          struct v7_property **res) {
   enum v7_err rcode = V7_OK;
   size_t name_len;
-  STATIC char buf[8];
+  char buf[8];
   const char *s = buf;
   uint8_t fr = 0;
+  unsigned long idx;
 
   if (v7_is_string(name)) {
     s = v7_get_string(v7, &name, &name_len);
+  } else if (v7_is_number(name) && val_to_index(v7, name, &idx)) {
+    *res = v7_get_element_property(v7, obj, idx);
+    goto clean;
   } else {
     char *stmp;
     V7_TRY(v7_stringify_throwing(v7, name, buf, sizeof(buf),
@@ -212,7 +566,8 @@ V7_PRIVATE enum v7_err v7_get_property_v(struct v7 *v7, val_t obj,
     name_len = strlen(s);
   }
 
-  *res = v7_get_property(v7, obj, s, name_len);
+  *res = get_property(v7, obj, s, name_len,
+                      v7_is_string(name) ? name : V7_UNDEFINED);
 
 clean:
   if (fr) {
@@ -221,9 +576,10 @@ clean:
   return rcode;
 }
 
+/* Like `v7_get_throwing()`, `str` is as in `get_own_property()` */
 WARN_UNUSED_RESULT
-enum v7_err v7_get_throwing(struct v7 *v7, val_t obj, const char *name,
-                            size_t name_len, val_t *res) {
+static enum v7_err get_throwing(struct v7 *v7, val_t obj, const char *name,
+                                size_t name_len, val_t str, val_t *res) {
   enum v7_err rcode = V7_OK;
   val_t v = obj;
   if (v7_is_string(obj)) {
@@ -245,13 +601,19 @@ enum v7_err v7_get_throwing(struct v7 *v7, val_t obj, const char *name,
     v = v7->vals.function_prototype;
   }
 
-  V7_TRY(
-      v7_property_value(v7, obj, v7_get_property(v7, v, name, name_len), res));
+  V7_TRY(v7_property_value(v7, obj, get_property(v7, v, name, name_len, str),
+                           res));
 
 clean:
   return rcode;
 }
 
+WARN_UNUSED_RESULT
+enum v7_err v7_get_throwing(struct v7 *v7, val_t obj, const char *name,
+                            size_t name_len, val_t *res) {
+  return get_throwing(v7, obj, name, name_len, V7_UNDEFINED, res);
+}
+
 v7_val_t v7_get(struct v7 *v7, val_t obj, const char *name, size_t name_len) {
   enum v7_err rcode = V7_OK;
   uint8_t saved_is_thrown = 0;
@@ -277,9 +639,10 @@ V7_PRIVATE enum v7_err v7_get_throwing_v(struct v7 *v7, v7_val_t obj,
                                          v7_val_t name, v7_val_t *res) {
   enum v7_err rcode = V7_OK;
   size_t name_len;
-  STATIC char buf[8];
+  char buf[8];
   const char *s = buf;
   uint8_t fr = 0;
+  unsigned long idx;
 
   /* subscripting strings */
   if (v7_is_string(obj)) {
@@ -300,6 +663,12 @@ V7_PRIVATE enum v7_err v7_get_throwing_v(struct v7 *v7, v7_val_t obj,
 
   if (v7_is_string(name)) {
     s = v7_get_string(v7, &name, &name_len);
+  } else if (v7_is_object(obj) && v7_is_number(name) &&
+             val_to_index(v7, name, &idx)) {
+    /* element lookup: no need to stringify the index */
+    V7_TRY(v7_property_value(v7, obj, v7_get_element_property(v7, obj, idx),
+                             res));
+    goto clean;
   } else {
     char *stmp;
     V7_TRY(v7_stringify_throwing(v7, name, buf, sizeof(buf),
@@ -310,7 +679,8 @@ V7_PRIVATE enum v7_err v7_get_throwing_v(struct v7 *v7, v7_val_t obj,
     }
     name_len = strlen(s);
   }
-  V7_TRY(v7_get_throwing(v7, obj, s, name_len, res));
+  V7_TRY(get_throwing(v7, obj, s, name_len,
+                      v7_is_string(name) ? name : V7_UNDEFINED, res));
 
 clean:
   if (fr) {
@@ -442,8 +812,7 @@ V7_PRIVATE enum v7_err def_property_v(struct v7 *v7, val_t obj, val_t name,
                                       struct v7_property **res) {
   enum v7_err rcode = V7_OK;
   struct v7_property *prop = NULL;
-  size_t len;
-  const char *n = v7_get_string(v7, &name, &len);
+  unsigned long idx;
 
   v7_own(v7, &name);
   v7_own(v7, &val);
@@ -453,7 +822,21 @@ V7_PRIVATE enum v7_err def_property_v(struct v7 *v7, val_t obj, val_t name,
     goto clean;
   }
 
-  prop = v7_get_own_property(v7, obj, n, len);
+  if (val_to_index(v7, name, &idx)) {
+    /* Element properties are named by numbers, see `obj_next_prop()` */
+    name = v7_mk_number(v7, idx);
+    prop = v7_get_own_element(v7, obj, idx, 0);
+  } else {
+    size_t len;
+    const char *n;
+    uint32_t hash = 0;
+    if (!v7_is_string(name)) {
+      V7_TRY(to_string(v7, name, &name, NULL, 0, NULL));
+    }
+    n = v7_get_string(v7, &name, &len);
+    prop = get_own_property(v7, obj, n, len, name, &hash, 0);
+  }
+
   if (prop == NULL) {
     /*
      * The own property with given `name` doesn't exist yet: try to create it,
@@ -478,12 +861,11 @@ V7_PRIVATE enum v7_err def_property_v(struct v7 *v7, val_t obj, val_t name,
       prop = NULL; /* LCOV_EXCL_LINE */
       goto clean;
     }
-    prop->name = name;
+    prop->name = v7_intern_string(v7, name);
     prop->value = val;
     prop->attributes = apply_attrs_desc(attrs_desc, V7_DEFAULT_PROPERTY_ATTRS);
 
-    prop->next = get_object_struct(obj)->properties;
-    get_object_struct(obj)->properties = prop;
+    obj_link_property(v7, obj, prop);
     goto clean;
   } else {
     /* Property already exists */
@@ -583,7 +965,7 @@ V7_PRIVATE enum v7_err def_property(struct v7 *v7, val_t obj, const char *name,
     len = strlen(name);
   }
 
-  name_val = v7_mk_string(v7, name, len, 1);
+  name_val = v7_mk_interned_string(v7, name, len);
   V7_TRY(def_property_v(v7, obj, name_val, attrs_desc, val, as_assign, res));
 
 clean:
@@ -615,7 +997,10 @@ V7_PRIVATE int set_cfunc_prop(struct v7 *v7, val_t o, const char *name,
  * See comments in `object_public.h`
  */
 int v7_del(struct v7 *v7, val_t obj, const char *name, size_t len) {
-  struct v7_property *prop, *prev;
+  struct v7_property **pp;
+  struct v7_object *o;
+  struct v7_prop_table *t;
+  unsigned long idx;
 
   if (!v7_is_object(obj)) {
     return -1;
@@ -623,17 +1008,28 @@ int v7_del(struct v7 *v7, val_t obj, const char *name, size_t len) {
   if (len == (size_t) ~0) {
     len = strlen(name);
   }
-  for (prev = NULL, prop = get_object_struct(obj)->properties; prop != NULL;
-       prev = prop, prop = prop->next) {
+  if (cstr_to_index(name, len, &idx)) {
+    return v7_del_element(v7, obj, idx);
+  }
+  o = get_object_struct(obj);
+  if ((t = obj_prop_table(o)) != NULL) {
+    uint32_t hash = str_hash(name, len);
+    struct v7_property *p = ptab_find_str(v7, t, hash, name, len, V7_UNDEFINED);
+    if (p == NULL) {
+      return -1;
+    }
+    obj_del_property(v7, o, p, hash);
+    return 0;
+  }
+  for (pp = &o->properties; *pp != NULL; pp = &pp[0]->next) {
     size_t n;
-    const char *s = v7_get_string(v7, &prop->name, &n);
+    const char *s;
+    if (!v7_is_string(pp[0]->name)) {
+      continue;
+    }
+    s = v7_get_string(v7, &pp[0]->name, &n);
     if (n == len && strncmp(s, name, len) == 0) {
-      if (prev) {
-        prev->next = prop->next;
-      } else {
-        get_object_struct(obj)->properties = prop->next;
-      }
-      v7_destroy_property(&prop);
+      obj_unlink_property(v7, o, pp);
       return 0;
     }
   }
@@ -666,8 +1062,8 @@ clean:
   return rcode;
 }
 
-void *v7_next_prop(void *handle, v7_val_t obj, v7_val_t *name, v7_val_t *value,
-                   v7_prop_attr_t *attrs) {
+V7_PRIVATE void *obj_next_prop(void *handle, val_t obj, val_t *name,
+                               val_t *value, v7_prop_attr_t *attrs) {
   struct v7_property *p;
   if (handle == NULL) {
     p = get_object_struct(obj)->properties;
@@ -682,6 +1078,15 @@ void *v7_next_prop(void *handle, v7_val_t obj, v7_val_t *name, v7_val_t *value,
   return p;
 }
 
+void *v7_next_prop(struct v7 *v7, void *handle, v7_val_t obj, v7_val_t *name,
+                   v7_val_t *value, v7_prop_attr_t *attrs) {
+  handle = obj_next_prop(handle, obj, name, value, attrs);
+  if (handle != NULL && name != NULL) {
+    *name = prop_name_to_string(v7, *name);
+  }
+  return handle;
+}
+
 /* }}} Object properties */
 
 /* Object prototypes {{{ */
@@ -782,20 +1187,17 @@ V7_PRIVATE struct v7_property *get_user_data_property(v7_val_t obj) {
 static struct v7_property *get_or_create_user_data_property(struct v7 *v7,
                                                             v7_val_t obj) {
   struct v7_property *p = get_user_data_property(obj);
-  struct v7_object *o;
 
   if (p != NULL) return p;
 
   if (!v7_is_object(obj)) return NULL;
-  o = get_object_struct(obj);
   v7_own(v7, &obj);
   p = v7_mk_property(v7);
   v7_disown(v7, &obj);
 
   p->attributes |= _V7_PROPERTY_USER_DATA_AND_DESTRUCTOR | _V7_PROPERTY_HIDDEN;
 
-  p->next = o->properties;
-  o->properties = p;
+  obj_link_property(v7, obj, p);
 
   return p;
 }
@@ -11,6 +11,15 @@
 #include "v7/src/internal.h"
 #include "v7/src/core.h"
 
+/* Max array index, as per ECMA-262 15.4 */
+#define V7_MAX_ARRAY_INDEX 0xfffffffeUL
+
+/*
+ * Size of the buffer which is enough to print any array index, see
+ * `prop_name_get_string()`
+ */
+#define V7_INDEX_BUF_SIZE 12
+
 V7_PRIVATE val_t mk_object(struct v7 *v7, val_t prototype);
 V7_PRIVATE val_t v7_object_to_value(struct v7_object *o);
 V7_PRIVATE struct v7_generic_object *get_generic_object_struct(val_t v);
@@ -28,6 +37,80 @@ V7_PRIVATE struct v7_object *get_object_struct(v7_val_t v);
  */
 V7_PRIVATE int v7_is_generic_object(v7_val_t v);
 
+/*
+ * If `s` is an array index in its canonical form (i.e. as it would be printed
+ * by `ToString`), stores the index in `idx` and returns 1; otherwise returns 0.
+ */
+V7_PRIVATE int cstr_to_index(const char *s, size_t len, unsigned long *idx);
+
+/*
+ * Like `cstr_to_index()`, but takes the value which is either a string or a
+ * number.
+ */
+V7_PRIVATE int val_to_index(struct v7 *v7, val_t v, unsigned long *idx);
+
+/*
+ * Element properties (the ones whose names are array indices) keep their
+ * names as numbers, which are converted to strings only when they are
+ * actually needed as such.
+ *
+ * Like `v7_get_string()`, but handles the number names as well: those are
+ * printed into `buf`, which should be at least `V7_INDEX_BUF_SIZE` bytes long.
+ */
+V7_PRIVATE const char *prop_name_get_string(struct v7 *v7, val_t *name,
+                                            char *buf, size_t *len);
+
+/* Returns property name as a string, see `prop_name_get_string()` */
+V7_PRIVATE val_t prop_name_to_string(struct v7 *v7, val_t name);
+
+/*
+ * Same as `v7_next_prop()`, but names of the element properties are returned
+ * as numbers, see `prop_name_get_string()`
+ */
+V7_PRIVATE void *obj_next_prop(void *handle, val_t obj, val_t *name,
+                               val_t *value, v7_prop_attr_t *attrs);
+
+/*
+ * Adds the property to the head of the object's properties list, keeping the
+ * property table (if any) up to date.
+ */
+V7_PRIVATE void obj_link_property(struct v7 *v7, val_t obj,
+                                  struct v7_property *p);
+
+/*
+ * Removes property `*pp` from the object's properties list, `pp` should point
+ * to the `next` field of the previous property (or to the list head).
+ */
+V7_PRIVATE void obj_unlink_property(struct v7 *v7, struct v7_object *o,
+                                    struct v7_property **pp);
+
+/* Changes the index of the given element property */
+V7_PRIVATE void obj_set_element_index(struct v7 *v7, struct v7_object *o,
+                                      struct v7_property *p, unsigned long idx);
+
+/* Frees the property table, called when the object is destroyed */
+V7_PRIVATE void obj_free_prop_table(struct v7_object *o);
+
+/* Returns max index of the element properties + 1 */
+V7_PRIVATE unsigned long obj_elements_length(struct v7 *v7,
+                                             struct v7_object *o);
+
+/*
+ * Returns own element property with the given index, without converting the
+ * index to a string.
+ */
+V7_PRIVATE struct v7_property *v7_get_own_element(struct v7 *v7, val_t obj,
+                                                  unsigned long idx,
+                                                  v7_prop_attr_t attrs);
+
+/* Like `v7_get_own_element()`, but walks the prototype chain */
+V7_PRIVATE struct v7_property *v7_get_element_property(struct v7 *v7,
+                                                       val_t obj,
+                                                       unsigned long idx);
+
+/* Deletes own element property; returns 0 on success, -1 on error */
+V7_PRIVATE int v7_del_element(struct v7 *v7, val_t obj, unsigned long idx);
+
 V7_PRIVATE struct v7_property *v7_mk_property(struct v7 *v7);
 
 V7_PRIVATE struct v7_property *v7_get_own_property2(struct v7 *v7, val_t obj,
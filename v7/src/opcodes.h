@@ -496,6 +496,79 @@ enum opcode {
    */
   OP_EXIT_CATCH,
 
+  /*
+   * Dispatches a switch statement whose cases are all literals of the same
+   * type (see `enum bcode_switch_table_type`). Takes a jump target (like the
+   * other jumps) followed by the table, see `bcode_switch_table_size()`. The
+   * table is followed by `cnt + 1` `OP_JMP` instructions.
+   *
+   * If `a` is of the table's type, then the key is looked up in the table:
+   * if it is found, `a` replaces the TOS below it and the jump number `n` is
+   * taken (like `OP_JMP_TRUE_DROP` of the matching case does):
+   *
+   * `( b a -- a )`
+   *
+   * Otherwise, `a` is dropped and the jump number 0 is taken (to the
+   * `default` case or the end of the switch):
+   *
+   * `( b a -- b )`
+   *
+   * If `a` is not of the table's type, the jump to the target is taken, which
+   * is the usual sequence of comparisons:
+   *
+   * `( b a -- b a )`
+   */
+  OP_SWITCH_TABLE,
+
+  /*
+   * ==== Superinstructions
+   *
+   * The following instructions are never emitted by the compiler directly:
+   * they are produced by the peephole optimizer (see `bcode_optimize()`) out
+   * of common sequences of the instructions above, and behave exactly like
+   * the sequences they replace.
+   */
+
+  /*
+   * `GET_VAR a; PUSH_LIT b; GET`: takes two varint arguments -- variable
+   * name and property name.
+   *
+   * `( -- a.b )`
+   */
+  OP_GET_VAR_GET_PROP,
+
+  /*
+   * `PUSH_LIT b; ADD`: takes a varint argument -- the literal to add.
+   *
+   * `( a -- a+b )`
+   */
+  OP_PUSH_LIT_ADD,
+
+  /*
+   * `GET_VAR a; PUSH_ONE; ADD; SET_VAR a`: takes a varint argument --
+   * variable name.
+   *
+   * `( -- a+1 )`
+   */
+  OP_INC_VAR,
+  /* Like OP_INC_VAR, but subtracts one: `( -- a-1 )` */
+  OP_DEC_VAR,
+
+  /*
+   * Comparison followed by a conditional jump, e.g. `LT; JMP_TRUE`. Take
+   * the jump target like the other jumps.
+   *
+   * `( a b -- )`
+   */
+  OP_LT_JMP_TRUE,
+  OP_LE_JMP_TRUE,
+  OP_GT_JMP_TRUE,
+  OP_GE_JMP_TRUE,
+  OP_LT_JMP_FALSE,
+  OP_LE_JMP_FALSE,
+  OP_GT_JMP_FALSE,
+  OP_GE_JMP_FALSE,
+
   OP_MAX,
 };
 
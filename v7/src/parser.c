@@ -2455,63 +2455,49 @@ fid_none:
   return rc;
 }
 
-V7_PRIVATE enum v7_err parse(struct v7 *v7, struct ast *a, const char *src,
-                             size_t src_len, int is_json) {
+/*
+ * Runs the parser coroutine, starting with the "function" `fid`. Returns
+ * `V7_OK` on success; otherwise, the error code is returned and `*error_msg`
+ * is set. Nothing is thrown.
+ */
+static enum v7_err parse_cr(struct v7 *v7, struct ast *a, enum my_fid fid,
+                            const char **error_msg) {
   enum v7_err rcode;
-  const char *error_msg = NULL;
-  const char *p;
   struct cr_ctx cr_ctx;
   union user_arg_ret arg_retval;
   enum cr_status rc;
 #if defined(V7_ENABLE_STACK_TRACKING)
   struct stack_track_ctx stack_track_ctx;
 #endif
-  int saved_line_no = v7->line_no;
 
 #if defined(V7_ENABLE_STACK_TRACKING)
   v7_stack_track_start(v7, &stack_track_ctx);
 #endif
 
-  v7->pstate.source_code = v7->pstate.pc = src;
-  v7->pstate.src_end = src + src_len;
-  v7->pstate.file_name = "<stdin>";
-  v7->pstate.line_no = 1;
-  v7->pstate.in_function = 0;
-  v7->pstate.in_loop = 0;
-  v7->pstate.in_switch = 0;
-
-  /*
-   * TODO(dfrank): `v7->parser.line_no` vs `v7->line_no` is confusing.  probaby
-   * we need to refactor it.
-   *
-   * See comment for v7->line_no in core.h for some details.
-   */
-  v7->line_no = 1;
-
-  next_tok(v7);
-  /*
-   * setup initial state for "after newline" tracking.
-   * next_tok will consume our token and position the current line
-   * position at the beginning of the next token.
-   * While processing the first token, both the leading and the
-   * trailing newlines will be counted and thus it will create a spurious
-   * "after newline" condition at the end of the first token
-   * regardless if there is actually a newline after it.
-   */
-  for (p = src; isspace((int) *p); p++) {
-    if (*p == '\n') {
-      v7->pstate.prev_line_no++;
-    }
-  }
-
   /* init cr context */
   cr_context_init(&cr_ctx, &arg_retval, sizeof(arg_retval), _fid_descrs);
 
-  /* prepare first function call: fid_mul_sum */
-  if (is_json) {
-    CR_FIRST_CALL_PREPARE_C(&cr_ctx, fid_parse_terminal);
-  } else {
-    CR_FIRST_CALL_PREPARE_C(&cr_ctx, fid_parse_script);
+  /* prepare first function call */
+  switch (fid) {
+    case fid_parse_terminal:
+      CR_FIRST_CALL_PREPARE_C(&cr_ctx, fid_parse_terminal);
+      break;
+    case fid_parse_use_strict:
+      CR_FIRST_CALL_PREPARE_C(&cr_ctx, fid_parse_use_strict);
+      break;
+    case fid_parse_statement:
+      CR_FIRST_CALL_PREPARE_C(&cr_ctx, fid_parse_statement);
+      break;
+    case fid_parse_funcdecl:
+      /* function declaration, as in `parse_body` */
+      arg_retval.arg.fid_parse_funcdecl.require_named = 1;
+      arg_retval.arg.fid_parse_funcdecl.reserved_name = 0;
+      CR_FIRST_CALL_PREPARE_C(&cr_ctx, fid_parse_funcdecl);
+      break;
+    default:
+      assert(fid == fid_parse_script);
+      CR_FIRST_CALL_PREPARE_C(&cr_ctx, fid_parse_script);
+      break;
   }
 
   /* proceed to coroutine execution */
@@ -2526,18 +2512,18 @@ V7_PRIVATE enum v7_err parse(struct v7 *v7, struct ast *a, const char *src,
       switch ((enum parser_exc_id) CR_THROWN_C(&cr_ctx)) {
         case PARSER_EXC_ID__SYNTAX_ERROR:
           rcode = V7_SYNTAX_ERROR;
-          error_msg = "Syntax error";
+          *error_msg = "Syntax error";
           break;
 
         default:
           rcode = V7_INTERNAL_ERROR;
-          error_msg = "Internal error: no exception id set";
+          *error_msg = "Internal error: no exception id set";
           break;
       }
       break;
     default:
       rcode = V7_INTERNAL_ERROR;
-      error_msg = "Internal error: unexpected parser coroutine return code";
+      *error_msg = "Internal error: unexpected parser coroutine return code";
       break;
   }
 
@@ -2592,10 +2578,108 @@ V7_PRIVATE enum v7_err parse(struct v7 *v7, struct ast *a, const char *src,
   }
 #endif
 
+  return rcode;
+}
+
+/*
+ * Throws SyntaxError pointing at the current token, and returns `rcode`.
+ */
+static enum v7_err parse_throw(struct v7 *v7, enum v7_err rcode,
+                               const char *error_msg) {
+  unsigned long col = get_column(v7->pstate.source_code, v7->tok);
+  int line_len = 0;
+  const char *p;
+
+  assert(error_msg != NULL);
+
+  for (p = v7->tok - col; p < v7->pstate.src_end && *p != '\0' && *p != '\n';
+       p++) {
+    line_len++;
+  }
+
+  /* fixup line number: line_no points to the beginning of the next token */
+  for (; p < v7->pstate.pc; p++) {
+    if (*p == '\n') {
+      v7->pstate.line_no--;
+    }
+  }
+
+  /*
+   * We already have a proper `rcode`, that's why we discard returned value
+   * of `v7_throwf()`, which is always `V7_EXEC_EXCEPTION`.
+   *
+   * TODO(dfrank): probably get rid of distinct error types, and use just
+   * `V7_JS_EXCEPTION`. However it would be good to have a way to get exact
+   * error type, so probably error object should contain some property with
+   * error code, but it would make exceptions even more expensive, etc, etc.
+   */
+  {
+    enum v7_err _tmp;
+    _tmp = v7_throwf(v7, SYNTAX_ERROR, "%s at line %d col %lu:\n%.*s\n%*s^",
+                     error_msg, v7->pstate.line_no, col, line_len,
+                     v7->tok - col, (int) col - 1, "");
+    (void) _tmp;
+  }
+
+  return rcode;
+}
+
+V7_PRIVATE enum v7_err parse(struct v7 *v7, struct ast *a, const char *src,
+                             size_t src_len, int is_json) {
+  enum v7_err rcode;
+  const char *error_msg = NULL;
+  const char *p;
+  int saved_line_no = v7->line_no;
+
+  v7->pstate.source_code = v7->pstate.pc = src;
+  v7->pstate.src_end = src + src_len;
+  v7->pstate.file_name = "<stdin>";
+  v7->pstate.line_no = 1;
+  v7->pstate.in_function = 0;
+  v7->pstate.in_loop = 0;
+  v7->pstate.in_switch = 0;
+  v7->pstate.inhibit_in = 0;
+
+  /*
+   * TODO(dfrank): `v7->parser.line_no` vs `v7->line_no` is confusing.  probaby
+   * we need to refactor it.
+   *
+   * See comment for v7->line_no in core.h for some details.
+   */
+  v7->line_no = 1;
+
+  next_tok(v7);
+  /*
+   * setup initial state for "after newline" tracking.
+   * next_tok will consume our token and position the current line
+   * position at the beginning of the next token.
+   * While processing the first token, both the leading and the
+   * trailing newlines will be counted and thus it will create a spurious
+   * "after newline" condition at the end of the first token
+   * regardless if there is actually a newline after it.
+   */
+  for (p = src; isspace((int) *p); p++) {
+    if (*p == '\n') {
+      v7->pstate.prev_line_no++;
+    }
+  }
+
+  rcode = parse_cr(v7, a, is_json ? fid_parse_terminal : fid_parse_script,
+                   &error_msg);
+
+  /* Move the nodes wrapped around their operands in place */
+  ast_flush_inserts(a);
+
+  /* If the AST doesn't fit in small skips, parse it again with large ones */
+  if (a->has_overflow && a->skip_size == AST_SKIP_SIZE_SMALL) {
+    ast_use_large_skips(a);
+    rcode = parse(v7, a, src, src_len, is_json);
+    goto clean;
+  }
+
   /* Check if AST was overflown */
   if (a->has_overflow) {
-    rcode = v7_throwf(v7, SYNTAX_ERROR,
-                      "Script too large (try V7_LARGE_AST build option)");
+    rcode = v7_throwf(v7, SYNTAX_ERROR, "Script too large");
     V7_THROW(V7_AST_TOO_LARGE);
   }
 
@@ -2605,42 +2689,154 @@ V7_PRIVATE enum v7_err parse(struct v7 *v7, struct ast *a, const char *src,
   }
 
   if (rcode != V7_OK) {
-    unsigned long col = get_column(v7->pstate.source_code, v7->tok);
-    int line_len = 0;
+    V7_THROW(parse_throw(v7, rcode, error_msg));
+  }
+
+clean:
+  v7->line_no = saved_line_no;
+  return rcode;
+}
 
-    assert(error_msg != NULL);
+V7_PRIVATE enum v7_err parse_stmt(struct v7 *v7, struct ast *a,
+                                  struct v7_pstmt *ps) {
+  enum v7_err rcode = V7_OK;
+  const char *error_msg = NULL;
+  const char *p;
+  ast_off_t start, var_start;
+  int saved_line_no = v7->line_no;
+  size_t saved_last_var_node = v7->last_var_node;
 
-    for (p = v7->tok - col; p < v7->pstate.src_end && *p != '\0' && *p != '\n';
-         p++) {
-      line_len++;
-    }
+  ps->need_more = 0;
 
-    /* fixup line number: line_no points to the beginning of the next token */
-    for (; p < v7->pstate.pc; p++) {
+  v7->pstate.source_code = ps->src;
+  v7->pstate.src_end = ps->src + ps->src_len;
+  v7->pstate.file_name = "<stdin>";
+  v7->pstate.in_function = 0;
+  v7->pstate.in_loop = 0;
+  v7->pstate.in_switch = 0;
+  v7->pstate.inhibit_in = 0;
+  v7->pstate.in_strict = ps->in_strict;
+  v7->line_no = ps->started ? ps->ast_line_no : 1;
+
+  if (!ps->started) {
+    /* scan the first token, see `parse()` */
+    v7->pstate.pc = ps->src;
+    v7->pstate.line_no = 1;
+    v7->cur_tok = TOK_END_OF_INPUT;
+    next_tok(v7);
+    for (p = ps->src; p < v7->pstate.src_end && isspace((int) *p); p++) {
       if (*p == '\n') {
-        v7->pstate.line_no--;
+        v7->pstate.prev_line_no++;
       }
     }
+  } else {
+    /* restore tokenizer state saved after the previous statement */
+    v7->pstate.pc = ps->src + ps->pc;
+    v7->pstate.line_no = ps->line_no;
+    v7->pstate.prev_line_no = ps->prev_line_no;
+    v7->tok = ps->src + ps->tok;
+    v7->tok_len = ps->tok_len;
+    v7->cur_tok = ps->cur_tok;
+    v7->cur_tok_dbl = ps->cur_tok_dbl;
+    v7->after_newline = ps->after_newline;
+  }
 
+  ps->end = (v7->cur_tok == TOK_END_OF_INPUT);
+  if (!ps->end) {
     /*
-     * We already have a proper `rcode`, that's why we discard returned value
-     * of `v7_throwf()`, which is always `V7_EXEC_EXCEPTION`.
-     *
-     * TODO(dfrank): probably get rid of distinct error types, and use just
-     * `V7_JS_EXCEPTION`. However it would be good to have a way to get exact
-     * error type, so probably error object should contain some property with
-     * error code, but it would make exceptions even more expensive, etc, etc.
+     * The statement starts with the line number left by the previous one, so
+     * the line numbers of its nodes are recorded just like in the AST of the
+     * whole script (see `insert_line_no_if_changed()`), and the compiler
+     * starts the statement from the same line as well.
      */
-    {
-      enum v7_err _tmp;
-      _tmp = v7_throwf(v7, SYNTAX_ERROR, "%s at line %d col %lu:\n%.*s\n%*s^",
-                       error_msg, v7->pstate.line_no, col, line_len,
-                       v7->tok - col, (int) col - 1, "");
-      (void) _tmp;
+    start = ast_insert_node(a, a->mbuf.len, AST_SCRIPT);
+#ifndef V7_DISABLE_LINE_NUMBERS
+    ast_add_line_no(a, start - 1, v7->line_no);
+#endif
+    v7->last_var_node = start;
+    ast_modify_skip(a, start, start, AST_FUNC_FIRST_VAR_SKIP);
+
+    if (!ps->started &&
+        parse_cr(v7, a, fid_parse_use_strict, &error_msg) == V7_OK) {
+      v7->pstate.in_strict = 1;
     }
-    V7_THROW(rcode);
+
+    if (v7->cur_tok == TOK_END_OF_INPUT) {
+      /* the script consists of the "use strict" directive only */
+    } else if (v7->cur_tok == TOK_FUNCTION) {
+      /* function declaration: see `parse_body` */
+      next_tok(v7);
+      if (v7->cur_tok != TOK_IDENTIFIER) {
+        rcode = V7_SYNTAX_ERROR;
+        error_msg = "Syntax error";
+      } else {
+        var_start = add_node(v7, a, AST_VAR);
+        ast_modify_skip(a, v7->last_var_node, var_start,
+                        AST_FUNC_FIRST_VAR_SKIP);
+        ast_modify_skip(a, var_start, var_start, AST_FUNC_FIRST_VAR_SKIP);
+        v7->last_var_node = var_start;
+        add_inlined_node(v7, a, AST_FUNC_DECL, v7->tok, v7->tok_len);
+
+        rcode = parse_cr(v7, a, fid_parse_funcdecl, &error_msg);
+        ast_set_skip(a, var_start, AST_END_SKIP);
+      }
+    } else {
+      rcode = parse_cr(v7, a, fid_parse_statement, &error_msg);
+    }
+    ast_set_skip(a, start, AST_END_SKIP);
+  }
+
+  v7->last_var_node = saved_last_var_node;
+
+  /*
+   * If the tokenizer has reached the end of the window, the last token might
+   * be incomplete (an incomplete string literal is even scanned as the end of
+   * input). An error might be caused by the truncated source as well (e.g. by
+   * an unterminated regexp literal), so it's only reported once the whole
+   * source is available.
+   */
+  if (!ps->eof &&
+      (v7->pstate.pc >= v7->pstate.src_end ||
+       v7->cur_tok == TOK_END_OF_INPUT || rcode != V7_OK)) {
+    ps->need_more = 1;
+    rcode = V7_OK;
+    goto clean;
+  }
+
+  /* Move the nodes wrapped around their operands in place */
+  ast_flush_inserts(a);
+
+  /* As in `parse()`, parse the statement again with large skips if needed */
+  if (a->has_overflow && a->skip_size == AST_SKIP_SIZE_SMALL) {
+    ast_use_large_skips(a);
+    rcode = parse_stmt(v7, a, ps);
+    goto clean;
   }
 
+  /* Check if AST was overflown */
+  if (a->has_overflow) {
+    rcode = v7_throwf(v7, SYNTAX_ERROR, "Script too large");
+    V7_THROW(V7_AST_TOO_LARGE);
+  }
+
+  if (rcode != V7_OK) {
+    V7_THROW(parse_throw(v7, rcode, error_msg));
+  }
+
+  ps->started = 1;
+  ps->in_strict = v7->pstate.in_strict;
+
+  /* save tokenizer state for the next statement */
+  ps->pc = v7->pstate.pc - ps->src;
+  ps->line_no = v7->pstate.line_no;
+  ps->prev_line_no = v7->pstate.prev_line_no;
+  ps->ast_line_no = v7->line_no;
+  ps->tok = v7->tok - ps->src;
+  ps->tok_len = v7->tok_len;
+  ps->cur_tok = v7->cur_tok;
+  ps->cur_tok_dbl = v7->cur_tok_dbl;
+  ps->after_newline = v7->after_newline;
+
 clean:
   v7->line_no = saved_line_no;
   return rcode;
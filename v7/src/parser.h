@@ -8,6 +8,7 @@
 
 #include "v7/src/internal.h"
 #include "v7/src/core_public.h"
+#include "v7/src/tokenizer.h"
 
 struct v7;
 struct ast;
@@ -33,6 +34,58 @@ struct v7_pstate {
 V7_PRIVATE enum v7_err parse(struct v7 *v7, struct ast *a, const char *src,
                              size_t src_len, int is_json);
 
+/*
+ * State of the statement by statement parsing of a script, see `parse_stmt()`.
+ * Should be zeroed out before parsing the first statement.
+ */
+struct v7_pstmt {
+  /* Set by the caller before each `parse_stmt()` call */
+  const char *src; /* Window of the source code, starts at the line start */
+  size_t src_len;  /* Length of the window */
+  unsigned int eof : 1; /* True if the window reaches the end of the source */
+
+  /* Set by `parse_stmt()` */
+  unsigned int need_more : 1; /* True if the window should be extended */
+  unsigned int end : 1;       /* True if there are no more statements */
+  unsigned int started : 1;   /* True if the first token is scanned */
+  unsigned int in_strict : 1; /* True if the script is in strict mode */
+
+  /*
+   * Tokenizer state at the beginning of the next statement; `tok` and `pc`
+   * are offsets in `src`, so the caller should adjust them when the window is
+   * moved.
+   */
+  size_t tok;
+  size_t pc;
+  unsigned long tok_len;
+  enum v7_tok cur_tok;
+  double cur_tok_dbl;
+  int after_newline;
+  int line_no;
+  int prev_line_no;
+
+  /*
+   * Line number recorded in the AST most recently, see `parse_stmt()`. The
+   * caller should not adjust it.
+   */
+  int ast_line_no;
+};
+
+/*
+ * Parses the next top-level statement of a script from the window of the
+ * source code described by `ps`. The resulting AST looks just like the AST of
+ * a script consisting of that single statement (and, for the first statement,
+ * the "use strict" directive), so it can be compiled with
+ * `compile_script_decls()` and `compile_script_stmt()`.
+ *
+ * If the statement may continue beyond the window (and `ps->eof` is not set),
+ * then nothing is thrown and `ps->need_more` is set: the caller should extend
+ * the window, reinitialize the AST and try again. At the end of the script,
+ * `ps->end` is set and `a` is left empty.
+ */
+V7_PRIVATE enum v7_err parse_stmt(struct v7 *v7, struct ast *a,
+                                  struct v7_pstmt *ps);
+
 #if defined(__cplusplus)
 }
 #endif /* __cplusplus */
@@ -3869,61 +3869,49 @@ fid_none:
   return rc;
 }
 
- enum v7_err parse(struct v7 *v7, struct ast *a, const char *src,
-                             size_t src_len, int is_json) {
+/*
+ * Runs the parser coroutine, starting with the "function" `fid`. Returns
+ * `V7_OK` on success; otherwise, the error code is returned and `*error_msg`
+ * is set. Nothing is thrown.
+ */
+static enum v7_err parse_cr(struct v7 *v7, struct ast *a, enum my_fid fid,
+                            const char **error_msg) {
   enum v7_err rcode;
-  const char *error_msg = ((void *)0);
-  const char *p;
   struct cr_ctx cr_ctx;
   union user_arg_ret arg_retval;
   enum cr_status rc;
 
 
-  int saved_line_no = v7->line_no;
-
 
 
 
-  v7->pstate.source_code = v7->pstate.pc = src;
-  v7->pstate.src_end = src + src_len;
-  v7->pstate.file_name = "<stdin>";
-  v7->pstate.line_no = 1;
-  v7->pstate.in_function = 0;
-  v7->pstate.in_loop = 0;
-  v7->pstate.in_switch = 0;
 
-  /*
-   * TODO(dfrank): `v7->parser.line_no` vs `v7->line_no` is confusing.  probaby
-   * we need to refactor it.
-   *
-   * See comment for v7->line_no in core.h for some details.
-   */
-  v7->line_no = 1;
 
-  next_tok(v7);
-  /*
-   * setup initial state for "after newline" tracking.
-   * next_tok will consume our token and position the current line
-   * position at the beginning of the next token.
-   * While processing the first token, both the leading and the
-   * trailing newlines will be counted and thus it will create a spurious
-   * "after newline" condition at the end of the first token
-   * regardless if there is actually a newline after it.
-   */
-  for (p = src; isspace((int) *p); p++) {
-    if (*p == '\n') {
-      v7->pstate.prev_line_no++;
-    }
-  }
 
   /* init cr context */
   cr_context_init(&cr_ctx, &arg_retval, sizeof(arg_retval), _fid_descrs);
 
-  /* prepare first function call: fid_mul_sum */
-  if (is_json) {
-    do { *(((cr_locals_size_t *) (&cr_ctx)->stack_ret.buf) + (&cr_ctx)->cur_fid_idx - 1) = (CR_FID__NONE); (&cr_ctx)->called_fid = (fid_parse_terminal); (&cr_ctx)->call_locals_size = (((sizeof(fid_parse_terminal_locals_t) == sizeof(cr_zero_size_type_t)) ? 0 : (sizeof(fid_parse_terminal_locals_t) <= ((cr_locals_size_t) -1) ? ((cr_locals_size_t)(((sizeof(fid_parse_terminal_locals_t)) + (sizeof(void *) - 1)) & (~(sizeof(void *) - 1)))) : ((cr_locals_size_t) -1)))); (&cr_ctx)->call_arg_size = (((sizeof(fid_parse_terminal_arg_t) == sizeof(cr_zero_size_type_t)) ? 0 : sizeof(fid_parse_terminal_arg_t))); } while (0);
-  } else {
-    do { *(((cr_locals_size_t *) (&cr_ctx)->stack_ret.buf) + (&cr_ctx)->cur_fid_idx - 1) = (CR_FID__NONE); (&cr_ctx)->called_fid = (fid_parse_script); (&cr_ctx)->call_locals_size = (((sizeof(fid_parse_script_locals_t) == sizeof(cr_zero_size_type_t)) ? 0 : (sizeof(fid_parse_script_locals_t) <= ((cr_locals_size_t) -1) ? ((cr_locals_size_t)(((sizeof(fid_parse_script_locals_t)) + (sizeof(void *) - 1)) & (~(sizeof(void *) - 1)))) : ((cr_locals_size_t) -1)))); (&cr_ctx)->call_arg_size = (((sizeof(fid_parse_script_arg_t) == sizeof(cr_zero_size_type_t)) ? 0 : sizeof(fid_parse_script_arg_t))); } while (0);
+  /* prepare first function call */
+  switch (fid) {
+    case fid_parse_terminal:
+      do { *(((cr_locals_size_t *) (&cr_ctx)->stack_ret.buf) + (&cr_ctx)->cur_fid_idx - 1) = (CR_FID__NONE); (&cr_ctx)->called_fid = (fid_parse_terminal); (&cr_ctx)->call_locals_size = (((sizeof(fid_parse_terminal_locals_t) == sizeof(cr_zero_size_type_t)) ? 0 : (sizeof(fid_parse_terminal_locals_t) <= ((cr_locals_size_t) -1) ? ((cr_locals_size_t)(((sizeof(fid_parse_terminal_locals_t)) + (sizeof(void *) - 1)) & (~(sizeof(void *) - 1)))) : ((cr_locals_size_t) -1)))); (&cr_ctx)->call_arg_size = (((sizeof(fid_parse_terminal_arg_t) == sizeof(cr_zero_size_type_t)) ? 0 : sizeof(fid_parse_terminal_arg_t))); } while (0);
+      break;
+    case fid_parse_use_strict:
+      do { *(((cr_locals_size_t *) (&cr_ctx)->stack_ret.buf) + (&cr_ctx)->cur_fid_idx - 1) = (CR_FID__NONE); (&cr_ctx)->called_fid = (fid_parse_use_strict); (&cr_ctx)->call_locals_size = (((sizeof(fid_parse_use_strict_locals_t) == sizeof(cr_zero_size_type_t)) ? 0 : (sizeof(fid_parse_use_strict_locals_t) <= ((cr_locals_size_t) -1) ? ((cr_locals_size_t)(((sizeof(fid_parse_use_strict_locals_t)) + (sizeof(void *) - 1)) & (~(sizeof(void *) - 1)))) : ((cr_locals_size_t) -1)))); (&cr_ctx)->call_arg_size = (((sizeof(fid_parse_use_strict_arg_t) == sizeof(cr_zero_size_type_t)) ? 0 : sizeof(fid_parse_use_strict_arg_t))); } while (0);
+      break;
+    case fid_parse_statement:
+      do { *(((cr_locals_size_t *) (&cr_ctx)->stack_ret.buf) + (&cr_ctx)->cur_fid_idx - 1) = (CR_FID__NONE); (&cr_ctx)->called_fid = (fid_parse_statement); (&cr_ctx)->call_locals_size = (((sizeof(fid_parse_statement_locals_t) == sizeof(cr_zero_size_type_t)) ? 0 : (sizeof(fid_parse_statement_locals_t) <= ((cr_locals_size_t) -1) ? ((cr_locals_size_t)(((sizeof(fid_parse_statement_locals_t)) + (sizeof(void *) - 1)) & (~(sizeof(void *) - 1)))) : ((cr_locals_size_t) -1)))); (&cr_ctx)->call_arg_size = (((sizeof(fid_parse_statement_arg_t) == sizeof(cr_zero_size_type_t)) ? 0 : sizeof(fid_parse_statement_arg_t))); } while (0);
+      break;
+    case fid_parse_funcdecl:
+      /* function declaration, as in `parse_body` */
+      arg_retval.arg.fid_parse_funcdecl.require_named = 1;
+      arg_retval.arg.fid_parse_funcdecl.reserved_name = 0;
+      do { *(((cr_locals_size_t *) (&cr_ctx)->stack_ret.buf) + (&cr_ctx)->cur_fid_idx - 1) = (CR_FID__NONE); (&cr_ctx)->called_fid = (fid_parse_funcdecl); (&cr_ctx)->call_locals_size = (((sizeof(fid_parse_funcdecl_locals_t) == sizeof(cr_zero_size_type_t)) ? 0 : (sizeof(fid_parse_funcdecl_locals_t) <= ((cr_locals_size_t) -1) ? ((cr_locals_size_t)(((sizeof(fid_parse_funcdecl_locals_t)) + (sizeof(void *) - 1)) & (~(sizeof(void *) - 1)))) : ((cr_locals_size_t) -1)))); (&cr_ctx)->call_arg_size = (((sizeof(fid_parse_funcdecl_arg_t) == sizeof(cr_zero_size_type_t)) ? 0 : sizeof(fid_parse_funcdecl_arg_t))); } while (0);
+      break;
+    default:
+      (void)( (!!(fid == fid_parse_script)) || (_wassert(L"fid == fid_parse_script", L"e:\\myproject\\scriptools\\unpacket_v7\\v7\\src\\parser.c", 2498), 0) );
+      do { *(((cr_locals_size_t *) (&cr_ctx)->stack_ret.buf) + (&cr_ctx)->cur_fid_idx - 1) = (CR_FID__NONE); (&cr_ctx)->called_fid = (fid_parse_script); (&cr_ctx)->call_locals_size = (((sizeof(fid_parse_script_locals_t) == sizeof(cr_zero_size_type_t)) ? 0 : (sizeof(fid_parse_script_locals_t) <= ((cr_locals_size_t) -1) ? ((cr_locals_size_t)(((sizeof(fid_parse_script_locals_t)) + (sizeof(void *) - 1)) & (~(sizeof(void *) - 1)))) : ((cr_locals_size_t) -1)))); (&cr_ctx)->call_arg_size = (((sizeof(fid_parse_script_arg_t) == sizeof(cr_zero_size_type_t)) ? 0 : sizeof(fid_parse_script_arg_t))); } while (0);
+      break;
   }
 
   /* proceed to coroutine execution */
@@ -3938,18 +3926,18 @@ fid_none:
       switch ((enum parser_exc_id) ((&cr_ctx)->thrown_exc)) {
         case PARSER_EXC_ID__SYNTAX_ERROR:
           rcode = V7_SYNTAX_ERROR;
-          error_msg = "Syntax error";
+          *error_msg = "Syntax error";
           break;
 
         default:
           rcode = V7_INTERNAL_ERROR;
-          error_msg = "Internal error: no exception id set";
+          *error_msg = "Internal error: no exception id set";
           break;
       }
       break;
     default:
       rcode = V7_INTERNAL_ERROR;
-      error_msg = "Internal error: unexpected parser coroutine return code";
+      *error_msg = "Internal error: unexpected parser coroutine return code";
       break;
   }
 
@@ -3989,6 +3977,7 @@ fid_none:
 
 
 
+
 
 
   /* free resources occupied by context (at least, "stack" arrays) */
@@ -4002,11 +3991,110 @@ fid_none:
 
 
 
+
+  return rcode;
+}
+
+/*
+ * Throws SyntaxError pointing at the current token, and returns `rcode`.
+ */
+static enum v7_err parse_throw(struct v7 *v7, enum v7_err rcode,
+                               const char *error_msg) {
+  unsigned long col = get_column(v7->pstate.source_code, v7->tok);
+  int line_len = 0;
+  const char *p;
+
+  (void)( (!!(error_msg != ((void *)0))) || (_wassert(L"error_msg != NULL", L"e:\\myproject\\scriptools\\unpacket_v7\\v7\\src\\parser.c", 2593), 0) );
+
+  for (p = v7->tok - col; p < v7->pstate.src_end && *p != '\0' && *p != '\n';
+       p++) {
+    line_len++;
+  }
+
+  /* fixup line number: line_no points to the beginning of the next token */
+  for (; p < v7->pstate.pc; p++) {
+    if (*p == '\n') {
+      v7->pstate.line_no--;
+    }
+  }
+
+  /*
+   * We already have a proper `rcode`, that's why we discard returned value
+   * of `v7_throwf()`, which is always `V7_EXEC_EXCEPTION`.
+   *
+   * TODO(dfrank): probably get rid of distinct error types, and use just
+   * `V7_JS_EXCEPTION`. However it would be good to have a way to get exact
+   * error type, so probably error object should contain some property with
+   * error code, but it would make exceptions even more expensive, etc, etc.
+   */
+  {
+    enum v7_err _tmp;
+    _tmp = v7_throwf(v7, "SyntaxError", "%s at line %d col %lu:\n%.*s\n%*s^",
+                     error_msg, v7->pstate.line_no, col, line_len,
+                     v7->tok - col, (int) col - 1, "");
+    (void) _tmp;
+  }
+
+  return rcode;
+}
+
+ enum v7_err parse(struct v7 *v7, struct ast *a, const char *src,
+                             size_t src_len, int is_json) {
+  enum v7_err rcode;
+  const char *error_msg = ((void *)0);
+  const char *p;
+  int saved_line_no = v7->line_no;
+
+  v7->pstate.source_code = v7->pstate.pc = src;
+  v7->pstate.src_end = src + src_len;
+  v7->pstate.file_name = "<stdin>";
+  v7->pstate.line_no = 1;
+  v7->pstate.in_function = 0;
+  v7->pstate.in_loop = 0;
+  v7->pstate.in_switch = 0;
+  v7->pstate.inhibit_in = 0;
+
+  /*
+   * TODO(dfrank): `v7->parser.line_no` vs `v7->line_no` is confusing.  probaby
+   * we need to refactor it.
+   *
+   * See comment for v7->line_no in core.h for some details.
+   */
+  v7->line_no = 1;
+
+  next_tok(v7);
+  /*
+   * setup initial state for "after newline" tracking.
+   * next_tok will consume our token and position the current line
+   * position at the beginning of the next token.
+   * While processing the first token, both the leading and the
+   * trailing newlines will be counted and thus it will create a spurious
+   * "after newline" condition at the end of the first token
+   * regardless if there is actually a newline after it.
+   */
+  for (p = src; isspace((int) *p); p++) {
+    if (*p == '\n') {
+      v7->pstate.prev_line_no++;
+    }
+  }
+
+  rcode = parse_cr(v7, a, is_json ? fid_parse_terminal : fid_parse_script,
+                   &error_msg);
+
+  /* Move the nodes wrapped around their operands in place */
+  ast_flush_inserts(a);
+
+  /* If the AST doesn't fit in small skips, parse it again with large ones */
+  if (a->has_overflow && a->skip_size == AST_SKIP_SIZE_SMALL) {
+    ast_use_large_skips(a);
+    rcode = parse(v7, a, src, src_len, is_json);
+    goto clean;
+  }
+
   /* Check if AST was overflown */
   if (a->has_overflow) {
-    rcode = v7_throwf(v7, "SyntaxError",
-                      "Script too large (try V7_LARGE_AST build option)");
-    do { (void) v7; rcode = (V7_AST_TOO_LARGE); (void)( (!!(rcode != V7_OK)) || (_wassert(L"rcode != V7_OK", L"e:\\myproject\\scriptools\\unpacket_v7\\v7\\src\\parser.c", 2599), 0) ); (void)( (!!(!v7_is_undefined(v7->vals.thrown_error) && v7->is_thrown)) || (_wassert(L"!v7_is_undefined(v7->vals.thrown_error) && v7->is_thrown", L"e:\\myproject\\scriptools\\unpacket_v7\\v7\\src\\parser.c", 2599), 0) ); goto clean; } while (0);
+    rcode = v7_throwf(v7, "SyntaxError", "Script too large");
+    do { (void) v7; rcode = (V7_AST_TOO_LARGE); (void)( (!!(rcode != V7_OK)) || (_wassert(L"rcode != V7_OK", L"e:\\myproject\\scriptools\\unpacket_v7\\v7\\src\\parser.c", 2683), 0) ); (void)( (!!(!v7_is_undefined(v7->vals.thrown_error) && v7->is_thrown)) || (_wassert(L"!v7_is_undefined(v7->vals.thrown_error) && v7->is_thrown", L"e:\\myproject\\scriptools\\unpacket_v7\\v7\\src\\parser.c", 2683), 0) ); goto clean; } while (0);
   }
 
   if (rcode == V7_OK && v7->cur_tok != TOK_END_OF_INPUT) {
@@ -4015,44 +4103,147 @@ fid_none:
   }
 
   if (rcode != V7_OK) {
-    unsigned long col = get_column(v7->pstate.source_code, v7->tok);
-    int line_len = 0;
+    do { (void) v7; rcode = (parse_throw(v7, rcode, error_msg)); (void)( (!!(rcode != V7_OK)) || (_wassert(L"rcode != V7_OK", L"e:\\myproject\\scriptools\\unpacket_v7\\v7\\src\\parser.c", 2692), 0) ); (void)( (!!(!v7_is_undefined(v7->vals.thrown_error) && v7->is_thrown)) || (_wassert(L"!v7_is_undefined(v7->vals.thrown_error) && v7->is_thrown", L"e:\\myproject\\scriptools\\unpacket_v7\\v7\\src\\parser.c", 2692), 0) ); goto clean; } while (0);
+  }
 
-    (void)( (!!(error_msg != ((void *)0))) || (_wassert(L"error_msg != NULL", L"e:\\myproject\\scriptools\\unpacket_v7\\v7\\src\\parser.c", 2611), 0) );
+clean:
+  v7->line_no = saved_line_no;
+  return rcode;
+}
 
-    for (p = v7->tok - col; p < v7->pstate.src_end && *p != '\0' && *p != '\n';
-         p++) {
-      line_len++;
-    }
+ enum v7_err parse_stmt(struct v7 *v7, struct ast *a,
+                                  struct v7_pstmt *ps) {
+  enum v7_err rcode = V7_OK;
+  const char *error_msg = ((void *)0);
+  const char *p;
+  ast_off_t start, var_start;
+  int saved_line_no = v7->line_no;
+  size_t saved_last_var_node = v7->last_var_node;
 
-    /* fixup line number: line_no points to the beginning of the next token */
-    for (; p < v7->pstate.pc; p++) {
+  ps->need_more = 0;
+
+  v7->pstate.source_code = ps->src;
+  v7->pstate.src_end = ps->src + ps->src_len;
+  v7->pstate.file_name = "<stdin>";
+  v7->pstate.in_function = 0;
+  v7->pstate.in_loop = 0;
+  v7->pstate.in_switch = 0;
+  v7->pstate.inhibit_in = 0;
+  v7->pstate.in_strict = ps->in_strict;
+  v7->line_no = ps->started ? ps->ast_line_no : 1;
+
+  if (!ps->started) {
+    /* scan the first token, see `parse()` */
+    v7->pstate.pc = ps->src;
+    v7->pstate.line_no = 1;
+    v7->cur_tok = TOK_END_OF_INPUT;
+    next_tok(v7);
+    for (p = ps->src; p < v7->pstate.src_end && isspace((int) *p); p++) {
       if (*p == '\n') {
-        v7->pstate.line_no--;
+        v7->pstate.prev_line_no++;
       }
     }
+  } else {
+    /* restore tokenizer state saved after the previous statement */
+    v7->pstate.pc = ps->src + ps->pc;
+    v7->pstate.line_no = ps->line_no;
+    v7->pstate.prev_line_no = ps->prev_line_no;
+    v7->tok = ps->src + ps->tok;
+    v7->tok_len = ps->tok_len;
+    v7->cur_tok = ps->cur_tok;
+    v7->cur_tok_dbl = ps->cur_tok_dbl;
+    v7->after_newline = ps->after_newline;
+  }
 
-    /*
-     * We already have a proper `rcode`, that's why we discard returned value
-     * of `v7_throwf()`, which is always `V7_EXEC_EXCEPTION`.
-     *
-     * TODO(dfrank): probably get rid of distinct error types, and use just
-     * `V7_JS_EXCEPTION`. However it would be good to have a way to get exact
-     * error type, so probably error object should contain some property with
-     * error code, but it would make exceptions even more expensive, etc, etc.
-     */
-    {
-      enum v7_err _tmp;
-      _tmp = v7_throwf(v7, "SyntaxError", "%s at line %d col %lu:\n%.*s\n%*s^",
-                       error_msg, v7->pstate.line_no, col, line_len,
-                       v7->tok - col, (int) col - 1, "");
-      (void) _tmp;
+  ps->end = (v7->cur_tok == TOK_END_OF_INPUT);
+  if (!ps->end) {
+    start = ast_insert_node(a, a->mbuf.len, AST_SCRIPT);
+    ast_add_line_no(a, start - 1, v7->line_no);
+    v7->last_var_node = start;
+    ast_modify_skip(a, start, start, AST_FUNC_FIRST_VAR_SKIP);
+
+    if (!ps->started &&
+        parse_cr(v7, a, fid_parse_use_strict, &error_msg) == V7_OK) {
+      v7->pstate.in_strict = 1;
     }
-    do { (void) v7; rcode = (rcode); (void)( (!!(rcode != V7_OK)) || (_wassert(L"rcode != V7_OK", L"e:\\myproject\\scriptools\\unpacket_v7\\v7\\src\\parser.c", 2641), 0) ); (void)( (!!(!v7_is_undefined(v7->vals.thrown_error) && v7->is_thrown)) || (_wassert(L"!v7_is_undefined(v7->vals.thrown_error) && v7->is_thrown", L"e:\\myproject\\scriptools\\unpacket_v7\\v7\\src\\parser.c", 2641), 0) ); goto clean; } while (0);
+
+    if (v7->cur_tok == TOK_END_OF_INPUT) {
+      /* the script consists of the "use strict" directive only */
+    } else if (v7->cur_tok == TOK_FUNCTION) {
+      /* function declaration: see `parse_body` */
+      next_tok(v7);
+      if (v7->cur_tok != TOK_IDENTIFIER) {
+        rcode = V7_SYNTAX_ERROR;
+        error_msg = "Syntax error";
+      } else {
+        var_start = add_node(v7, a, AST_VAR);
+        ast_modify_skip(a, v7->last_var_node, var_start,
+                        AST_FUNC_FIRST_VAR_SKIP);
+        ast_modify_skip(a, var_start, var_start, AST_FUNC_FIRST_VAR_SKIP);
+        v7->last_var_node = var_start;
+        add_inlined_node(v7, a, AST_FUNC_DECL, v7->tok, v7->tok_len);
+
+        rcode = parse_cr(v7, a, fid_parse_funcdecl, &error_msg);
+        ast_set_skip(a, var_start, AST_END_SKIP);
+      }
+    } else {
+      rcode = parse_cr(v7, a, fid_parse_statement, &error_msg);
+    }
+    ast_set_skip(a, start, AST_END_SKIP);
+  }
+
+  v7->last_var_node = saved_last_var_node;
+
+  /*
+   * If the tokenizer has reached the end of the window, the last token might
+   * be incomplete (an incomplete string literal is even scanned as the end of
+   * input). An error might be caused by the truncated source as well (e.g. by
+   * an unterminated regexp literal), so it's only reported once the whole
+   * source is available.
+   */
+  if (!ps->eof &&
+      (v7->pstate.pc >= v7->pstate.src_end ||
+       v7->cur_tok == TOK_END_OF_INPUT || rcode != V7_OK)) {
+    ps->need_more = 1;
+    rcode = V7_OK;
+    goto clean;
   }
 
+  /* Move the nodes wrapped around their operands in place */
+  ast_flush_inserts(a);
+
+  /* As in `parse()`, parse the statement again with large skips if needed */
+  if (a->has_overflow && a->skip_size == AST_SKIP_SIZE_SMALL) {
+    ast_use_large_skips(a);
+    rcode = parse_stmt(v7, a, ps);
+    goto clean;
+  }
+
+  /* Check if AST was overflown */
+  if (a->has_overflow) {
+    rcode = v7_throwf(v7, "SyntaxError", "Script too large");
+    do { (void) v7; rcode = (V7_AST_TOO_LARGE); (void)( (!!(rcode != V7_OK)) || (_wassert(L"rcode != V7_OK", L"e:\\myproject\\scriptools\\unpacket_v7\\v7\\src\\parser.c", 2810), 0) ); (void)( (!!(!v7_is_undefined(v7->vals.thrown_error) && v7->is_thrown)) || (_wassert(L"!v7_is_undefined(v7->vals.thrown_error) && v7->is_thrown", L"e:\\myproject\\scriptools\\unpacket_v7\\v7\\src\\parser.c", 2810), 0) ); goto clean; } while (0);
+  }
+
+  if (rcode != V7_OK) {
+    do { (void) v7; rcode = (parse_throw(v7, rcode, error_msg)); (void)( (!!(rcode != V7_OK)) || (_wassert(L"rcode != V7_OK", L"e:\\myproject\\scriptools\\unpacket_v7\\v7\\src\\parser.c", 2814), 0) ); (void)( (!!(!v7_is_undefined(v7->vals.thrown_error) && v7->is_thrown)) || (_wassert(L"!v7_is_undefined(v7->vals.thrown_error) && v7->is_thrown", L"e:\\myproject\\scriptools\\unpacket_v7\\v7\\src\\parser.c", 2814), 0) ); goto clean; } while (0);
+  }
+
+  ps->started = 1;
+  ps->in_strict = v7->pstate.in_strict;
+
+  /* save tokenizer state for the next statement */
+  ps->pc = v7->pstate.pc - ps->src;
+  ps->line_no = v7->pstate.line_no;
+  ps->prev_line_no = v7->pstate.prev_line_no;
+  ps->ast_line_no = v7->line_no;
+  ps->tok = v7->tok - ps->src;
+  ps->tok_len = v7->tok_len;
+  ps->cur_tok = v7->cur_tok;
+  ps->cur_tok_dbl = v7->cur_tok_dbl;
+  ps->after_newline = v7->after_newline;
+
 clean:
   v7->line_no = saved_line_no;
   return rcode;
 }
-
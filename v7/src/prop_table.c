@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2014 Cesanta Software Limited
+ * All rights reserved
+ */
+
+#include "v7/src/internal.h"
+#include "v7/src/core.h"
+#include "v7/src/primitive.h"
+#include "v7/src/string.h"
+#include "v7/src/prop_table.h"
+
+#define PTAB_INITIAL_SIZE 16
+#define PTAB_DELETED ((struct v7_property *) 1)
+
+/* Knuth's multiplicative hashing spreads sequential indices over the slots */
+#define PTAB_SLOT(t, hash) (((uint32_t)(hash) *2654435761U) & ((t)->size - 1))
+
+static int ptab_is_element(struct v7_property *p) {
+  return v7_is_number(p->name);
+}
+
+static void ptab_insert_entry(struct v7_prop_table *t, uint32_t hash,
+                              struct v7_property *p, struct v7_property *prev) {
+  uint32_t i = PTAB_SLOT(t, hash);
+  while (t->entries[i].prop != NULL && t->entries[i].prop != PTAB_DELETED) {
+    i = (i + 1) & (t->size - 1);
+  }
+  if (t->entries[i].prop == NULL) {
+    t->used++;
+  }
+  t->entries[i].hash = hash;
+  t->entries[i].prop = p;
+  t->entries[i].prev = prev;
+  t->count++;
+}
+
+/*
+ * Reallocates slots so that the table is at most half full; deleted slots
+ * are dropped.
+ */
+static void ptab_rehash(struct v7_prop_table *t) {
+  struct v7_prop_table_entry *old = t->entries;
+  uint32_t old_size = t->size, i;
+
+  while (t->count * 2 >= t->size) {
+    t->size *= 2;
+  }
+
+  t->entries = (struct v7_prop_table_entry *) calloc(t->size, sizeof(*old));
+  if (t->entries == NULL) abort();
+  t->count = t->used = 0;
+
+  for (i = 0; i < old_size; i++) {
+    if (old[i].prop != NULL && old[i].prop != PTAB_DELETED) {
+      ptab_insert_entry(t, old[i].hash, old[i].prop, old[i].prev);
+    }
+  }
+  free(old);
+}
+
+V7_PRIVATE struct v7_prop_table *ptab_new(void) {
+  struct v7_prop_table *t =
+      (struct v7_prop_table *) calloc(1, sizeof(struct v7_prop_table));
+  if (t == NULL) abort();
+  t->size = PTAB_INITIAL_SIZE;
+  t->entries = (struct v7_prop_table_entry *) calloc(
+      t->size, sizeof(struct v7_prop_table_entry));
+  if (t->entries == NULL) abort();
+  return t;
+}
+
+V7_PRIVATE void ptab_free(struct v7_prop_table *t) {
+  if (t == NULL) return;
+  free(t->entries);
+  free(t);
+}
+
+/* Returns the entry of the given property, or `NULL` */
+static struct v7_prop_table_entry *ptab_entry(struct v7_prop_table *t,
+                                              uint32_t hash,
+                                              struct v7_property *p) {
+  uint32_t i = PTAB_SLOT(t, hash);
+  for (; t->entries[i].prop != NULL; i = (i + 1) & (t->size - 1)) {
+    if (t->entries[i].prop == p) {
+      return &t->entries[i];
+    }
+  }
+  return NULL;
+}
+
+V7_PRIVATE void ptab_add(struct v7_prop_table *t, uint32_t hash,
+                         struct v7_property *p, struct v7_property *prev) {
+  /* Keep at least a quarter of slots empty, so that probing terminates fast */
+  if ((t->used + 1) * 4 > t->size * 3) {
+    ptab_rehash(t);
+  }
+  ptab_insert_entry(t, hash, p, prev);
+
+  if (ptab_is_element(p) && !t->length_stale && hash >= t->length) {
+    t->length = hash + 1;
+  }
+}
+
+V7_PRIVATE struct v7_property *ptab_del(struct v7_prop_table *t,
+                                        uint32_t hash, struct v7_property *p) {
+  struct v7_prop_table_entry *e = ptab_entry(t, hash, p);
+  if (e == NULL) {
+    return NULL;
+  }
+  e->prop = PTAB_DELETED;
+  t->count--;
+  if (ptab_is_element(p) && hash + 1 == t->length) {
+    t->length_stale = 1;
+  }
+  return e->prev;
+}
+
+V7_PRIVATE void ptab_set_prev(struct v7_prop_table *t, uint32_t hash,
+                              struct v7_property *p, struct v7_property *prev) {
+  struct v7_prop_table_entry *e = ptab_entry(t, hash, p);
+  if (e != NULL) {
+    e->prev = prev;
+  }
+}
+
+V7_PRIVATE struct v7_property *ptab_find_element(struct v7 *v7,
+                                                 struct v7_prop_table *t,
+                                                 unsigned long idx) {
+  val_t name = v7_mk_number(v7, idx);
+  uint32_t i = PTAB_SLOT(t, idx);
+  for (; t->entries[i].prop != NULL; i = (i + 1) & (t->size - 1)) {
+    struct v7_prop_table_entry *e = &t->entries[i];
+    if (e->prop != PTAB_DELETED && e->hash == idx && e->prop->name == name) {
+      return e->prop;
+    }
+  }
+  return NULL;
+}
+
+V7_PRIVATE struct v7_property *ptab_find_str(struct v7 *v7,
+                                             struct v7_prop_table *t,
+                                             uint32_t hash, const char *name,
+                                             size_t len, val_t str) {
+  int interned = s_is_interned(v7, str);
+  uint32_t i = PTAB_SLOT(t, hash);
+  for (; t->entries[i].prop != NULL; i = (i + 1) & (t->size - 1)) {
+    struct v7_prop_table_entry *e = &t->entries[i];
+    if (e->prop != PTAB_DELETED && e->hash == hash &&
+        v7_is_string(e->prop->name)) {
+      size_t n;
+      const char *s;
+      if (e->prop->name == str) {
+        return e->prop;
+      } else if (interned && s_is_interned(v7, e->prop->name)) {
+        /* Distinct interned names differ */
+        continue;
+      }
+      s = v7_get_string(v7, &e->prop->name, &n);
+      if (n == len && (s == name || memcmp(s, name, len) == 0)) {
+        return e->prop;
+      }
+    }
+  }
+  return NULL;
+}
+
+V7_PRIVATE unsigned long ptab_length(struct v7_prop_table *t) {
+  if (t->length_stale) {
+    uint32_t i;
+    t->length = 0;
+    for (i = 0; i < t->size; i++) {
+      struct v7_prop_table_entry *e = &t->entries[i];
+      if (e->prop != NULL && e->prop != PTAB_DELETED &&
+          ptab_is_element(e->prop) && e->hash >= t->length) {
+        t->length = e->hash + 1;
+      }
+    }
+    t->length_stale = 0;
+  }
+  return t->length;
+}
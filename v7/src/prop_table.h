@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2014 Cesanta Software Limited
+ * All rights reserved
+ */
+
+#ifndef CS_V7_SRC_PROP_TABLE_H_
+#define CS_V7_SRC_PROP_TABLE_H_
+
+#include "v7/src/internal.h"
+#include "v7/src/core.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Minimal number of properties an object should have before it gets a
+ * property table, see `struct v7_prop_table`.
+ */
+#ifndef V7_PROP_TABLE_MIN_PROPS
+#define V7_PROP_TABLE_MIN_PROPS 8
+#endif
+
+struct v7_prop_table_entry {
+  uint32_t hash;
+  /* `NULL`: empty slot, `PTAB_DELETED`: deleted slot */
+  struct v7_property *prop;
+  /* Previous property in the object's properties list */
+  struct v7_property *prev;
+};
+
+/*
+ * Open-addressing hash table which indexes the properties of an object by
+ * name: element properties (i.e. properties whose names are array indices,
+ * stored as numbers) are hashed by the index itself, and string-named
+ * properties by `str_hash()` of the name. Properties with other names
+ * (e.g. the user data property) are not indexed.
+ *
+ * Properties are still linked in `struct v7_object::properties`, so the
+ * enumeration order and GC marking are not affected. Each entry also keeps the
+ * previous property in that list, so that a property can be unlinked without
+ * walking the list. The table stores
+ * property pointers rather than names, so it survives the compaction of owned
+ * strings.
+ *
+ * The table is owned by a hidden property which is always the first one in
+ * the object's property list; the object has `V7_OBJ_PROP_TABLE` attribute
+ * set.
+ */
+struct v7_prop_table {
+  uint32_t size;  /* Number of slots, always a power of 2 */
+  uint32_t count; /* Number of live entries */
+  uint32_t used;  /* Number of live entries plus deleted slots */
+
+  /* Max element index + 1, valid if `length_stale` is zero */
+  uint32_t length;
+  unsigned int length_stale : 1;
+
+  struct v7_prop_table_entry *entries;
+};
+
+V7_PRIVATE struct v7_prop_table *ptab_new(void);
+V7_PRIVATE void ptab_free(struct v7_prop_table *t);
+
+/*
+ * Adds a property to the table. For element properties, `hash` is the index
+ * itself, for string-named ones it's `str_hash()` of the name. `prev` is the
+ * property which precedes `p` in the object's properties list.
+ */
+V7_PRIVATE void ptab_add(struct v7_prop_table *t, uint32_t hash,
+                         struct v7_property *p, struct v7_property *prev);
+
+/*
+ * Removes the given property from the table, and returns the property which
+ * preceded it in the list; returns `NULL` if it's not there.
+ */
+V7_PRIVATE struct v7_property *ptab_del(struct v7_prop_table *t,
+                                        uint32_t hash, struct v7_property *p);
+
+/* Updates the previous property of `p`; does nothing if `p` is not there */
+V7_PRIVATE void ptab_set_prev(struct v7_prop_table *t, uint32_t hash,
+                              struct v7_property *p, struct v7_property *prev);
+
+/* Returns element property with the given index, or `NULL` */
+V7_PRIVATE struct v7_property *ptab_find_element(struct v7 *v7,
+                                                 struct v7_prop_table *t,
+                                                 unsigned long idx);
+
+/*
+ * Returns string-named property with the given name, or `NULL`. `hash` should
+ * be `str_hash(name, len)`. `str` is the string value of the name if there's
+ * one, or `V7_UNDEFINED`: if it's interned, it's compared by identity.
+ */
+V7_PRIVATE struct v7_property *ptab_find_str(struct v7 *v7,
+                                             struct v7_prop_table *t,
+                                             uint32_t hash, const char *name,
+                                             size_t len, val_t str);
+
+/* Returns max element index + 1 */
+V7_PRIVATE unsigned long ptab_length(struct v7_prop_table *t);
+
+#if defined(__cplusplus)
+}
+#endif /* __cplusplus */
+
+#endif /* CS_V7_SRC_PROP_TABLE_H_ */
@@ -13,16 +13,183 @@
 #include "v7/src/slre.h"
 
 #if V7_ENABLE__RegExp
+
+static uint32_t regexp_cache_hash(const char *re, size_t re_len,
+                                  const char *flags, size_t flags_len) {
+  return str_hash(re, re_len) ^ (str_hash(flags, flags_len) * 31);
+}
+
+/*
+ * Returns a new reference to the compiled regexp from the cache, or NULL if
+ * it's not there.
+ */
+static struct slre_prog *regexp_cache_get(struct v7 *v7, uint32_t hash,
+                                          const char *re, size_t re_len,
+                                          const char *flags,
+                                          size_t flags_len) {
+  size_t i;
+
+  if (v7->regexp_cache == NULL) return NULL;
+
+  for (i = 0; i < v7->regexp_cache_size; i++) {
+    struct v7_regexp_cache_entry *e = &v7->regexp_cache[i];
+    if (e->key != NULL && e->hash == hash && e->src_len == re_len &&
+        e->flags_len == flags_len && memcmp(e->key, re, re_len) == 0 &&
+        memcmp(e->key + re_len + 1, flags, flags_len) == 0) {
+      e->last_used = ++v7->regexp_cache_clock;
+      return slre_retain(e->prog);
+    }
+  }
+  return NULL;
+}
+
+/* Adds the compiled regexp to the cache, replacing the least recently used */
+static void regexp_cache_put(struct v7 *v7, uint32_t hash, const char *re,
+                             size_t re_len, const char *flags,
+                             size_t flags_len, struct slre_prog *p) {
+  struct v7_regexp_cache_entry *e;
+  size_t i;
+  char *key;
+
+  if (v7->regexp_cache_size == 0 || re_len > v7->regexp_cache_max_len) return;
+
+  if (v7->regexp_cache == NULL) {
+    v7->regexp_cache = (struct v7_regexp_cache_entry *) calloc(
+        v7->regexp_cache_size, sizeof(*v7->regexp_cache));
+    if (v7->regexp_cache == NULL) return;
+  }
+  if ((key = (char *) malloc(re_len + flags_len + 2)) == NULL) return;
+
+  e = &v7->regexp_cache[0];
+  for (i = 0; i < v7->regexp_cache_size && e->key != NULL; i++) {
+    struct v7_regexp_cache_entry *cur = &v7->regexp_cache[i];
+    if (cur->key == NULL || cur->last_used < e->last_used) e = cur;
+  }
+  if (e->key != NULL) {
+    free(e->key);
+    slre_free(e->prog);
+  }
+
+  memcpy(key, re, re_len);
+  key[re_len] = '\0';
+  memcpy(key + re_len + 1, flags, flags_len);
+  key[re_len + 1 + flags_len] = '\0';
+
+  e->key = key;
+  e->src_len = re_len;
+  e->flags_len = flags_len;
+  e->hash = hash;
+  e->last_used = ++v7->regexp_cache_clock;
+  e->prog = slre_retain(p);
+}
+
+V7_PRIVATE void regexp_cache_free(struct v7 *v7) {
+  size_t i;
+
+  if (v7->regexp_cache == NULL) return;
+  for (i = 0; i < v7->regexp_cache_size; i++) {
+    if (v7->regexp_cache[i].key != NULL) {
+      free(v7->regexp_cache[i].key);
+      slre_free(v7->regexp_cache[i].prog);
+    }
+  }
+  free(v7->regexp_cache);
+  v7->regexp_cache = NULL;
+}
+
+/* `SLRE_FLAG_I` and `SLRE_FLAG_M` of the flags string */
+static int regexp_matcher_flags(const char *flags) {
+  int res = 0;
+  for (; *flags != '\0'; flags++) {
+    if (*flags == 'i') res |= SLRE_FLAG_I;
+    if (*flags == 'm') res |= SLRE_FLAG_M;
+  }
+  return res;
+}
+
+void v7_register_regexp_matcher(struct v7 *v7, const char *regex,
+                                const char *flags, v7_regexp_matcher_t fn) {
+  struct v7_regexp_matcher *m;
+  size_t len = strlen(regex);
+
+  m = (struct v7_regexp_matcher *) realloc(
+      v7->regexp_matchers, (v7->regexp_matchers_cnt + 1) * sizeof(*m));
+  if (m == NULL) return;
+  v7->regexp_matchers = m;
+  m += v7->regexp_matchers_cnt;
+  if ((m->src = (char *) malloc(len + 1)) == NULL) return;
+  memcpy(m->src, regex, len + 1);
+  m->src_len = len;
+  m->flags = regexp_matcher_flags(flags == NULL ? "" : flags);
+  m->fn = fn;
+  v7->regexp_matchers_cnt++;
+}
+
+V7_PRIVATE void regexp_matchers_free(struct v7 *v7) {
+  size_t i;
+  for (i = 0; i < v7->regexp_matchers_cnt; i++) {
+    free(v7->regexp_matchers[i].src);
+  }
+  free(v7->regexp_matchers);
+  v7->regexp_matchers = NULL;
+  v7->regexp_matchers_cnt = 0;
+}
+
+/*
+ * Returns the registered native matcher of the regexp, or NULL if there is
+ * none. Programs may be loaded in place, so the matcher is kept in the RegExp
+ * object rather than in the program.
+ */
+static v7_regexp_matcher_t regexp_find_matcher(struct v7 *v7,
+                                               struct slre_prog *p,
+                                               const char *re,
+                                               size_t re_len) {
+  int flags = slre_get_flags(p) & (SLRE_FLAG_I | SLRE_FLAG_M);
+  size_t i;
+
+  for (i = 0; i < v7->regexp_matchers_cnt; i++) {
+    struct v7_regexp_matcher *m = &v7->regexp_matchers[i];
+    if (m->src_len == re_len && m->flags == flags &&
+        memcmp(m->src, re, re_len) == 0) {
+      return m->fn;
+    }
+  }
+  return NULL;
+}
+
 enum v7_err v7_mk_regexp(struct v7 *v7, const char *re, size_t re_len,
                          const char *flags, size_t flags_len, v7_val_t *res) {
+  return mk_regexp_from_image(v7, re, re_len, flags, flags_len, NULL, 0, res);
+}
+
+V7_PRIVATE enum v7_err mk_regexp_from_image(struct v7 *v7, const char *re,
+                                            size_t re_len, const char *flags,
+                                            size_t flags_len, const char *image,
+                                            size_t image_len, v7_val_t *res) {
   enum v7_err rcode = V7_OK;
   struct slre_prog *p = NULL;
   struct v7_regexp *rp;
+  uint32_t hash;
 
   if (re_len == ~((size_t) 0)) re_len = strlen(re);
+  if (flags == NULL) {
+    flags = "";
+    flags_len = 0;
+  }
 
-  if (slre_compile(re, re_len, flags, flags_len, &p, 1) != SLRE_OK ||
-      p == NULL) {
+  hash = regexp_cache_hash(re, re_len, flags, flags_len);
+  if ((p = regexp_cache_get(v7, hash, re, re_len, flags, flags_len)) != NULL) {
+    /* Compiled already */
+  } else if (image != NULL && slre_load(image, image_len, &p) == SLRE_OK) {
+    regexp_cache_put(v7, hash, re, re_len, flags, flags_len, p);
+  } else if (slre_compile(re, re_len, flags, flags_len, &p, 1) == SLRE_OK &&
+             p != NULL) {
+    regexp_cache_put(v7, hash, re, re_len, flags, flags_len, p);
+  } else {
+    p = NULL;
+  }
+
+  if (p == NULL) {
     rcode = v7_throwf(v7, TYPE_ERROR, "Invalid regex");
     goto clean;
   } else {
@@ -31,7 +198,10 @@ enum v7_err v7_mk_regexp(struct v7 *v7, const char *re, size_t re_len,
     rp->regexp_string = v7_mk_string(v7, re, re_len, 1);
     v7_own(v7, &rp->regexp_string);
     rp->compiled_regexp = p;
+    rp->native = regexp_find_matcher(v7, p, re, re_len);
     rp->lastIndex = 0;
+    rp->last_str = V7_UNDEFINED;
+    rp->last_char_index = -1;
 
     v7_def(v7, *res, "", 0, _V7_DESC_HIDDEN(1),
            pointer_to_value(rp) | V7_TAG_REGEXP);
@@ -87,4 +257,12 @@ int v7_is_regexp(struct v7 *v7, val_t v) {
   return 0;
 }
 
+void v7_register_regexp_matcher(struct v7 *v7, const char *regex,
+                                const char *flags, v7_regexp_matcher_t fn) {
+  (void) v7;
+  (void) regex;
+  (void) flags;
+  (void) fn;
+}
+
 #endif /* V7_ENABLE__RegExp */
@@ -18,6 +18,14 @@
  */
 #define _V7_REGEXP_MAX_FLAGS_LEN 3
 
+/* Defaults for `struct v7_create_opts::regexp_cache_*` */
+#ifndef V7_REGEXP_CACHE_SIZE
+#define V7_REGEXP_CACHE_SIZE 16
+#endif
+#ifndef V7_REGEXP_CACHE_MAX_LEN
+#define V7_REGEXP_CACHE_MAX_LEN 256
+#endif
+
 struct v7_regexp;
 
 V7_PRIVATE struct v7_regexp *v7_get_regexp_struct(struct v7 *, v7_val_t);
@@ -30,6 +38,22 @@ V7_PRIVATE struct v7_regexp *v7_get_regexp_struct(struct v7 *, v7_val_t);
  */
 V7_PRIVATE size_t
 get_regexp_flags_str(struct v7 *v7, struct v7_regexp *rp, char *buf);
+
+/*
+ * Like `v7_mk_regexp()`, but if the regexp is not cached, loads the program
+ * from `image` made by `slre_dump()` instead of compiling `re` (which is still
+ * needed for the `source` property). `image` can be NULL.
+ */
+V7_PRIVATE enum v7_err mk_regexp_from_image(struct v7 *v7, const char *re,
+                                            size_t re_len, const char *flags,
+                                            size_t flags_len, const char *image,
+                                            size_t image_len, v7_val_t *res);
+
+/* Frees the compiled regexp cache */
+V7_PRIVATE void regexp_cache_free(struct v7 *v7);
+
+/* Frees matchers registered by `v7_register_regexp_matcher()` */
+V7_PRIVATE void regexp_matchers_free(struct v7 *v7);
 #endif /* V7_ENABLE__RegExp */
 
 #endif /* CS_V7_SRC_REGEXP_H_ */
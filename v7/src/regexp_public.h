@@ -30,6 +30,28 @@ enum v7_err v7_mk_regexp(struct v7 *v7, const char *regex, size_t regex_len,
 /* Returns true if given value is a JavaScript RegExp object*/
 int v7_is_regexp(struct v7 *v7, v7_val_t v);
 
+/*
+ * Native regex matcher, generated ahead of time by the standalone `slre` tool:
+ *
+ *     slre -p '(\d+)-(\d+)' -o g -c match_range >match_range.c
+ *
+ * Matches from `p` until `end`, `bol` is the start of the text; `caps` holds
+ * start and end pointers of the captures. Returns 1 on match, 0 if there's no
+ * match, or -1 if out of memory (the interpreter is used then).
+ */
+typedef int (*v7_regexp_matcher_t)(const char *p, const char *end,
+                                   const char *bol, const char **caps);
+
+/*
+ * Registers a native matcher for the NUL-terminated regex `regex` with
+ * `flags`. RegExp objects made afterwards with the same source and the same
+ * `i` and `m` flags run `fn` instead of the interpreter. `fn` must be
+ * generated from exactly that regex and flags by the `slre` tool of the same
+ * version.
+ */
+void v7_register_regexp_matcher(struct v7 *v7, const char *regex,
+                                const char *flags, v7_regexp_matcher_t fn);
+
 #if defined(__cplusplus)
 }
 #endif /* __cplusplus */
@@ -17,7 +17,7 @@
 #if !defined(V7_DISABLE_FILENAMES) && !defined(V7_DISABLE_LINE_NUMBERS)
 struct shdata {
   /* Reference count */
-  uint8_t refcnt;
+  uint32_t refcnt;
 
   /*
    * Note: we'd use `unsigned char payload[];` here, but we can't, since this
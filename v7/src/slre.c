@@ -19,6 +19,7 @@
 #include "v7/src/v7_features.h"
 
 #include <setjmp.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -34,8 +35,16 @@
 #define SLRE_MAX_RANGES 32
 #define SLRE_MAX_SETS 16
 #define SLRE_MAX_REP 0xFFFF
+#define SLRE_MAX_PREFIX 16
+/*
+ * Max size, in instructions, of a counted repetition expanded into copies of
+ * its body; larger ones are left to the backtracking matcher, see
+ * `re_rep_unroll()`
+ */
+#define SLRE_MAX_UNROLLED 256
 
 #define SLRE_MALLOC malloc
+#define SLRE_REALLOC realloc
 #define SLRE_FREE free
 #define SLRE_THROW(e, err_code) longjmp((e)->jmp_buf, (err_code))
 
@@ -119,30 +128,177 @@ struct slre_class {
   struct slre_range spans[SLRE_MAX_RANGES];
 };
 
+/*
+ * Instruction of the program. Like the rest of the program, it only has
+ * bytes, and multi-byte operands are little-endian (see `re_get()`), so that
+ * an image of the program can run wherever it is, see `struct slre_prog`.
+ */
 struct slre_instruction {
   unsigned char opcode;
+  unsigned char n; /* `I_LBRA`, `I_RBRA`, `I_REF`: capture */
+  /*
+   * Index of the target instruction; `I_CH`: character; `I_SET`, `I_SET_N`:
+   * offset of the charset in the program; `I_REP_INI`: min count
+   */
+  unsigned char x[4];
+  /*
+   * `I_SPLIT`, `I_LA`, `I_LA_N`: index of the second target instruction;
+   * `I_REP_INI`: number of optional repetitions; `I_REP`: counter
+   */
+  unsigned char y[4];
+};
+
+/* Backtrack stack entry, see `re_match()` */
+struct slre_bt {
+  unsigned char type; /* One of `enum slre_bt_type` */
+  /* Instruction to continue from (not used by `BT_UNDO`) */
+  const struct slre_instruction *pc;
+  /* Position to continue from, or old capture value for `BT_UNDO` */
+  const char *p;
   union {
-    unsigned char n;
-    Rune c;                /* character */
-    struct slre_class *cp; /* class pointer */
-    struct {
-      struct slre_instruction *x;
-      union {
-        struct {
-          unsigned short min;
-          unsigned short max;
-        } rp;
-        struct slre_instruction *y;
-      } y;
-    } xy;
-  } par;
+    const char **cap; /* `BT_UNDO`: capture slot to restore */
+    size_t prev_la;   /* `BT_LA*`: index of the enclosing lookahead entry */
+  } u;
+};
+
+enum slre_bt_type {
+  BT_ALT,  /* Alternative to try on failure */
+  BT_UNDO, /* Capture to restore on failure */
+  BT_LA,   /* Positive lookahead being matched */
+  BT_LA_N  /* Negative lookahead being matched */
 };
 
+/*
+ * Compiled program: this header, `ninst` instructions, and the charsets,
+ * each of which is the number of ranges followed by the ranges (start and
+ * end, 2 bytes each). The program is never changed after compilation, and
+ * has no pointers, so that `slre_dump()` just copies it and `slre_load()`
+ * runs the image in place, e.g. from ROM. Matches keep their scratch data in
+ * `struct slre_state`.
+ */
 struct slre_prog {
-  struct slre_instruction *start, *end;
-  unsigned int num_captures;
-  int flags;
-  struct slre_class charset[SLRE_MAX_SETS];
+  unsigned char version; /* `RE_IMAGE_VERSION` */
+  /* Non-zero if made by `slre_compile()`, see `struct re_heap_prog` */
+  unsigned char heap;
+  unsigned char flags;
+  unsigned char num_captures;
+
+  /*
+   * Non-zero if the program can be run by the Pike VM (no backreferences,
+   * lookaheads or counted repetitions), and by the lazy DFA (additionally, no
+   * assertions except for `^`); see `re_analyze()`.
+   */
+  unsigned char pike;
+  unsigned char dfa;
+
+  /*
+   * Where a match can start, so that the search can skip the other positions
+   * (see `re_analyze_accel()` and `re_skip()`): one of `enum slre_accel`.
+   */
+  unsigned char accel;
+  unsigned char prefix_len;
+  char prefix[SLRE_MAX_PREFIX]; /* `RE_ACCEL_PREFIX`: literal prefix */
+  unsigned char first[32];      /* `RE_ACCEL_FIRST`: bitmap of first bytes */
+
+  unsigned char num_reps[4]; /* Number of `I_REP` counters */
+  unsigned char ninst[4];    /* Number of instructions */
+  unsigned char size[4];     /* Size of the whole program, in bytes */
+};
+
+/* Program made by `slre_compile()`, owned by its references */
+struct re_heap_prog {
+  unsigned int refcnt; /* See `slre_retain()` */
+  struct slre_prog prog;
+};
+
+#define RE_IMAGE_VERSION 2
+
+/* First instruction of the program */
+#define RE_START(prog) ((const struct slre_instruction *) ((prog) + 1))
+
+/* Little-endian numbers of the program */
+#define RE_GET16(p) ((unsigned int) (p)[0] | ((unsigned int) (p)[1] << 8))
+#define RE_GET32(p) (RE_GET16(p) | ((unsigned long) RE_GET16((p) + 2) << 16))
+
+/* Operands of the instruction, see `struct slre_instruction` */
+#define RE_X(pc) RE_GET32((pc)->x)
+#define RE_Y(pc) RE_GET32((pc)->y)
+
+/* Charset of `I_SET` and `I_SET_N`: number of ranges, then the ranges */
+#define RE_SET(prog, pc) ((const unsigned char *) (prog) + RE_X(pc))
+#define RE_SET_S(set, i) RE_GET16((set) + 1 + 4 * (i))
+#define RE_SET_E(set, i) RE_GET16((set) + 3 + 4 * (i))
+
+static void re_put(unsigned char *p, unsigned long v, int n) {
+  for (; n > 0; n--, v >>= 8) *p++ = (unsigned char) v;
+}
+
+enum slre_accel {
+  RE_ACCEL_NONE,
+  RE_ACCEL_ANCHORED, /* Starts with `^`, without `m` flag */
+  RE_ACCEL_PREFIX,   /* Starts with the literal `prefix` */
+  RE_ACCEL_FIRST     /* First byte is one of `first` */
+};
+
+/*
+ * Programs start with the loop which restarts the match at every position of
+ * the text: `SPLIT body, restart; restart: ANYNL; JUMP 0; body: LBRA 0 ...`
+ */
+#define RE_PC_RESTART 1
+#define RE_PC_BODY 3
+
+/* Pike VM thread list */
+struct slre_vm_list {
+  unsigned int n;
+  unsigned int *pcs;     /* Instruction indices, in priority order */
+  struct slre_cap *caps; /* `num_captures` entries for each thread */
+};
+
+#define SLRE_DFA_MAX_STATES 128
+
+/* Lazy DFA state: set of NFA threads, as sorted instruction indices */
+struct slre_dfa_state {
+  unsigned int *pcs;
+  unsigned int n;
+  int match; /* Non-zero if one of the threads is `I_END` */
+  /* 1-based index of the next state for ASCII characters; 0 if not known */
+  unsigned short next[128];
+};
+
+/* Scratch data of the Pike VM and the lazy DFA */
+struct slre_vm {
+  /* Generation at which the instruction was last added to a thread list */
+  unsigned int *mark;
+  unsigned int gen;
+
+  struct slre_vm_list lists[2];
+
+  /* `SLRE_DFA_MAX_STATES` entries, allocated by the first DFA run */
+  struct slre_dfa_state *states;
+  unsigned int states_cnt;
+  unsigned int flushes;
+};
+
+/* Counters of `I_REP` */
+struct slre_rep {
+  unsigned short min;
+  unsigned short max;
+};
+
+#define RE_BT_INLINE 32
+#define RE_REPS_INLINE 8
+
+/*
+ * Scratch data of a match, see `re_state_init()`. Small backtrack stacks and
+ * counter arrays don't need the heap.
+ */
+struct slre_state {
+  struct slre_bt *bt; /* Backtrack stack, `bt_buf` until it grows */
+  size_t bt_size;
+  struct slre_rep *reps; /* `I_REP` counters, `reps_buf` if they fit */
+  struct slre_vm *vm;    /* Allocated by the first Pike VM or DFA run */
+  struct slre_bt bt_buf[RE_BT_INLINE];
+  struct slre_rep reps_buf[RE_REPS_INLINE];
 };
 
 struct slre_env {
@@ -152,11 +308,18 @@ struct slre_env {
   Rune curr_rune;
 
   struct slre_prog *prog;
+  struct slre_instruction *end; /* Next instruction to emit */
   struct slre_node *pstart, *pend;
 
   struct slre_node *caps[SLRE_MAX_CAPS];
   unsigned int num_captures;
+  unsigned int num_reps;
+  int flags;
+  int has_refs; /* Non-zero if there are backreferences */
+
+  struct slre_class sets[SLRE_MAX_SETS];
   unsigned int sets_num;
+  unsigned long set_offs[SLRE_MAX_SETS]; /* Offsets in the program */
 
   int lookahead;
   struct slre_class *curr_set;
@@ -169,13 +332,6 @@ struct slre_env {
 #endif
 };
 
-struct slre_thread {
-  struct slre_thread *prev;
-  struct slre_instruction *pc;
-  const char *start;
-  struct slre_loot loot;
-};
-
 enum slre_opcode {
   I_END = 10, /* Terminate: match found */
   I_ANY,
@@ -273,10 +429,10 @@ static int re_nextc_env(struct slre_env *e) {
 }
 
 static void re_nchset(struct slre_env *e) {
-  if (e->sets_num >= nelem(e->prog->charset)) {
+  if (e->sets_num >= nelem(e->sets)) {
     SLRE_THROW(e, SLRE_TOO_MANY_CHARSETS);
   }
-  e->curr_set = e->prog->charset + e->sets_num++;
+  e->curr_set = e->sets + e->sets_num++;
   e->curr_set->end = e->curr_set->spans;
 }
 
@@ -645,6 +801,7 @@ static struct slre_node *re_parse_la(struct slre_env *e) {
       }
       nd->par.xy.y.n = e->curr_rune;
       nd->par.xy.x = e->caps[e->curr_rune];
+      e->has_refs = 1;
       RE_NEXT(e);
       break;
     case '.':
@@ -745,76 +902,96 @@ static struct slre_node *re_parser(struct slre_env *e) {
   return alt;
 }
 
-static unsigned int re_nodelen(struct slre_node *nd) {
-  unsigned int n = 0;
+/*
+ * Returns non-zero if the repetition `nd` of the body of `len` instructions
+ * should be expanded: `x{n,m}` into n copies of `x` followed by m-n optional
+ * ones, and `x{n,}` into n-1 copies followed by `x+`. Expanded repetitions
+ * don't need counters, so the Pike VM and the DFA can run them. Large ones
+ * are compiled to `I_REP`, like all the repetitions of the programs with
+ * backreferences, which need backtracking anyway.
+ */
+static int re_rep_unroll(struct slre_env *e, struct slre_node *nd,
+                         unsigned int len) {
+  unsigned long min = nd->par.xy.y.rp.min, max = nd->par.xy.y.rp.max;
+  if (e->has_refs) return 0;
+  if (max >= SLRE_MAX_REP) {
+    return min * len + 1 <= SLRE_MAX_UNROLLED;
+  }
+  return min * len + (max - min) * (len + 1) <= SLRE_MAX_UNROLLED;
+}
+
+static unsigned int re_nodelen(struct slre_env *e, struct slre_node *nd) {
+  unsigned int n = 0, len, min, max;
   if (!nd) return 0;
   switch (nd->type) {
     case P_ALT:
       n = 2;
     case P_CAT:
-      return re_nodelen(nd->par.xy.x) + re_nodelen(nd->par.xy.y.y) + n;
+      return re_nodelen(e, nd->par.xy.x) + re_nodelen(e, nd->par.xy.y.y) + n;
     case P_BRA:
     case P_LA:
     case P_LA_N:
-      return re_nodelen(nd->par.xy.x) + 2;
+      return re_nodelen(e, nd->par.xy.x) + 2;
     case P_REP:
-      n = nd->par.xy.y.rp.max - nd->par.xy.y.rp.min;
-      switch (nd->par.xy.y.rp.min) {
-        case 0:
-          if (!n) return 0;
-          if (nd->par.xy.y.rp.max >= SLRE_MAX_REP)
-            return re_nodelen(nd->par.xy.x) + 2;
-        case 1:
-          if (!n) return re_nodelen(nd->par.xy.x);
-          if (nd->par.xy.y.rp.max >= SLRE_MAX_REP)
-            return re_nodelen(nd->par.xy.x) + 1;
-        default:
-          n = 4;
-          if (nd->par.xy.y.rp.max >= SLRE_MAX_REP) n++;
-          return re_nodelen(nd->par.xy.x) + n;
+      len = re_nodelen(e, nd->par.xy.x);
+      min = nd->par.xy.y.rp.min;
+      max = nd->par.xy.y.rp.max;
+      if (max >= SLRE_MAX_REP) {
+        if (min == 0) return len + 2;
+        if (min == 1 || re_rep_unroll(e, nd, len)) return min * len + 1;
+        return len + 5;
       }
+      if (min == max && min <= 1) return min * len;
+      if (re_rep_unroll(e, nd, len)) return min * len + (max - min) * (len + 1);
+      return len + 4;
     default:
       return 1;
   }
 }
 
-static struct slre_instruction *re_newinst(struct slre_prog *prog, int opcode) {
-  memset(prog->end, 0, sizeof(struct slre_instruction));
-  prog->end->opcode = opcode;
-  return prog->end++;
+static struct slre_instruction *re_newinst(struct slre_env *e, int opcode) {
+  memset(e->end, 0, sizeof(struct slre_instruction));
+  e->end->opcode = opcode;
+  return e->end++;
+}
+
+/* Points the operand of the instruction at the instruction `to` */
+static void re_link(struct slre_env *e, unsigned char *operand,
+                    const struct slre_instruction *to) {
+  re_put(operand, to - RE_START(e->prog), 4);
 }
 
 static void re_compile(struct slre_env *e, struct slre_node *nd) {
   struct slre_instruction *inst, *split, *jump, *rep;
-  unsigned int n;
+  unsigned int n, i, len, min, max;
 
   if (!nd) return;
 
   switch (nd->type) {
     case P_ALT:
-      split = re_newinst(e->prog, I_SPLIT);
+      split = re_newinst(e, I_SPLIT);
       re_compile(e, nd->par.xy.x);
-      jump = re_newinst(e->prog, I_JUMP);
+      jump = re_newinst(e, I_JUMP);
       re_compile(e, nd->par.xy.y.y);
-      split->par.xy.x = split + 1;
-      split->par.xy.y.y = jump + 1;
-      jump->par.xy.x = e->prog->end;
+      re_link(e, split->x, split + 1);
+      re_link(e, split->y, jump + 1);
+      re_link(e, jump->x, e->end);
       break;
 
     case P_ANY:
-      re_newinst(e->prog, I_ANY);
+      re_newinst(e, I_ANY);
       break;
 
     case P_BOL:
-      re_newinst(e->prog, I_BOL);
+      re_newinst(e, I_BOL);
       break;
 
     case P_BRA:
-      inst = re_newinst(e->prog, I_LBRA);
-      inst->par.n = nd->par.xy.y.n;
+      inst = re_newinst(e, I_LBRA);
+      inst->n = nd->par.xy.y.n;
       re_compile(e, nd->par.xy.x);
-      inst = re_newinst(e->prog, I_RBRA);
-      inst->par.n = nd->par.xy.y.n;
+      inst = re_newinst(e, I_RBRA);
+      inst->n = nd->par.xy.y.n;
       break;
 
     case P_CAT:
@@ -823,136 +1000,348 @@ static void re_compile(struct slre_env *e, struct slre_node *nd) {
       break;
 
     case P_CH:
-      inst = re_newinst(e->prog, I_CH);
-      inst->par.c = nd->par.c;
+      inst = re_newinst(e, I_CH);
+      re_put(inst->x, nd->par.c, 4);
       break;
 
     case P_EOL:
-      re_newinst(e->prog, I_EOL);
+      re_newinst(e, I_EOL);
       break;
 
     case P_EOS:
-      re_newinst(e->prog, I_EOS);
+      re_newinst(e, I_EOS);
       break;
 
     case P_LA:
-      split = re_newinst(e->prog, I_LA);
+      split = re_newinst(e, I_LA);
       re_compile(e, nd->par.xy.x);
-      re_newinst(e->prog, I_END);
-      split->par.xy.x = split + 1;
-      split->par.xy.y.y = e->prog->end;
+      re_newinst(e, I_END);
+      re_link(e, split->x, split + 1);
+      re_link(e, split->y, e->end);
       break;
     case P_LA_N:
-      split = re_newinst(e->prog, I_LA_N);
+      split = re_newinst(e, I_LA_N);
       re_compile(e, nd->par.xy.x);
-      re_newinst(e->prog, I_END);
-      split->par.xy.x = split + 1;
-      split->par.xy.y.y = e->prog->end;
+      re_newinst(e, I_END);
+      re_link(e, split->x, split + 1);
+      re_link(e, split->y, e->end);
       break;
 
     case P_REF:
-      inst = re_newinst(e->prog, I_REF);
-      inst->par.n = nd->par.xy.y.n;
+      inst = re_newinst(e, I_REF);
+      inst->n = nd->par.xy.y.n;
       break;
 
     case P_REP:
-      n = nd->par.xy.y.rp.max - nd->par.xy.y.rp.min;
-      switch (nd->par.xy.y.rp.min) {
-        case 0:
-          if (!n) break;
-          if (nd->par.xy.y.rp.max >= SLRE_MAX_REP) {
-            split = re_newinst(e->prog, I_SPLIT);
-            re_compile(e, nd->par.xy.x);
-            jump = re_newinst(e->prog, I_JUMP);
-            jump->par.xy.x = split;
-            split->par.xy.x = split + 1;
-            split->par.xy.y.y = e->prog->end;
-            if (nd->par.xy.y.rp.ng) {
-              split->par.xy.y.y = split + 1;
-              split->par.xy.x = e->prog->end;
-            }
-            break;
-          }
-        case 1:
-          if (!n) {
-            re_compile(e, nd->par.xy.x);
-            break;
-          }
-          if (nd->par.xy.y.rp.max >= SLRE_MAX_REP) {
-            inst = e->prog->end;
-            re_compile(e, nd->par.xy.x);
-            split = re_newinst(e->prog, I_SPLIT);
-            split->par.xy.x = inst;
-            split->par.xy.y.y = e->prog->end;
-            if (nd->par.xy.y.rp.ng) {
-              split->par.xy.y.y = inst;
-              split->par.xy.x = e->prog->end;
-            }
-            break;
-          }
-        default:
-          inst = re_newinst(e->prog, I_REP_INI);
-          inst->par.xy.y.rp.min = nd->par.xy.y.rp.min;
-          inst->par.xy.y.rp.max = n;
-          rep = re_newinst(e->prog, I_REP);
-          split = re_newinst(e->prog, I_SPLIT);
+      min = nd->par.xy.y.rp.min;
+      max = nd->par.xy.y.rp.max;
+      n = max - min;
+      if (max >= SLRE_MAX_REP && min == 0) {
+        split = re_newinst(e, I_SPLIT);
+        re_compile(e, nd->par.xy.x);
+        jump = re_newinst(e, I_JUMP);
+        re_link(e, jump->x, split);
+        re_link(e, split->x, split + 1);
+        re_link(e, split->y, e->end);
+        if (nd->par.xy.y.rp.ng) {
+          re_link(e, split->y, split + 1);
+          re_link(e, split->x, e->end);
+        }
+        break;
+      }
+      if (max < SLRE_MAX_REP && n == 0 && min <= 1) {
+        if (min) re_compile(e, nd->par.xy.x);
+        break;
+      }
+      len = re_nodelen(e, nd->par.xy.x);
+      if (max >= SLRE_MAX_REP && (min == 1 || re_rep_unroll(e, nd, len))) {
+        /* `x{n,}` is n-1 copies of `x` and `x+` */
+        for (i = 1; i < min; i++) re_compile(e, nd->par.xy.x);
+        inst = e->end;
+        re_compile(e, nd->par.xy.x);
+        split = re_newinst(e, I_SPLIT);
+        re_link(e, split->x, inst);
+        re_link(e, split->y, e->end);
+        if (nd->par.xy.y.rp.ng) {
+          re_link(e, split->y, inst);
+          re_link(e, split->x, e->end);
+        }
+        break;
+      }
+      if (max < SLRE_MAX_REP && re_rep_unroll(e, nd, len)) {
+        /*
+         * `x{n,m}` is n copies of `x` and m-n optional ones, each of which
+         * can skip the rest: `SPLIT 1f, 3f; 1: x; SPLIT 2f, 3f; 2: x; 3:`
+         */
+        for (i = 0; i < min; i++) re_compile(e, nd->par.xy.x);
+        inst = e->end;
+        for (i = 0; i < n; i++) {
+          re_newinst(e, I_SPLIT);
           re_compile(e, nd->par.xy.x);
-          jump = re_newinst(e->prog, I_JUMP);
-          jump->par.xy.x = rep;
-          rep->par.xy.x = e->prog->end;
-          split->par.xy.x = split + 1;
-          split->par.xy.y.y = e->prog->end;
+        }
+        for (split = inst; split < e->end; split += len + 1) {
+          re_link(e, split->x, split + 1);
+          re_link(e, split->y, e->end);
           if (nd->par.xy.y.rp.ng) {
-            split->par.xy.y.y = split + 1;
-            split->par.xy.x = e->prog->end;
-          }
-          if (nd->par.xy.y.rp.max >= SLRE_MAX_REP) {
-            inst = split + 1;
-            split = re_newinst(e->prog, I_SPLIT);
-            split->par.xy.x = inst;
-            split->par.xy.y.y = e->prog->end;
-            if (nd->par.xy.y.rp.ng) {
-              split->par.xy.y.y = inst;
-              split->par.xy.x = e->prog->end;
-            }
-            break;
+            re_link(e, split->y, split + 1);
+            re_link(e, split->x, e->end);
           }
-          break;
+        }
+        break;
+      }
+      inst = re_newinst(e, I_REP_INI);
+      re_put(inst->x, min, 4);
+      re_put(inst->y, n, 4);
+      rep = re_newinst(e, I_REP);
+      re_put(rep->y, e->num_reps++, 4);
+      split = re_newinst(e, I_SPLIT);
+      re_compile(e, nd->par.xy.x);
+      jump = re_newinst(e, I_JUMP);
+      re_link(e, jump->x, rep);
+      re_link(e, rep->x, e->end);
+      re_link(e, split->x, split + 1);
+      re_link(e, split->y, e->end);
+      if (nd->par.xy.y.rp.ng) {
+        re_link(e, split->y, split + 1);
+        re_link(e, split->x, e->end);
+      }
+      if (max >= SLRE_MAX_REP) {
+        inst = split + 1;
+        split = re_newinst(e, I_SPLIT);
+        re_link(e, split->x, inst);
+        re_link(e, split->y, e->end);
+        if (nd->par.xy.y.rp.ng) {
+          re_link(e, split->y, inst);
+          re_link(e, split->x, e->end);
+        }
       }
       break;
 
     case P_SET:
-      inst = re_newinst(e->prog, I_SET);
-      inst->par.cp = nd->par.cp;
+      inst = re_newinst(e, I_SET);
+      re_put(inst->x, e->set_offs[nd->par.cp - e->sets], 4);
       break;
     case P_SET_N:
-      inst = re_newinst(e->prog, I_SET_N);
-      inst->par.cp = nd->par.cp;
+      inst = re_newinst(e, I_SET_N);
+      re_put(inst->x, e->set_offs[nd->par.cp - e->sets], 4);
       break;
 
     case P_WORD:
-      re_newinst(e->prog, I_WORD);
+      re_newinst(e, I_WORD);
       break;
     case P_WORD_N:
-      re_newinst(e->prog, I_WORD_N);
+      re_newinst(e, I_WORD_N);
       break;
   }
 }
 
+/* Finds out which of the execution engines can run the program */
+static void re_analyze(struct slre_prog *prog) {
+  const struct slre_instruction *pc = RE_START(prog),
+                                *end = pc + RE_GET32(prog->ninst);
+
+  prog->pike = prog->dfa = 1;
+  for (; pc < end; pc++) {
+    switch (pc->opcode) {
+      case I_LA:
+      case I_LA_N:
+      case I_REF:
+      case I_REP:
+      case I_REP_INI:
+        /* Need backtracking */
+        prog->pike = prog->dfa = 0;
+        return;
+      case I_EOL:
+      case I_EOS:
+      case I_WORD:
+      case I_WORD_N:
+        /* Depend on the next character, which the DFA doesn't know */
+        prog->dfa = 0;
+        break;
+    }
+  }
+}
+
+static void re_first_add(struct slre_prog *prog, int c) {
+  prog->first[c >> 3] |= 1 << (c & 7);
+}
+
+/*
+ * Adds the possible first bytes of the character-consuming instruction to the
+ * first byte bitmap. Returns 0 if they can't be told.
+ */
+static int re_first_add_inst(struct slre_prog *prog,
+                             const struct slre_instruction *pc) {
+  int ignore_case = prog->flags & SLRE_FLAG_I;
+  const unsigned char *set;
+  char buf[UTFmax];
+  Rune c, s, e;
+  int i, j;
+
+  /*
+   * ASCII characters only match ASCII ones even ignoring case (see
+   * `re_fold_eq()`), so only the non-ASCII ones need all the lead bytes
+   */
+  switch (pc->opcode) {
+    case I_CH:
+      c = RE_X(pc);
+      if (c == 0) {
+        /* Never matches */
+        return 1;
+      } else if (c < Runeself) {
+        re_first_add(prog, c);
+        if (ignore_case) {
+          re_first_add(prog, tolower(c));
+          re_first_add(prog, toupper(c));
+        }
+        return 1;
+      }
+      if (ignore_case) {
+        for (i = 0x80; i < 0x100; i++) re_first_add(prog, i);
+        return 1;
+      }
+      runetochar(buf, &c);
+      re_first_add(prog, (unsigned char) buf[0]);
+      return 1;
+    case I_SET:
+      set = RE_SET(prog, pc);
+      for (j = 0; j < set[0]; j++) {
+        s = RE_SET_S(set, j);
+        e = RE_SET_E(set, j);
+        for (c = s > 0 ? s : 1; c <= e && c < Runeself; c++) {
+          re_first_add(prog, c);
+          if (ignore_case) {
+            re_first_add(prog, tolower(c));
+            re_first_add(prog, toupper(c));
+          }
+        }
+        if (e >= Runeself) {
+          for (i = 0x80; i < 0x100; i++) re_first_add(prog, i);
+        }
+      }
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/*
+ * Finds out where a match can start: right at the beginning if the program
+ * starts with `^`, at a literal prefix, or at one of the bytes the first
+ * character-consuming instructions accept. Patterns which can match an empty
+ * string can start anywhere.
+ */
+static void re_analyze_accel(struct slre_prog *prog) {
+  const struct slre_instruction *start = RE_START(prog), **stack;
+  const struct slre_instruction *pc = start + RE_PC_BODY;
+  size_t n = RE_GET32(prog->ninst), sp = 0;
+  unsigned char *seen;
+  int i, cnt, ok = 1;
+
+  prog->accel = RE_ACCEL_NONE;
+  prog->prefix_len = 0;
+  memset(prog->first, 0, sizeof(prog->first));
+
+  /* Literal prefix; instructions up to the first branch run sequentially */
+  for (; pc->opcode == I_LBRA || pc->opcode == I_RBRA || pc->opcode == I_CH;
+       pc++) {
+    if (pc->opcode == I_CH) {
+      char buf[UTFmax];
+      Rune c = RE_X(pc);
+      int len;
+      if ((prog->flags & SLRE_FLAG_I) || c == 0) break;
+      len = runetochar(buf, &c);
+      if (prog->prefix_len + len > SLRE_MAX_PREFIX) break;
+      memcpy(prog->prefix + prog->prefix_len, buf, len);
+      prog->prefix_len += len;
+    }
+  }
+  if (prog->prefix_len > 0) {
+    prog->accel = RE_ACCEL_PREFIX;
+    return;
+  }
+  if (pc->opcode == I_BOL && !(prog->flags & SLRE_FLAG_M)) {
+    prog->accel = RE_ACCEL_ANCHORED;
+    return;
+  }
+
+  /* First bytes of all the instructions reachable without consuming input */
+  seen = (unsigned char *) calloc(n, 1);
+  stack = (const struct slre_instruction **) SLRE_MALLOC(n * 3 *
+                                                         sizeof(*stack));
+  if (seen == NULL || stack == NULL) {
+    ok = 0;
+  } else {
+    stack[sp++] = start + RE_PC_BODY;
+  }
+  while (ok && sp > 0) {
+    pc = stack[--sp];
+    if (seen[pc - start]) continue;
+    seen[pc - start] = 1;
+    switch (pc->opcode) {
+      case I_JUMP:
+        stack[sp++] = start + RE_X(pc);
+        break;
+      case I_SPLIT:
+        stack[sp++] = start + RE_X(pc);
+        stack[sp++] = start + RE_Y(pc);
+        break;
+      case I_REP:
+        /* Can enter the body or leave the loop */
+        stack[sp++] = pc + 1;
+        stack[sp++] = pc + 2;
+        stack[sp++] = start + RE_X(pc);
+        break;
+      case I_LBRA:
+      case I_RBRA:
+      case I_REP_INI:
+      case I_BOL:
+      case I_EOL:
+      case I_EOS:
+      case I_WORD:
+      case I_WORD_N:
+        stack[sp++] = pc + 1;
+        break;
+      default:
+        /* `I_END` means an empty match, `I_ANY` and the like accept anything */
+        ok = re_first_add_inst(prog, pc);
+        break;
+    }
+  }
+  free(seen);
+  SLRE_FREE(stack);
+
+  for (i = cnt = 0; ok && i < 0x100; i++) {
+    if (prog->first[i >> 3] & (1 << (i & 7))) cnt++;
+  }
+  /* Skipping is only worth it if most of the bytes can be skipped */
+  if (ok && cnt < 0x80) {
+    prog->accel = RE_ACCEL_FIRST;
+  }
+}
+
 #ifdef RE_TEST
+static void print_range(int first, unsigned int s, unsigned int e) {
+  printf("%s", first ? "'" : ",'");
+  printf(s >= 32 && s < 127 ? "%c" : (s < 256 ? "\\x%02X" : "\\u%04X"), s);
+  if (s != e) {
+    printf(e >= 32 && e < 127 ? "-%c" : (e < 256 ? "-\\x%02X" : "-\\u%04X"), e);
+  }
+  printf("'");
+}
+
 static void print_set(struct slre_class *cp) {
   struct slre_range *p;
   for (p = cp->spans; p < cp->end; p++) {
-    printf("%s", p == cp->spans ? "'" : ",'");
-    printf(
-        p->s >= 32 && p->s < 127 ? "%c" : (p->s < 256 ? "\\x%02X" : "\\u%04X"),
-        p->s);
-    if (p->s != p->e) {
-      printf(p->e >= 32 && p->e < 127 ? "-%c"
-                                      : (p->e < 256 ? "-\\x%02X" : "-\\u%04X"),
-             p->e);
-    }
-    printf("'");
+    print_range(p == cp->spans, p->s, p->e);
+  }
+  printf("]");
+}
+
+static void print_prog_set(const unsigned char *set) {
+  int i;
+  for (i = 0; i < set[0]; i++) {
+    print_range(i == 0, RE_SET_S(set, i), RE_SET_E(set, i));
   }
   printf("]");
 }
@@ -1032,10 +1421,11 @@ static void node_print(struct slre_node *nd) {
   }
 }
 
-static void program_print(struct slre_prog *prog) {
-  struct slre_instruction *inst;
-  for (inst = prog->start; inst < prog->end; ++inst) {
-    printf("%3d: ", inst - prog->start);
+static void program_print(const struct slre_prog *prog) {
+  const struct slre_instruction *start = RE_START(prog), *inst;
+  const struct slre_instruction *end = start + RE_GET32(prog->ninst);
+  for (inst = start; inst < end; ++inst) {
+    printf("%3d: ", (int) (inst - start));
     switch (inst->opcode) {
       case I_END:
         puts("end");
@@ -1050,9 +1440,8 @@ static void program_print(struct slre_prog *prog) {
         puts("^");
         break;
       case I_CH:
-        printf(
-            inst->par.c >= 32 && inst->par.c < 127 ? "'%c'\n" : "'\\u%04X'\n",
-            inst->par.c);
+        printf(RE_X(inst) >= 32 && RE_X(inst) < 127 ? "'%c'\n" : "'\\u%04X'\n",
+               (int) RE_X(inst));
         break;
       case I_EOL:
         puts("$");
@@ -1061,44 +1450,42 @@ static void program_print(struct slre_prog *prog) {
         puts("\\0");
         break;
       case I_JUMP:
-        printf("-->%d\n", inst->par.xy.x - prog->start);
+        printf("-->%d\n", (int) RE_X(inst));
         break;
       case I_LA:
-        printf("la %d %d\n", inst->par.xy.x - prog->start,
-               inst->par.xy.y.y - prog->start);
+        printf("la %d %d\n", (int) RE_X(inst), (int) RE_Y(inst));
         break;
       case I_LA_N:
-        printf("la_n %d %d\n", inst->par.xy.x - prog->start,
-               inst->par.xy.y.y - prog->start);
+        printf("la_n %d %d\n", (int) RE_X(inst), (int) RE_Y(inst));
         break;
       case I_LBRA:
-        printf("( %d\n", inst->par.n);
+        printf("( %d\n", inst->n);
         break;
       case I_RBRA:
-        printf(") %d\n", inst->par.n);
+        printf(") %d\n", inst->n);
         break;
       case I_SPLIT:
-        printf("-->%d | -->%d\n", inst->par.xy.x - prog->start,
-               inst->par.xy.y.y - prog->start);
+        printf("-->%d | -->%d\n", (int) RE_X(inst), (int) RE_Y(inst));
         break;
       case I_REF:
-        printf("\\%d\n", inst->par.n);
+        printf("\\%d\n", inst->n);
         break;
       case I_REP:
-        printf("repeat -->%d\n", inst->par.xy.x - prog->start);
+        printf("repeat -->%d (counter %d)\n", (int) RE_X(inst),
+               (int) RE_Y(inst));
         break;
       case I_REP_INI:
-        printf("init_rep %d %d\n", inst->par.xy.y.rp.min,
-               inst->par.xy.y.rp.min + inst->par.xy.y.rp.max);
+        printf("init_rep %d %d\n", (int) RE_X(inst),
+               (int) (RE_X(inst) + RE_Y(inst)));
         break;
       case I_SET:
         printf("[");
-        print_set(inst->par.cp);
+        print_prog_set(RE_SET(prog, inst));
         puts("");
         break;
       case I_SET_N:
         printf("[^");
-        print_set(inst->par.cp);
+        print_prog_set(RE_SET(prog, inst));
         puts("");
         break;
       case I_WORD:
@@ -1117,30 +1504,32 @@ int slre_compile(const char *pat, size_t pat_len, const char *flags,
   struct slre_env e;
   struct slre_node *nd;
   struct slre_instruction *split, *jump;
+  struct re_heap_prog *hp;
+  unsigned long ninst, size;
+  unsigned int i;
   int err_code;
 
   e.is_regex = is_regex;
-  e.prog = (struct slre_prog *) SLRE_MALLOC(sizeof(struct slre_prog));
+  e.prog = NULL;
   e.pstart = e.pend =
       (struct slre_node *) SLRE_MALLOC(sizeof(struct slre_node) * pat_len * 2);
-  e.prog->flags = is_regex ? SLRE_FLAG_RE : 0;
+  e.flags = is_regex ? SLRE_FLAG_RE : 0;
 
   if ((err_code = setjmp(e.jmp_buf)) != SLRE_OK) {
     SLRE_FREE(e.pstart);
-    SLRE_FREE(e.prog);
     return err_code;
   }
 
   while (fl_len--) {
     switch (flags[fl_len]) {
       case 'g':
-        e.prog->flags |= SLRE_FLAG_G;
+        e.flags |= SLRE_FLAG_G;
         break;
       case 'i':
-        e.prog->flags |= SLRE_FLAG_I;
+        e.flags |= SLRE_FLAG_I;
         break;
       case 'm':
-        e.prog->flags |= SLRE_FLAG_M;
+        e.flags |= SLRE_FLAG_M;
         break;
     }
   }
@@ -1149,6 +1538,8 @@ int slre_compile(const char *pat, size_t pat_len, const char *flags,
   e.src_end = pat + pat_len;
   e.sets_num = 0;
   e.num_captures = 1;
+  e.num_reps = 0;
+  e.has_refs = 0;
   /*e.flags = flags;*/
   memset(e.caps, 0, sizeof(e.caps));
 
@@ -1161,20 +1552,50 @@ int slre_compile(const char *pat, size_t pat_len, const char *flags,
     SLRE_THROW(&e, SLRE_SYNTAX_ERROR);
   }
 
+  /* Instructions, followed by the charsets */
+  ninst = re_nodelen(&e, nd) + 6;
+  size = sizeof(struct slre_prog) + ninst * sizeof(struct slre_instruction);
+  for (i = 0; i < e.sets_num; i++) {
+    e.set_offs[i] = size;
+    size += 1 + 4 * (e.sets[i].end - e.sets[i].spans);
+  }
+  hp = (struct re_heap_prog *) SLRE_MALLOC(
+      offsetof(struct re_heap_prog, prog) + size);
+  hp->refcnt = 1;
+  e.prog = &hp->prog;
+  memset(e.prog, 0, size);
+  e.prog->version = RE_IMAGE_VERSION;
+  e.prog->heap = 1;
+  e.prog->flags = e.flags;
   e.prog->num_captures = e.num_captures;
-  e.prog->start = e.prog->end = (struct slre_instruction *) SLRE_MALLOC(
-      (re_nodelen(nd) + 6) * sizeof(struct slre_instruction));
-
-  split = re_newinst(e.prog, I_SPLIT);
-  split->par.xy.x = split + 3;
-  split->par.xy.y.y = split + 1;
-  re_newinst(e.prog, I_ANYNL);
-  jump = re_newinst(e.prog, I_JUMP);
-  jump->par.xy.x = split;
-  re_newinst(e.prog, I_LBRA);
+  re_put(e.prog->size, size, 4);
+  e.end = (struct slre_instruction *) RE_START(e.prog);
+
+  split = re_newinst(&e, I_SPLIT);
+  re_link(&e, split->x, split + 3);
+  re_link(&e, split->y, split + 1);
+  re_newinst(&e, I_ANYNL);
+  jump = re_newinst(&e, I_JUMP);
+  re_link(&e, jump->x, split);
+  re_newinst(&e, I_LBRA);
   re_compile(&e, nd);
-  re_newinst(e.prog, I_RBRA);
-  re_newinst(e.prog, I_END);
+  re_newinst(&e, I_RBRA);
+  re_newinst(&e, I_END);
+  re_put(e.prog->ninst, e.end - RE_START(e.prog), 4);
+  re_put(e.prog->num_reps, e.num_reps, 4);
+
+  for (i = 0; i < e.sets_num; i++) {
+    unsigned char *p = (unsigned char *) e.prog + e.set_offs[i];
+    struct slre_range *r;
+    *p++ = (unsigned char) (e.sets[i].end - e.sets[i].spans);
+    for (r = e.sets[i].spans; r < e.sets[i].end; r++, p += 4) {
+      re_put(p, r->s, 2);
+      re_put(p + 2, r->e, 2);
+    }
+  }
+
+  re_analyze(e.prog);
+  re_analyze_accel(e.prog);
 
 #ifdef RE_TEST
   node_print(nd);
@@ -1193,218 +1614,1028 @@ int slre_compile(const char *pat, size_t pat_len, const char *flags,
   return err_code;
 }
 
-void slre_free(struct slre_prog *prog) {
-  if (prog) {
-    SLRE_FREE(prog->start);
-    SLRE_FREE(prog);
+static void re_dfa_flush(struct slre_vm *vm) {
+  unsigned int i;
+  for (i = 0; i < vm->states_cnt; i++) {
+    SLRE_FREE(vm->states[i].pcs);
   }
+  vm->states_cnt = 0;
+  vm->flushes++;
 }
 
-static struct slre_thread *re_newthread(struct slre_thread *t,
-                                        struct slre_instruction *pc,
-                                        const char *start,
-                                        struct slre_loot *loot) {
-  struct slre_thread *new_thread =
-      (struct slre_thread *) SLRE_MALLOC(sizeof(struct slre_thread));
-  if (new_thread != NULL) new_thread->prev = t;
-  t->pc = pc;
-  t->start = start;
-  t->loot = *loot;
-  return new_thread;
+static void re_vm_free(struct slre_vm *vm) {
+  if (vm != NULL) {
+    re_dfa_flush(vm);
+    SLRE_FREE(vm->states);
+    SLRE_FREE(vm->mark);
+    SLRE_FREE(vm->lists[0].pcs);
+    SLRE_FREE(vm->lists[0].caps);
+    SLRE_FREE(vm->lists[1].pcs);
+    SLRE_FREE(vm->lists[1].caps);
+    SLRE_FREE(vm);
+  }
 }
 
-static struct slre_thread *get_prev_thread(struct slre_thread *t) {
-  struct slre_thread *tmp_thr = t->prev;
-  SLRE_FREE(t);
-  return tmp_thr;
-}
+/* Heap program which the program belongs to */
+#define RE_HEAP_PROG(prog)                                     \
+  ((struct re_heap_prog *) ((char *) (prog) -                  \
+                            offsetof(struct re_heap_prog, prog)))
 
-static void free_threads(struct slre_thread *t) {
-  while (t->prev != NULL) t = get_prev_thread(t);
+struct slre_prog *slre_retain(struct slre_prog *prog) {
+  if (prog->heap) RE_HEAP_PROG(prog)->refcnt++;
+  return prog;
 }
 
-#define RE_NO_MATCH() \
-  if (!(thr = 0)) continue
-
-static unsigned char re_match(struct slre_instruction *pc, const char *current,
-                              const char *end, const char *bol,
-                              unsigned int flags, struct slre_loot *loot) {
-  struct slre_loot sub, tmpsub;
-  Rune c, r;
-  struct slre_range *p;
-  unsigned char thr;
-  size_t i;
-  struct slre_thread thread, *curr_thread, *tmp_thr;
-
-  /* queue initial thread */
-  thread.prev = NULL;
-  curr_thread = re_newthread(&thread, pc, current, loot);
-
-  /* run threads in stack order */
-  do {
-    curr_thread = get_prev_thread(curr_thread);
-    pc = curr_thread->pc;
-    current = curr_thread->start;
-    sub = curr_thread->loot;
-    for (thr = 1; thr;) {
-      switch (pc->opcode) {
-        case I_END:
-          memcpy(loot->caps, sub.caps, sizeof loot->caps);
-          free_threads(curr_thread);
-          return 1;
-        case I_ANY:
-        case I_ANYNL:
-          if (current < end) {
-            current += chartorune(&c, current);
-            if (c && !(pc->opcode == I_ANY && isnewline(c))) break;
-          }
-          RE_NO_MATCH();
-
-        case I_BOL:
-          if (current == bol) break;
-          if ((flags & SLRE_FLAG_M) && isnewline(current[-1])) break;
-          RE_NO_MATCH();
-        case I_CH:
-          if (current < end) {
-            current += chartorune(&c, current);
-            if (c &&
-                (c == pc->par.c || ((flags & SLRE_FLAG_I) &&
-                                    tolowerrune(c) == tolowerrune(pc->par.c))))
-              break;
-          }
-          RE_NO_MATCH();
-        case I_EOL:
-          if (current >= end) break;
-          if ((flags & SLRE_FLAG_M) && isnewline(*current)) break;
-          RE_NO_MATCH();
-        case I_EOS:
-          if (current >= end) break;
-          RE_NO_MATCH();
-
-        case I_JUMP:
-          pc = pc->par.xy.x;
-          continue;
-
-        case I_LA:
-          if (re_match(pc->par.xy.x, current, end, bol, flags, &sub)) {
-            pc = pc->par.xy.y.y;
-            continue;
-          }
-          RE_NO_MATCH();
-        case I_LA_N:
-          tmpsub = sub;
-          if (!re_match(pc->par.xy.x, current, end, bol, flags, &tmpsub)) {
-            pc = pc->par.xy.y.y;
-            continue;
-          }
-          RE_NO_MATCH();
-
-        case I_LBRA:
-          sub.caps[pc->par.n].start = current;
-          break;
-
-        case I_REF:
-          i = sub.caps[pc->par.n].end - sub.caps[pc->par.n].start;
-          if (flags & SLRE_FLAG_I) {
-            int num = i;
-            const char *s = current, *p = sub.caps[pc->par.n].start;
-            Rune rr;
-            for (; num && *s && *p; num--) {
-              s += chartorune(&r, s);
-              p += chartorune(&rr, p);
-              if (tolowerrune(r) != tolowerrune(rr)) break;
-            }
-            if (num) RE_NO_MATCH();
-          } else if (strncmp(current, sub.caps[pc->par.n].start, i)) {
-            RE_NO_MATCH();
-          }
-          if (i > 0) current += i;
-          break;
-
-        case I_REP:
-          if (pc->par.xy.y.rp.min) {
-            pc->par.xy.y.rp.min--;
-            pc++;
-          } else if (!pc->par.xy.y.rp.max--) {
-            pc = pc->par.xy.x;
-            continue;
-          }
-          break;
-
-        case I_REP_INI:
-          (pc + 1)->par.xy.y.rp.min = pc->par.xy.y.rp.min;
-          (pc + 1)->par.xy.y.rp.max = pc->par.xy.y.rp.max;
-          break;
-
-        case I_RBRA:
-          sub.caps[pc->par.n].end = current;
-          break;
-
-        case I_SET:
-        case I_SET_N:
-          if (current >= end) RE_NO_MATCH();
-          current += chartorune(&c, current);
-          if (!c) RE_NO_MATCH();
-
-          i = 1;
-          for (p = pc->par.cp->spans; i && p < pc->par.cp->end; p++)
-            if (flags & SLRE_FLAG_I) {
-              for (r = p->s; r <= p->e; ++r)
-                if (tolowerrune(c) == tolowerrune(r)) {
-                  i = 0;
-                  break;
-                }
-            } else if (p->s <= c && c <= p->e)
-              i = 0;
-
-          if (pc->opcode == I_SET) i = !i;
-          if (i) break;
-          RE_NO_MATCH();
+void slre_free(struct slre_prog *prog) {
+  /* Loaded programs are the images themselves, which the caller owns */
+  if (prog != NULL && prog->heap && --RE_HEAP_PROG(prog)->refcnt == 0) {
+    SLRE_FREE(RE_HEAP_PROG(prog));
+  }
+}
 
-        case I_SPLIT:
-          tmp_thr = curr_thread;
-          curr_thread =
-              re_newthread(curr_thread, pc->par.xy.y.y, current, &sub);
-          if (curr_thread == NULL) {
-            fprintf(stderr, "re_match: no memory for thread!\n");
-            free_threads(tmp_thr);
-            return 0;
-          }
-          pc = pc->par.xy.x;
-          continue;
+size_t slre_dump(const struct slre_prog *prog, char *buf, size_t size) {
+  size_t len = RE_GET32(prog->size);
+  if (buf != NULL && size >= len) {
+    memcpy(buf, prog, len);
+    ((struct slre_prog *) buf)->heap = 0;
+  }
+  return len;
+}
 
-        case I_WORD:
-        case I_WORD_N:
-          i = (current > bol && iswordchar(current[-1]));
-          if (iswordchar(current[0])) i = !i;
-          if (pc->opcode == I_WORD_N) i = !i;
-          if (i) break;
-        /* RE_NO_MATCH(); */
+/*
+ * Stores the instructions `pc` can continue with without consuming input and
+ * returns their number
+ */
+static int re_eps_next(const struct slre_instruction *start,
+                       const struct slre_instruction *pc, unsigned long *next) {
+  switch (pc->opcode) {
+    case I_JUMP:
+      next[0] = RE_X(pc);
+      return 1;
+    case I_SPLIT:
+    case I_LA:
+    case I_LA_N:
+      next[0] = RE_X(pc);
+      next[1] = RE_Y(pc);
+      return 2;
+    case I_REP:
+      next[0] = pc + 1 - start;
+      next[1] = pc + 2 - start;
+      next[2] = RE_X(pc);
+      return 3;
+    case I_LBRA:
+    case I_RBRA:
+    case I_REP_INI:
+    case I_BOL:
+    case I_EOL:
+    case I_EOS:
+    case I_WORD:
+    case I_WORD_N:
+      next[0] = pc + 1 - start;
+      return 1;
+    default:
+      return 0;
+  }
+}
 
-        default:
-          RE_NO_MATCH();
-      }
-      pc++;
+/*
+ * Returns 1 if the program has no loop that can go round without consuming
+ * input (`slre_compile()` rejects those, and the backtracking matcher would
+ * never leave them), 0 if it has or there's no memory to check
+ */
+static int re_check_loops(const struct slre_prog *prog, unsigned long ninst) {
+  const struct slre_instruction *start = RE_START(prog);
+  unsigned long *deg, *queue, next[3], head = 0, tail = 0, i;
+  int j, n;
+
+  deg = (unsigned long *) calloc(ninst * 2, sizeof(*deg));
+  if (deg == NULL) return 0;
+  queue = deg + ninst;
+
+  /* Drop the instructions no such loop leads to until none is left */
+  for (i = 0; i < ninst; i++) {
+    n = re_eps_next(start, start + i, next);
+    for (j = 0; j < n; j++) deg[next[j]]++;
+  }
+  for (i = 0; i < ninst; i++) {
+    if (deg[i] == 0) queue[tail++] = i;
+  }
+  while (head < tail) {
+    n = re_eps_next(start, start + queue[head++], next);
+    for (j = 0; j < n; j++) {
+      if (--deg[next[j]] == 0) queue[tail++] = next[j];
     }
-  } while (curr_thread->prev != NULL);
-  return 0;
+  }
+
+  free(deg);
+  return tail == ninst;
 }
 
-int slre_exec(struct slre_prog *prog, int flag_g, const char *start,
-              const char *end, struct slre_loot *loot) {
-  struct slre_loot tmpsub;
-  const char *st = start;
+/*
+ * Checks the image, so that the matchers can trust it: instruction operands
+ * (targets, captures, counters and charsets) and charset ranges must be
+ * within bounds, the program must end with `I_END`, so that running past
+ * an instruction never leaves the program, and it must have no loops which
+ * don't consume input. Only the last check needs memory, for a moment.
+ */
+int slre_load(const char *image, size_t len, struct slre_prog **pr) {
+  const struct slre_prog *prog = (const struct slre_prog *) image;
+  const struct slre_instruction *pc, *end;
+  const unsigned char *set;
+  unsigned long ninst, size, num_reps, sets, n;
+  int i;
+
+  if (len < sizeof(*prog) || prog->version != RE_IMAGE_VERSION ||
+      prog->heap || prog->num_captures == 0 ||
+      prog->num_captures > SLRE_MAX_CAPS ||
+      prog->prefix_len > SLRE_MAX_PREFIX) {
+    return SLRE_BAD_IMAGE;
+  }
+  ninst = RE_GET32(prog->ninst);
+  size = RE_GET32(prog->size);
+  num_reps = RE_GET32(prog->num_reps);
+  if (size > len || size < sizeof(*prog) || ninst <= RE_PC_BODY ||
+      ninst > (size - sizeof(*prog)) / sizeof(*pc) || num_reps > ninst) {
+    return SLRE_BAD_IMAGE;
+  }
+  end = RE_START(prog) + ninst;
+  sets = (const char *) end - image;
+  if (end[-1].opcode != I_END) return SLRE_BAD_IMAGE;
 
-  if (!loot) loot = &tmpsub;
-  memset(loot, 0, sizeof(*loot));
+  for (pc = RE_START(prog); pc < end; pc++) {
+    switch (pc->opcode) {
+      case I_LBRA:
+      case I_RBRA:
+      case I_REF:
+        if (pc->n >= prog->num_captures) return SLRE_BAD_IMAGE;
+        break;
+      case I_SET:
+      case I_SET_N:
+        if ((n = RE_X(pc)) < sets || n >= size) return SLRE_BAD_IMAGE;
+        set = (const unsigned char *) image + n;
+        if (set[0] > SLRE_MAX_RANGES || size - n < 1 + 4 * (size_t) set[0]) {
+          return SLRE_BAD_IMAGE;
+        }
+        for (i = 0; i < set[0]; i++) {
+          if (RE_SET_S(set, i) > RE_SET_E(set, i)) return SLRE_BAD_IMAGE;
+        }
+        break;
+      case I_REP_INI:
+        /* Sets the counter of the following `I_REP` */
+        if (pc + 1 == end || pc[1].opcode != I_REP ||
+            RE_X(pc) > SLRE_MAX_REP || RE_Y(pc) > SLRE_MAX_REP) {
+          return SLRE_BAD_IMAGE;
+        }
+        break;
+      case I_REP:
+        /* Continues with the instruction after the next one */
+        if (RE_Y(pc) >= num_reps || RE_X(pc) >= ninst || end - pc <= 2) {
+          return SLRE_BAD_IMAGE;
+        }
+        break;
+      case I_SPLIT:
+      case I_LA:
+      case I_LA_N:
+        if (RE_Y(pc) >= ninst) return SLRE_BAD_IMAGE;
+      /* fallthrough */
+      case I_JUMP:
+        if (RE_X(pc) >= ninst) return SLRE_BAD_IMAGE;
+        break;
+      case I_END:
+      case I_ANY:
+      case I_ANYNL:
+      case I_BOL:
+      case I_CH:
+      case I_EOL:
+      case I_EOS:
+      case I_WORD:
+      case I_WORD_N:
+        break;
+      default:
+        return SLRE_BAD_IMAGE;
+    }
+  }
+
+  if (!re_check_loops(prog, ninst)) return SLRE_BAD_IMAGE;
+
+  *pr = (struct slre_prog *) prog;
+  return SLRE_OK;
+}
+
+#define RE_NO_LA ((size_t) -1)
+
+/* Initializes scratch data of a match of the program */
+static void re_state_init(const struct slre_prog *prog,
+                          struct slre_state *st) {
+  unsigned long n = RE_GET32(prog->num_reps);
+
+  st->bt = st->bt_buf;
+  st->bt_size = RE_BT_INLINE;
+  st->reps = st->reps_buf;
+  if (n > RE_REPS_INLINE) {
+    /* NULL if out of memory, see `re_match()` */
+    st->reps = (struct slre_rep *) calloc(n, sizeof(struct slre_rep));
+  } else {
+    memset(st->reps_buf, 0, sizeof(st->reps_buf));
+  }
+  st->vm = NULL;
+}
+
+static void re_state_free(struct slre_state *st) {
+  if (st->bt != st->bt_buf) SLRE_FREE(st->bt);
+  if (st->reps != st->reps_buf) SLRE_FREE(st->reps);
+  re_vm_free(st->vm);
+}
+
+/*
+ * Pushes an entry to the backtrack stack, growing it if needed. Returns NULL
+ * if out of memory.
+ */
+static struct slre_bt *re_bt_push(struct slre_state *st, size_t *sp,
+                                  unsigned char type) {
+  if (*sp == st->bt_size) {
+    size_t new_size = st->bt_size * 2;
+    struct slre_bt *bt;
+    if (st->bt == st->bt_buf) {
+      bt = (struct slre_bt *) SLRE_MALLOC(new_size * sizeof(struct slre_bt));
+      if (bt != NULL) memcpy(bt, st->bt_buf, sizeof(st->bt_buf));
+    } else {
+      bt = (struct slre_bt *) SLRE_REALLOC(st->bt,
+                                          new_size * sizeof(struct slre_bt));
+    }
+    if (bt == NULL) {
+      return NULL;
+    }
+    st->bt = bt;
+    st->bt_size = new_size;
+  }
+  st->bt[*sp].type = type;
+  return &st->bt[(*sp)++];
+}
+
+/* Decodes the next character; ASCII doesn't need `chartorune()` */
+static int re_next_rune(Rune *c, const char *s) {
+  if ((unsigned char) *s < Runeself) {
+    *c = (unsigned char) *s;
+    return 1;
+  }
+  return chartorune(c, s);
+}
+
+/*
+ * Returns non-zero if the characters are equal ignoring case. As in the
+ * `Canonicalize` operation of ECMA-262 15.10.2.8, a non-ASCII character never
+ * matches an ASCII one.
+ */
+static int re_fold_eq(Rune a, Rune b) {
+  if (a == b) return 1;
+  if (a < Runeself && b < Runeself) return tolower(a) == tolower(b);
+  if (a < Runeself || b < Runeself) return 0;
+  return tolowerrune(a) == tolowerrune(b);
+}
+
+/*
+ * Returns non-zero if the character `c` matches the character-consuming
+ * instruction (`I_ANY`, `I_ANYNL`, `I_CH`, `I_SET` or `I_SET_N`).
+ */
+static int re_match_rune(const struct slre_prog *prog,
+                         const struct slre_instruction *pc, Rune c,
+                         unsigned int flags) {
+  const unsigned char *set;
+  unsigned int s, e, r;
+  int i, j;
+
+  if (!c) return 0;
+
+  switch (pc->opcode) {
+    case I_ANY:
+      return !isnewline(c);
+    case I_ANYNL:
+      return 1;
+    case I_CH:
+      if (c == RE_X(pc)) return 1;
+      if (!(flags & SLRE_FLAG_I)) return 0;
+      return re_fold_eq(c, (Rune) RE_X(pc));
+    case I_SET:
+    case I_SET_N:
+      set = RE_SET(prog, pc);
+      i = 1;
+      for (j = 0; i && j < set[0]; j++) {
+        s = RE_SET_S(set, j);
+        e = RE_SET_E(set, j);
+        if ((flags & SLRE_FLAG_I) && c < Runeself && e < Runeself) {
+          /* Only the other case of an ASCII letter folds to the same */
+          r = tolower(c);
+          if (s <= r && r <= e) i = 0;
+          r = toupper(c);
+          if (s <= r && r <= e) i = 0;
+        } else if (flags & SLRE_FLAG_I) {
+          for (r = s; r <= e; ++r)
+            if (re_fold_eq(c, (Rune) r)) {
+              i = 0;
+              break;
+            }
+        } else if (s <= c && c <= e)
+          i = 0;
+      }
+      return pc->opcode == I_SET ? !i : i;
+    default:
+      return 0;
+  }
+}
+
+/*
+ * Returns non-zero if the zero-width instruction (`I_BOL`, `I_EOL`, `I_EOS`,
+ * `I_WORD` or `I_WORD_N`) holds at the position `current`.
+ */
+static int re_match_assertion(const struct slre_instruction *pc,
+                              const char *current, const char *end,
+                              const char *bol, unsigned int flags) {
+  int i;
+
+  switch (pc->opcode) {
+    case I_BOL:
+      return current == bol ||
+             ((flags & SLRE_FLAG_M) && isnewline(current[-1]));
+    case I_EOL:
+      return current >= end || ((flags & SLRE_FLAG_M) && isnewline(*current));
+    case I_EOS:
+      return current >= end;
+    case I_WORD:
+    case I_WORD_N:
+      i = (current > bol && iswordchar(current[-1]));
+      if (iswordchar(current[0])) i = !i;
+      return pc->opcode == I_WORD_N ? !i : i;
+    default:
+      return 0;
+  }
+}
+
+/*
+ * Backtracking matcher. Instead of copying the whole state on each choice
+ * point, it keeps a stack (`struct slre_state::bt`) of:
+ *
+ * - alternatives to try on failure (`BT_ALT`), i.e. instruction and position;
+ * - old values of the captures changed since the last choice point
+ *   (`BT_UNDO`), which are restored when backtracking past them;
+ * - lookaheads being matched (`BT_LA`, `BT_LA_N`), so that lookaheads are
+ *   matched without recursion: `I_END` of the lookahead body, as well as
+ *   backtracking past the lookahead entry, complete the lookahead.
+ */
+static unsigned char re_match(const struct slre_prog *prog,
+                              struct slre_state *st,
+                              const struct slre_instruction *pc,
+                              const char *current, const char *end,
+                              const char *bol, unsigned int flags,
+                              struct slre_loot *loot) {
+  const struct slre_instruction *start = RE_START(prog);
+  struct slre_loot sub = *loot;
+  struct slre_bt *bt;
+  struct slre_rep *rep;
+  size_t i, sp = 0, la = RE_NO_LA;
+  Rune c, r;
+
+  if (st->reps == NULL) goto oom;
+
+  for (;;) {
+    switch (pc->opcode) {
+      case I_END:
+        if (la == RE_NO_LA) {
+          memcpy(loot->caps, sub.caps, sizeof loot->caps);
+          return 1;
+        } else if (st->bt[la].type == BT_LA) {
+          /*
+           * Positive lookahead matched: drop alternatives of its body, but
+           * keep the undo entries since the captures it has set are kept
+           */
+          struct slre_bt la_entry = st->bt[la];
+          size_t n = la;
+          for (i = la + 1; i < sp; i++) {
+            if (st->bt[i].type == BT_UNDO) {
+              st->bt[n++] = st->bt[i];
+            }
+          }
+          sp = n;
+          la = la_entry.u.prev_la;
+          pc = la_entry.pc;
+          current = la_entry.p;
+          continue;
+        } else {
+          /*
+           * Negative lookahead body matched: restore captures and drop the
+           * lookahead entry, and then fail
+           */
+          for (; sp > la + 1; sp--) {
+            bt = &st->bt[sp - 1];
+            if (bt->type == BT_UNDO) *bt->u.cap = bt->p;
+          }
+          la = st->bt[--sp].u.prev_la;
+          goto fail;
+        }
+
+      case I_ANY:
+      case I_ANYNL:
+      case I_CH:
+      case I_SET:
+      case I_SET_N:
+        if (current < end) {
+          current += re_next_rune(&c, current);
+          if (re_match_rune(prog, pc, c, flags)) break;
+        }
+        goto fail;
+
+      case I_BOL:
+      case I_EOL:
+      case I_EOS:
+      case I_WORD:
+      case I_WORD_N:
+        if (re_match_assertion(pc, current, end, bol, flags)) break;
+        goto fail;
+
+      case I_JUMP:
+        pc = start + RE_X(pc);
+        continue;
+
+      case I_LA:
+      case I_LA_N:
+        if ((bt = re_bt_push(st, &sp, pc->opcode == I_LA ? BT_LA
+                                                           : BT_LA_N)) == NULL) {
+          goto oom;
+        }
+        bt->pc = start + RE_Y(pc);
+        bt->p = current;
+        bt->u.prev_la = la;
+        la = sp - 1;
+        pc = start + RE_X(pc);
+        continue;
+
+      case I_LBRA:
+      case I_RBRA: {
+        const char **cap = pc->opcode == I_LBRA ? &sub.caps[pc->n].start
+                                                : &sub.caps[pc->n].end;
+        /* No need to remember the old value if there's nothing to go back to */
+        if (sp > 0) {
+          if ((bt = re_bt_push(st, &sp, BT_UNDO)) == NULL) goto oom;
+          bt->p = *cap;
+          bt->u.cap = cap;
+        }
+        *cap = current;
+        break;
+      }
+
+      case I_REF:
+        /* A capture which hasn't been closed matches the empty string */
+        i = sub.caps[pc->n].start != NULL &&
+                    sub.caps[pc->n].end > sub.caps[pc->n].start
+                ? (size_t)(sub.caps[pc->n].end - sub.caps[pc->n].start)
+                : 0;
+        if (flags & SLRE_FLAG_I) {
+          int num = i;
+          const char *s = current, *p = sub.caps[pc->n].start;
+          Rune rr;
+          for (; num && *s && *p; num--) {
+            s += chartorune(&r, s);
+            p += chartorune(&rr, p);
+            if (!re_fold_eq(r, rr)) break;
+          }
+          if (num) goto fail;
+        } else if (i > 0 && strncmp(current, sub.caps[pc->n].start, i)) {
+          goto fail;
+        }
+        if (i > 0) current += i;
+        break;
+
+      case I_REP:
+        rep = &st->reps[RE_Y(pc)];
+        if (rep->min) {
+          rep->min--;
+          pc++;
+        } else if (!rep->max--) {
+          pc = start + RE_X(pc);
+          continue;
+        }
+        break;
+
+      case I_REP_INI:
+        rep = &st->reps[RE_Y(pc + 1)];
+        rep->min = RE_X(pc);
+        rep->max = RE_Y(pc);
+        break;
+
+      case I_SPLIT:
+        if ((bt = re_bt_push(st, &sp, BT_ALT)) == NULL) goto oom;
+        bt->pc = start + RE_Y(pc);
+        bt->p = current;
+        pc = start + RE_X(pc);
+        continue;
+
+      default:
+        goto fail;
+    }
+    pc++;
+    continue;
+
+  fail:
+    /* Unwind the stack until there's an alternative to try */
+    for (;;) {
+      if (sp == 0) return 0;
+      bt = &st->bt[--sp];
+      if (bt->type == BT_UNDO) {
+        *bt->u.cap = bt->p;
+      } else if (bt->type == BT_LA) {
+        /* Positive lookahead body failed: keep failing */
+        la = bt->u.prev_la;
+      } else {
+        /* Alternative, or negative lookahead body failed: continue */
+        if (bt->type == BT_LA_N) la = bt->u.prev_la;
+        pc = bt->pc;
+        current = bt->p;
+        break;
+      }
+    }
+  }
+
+oom:
+  fprintf(stderr, "re_match: no memory for backtrack stack!\n");
+  return 0;
+}
+
+/*
+ * Returns the first position at or after `p` where a match can start,
+ * according to `struct slre_prog::accel`, or NULL if there is none. Like the
+ * restart loop of the program, stops at NUL characters, and only returns
+ * character boundaries.
+ */
+static const char *re_skip(const struct slre_prog *prog, const char *p,
+                           const char *end, const char *bol) {
+  const char *q;
+  Rune c;
+
+  switch (prog->accel) {
+    case RE_ACCEL_ANCHORED:
+      return p == bol ? p : NULL;
+
+    case RE_ACCEL_PREFIX:
+      if (p >= end) return NULL;
+      for (;;) {
+        q = (const char *) memchr(p, prog->prefix[0], end - p);
+        if (q == NULL || memchr(p, '\0', q - p) != NULL) return NULL;
+        if ((size_t)(end - q) >= prog->prefix_len &&
+            memcmp(q, prog->prefix, prog->prefix_len) == 0) {
+          return q;
+        }
+        /* First byte of the prefix is ASCII or a lead byte */
+        p = q + 1;
+      }
+
+    case RE_ACCEL_FIRST:
+      while (p < end) {
+        unsigned char b = (unsigned char) *p;
+        if (prog->first[b >> 3] & (1 << (b & 7))) return p;
+        if (b == 0) return NULL;
+        p += b < Runeself ? 1 : chartorune(&c, p);
+      }
+      return NULL;
+
+    default:
+      return p;
+  }
+}
+
+/* Returns scratch data of the Pike VM and the DFA, or NULL if out of memory */
+static struct slre_vm *re_vm(const struct slre_prog *prog,
+                             struct slre_state *st) {
+  struct slre_vm *vm = st->vm;
+  size_t n = RE_GET32(prog->ninst), ncap = prog->num_captures, i;
+
+  if (vm == NULL) {
+    vm = (struct slre_vm *) calloc(1, sizeof(*vm));
+    if (vm == NULL) return NULL;
+    vm->mark = (unsigned int *) calloc(n, sizeof(*vm->mark));
+    for (i = 0; i < 2; i++) {
+      vm->lists[i].pcs = (unsigned int *) SLRE_MALLOC(n * sizeof(unsigned int));
+      vm->lists[i].caps =
+          (struct slre_cap *) SLRE_MALLOC(n * ncap * sizeof(struct slre_cap));
+    }
+    if (vm->mark == NULL || vm->lists[0].pcs == NULL ||
+        vm->lists[0].caps == NULL || vm->lists[1].pcs == NULL ||
+        vm->lists[1].caps == NULL) {
+      re_vm_free(vm);
+      return NULL;
+    }
+    st->vm = vm;
+  }
+  return vm;
+}
+
+/* Starts a new generation of instruction marks */
+static void re_vm_next_gen(const struct slre_prog *prog, struct slre_vm *vm) {
+  if (++vm->gen == 0) {
+    memset(vm->mark, 0, RE_GET32(prog->ninst) * sizeof(*vm->mark));
+    vm->gen = 1;
+  }
+}
+
+/*
+ * Adds a thread starting at `pc` to the list, following jumps, splits,
+ * capture brackets and assertions, so that the list only gets threads at
+ * character-consuming instructions and `I_END`. Instructions already added
+ * in the current generation are skipped, which bounds the list size by the
+ * program size. Threads are added in priority order, the same order the
+ * backtracking matcher would try them in. `caps` are the captures of the
+ * thread; they are unchanged on return.
+ *
+ * Returns 0 if out of memory.
+ */
+static int re_pike_add(const struct slre_prog *prog, struct slre_state *st,
+                       struct slre_vm_list *l,
+                       const struct slre_instruction *pc, const char *current,
+                       const char *end, const char *bol, unsigned int flags,
+                       struct slre_cap *caps) {
+  const struct slre_instruction *start = RE_START(prog);
+  struct slre_vm *vm = st->vm;
+  unsigned int ncap = prog->num_captures;
+  struct slre_bt *bt;
+  size_t sp = 0;
+
+  for (;;) {
+    while (vm->mark[pc - start] != vm->gen) {
+      vm->mark[pc - start] = vm->gen;
+      switch (pc->opcode) {
+        case I_JUMP:
+          pc = start + RE_X(pc);
+          continue;
+        case I_SPLIT:
+          if ((bt = re_bt_push(st, &sp, BT_ALT)) == NULL) return 0;
+          bt->pc = start + RE_Y(pc);
+          pc = start + RE_X(pc);
+          continue;
+        case I_LBRA:
+        case I_RBRA: {
+          const char **cap = pc->opcode == I_LBRA ? &caps[pc->n].start
+                                                  : &caps[pc->n].end;
+          if ((bt = re_bt_push(st, &sp, BT_UNDO)) == NULL) return 0;
+          bt->p = *cap;
+          bt->u.cap = cap;
+          *cap = current;
+          pc++;
+          continue;
+        }
+        case I_BOL:
+        case I_EOL:
+        case I_EOS:
+        case I_WORD:
+        case I_WORD_N:
+          if (re_match_assertion(pc, current, end, bol, flags)) {
+            pc++;
+            continue;
+          }
+          break;
+        default:
+          l->pcs[l->n] = pc - start;
+          memcpy(l->caps + l->n * ncap, caps, ncap * sizeof(*caps));
+          l->n++;
+          break;
+      }
+      break;
+    }
+
+    /* Restore captures and take the next alternative */
+    for (;;) {
+      if (sp == 0) return 1;
+      bt = &st->bt[--sp];
+      if (bt->type == BT_UNDO) {
+        *bt->u.cap = bt->p;
+      } else {
+        pc = bt->pc;
+        break;
+      }
+    }
+  }
+}
+
+/*
+ * Pike VM: runs all the threads in lockstep, one character at a time, so
+ * matching takes O(text length * program size) time whatever the pattern is.
+ * Returns the same result as `re_match()`: 1 on match, 0 on no match, or -1 if
+ * out of memory.
+ */
+static int re_pike(const struct slre_prog *prog, struct slre_state *st,
+                   const char *current, const char *end, const char *bol,
+                   unsigned int flags, struct slre_loot *loot) {
+  struct slre_vm *vm = re_vm(prog, st);
+  struct slre_vm_list *cl, *nl, *tmp;
+  struct slre_cap caps[SLRE_MAX_CAPS];
+  unsigned int ncap = prog->num_captures, i;
+  int matched = 0, active, len;
+  const char *next;
+  Rune c;
+
+  if (vm == NULL) return -1;
+  cl = &vm->lists[0];
+  nl = &vm->lists[1];
+
+  memcpy(caps, loot->caps, sizeof(caps));
+  cl->n = 0;
+  re_vm_next_gen(prog, vm);
+  if (!re_pike_add(prog, st, cl, RE_START(prog), current, end, bol, flags, caps)) {
+    return -1;
+  }
+
+  while (cl->n > 0) {
+    c = 0;
+    len = current < end ? re_next_rune(&c, current) : 0;
+    next = current + len;
+    active = 0;
+    nl->n = 0;
+    re_vm_next_gen(prog, vm);
+
+    for (i = 0; i < cl->n; i++) {
+      const struct slre_instruction *pc = RE_START(prog) + cl->pcs[i];
+      struct slre_cap *tcaps = cl->caps + i * ncap;
+      if (pc->opcode == I_END) {
+        /* Threads of lower priority would not be tried by backtracking */
+        memcpy(loot->caps, tcaps, ncap * sizeof(*tcaps));
+        matched = 1;
+        break;
+      }
+      if (len > 0 && re_match_rune(prog, pc, c, flags)) {
+        if (cl->pcs[i] != RE_PC_RESTART) {
+          active = 1;
+        } else if (!active && prog->accel != RE_ACCEL_NONE) {
+          /*
+           * The restart thread is the last one; if no other thread is alive,
+           * restart right at the next position where a match can start
+           */
+          if ((next = re_skip(prog, next, end, bol)) == NULL) break;
+        }
+        memcpy(caps, tcaps, ncap * sizeof(*tcaps));
+        if (!re_pike_add(prog, st, nl, pc + 1, next, end, bol, flags, caps)) {
+          return -1;
+        }
+      }
+    }
+
+    if (len == 0 || next == NULL) break;
+    current = next;
+    tmp = cl;
+    cl = nl;
+    nl = tmp;
+  }
+
+  return matched;
+}
+
+/*
+ * Adds the closure of `pc` to the DFA state set being built. `bol` tells
+ * whether `I_BOL` holds at the current position.
+ *
+ * Returns 0 if out of memory.
+ */
+static int re_dfa_add(const struct slre_prog *prog, struct slre_state *st,
+                      const struct slre_instruction *pc, int bol,
+                      unsigned int *set, unsigned int *n) {
+  const struct slre_instruction *start = RE_START(prog);
+  struct slre_vm *vm = st->vm;
+  struct slre_bt *bt;
+  size_t sp = 0;
+
+  for (;;) {
+    while (vm->mark[pc - start] != vm->gen) {
+      vm->mark[pc - start] = vm->gen;
+      switch (pc->opcode) {
+        case I_JUMP:
+          pc = start + RE_X(pc);
+          continue;
+        case I_SPLIT:
+          if ((bt = re_bt_push(st, &sp, BT_ALT)) == NULL) return 0;
+          bt->pc = start + RE_Y(pc);
+          pc = start + RE_X(pc);
+          continue;
+        case I_LBRA:
+        case I_RBRA:
+          pc++;
+          continue;
+        case I_BOL:
+          if (bol) {
+            pc++;
+            continue;
+          }
+          break;
+        default:
+          set[(*n)++] = pc - start;
+          break;
+      }
+      break;
+    }
+    if (sp == 0) return 1;
+    pc = st->bt[--sp].pc;
+  }
+}
+
+/*
+ * Returns index of the DFA state with the given set of threads, creating it
+ * if needed; when the cache is full, all the states are dropped first.
+ * Returns -1 if out of memory.
+ */
+static int re_dfa_state(const struct slre_prog *prog, struct slre_vm *vm,
+                        unsigned int *set, unsigned int n) {
+  struct slre_dfa_state *st;
+  unsigned int i, j, tmp;
+
+  /* Sets are small, insertion sort is fine */
+  for (i = 1; i < n; i++) {
+    for (j = i; j > 0 && set[j - 1] > set[j]; j--) {
+      tmp = set[j];
+      set[j] = set[j - 1];
+      set[j - 1] = tmp;
+    }
+  }
+
+  for (i = 0; i < vm->states_cnt; i++) {
+    st = &vm->states[i];
+    if (st->n == n && memcmp(st->pcs, set, n * sizeof(*set)) == 0) {
+      return i;
+    }
+  }
+
+  if (vm->states_cnt == SLRE_DFA_MAX_STATES) {
+    re_dfa_flush(vm);
+  }
+  st = &vm->states[vm->states_cnt];
+  memset(st, 0, sizeof(*st));
+  st->pcs = (unsigned int *) SLRE_MALLOC((n + 1) * sizeof(*set));
+  if (st->pcs == NULL) return -1;
+  memcpy(st->pcs, set, n * sizeof(*set));
+  st->n = n;
+  for (i = 0; i < n; i++) {
+    if (RE_START(prog)[set[i]].opcode == I_END) st->match = 1;
+  }
+  return vm->states_cnt++;
+}
+
+/*
+ * Lazy DFA: states are the sets of Pike VM threads (without captures), built
+ * on demand and cached together with the transitions on ASCII characters.
+ * Only tells whether there is a match. `bol` tells whether `I_BOL` holds at
+ * `current`. Returns 1 on match, 0 on no match, or -1 if out of memory.
+ */
+static int re_dfa(const struct slre_prog *prog, struct slre_state *st,
+                  const char *current, const char *end, unsigned int flags,
+                  int bol) {
+  struct slre_vm *vm = re_vm(prog, st);
+  struct slre_dfa_state *ds;
+  unsigned int *set, n = 0, i, flushes;
+  int s, t;
+  Rune c;
+
+  if (vm == NULL) return -1;
+  if (vm->states == NULL) {
+    vm->states = (struct slre_dfa_state *) SLRE_MALLOC(
+        SLRE_DFA_MAX_STATES * sizeof(struct slre_dfa_state));
+    if (vm->states == NULL) return -1;
+  }
+  /* The second list is not used by the DFA, borrow it for the new sets */
+  set = vm->lists[1].pcs;
+
+  re_vm_next_gen(prog, vm);
+  if (!re_dfa_add(prog, st, RE_START(prog), bol, set, &n) ||
+      (s = re_dfa_state(prog, vm, set, n)) < 0) {
+    return -1;
+  }
+
+  for (;;) {
+    ds = &vm->states[s];
+    if (ds->match) return 1;
+    if (ds->n == 0 || current >= end) return 0;
+
+    current += re_next_rune(&c, current);
+    if (c < 128 && ds->next[c] != 0) {
+      s = ds->next[c] - 1;
+      continue;
+    }
+
+    n = 0;
+    re_vm_next_gen(prog, vm);
+    for (i = 0; i < ds->n; i++) {
+      const struct slre_instruction *pc = RE_START(prog) + ds->pcs[i];
+      /* `I_BOL` checks the previous byte, so only ASCII newlines count */
+      if (re_match_rune(prog, pc, c, flags) &&
+          !re_dfa_add(prog, st, pc + 1,
+                      (flags & SLRE_FLAG_M) && c < 128 && isnewline(c), set,
+                      &n)) {
+        return -1;
+      }
+    }
+
+    flushes = vm->flushes;
+    if ((t = re_dfa_state(prog, vm, set, n)) < 0) return -1;
+    if (c < 128 && flushes == vm->flushes) {
+      vm->states[s].next[c] = t + 1;
+    }
+    s = t;
+  }
+}
+
+/*
+ * Matches the program once, using the native matcher if given, or the
+ * fastest engine which can run the program. Returns 1 on match, 0 otherwise.
+ */
+static int re_exec(const struct slre_prog *prog, slre_native_t native,
+                   struct slre_state *st, const char *current,
+                   const char *end, const char *bol, struct slre_loot *loot) {
+  const struct slre_instruction *start = RE_START(prog);
+  Rune c;
+
+  if (native != NULL) {
+    const char *caps[2 * SLRE_MAX_CAPS];
+    unsigned int i;
+    int res;
+    for (i = 0; i < prog->num_captures; i++) {
+      caps[2 * i] = loot->caps[i].start;
+      caps[2 * i + 1] = loot->caps[i].end;
+    }
+    if ((res = native(current, end, bol, caps)) > 0) {
+      for (i = 0; i < prog->num_captures; i++) {
+        loot->caps[i].start = caps[2 * i];
+        loot->caps[i].end = caps[2 * i + 1];
+      }
+    }
+    if (res >= 0) return res;
+    /* Out of memory: fall back to the interpreter */
+  }
+
+  if (prog->accel != RE_ACCEL_NONE &&
+      (current = re_skip(prog, current, end, bol)) == NULL) {
+    return 0;
+  }
+
+  if (prog->pike) {
+    int res = re_pike(prog, st, current, end, bol, prog->flags, loot);
+    if (res >= 0) return res;
+    /* Out of memory: try backtracking, which needs less */
+  }
+
+  if (prog->accel == RE_ACCEL_NONE) {
+    return re_match(prog, st, start, current, end, bol, prog->flags, loot);
+  }
+
+  /* Instead of the restart loop of the program, try possible starts only */
+  for (;;) {
+    if (re_match(prog, st, start + RE_PC_BODY, current, end, bol, prog->flags,
+                 loot)) {
+      return 1;
+    }
+    if (current >= end) return 0;
+    current += re_next_rune(&c, current);
+    if ((current = re_skip(prog, current, end, bol)) == NULL) return 0;
+  }
+}
+
+/*
+ * Only a damaged image can leave a capture open or inverted: such captures
+ * are dropped, and so is the match if its own capture is one of them
+ */
+static int re_check_caps(const struct slre_prog *prog,
+                         struct slre_loot *loot) {
+  unsigned int i;
+  for (i = 0; i < prog->num_captures; i++) {
+    struct slre_cap *cap = &loot->caps[i];
+    if (cap->start == NULL || cap->end < cap->start) {
+      if (i == 0) return 0;
+      cap->start = cap->end = NULL;
+    }
+  }
+  return 1;
+}
+
+int slre_exec(struct slre_prog *prog, slre_native_t native, int flag_g,
+              const char *start, const char *end, struct slre_loot *loot) {
+  struct slre_loot tmpsub;
+  struct slre_state state;
+  const char *st = start;
+
+  if (!loot) loot = &tmpsub;
+  memset(loot, 0, sizeof(*loot));
+  re_state_init(prog, &state);
 
   if (!flag_g) {
     loot->num_captures = prog->num_captures;
-    return !re_match(prog->start, start, end, start, prog->flags, loot);
+    flag_g = re_exec(prog, native, &state, start, end, start, loot) &&
+             re_check_caps(prog, loot);
+    re_state_free(&state);
+    return !flag_g;
   }
 
-  while (re_match(prog->start, st, end, start, prog->flags, &tmpsub)) {
+  for (;;) {
     unsigned int i;
+    /* Captures of the previous match must not leak into back-references */
+    memset(&tmpsub, 0, sizeof(tmpsub));
+    if (loot->num_captures + prog->num_captures > SLRE_MAX_CAPS ||
+        !re_exec(prog, native, &state, st, end, start, &tmpsub) ||
+        !re_check_caps(prog, &tmpsub)) {
+      break;
+    }
     st = tmpsub.caps[0].end;
     for (i = 0; i < prog->num_captures; i++) {
       struct slre_cap *l = &loot->caps[loot->num_captures + i];
@@ -1414,9 +2645,30 @@ int slre_exec(struct slre_prog *prog, int flag_g, const char *start,
     }
     loot->num_captures += prog->num_captures;
   }
+  re_state_free(&state);
   return !loot->num_captures;
 }
 
+int slre_test(struct slre_prog *prog, slre_native_t native, const char *start,
+              const char *end) {
+  if (prog->dfa && native == NULL) {
+    struct slre_state state;
+    const char *p = start;
+    int res;
+    if (prog->accel != RE_ACCEL_NONE &&
+        (p = re_skip(prog, start, end, start)) == NULL) {
+      return 1;
+    }
+    re_state_init(prog, &state);
+    res = re_dfa(prog, &state, p, end, prog->flags,
+                 p == start ||
+                     ((prog->flags & SLRE_FLAG_M) && isnewline(p[-1])));
+    re_state_free(&state);
+    if (res >= 0) return !res;
+  }
+  return slre_exec(prog, native, 0, start, end, NULL);
+}
+
 int slre_replace(struct slre_loot *loot, const char *src, size_t src_len,
                  const char *rstr, size_t rstr_len, struct slre_loot *dstsub) {
   int size = 0, n;
@@ -1500,7 +2752,8 @@ int slre_match(const char *re, size_t re_len, const char *flags, size_t fl_len,
   int res;
 
   if ((res = slre_compile(re, re_len, flags, fl_len, &prog, 1)) == SLRE_OK) {
-    res = slre_exec(prog, prog->flags & SLRE_FLAG_G, str, str + str_len, loot);
+    res = slre_exec(prog, NULL, prog->flags & SLRE_FLAG_G, str, str + str_len,
+                    loot);
     slre_free(prog);
   }
 
@@ -1516,7 +2769,7 @@ int slre_get_flags(struct slre_prog *crp) {
 #include <errno.h>
 
 static const char *err_code_to_str(int err_code) {
-  static const char *ar[] = {
+  static const char *const ar[] = {
       "no error", "invalid decimal digit", "invalid hex digit",
       "invalid escape character", "invalid unterminated escape sequence",
       "syntax error", "unmatched left parenthesis",
@@ -1524,10 +2777,10 @@ static const char *err_code_to_str(int err_code) {
       "infinite loop empty string", "too many charsets",
       "invalid charset range", "charset is too large", "malformed charset",
       "invalid back reference", "too many captures", "invalid quantifier",
-      "bad character after $"};
+      "bad character after $", "bad program image"};
 
   typedef char static_assertion_err_codes_out_of_sync
-      [2 * !!(((sizeof(ar) / sizeof(ar[0])) == SLRE_BAD_CHAR_AFTER_USD + 1)) -
+      [2 * !!(((sizeof(ar) / sizeof(ar[0])) == SLRE_BAD_IMAGE + 1)) -
        1];
 
   return err_code >= 0 && err_code < (int) (sizeof(ar) / sizeof(ar[0]))
@@ -1562,6 +2815,283 @@ static unsigned get_flags(const char *ch) {
   return flags;
 }
 
+/*
+ * Code generator for the `-c` option: emits a C function of the type
+ * `slre_native_t` which runs the given program like `re_match()` does, with
+ * each instruction turned into inline code and the flags resolved at
+ * generation time; counters of `I_REP` become local variables. Lookaheads are
+ * not supported. Returns 0 on success, or -1 if the program can't be
+ * translated.
+ */
+static int re_gen_c(const struct slre_prog *prog, const char *name,
+                    const char *pattern, const char *flags, FILE *fp) {
+  const struct slre_instruction *start = RE_START(prog), *pc;
+  const struct slre_instruction *end = start + RE_GET32(prog->ninst);
+  const unsigned char *set;
+  unsigned int fl = prog->flags;
+  int n = end - start;
+  char *target = (char *) calloc(n + 1, 1), *alt = (char *) calloc(n + 1, 1);
+  int i, j, eq = 0, fold = 0;
+
+  if (target == NULL || alt == NULL) {
+    free(target);
+    free(alt);
+    return -1;
+  }
+
+  /* Find out which instructions need labels, and check opcodes */
+  for (pc = start; pc < end; pc++) {
+    switch (pc->opcode) {
+      case I_LA:
+      case I_LA_N:
+        free(target);
+        free(alt);
+        return -1;
+      case I_SET:
+      case I_SET_N:
+        set = RE_SET(prog, pc);
+        for (j = 0; j < set[0]; j++) {
+          if (RE_SET_E(set, j) >= Runeself) eq = fold = 1;
+        }
+        break;
+      case I_REF:
+        eq = 1;
+        break;
+      case I_CH:
+        if ((int) RE_X(pc) >= Runeself) eq = 1;
+        break;
+      case I_REP:
+        target[pc + 2 - start] = 1;
+        target[RE_X(pc)] = 1;
+        break;
+      case I_SPLIT:
+        target[RE_Y(pc)] = 1;
+        alt[RE_Y(pc)] = 1;
+      /* fallthrough */
+      case I_JUMP:
+        target[RE_X(pc)] = 1;
+        break;
+    }
+  }
+
+  fprintf(fp, "/* Generated by `slre -p '%s' -o '%s' -c %s`, do not edit */\n\n",
+          pattern, flags, name);
+  fprintf(fp, "#include <ctype.h>\n#include <stdlib.h>\n#include <string.h>\n");
+  fprintf(fp, "#include \"common/utf.h\"\n\n");
+  fprintf(fp, "struct %s_bt {\n  const char **cap;\n  const char *p;\n", name);
+  fprintf(fp, "  int pc;\n};\n\n");
+  fprintf(fp,
+          "static int %s_grow(struct %s_bt **bt, struct %s_bt *bt0, "
+          "size_t *size) {\n",
+          name, name, name);
+  fprintf(fp, "  struct %s_bt *res;\n", name);
+  fprintf(fp, "  if (*bt == bt0) {\n");
+  fprintf(fp, "    res = (struct %s_bt *) malloc(*size * 2 * sizeof(*res));\n",
+          name);
+  fprintf(fp, "    if (res != NULL) memcpy(res, bt0, *size * sizeof(*res));\n");
+  fprintf(fp, "  } else {\n");
+  fprintf(fp,
+          "    res = (struct %s_bt *) realloc(*bt, *size * 2 * "
+          "sizeof(*res));\n",
+          name);
+  fprintf(fp, "  }\n  if (res == NULL) return 0;\n");
+  fprintf(fp, "  *bt = res;\n  *size *= 2;\n  return 1;\n}\n\n");
+  if ((fl & SLRE_FLAG_I) && eq) {
+    /* Same as `re_fold_eq()` */
+    fprintf(fp, "static int %s_eq(Rune a, Rune b) {\n", name);
+    fprintf(fp, "  if (a == b) return 1;\n");
+    fprintf(fp, "  if (a < %d && b < %d) return tolower(a) == tolower(b);\n",
+            Runeself, Runeself);
+    fprintf(fp, "  if (a < %d || b < %d) return 0;\n", Runeself, Runeself);
+    fprintf(fp, "  return tolowerrune(a) == tolowerrune(b);\n}\n\n");
+  }
+  if ((fl & SLRE_FLAG_I) && fold) {
+    fprintf(fp, "static int %s_fold(Rune c, Rune s, Rune e) {\n", name);
+    fprintf(fp, "  unsigned int r;\n");
+    fprintf(fp, "  for (r = s; r <= e; r++)\n");
+    fprintf(fp, "    if (%s_eq(c, (Rune) r)) return 1;\n", name);
+    fprintf(fp, "  return 0;\n}\n\n");
+  }
+
+  fprintf(fp,
+          "int %s(const char *p, const char *end, const char *bol,\n"
+          "    const char **caps) {\n",
+          name);
+  fprintf(fp, "  struct %s_bt bt0[32], *bt = bt0;\n", name);
+  fprintf(fp, "  size_t sp = 0, size = 32;\n");
+  fprintf(fp, "  const char *sub[%u];\n", 2 * prog->num_captures);
+  for (pc = start; pc < end; pc++) {
+    if (pc->opcode == I_REP) {
+      i = pc - start;
+      fprintf(fp, "  unsigned short rep%d_min = 0, rep%d_max = 0;\n", i, i);
+    }
+  }
+  fprintf(fp, "  Rune c;\n  int res;\n\n");
+  fprintf(fp, "  (void) c;\n  (void) bol;\n");
+  fprintf(fp, "  memcpy(sub, caps, sizeof(sub));\n\n");
+
+  for (pc = start; pc < end; pc++) {
+    i = pc - start;
+    if (target[i]) fprintf(fp, "L%d:\n", i);
+    switch (pc->opcode) {
+      case I_END:
+        fprintf(fp, "  memcpy(caps, sub, sizeof(sub));\n");
+        fprintf(fp, "  res = 1;\n  goto done;\n");
+        break;
+
+      case I_CH:
+        if ((int) RE_X(pc) == 0) {
+          /* NUL never matches, see `re_match_rune()` */
+          fprintf(fp, "  goto fail;\n");
+          break;
+        } else if ((int) RE_X(pc) < Runeself &&
+                   (!(fl & SLRE_FLAG_I) || !isalpha((int) RE_X(pc)))) {
+          fprintf(fp, "  if (p >= end || *p != %d) goto fail;\n  p++;\n",
+                  (int) RE_X(pc));
+          break;
+        }
+      /* fallthrough */
+      case I_ANY:
+      case I_ANYNL:
+      case I_SET:
+      case I_SET_N:
+        fprintf(fp, "  if (p >= end) goto fail;\n");
+        fprintf(fp, "  if ((unsigned char) *p < %d) {\n", Runeself);
+        fprintf(fp, "    c = (unsigned char) *p++;\n");
+        fprintf(fp, "  } else {\n    p += chartorune(&c, p);\n  }\n");
+        fprintf(fp, "  if (!c");
+        if (pc->opcode == I_ANY) {
+          fprintf(fp, " || isnewline(c)");
+        } else if (pc->opcode == I_CH) {
+          fprintf(fp, " || (c != %d", (int) RE_X(pc));
+          if (fl & SLRE_FLAG_I) {
+            if ((int) RE_X(pc) < Runeself) {
+              fprintf(fp, " && (c >= %d || tolower(c) != %d)", Runeself,
+                      tolower((int) RE_X(pc)));
+            } else {
+              fprintf(fp, " && !%s_eq(c, %d)", name, (int) RE_X(pc));
+            }
+          }
+          fprintf(fp, ")");
+        } else if (pc->opcode == I_SET || pc->opcode == I_SET_N) {
+          fprintf(fp, " || %s(0", pc->opcode == I_SET ? "!" : "");
+          set = RE_SET(prog, pc);
+          for (j = 0; j < set[0]; j++) {
+            int s = RE_SET_S(set, j), e = RE_SET_E(set, j);
+            if ((fl & SLRE_FLAG_I) && e < Runeself) {
+              fprintf(fp,
+                      "\n      || (c < %d && ((tolower(c) >= %d && tolower(c) <= "
+                      "%d) || (toupper(c) >= %d && toupper(c) <= %d)))",
+                      Runeself, s, e, s, e);
+            } else if (fl & SLRE_FLAG_I) {
+              fprintf(fp, "\n      || %s_fold(c, %d, %d)", name, s, e);
+            } else {
+              fprintf(fp, "\n      || (c >= %d && c <= %d)", s, e);
+            }
+          }
+          fprintf(fp, ")");
+        }
+        fprintf(fp, ") {\n    goto fail;\n  }\n");
+        break;
+
+      case I_BOL:
+        fprintf(fp, "  if (p != bol%s) goto fail;\n",
+                fl & SLRE_FLAG_M ? " && !isnewline(p[-1])" : "");
+        break;
+      case I_EOL:
+        fprintf(fp, "  if (p < end%s) goto fail;\n",
+                fl & SLRE_FLAG_M ? " && !isnewline(*p)" : "");
+        break;
+      case I_EOS:
+        fprintf(fp, "  if (p < end) goto fail;\n");
+        break;
+      case I_WORD:
+      case I_WORD_N:
+        fprintf(fp, "  if ((p > bol && iswordchar(p[-1])) %s iswordchar(p[0])) "
+                    "goto fail;\n",
+                pc->opcode == I_WORD ? "==" : "!=");
+        break;
+
+      case I_JUMP:
+        fprintf(fp, "  goto L%d;\n", (int) RE_X(pc));
+        break;
+
+      case I_LBRA:
+      case I_RBRA:
+        i = 2 * pc->n + (pc->opcode == I_RBRA);
+        fprintf(fp, "  if (sp > 0) {\n");
+        fprintf(fp,
+                "    if (sp == size && !%s_grow(&bt, bt0, &size)) goto oom;\n",
+                name);
+        fprintf(fp, "    bt[sp].cap = &sub[%d];\n", i);
+        fprintf(fp, "    bt[sp++].p = sub[%d];\n  }\n", i);
+        fprintf(fp, "  sub[%d] = p;\n", i);
+        break;
+
+      case I_REF:
+        i = 2 * pc->n;
+        fprintf(fp, "  {\n    size_t n = sub[%d] - sub[%d];\n", i + 1, i);
+        if (fl & SLRE_FLAG_I) {
+          fprintf(fp, "    size_t num = n;\n");
+          fprintf(fp, "    const char *s = p, *q = sub[%d];\n", i);
+          fprintf(fp, "    Rune r, rr;\n");
+          fprintf(fp, "    for (; num && *s && *q; num--) {\n");
+          fprintf(fp, "      s += chartorune(&r, s);\n");
+          fprintf(fp, "      q += chartorune(&rr, q);\n");
+          fprintf(fp, "      if (!%s_eq(r, rr)) break;\n", name);
+          fprintf(fp, "    }\n    if (num) goto fail;\n");
+        } else {
+          fprintf(fp, "    if (n > 0 && strncmp(p, sub[%d], n)) goto fail;\n",
+                  i);
+        }
+        fprintf(fp, "    p += n;\n  }\n");
+        break;
+
+      case I_REP:
+        fprintf(fp, "  if (rep%d_min) {\n    rep%d_min--;\n    goto L%d;\n", i, i,
+                i + 2);
+        fprintf(fp, "  } else if (!rep%d_max--) {\n    goto L%d;\n  }\n", i,
+                (int) RE_X(pc));
+        break;
+
+      case I_REP_INI:
+        fprintf(fp, "  rep%d_min = %d;\n  rep%d_max = %d;\n", i + 1,
+                (int) RE_X(pc), i + 1, (int) RE_Y(pc));
+        break;
+
+      case I_SPLIT:
+        fprintf(fp, "  if (sp == size && !%s_grow(&bt, bt0, &size)) goto oom;\n",
+                name);
+        fprintf(fp, "  bt[sp].cap = NULL;\n  bt[sp].p = p;\n");
+        fprintf(fp, "  bt[sp++].pc = %d;\n",
+                (int) RE_Y(pc));
+        fprintf(fp, "  goto L%d;\n", (int) RE_X(pc));
+        break;
+
+      default:
+        fprintf(fp, "  goto fail;\n");
+        break;
+    }
+  }
+
+  fprintf(fp, "\nfail:\n  for (;;) {\n");
+  fprintf(fp, "    if (sp == 0) {\n      res = 0;\n      goto done;\n    }\n");
+  fprintf(fp, "    sp--;\n");
+  fprintf(fp, "    if (bt[sp].cap != NULL) {\n");
+  fprintf(fp, "      *bt[sp].cap = bt[sp].p;\n      continue;\n    }\n");
+  fprintf(fp, "    p = bt[sp].p;\n    switch (bt[sp].pc) {\n");
+  for (i = 0; i < n; i++) {
+    if (alt[i]) fprintf(fp, "      case %d:\n        goto L%d;\n", i, i);
+  }
+  fprintf(fp, "    }\n  }\n\n");
+  fprintf(fp, "oom:\n  res = -1;\n\ndone:\n");
+  fprintf(fp, "  if (bt != bt0) free(bt);\n  return res;\n}\n");
+
+  free(target);
+  free(alt);
+  return 0;
+}
+
 static void show_usage_and_exit(char *argv[]) {
   fprintf(stderr, "Usage: %s [OPTIONS]\n", argv[0]);
   fprintf(stderr, "%s\n", "OPTIONS:");
@@ -1572,6 +3102,7 @@ static void show_usage_and_exit(char *argv[]) {
   fprintf(stderr, "%s\n", "  -n <cap_no>            Show given capture");
   fprintf(stderr, "%s\n", "  -r <replace_str>       Replace given capture");
   fprintf(stderr, "%s\n", "  -v                     Show verbose stats");
+  fprintf(stderr, "%s\n", "  -c <func_name>         Print C code of matcher");
   exit(1);
 }
 
@@ -1583,8 +3114,8 @@ static int process_line(struct slre_prog *pr, const char *flags,
   int i, n = cap_no == NULL ? -1 : atoi(cap_no), err_code = 0;
   struct slre_cap *cap = &loot.caps[n];
 
-  err_code =
-      slre_exec(pr, pr->flags & SLRE_FLAG_G, line, line + strlen(line), &loot);
+  err_code = slre_exec(pr, NULL, pr->flags & SLRE_FLAG_G, line,
+                       line + strlen(line), &loot);
   if (err_code == SLRE_OK) {
     if (n >= 0 && n < loot.num_captures && replace != NULL) {
       struct slre_cap *cap = &loot.caps[n];
@@ -1611,6 +3142,7 @@ static int process_line(struct slre_prog *pr, const char *flags,
 int main(int argc, char **argv) {
   const char *str = NULL, *pattern = NULL, *replace = NULL;
   const char *flags = "", *file_name = NULL, *cap_no = NULL, *verbose = NULL;
+  const char *func_name = NULL;
   struct slre_prog *pr = NULL;
   int i, err_code = 0;
 
@@ -1630,6 +3162,8 @@ int main(int argc, char **argv) {
       replace = argv[++i];
     } else if (strcmp(argv[i], "-v") == 0) {
       verbose = "";
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      func_name = argv[++i];
     } else if (strcmp(argv[i], "-h") == 0) {
       show_usage_and_exit(argv);
     } else {
@@ -1645,6 +3179,11 @@ int main(int argc, char **argv) {
     fprintf(stderr, "slre_compile(%s): %s\n", argv[0],
             err_code_to_str(err_code));
     exit(1);
+  } else if (func_name != NULL) {
+    if (re_gen_c(pr, func_name, pattern, flags, stdout) != 0) {
+      fprintf(stderr, "%s\n", "Lookaheads are not supported by -c");
+      err_code = 1;
+    }
   } else if (str != NULL) {
     err_code = process_line(pr, flags, str, cap_no, replace, verbose);
   } else if (file_name != NULL) {
@@ -38,7 +38,8 @@ enum slre_error {
   SLRE_INVALID_BACK_REFERENCE,
   SLRE_TOO_MANY_CAPTURES,
   SLRE_INVALID_QUANTIFIER,
-  SLRE_BAD_CHAR_AFTER_USD
+  SLRE_BAD_CHAR_AFTER_USD,
+  SLRE_BAD_IMAGE
 };
 
 #if V7_ENABLE__RegExp
@@ -69,12 +70,54 @@ struct slre_loot {
 /* Opaque structure that holds compiled regular expression */
 struct slre_prog;
 
+/*
+ * Native matcher, generated from a regex by the standalone `slre` tool (see
+ * `-c` option). Matches like the backtracking interpreter does from the
+ * position `p` of the text which started at `bol`, i.e. looks for the
+ * leftmost match with the same captures. `caps` holds start and end of each
+ * capture and is updated only on match. Returns 1 on match, 0 if there's no
+ * match, or -1 if out of memory.
+ */
+typedef int (*slre_native_t)(const char *p, const char *end, const char *bol,
+                             const char **caps);
+
 int slre_compile(const char *regexp, size_t regexp_len, const char *flags,
                  size_t flags_len, struct slre_prog **, int is_regex);
-int slre_exec(struct slre_prog *prog, int flag_g, const char *start,
-              const char *end, struct slre_loot *loot);
+/*
+ * Matches the program. If `native` is not NULL, it is run instead of
+ * interpreting the program; it should be generated from the same regex and
+ * flags.
+ */
+int slre_exec(struct slre_prog *prog, slre_native_t native, int flag_g,
+              const char *start, const char *end, struct slre_loot *loot);
+/*
+ * Like `slre_exec()` without captures: returns 0 if there is a match, 1
+ * otherwise. Faster for the patterns the lazy DFA can run.
+ */
+int slre_test(struct slre_prog *prog, slre_native_t native, const char *start,
+              const char *end);
+/*
+ * Compiled programs are reference counted: `slre_retain()` adds a reference,
+ * `slre_free()` drops one and frees the program when none is left. Both do
+ * nothing for loaded programs.
+ */
+struct slre_prog *slre_retain(struct slre_prog *prog);
 void slre_free(struct slre_prog *prog);
 
+/*
+ * Writes the image of the program to `buf` of `size` bytes (nothing is
+ * written if it doesn't fit) and returns the image size. The image is
+ * position-independent and needs no alignment.
+ */
+size_t slre_dump(const struct slre_prog *prog, char *buf, size_t size);
+/*
+ * Checks the image and makes it a program, which runs in place without
+ * parsing or analysing the source again, and without allocating memory for
+ * the program: the image, e.g. in ROM, must outlive the program. Returns
+ * `SLRE_OK` or `SLRE_BAD_IMAGE`.
+ */
+int slre_load(const char *image, size_t len, struct slre_prog **pr);
+
 int slre_match(const char *, size_t, const char *, size_t, const char *, size_t,
                struct slre_loot *);
 int slre_replace(struct slre_loot *loot, const char *src, size_t src_len,
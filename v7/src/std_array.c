@@ -107,18 +107,19 @@ V7_PRIVATE enum v7_err Array_set_length(struct v7 *v7, v7_val_t *res) {
     rcode = v7_throwf(v7, RANGE_ERROR, "Invalid array length");
     goto clean;
   } else {
+    struct v7_object *o = get_object_struct(this_obj);
     struct v7_property **p, **next;
     long index, max_index = -1;
 
     /* Remove all items with an index higher than new_len */
-    for (p = &get_object_struct(this_obj)->properties; *p != NULL; p = next) {
-      size_t n;
-      const char *s = v7_get_string(v7, &p[0]->name, &n);
+    for (p = &o->properties; *p != NULL; p = next) {
       next = &p[0]->next;
-      index = strtol(s, NULL, 10);
+      if (!v7_is_number(p[0]->name)) {
+        continue;
+      }
+      index = (long) v7_get_double(v7, p[0]->name);
       if (index >= new_len) {
-        v7_destroy_property(p);
-        *p = *next;
+        obj_unlink_property(v7, o, p);
         next = p;
       } else if (index > max_index) {
         max_index = index;
@@ -456,25 +457,24 @@ static enum v7_err a_splice(struct v7 *v7, int mutate, v7_val_t *res) {
     abuf->len -= (arg1 - arg0) * sizeof(val_t);
   } else if (mutate) {
     /* If splicing, modify this_obj array: remove spliced sub-array */
+    struct v7_object *o = get_object_struct(this_obj);
     struct v7_property **p, **next;
     long i;
 
-    for (p = &get_object_struct(this_obj)->properties; *p != NULL; p = next) {
-      size_t n;
-      const char *s = v7_get_string(v7, &p[0]->name, &n);
+    for (p = &o->properties; *p != NULL; p = next) {
       next = &p[0]->next;
-      i = strtol(s, NULL, 10);
+      if (!v7_is_number(p[0]->name)) {
+        continue;
+      }
+      i = (long) v7_get_double(v7, p[0]->name);
       if (i >= arg0 && i < arg1) {
         /* Remove items from spliced sub-array */
-        v7_destroy_property(p);
-        *p = *next;
+        obj_unlink_property(v7, o, p);
         next = p;
       } else if (i >= arg1) {
         /* Modify indices of the elements past sub-array */
-        char key[20];
-        size_t n = c_snprintf(key, sizeof(key), "%ld",
+        obj_set_element_index(v7, o, p[0],
                               i - (arg1 - arg0) + elems_to_insert);
-        p[0]->name = v7_mk_string(v7, key, n, 1);
       }
     }
 
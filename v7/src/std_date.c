@@ -64,8 +64,14 @@ struct timeparts {
   int dayofweek; /* 0-6 */
 };
 
-static etimeint_t g_gmtoffms; /* timezone offset, ms, no DST */
-static const char *g_tzname;  /* current timezone name */
+/*
+ * Timezone offset, ms, no DST. It's read from the C library each time instead
+ * of being cached in a global, so that instances on different threads don't
+ * race; the C library is initialized with `tzset()` in `init_date()`.
+ */
+static etimeint_t d_gmtoffms(void) {
+  return (etimeint_t) timezone * msPerSecond;
+}
 
 /* Leap year formula copied from ECMA 5.1 standart as is */
 static int ecma_DaysInYear(int y) {
@@ -95,8 +101,8 @@ static int ecma_IsLeapYear(int year) {
   return ecma_DaysInYear(year) == 366;
 }
 
-static int *ecma_getfirstdays(int isleap) {
-  static int sdays[2][MonthsInYear + 1] = {
+static const int *ecma_getfirstdays(int isleap) {
+  static const int sdays[2][MonthsInYear + 1] = {
       {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365},
       {0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335, 366}};
 
@@ -105,17 +111,22 @@ static int *ecma_getfirstdays(int isleap) {
 
 static int ecma_DaylightSavingTA(etime_t t) {
   time_t time = t / 1000;
+  struct tm tm;
   /*
-   * Win32 doesn't have locatime_r
-   * nixes don't have localtime_s
-   * as result using localtime
+   * Win32 doesn't have locatime_r, nixes don't have localtime_s; plain
+   * localtime uses a static buffer, which is not safe for threads
    */
-  struct tm *tm = localtime(&time);
-  if (tm == NULL) {
+#ifdef _WIN32
+  if (localtime_s(&tm, &time) != 0) {
     /* doesn't work on windows for times before epoch */
     return 0;
   }
-  if (tm->tm_isdst > 0) {
+#else
+  if (localtime_r(&time, &tm) == NULL) {
+    return 0;
+  }
+#endif
+  if (tm.tm_isdst > 0) {
     return msPerHour;
   } else {
     return 0;
@@ -123,7 +134,7 @@ static int ecma_DaylightSavingTA(etime_t t) {
 }
 
 static int ecma_LocalTZA() {
-  return (int) -g_gmtoffms;
+  return (int) -d_gmtoffms();
 }
 
 static etimeint_t ecma_UTC(etime_t t) {
@@ -170,7 +181,8 @@ static int ecma_DayWithinYear(etime_t t, int year) {
 }
 
 static int ecma_MonthFromTime(etime_t t, int year) {
-  int *days, i;
+  const int *days;
+  int i;
   etimeint_t dwy = ecma_DayWithinYear(t, year);
 
   days = ecma_getfirstdays(ecma_IsLeapYear(year));
@@ -185,8 +197,8 @@ static int ecma_MonthFromTime(etime_t t, int year) {
 }
 
 static int ecma_DateFromTime(etime_t t, int year) {
-  int *days, mft = ecma_MonthFromTime(t, year),
-             dwy = ecma_DayWithinYear(t, year);
+  const int *days;
+  int mft = ecma_MonthFromTime(t, year), dwy = ecma_DayWithinYear(t, year);
 
   if (mft > 11) {
     return -1;
@@ -253,7 +265,7 @@ static etimeint_t ecma_MakeTime(etimeint_t hour, etimeint_t min, etimeint_t sec,
 }
 
 static etimeint_t ecma_MakeDay(int year, int month, int date) {
-  int *days;
+  const int *days;
   etimeint_t yday, mday;
 
   year += floor(month / 12);
@@ -327,10 +339,11 @@ static int d_iscalledasfunction(struct v7 *v7, val_t this_obj) {
 }
 #endif
 
-static const char *mon_name[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
-                                 "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+static const char *const mon_name[] = {"Jan", "Feb", "Mar", "Apr",
+                                       "May", "Jun", "Jul", "Aug",
+                                       "Sep", "Oct", "Nov", "Dec"};
 
-int d_getnumbyname(const char **arr, int arr_size, const char *str) {
+int d_getnumbyname(const char *const *arr, int arr_size, const char *str) {
   int i;
   for (i = 0; i < arr_size; i++) {
     if (strncmp(arr[i], str, 3) == 0) {
@@ -781,8 +794,8 @@ static enum v7_err d_tostring(struct v7 *v7, val_t obj,
   }
 
 /* non-locale function should always return in english and 24h-format */
-static const char *wday_name[] = {"Sun", "Mon", "Tue", "Wed",
-                                  "Thu", "Fri", "Sat"};
+static const char *const wday_name[] = {"Sun", "Mon", "Tue", "Wed",
+                                        "Thu", "Fri", "Sat"};
 
 static int d_tptodatestr(const struct timeparts *tp, char *buf, int addtz) {
   (void) addtz;
@@ -793,8 +806,9 @@ static int d_tptodatestr(const struct timeparts *tp, char *buf, int addtz) {
 
 DEF_TOSTR(DateString, d_localtime, d_tptodatestr, 1)
 
+/* Current timezone name */
 static const char *d_gettzname() {
-  return g_tzname;
+  return tzname[0];
 }
 
 static int d_tptotimestr(const struct timeparts *tp, char *buf, int addtz) {
@@ -802,9 +816,9 @@ static int d_tptotimestr(const struct timeparts *tp, char *buf, int addtz) {
 
   len = sprintf(buf, "%02d:%02d:%02d GMT", tp->hour, tp->min, tp->sec);
 
-  if (addtz && g_gmtoffms != 0) {
-    len = sprintf(buf + len, "%c%02d00 (%s)", g_gmtoffms > 0 ? '-' : '+',
-                  abs((int) g_gmtoffms / msPerHour), d_gettzname());
+  if (addtz && d_gmtoffms() != 0) {
+    len = sprintf(buf + len, "%c%02d00 (%s)", d_gmtoffms() > 0 ? '-' : '+',
+                  abs((int) d_gmtoffms() / msPerHour), d_gettzname());
   }
 
   return (int) strlen(buf);
@@ -952,7 +966,7 @@ V7_PRIVATE enum v7_err Date_getTime(struct v7 *v7, v7_val_t *res) {
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err Date_getTimezoneOffset(struct v7 *v7, v7_val_t *res) {
   (void) v7;
-  *res = v7_mk_number(v7, g_gmtoffms / msPerMinute);
+  *res = v7_mk_number(v7, d_gmtoffms() / msPerMinute);
   return V7_OK;
 }
 #endif /* V7_ENABLE__Date__getters */
@@ -1166,20 +1180,10 @@ V7_PRIVATE void init_date(struct v7 *v7) {
 #endif
 
   /*
-   * GTM offset without DST
-   * TODO(alashkin): check this
-   * Could be changed to tm::tm_gmtoff,
-   * but tm_gmtoff includes DST, so
-   * side effects are possible
-   */
-  tzset();
-  g_gmtoffms = timezone * msPerSecond;
-  /*
-   * tzname could be changed by localtime_r call,
-   * so we have to store pointer
+   * Initialize `timezone` and `tzname`, see `d_gmtoffms()`
    * TODO(alashkin): need restart on tz change???
    */
-  g_tzname = tzname[0];
+  tzset();
 }
 
 #if defined(__cplusplus)
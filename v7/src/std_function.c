@@ -8,6 +8,7 @@
 #include "v7/src/core.h"
 #include "v7/src/function.h"
 #include "v7/src/bcode.h"
+#include "v7/src/compiler.h"
 #include "v7/src/eval.h"
 #include "v7/src/conversion.h"
 #include "v7/src/object.h"
@@ -84,6 +85,11 @@ V7_PRIVATE enum v7_err Function_length(struct v7 *v7, v7_val_t *res) {
 
   func = get_js_function_struct(this_obj);
 
+  rcode = compile_lazy_function(v7, func->bcode);
+  if (rcode != V7_OK) {
+    goto clean;
+  }
+
   *res = v7_mk_number(v7, func->bcode->args_cnt);
 
 clean:
@@ -108,6 +114,11 @@ V7_PRIVATE enum v7_err Function_name(struct v7 *v7, v7_val_t *res) {
 
   assert(func->bcode != NULL);
 
+  rcode = compile_lazy_function(v7, func->bcode);
+  if (rcode != V7_OK) {
+    goto clean;
+  }
+
   assert(func->bcode->names_cnt >= 1);
   bcode_next_name_v(v7, func->bcode, func->bcode->ops.p, res);
 
@@ -150,6 +161,12 @@ V7_PRIVATE enum v7_err Function_toString(struct v7 *v7, v7_val_t *res) {
   b += c_snprintf(b, BUF_LEFT(sizeof(buf), b - buf), "[function");
 
   assert(func->bcode != NULL);
+
+  rcode = compile_lazy_function(v7, func->bcode);
+  if (rcode != V7_OK) {
+    goto clean;
+  }
+
   ops = func->bcode->ops.p;
 
   /* first entry in name list */
@@ -195,6 +212,7 @@ V7_PRIVATE enum v7_err Function_toString(struct v7 *v7, v7_val_t *res) {
 
   *res = v7_mk_string(v7, buf, strlen(buf), 1);
 
+clean:
   return rcode;
 }
 
@@ -60,7 +60,7 @@ static void _Obj_append_reverse(struct v7 *v7, struct v7_property *p, val_t res,
   if (p == NULL) return;
   if (p->next) _Obj_append_reverse(v7, p->next, res, i + 1, ignore_flags);
 
-  v7_array_set(v7, res, i, p->name);
+  v7_array_set(v7, res, i, prop_name_to_string(v7, p->name));
 }
 
 WARN_UNUSED_RESULT
@@ -281,7 +281,8 @@ static enum v7_err o_define_props(struct v7 *v7, val_t obj, val_t descs,
 
   for (p = get_object_struct(descs)->properties; p; p = p->next) {
     size_t n;
-    const char *s = v7_get_string(v7, &p->name, &n);
+    char ibuf[V7_INDEX_BUF_SIZE];
+    const char *s = prop_name_get_string(v7, &p->name, ibuf, &n);
     if (p->attributes & (_V7_PROPERTY_HIDDEN | V7_PROPERTY_NON_ENUMERABLE)) {
       continue;
     }
@@ -520,7 +521,7 @@ static enum v7_err is_rigid(struct v7 *v7, v7_val_t *res, int is_frozen) {
   if (get_object_struct(arg)->attributes & V7_OBJ_NOT_EXTENSIBLE) {
     void *h = NULL;
     v7_prop_attr_t attrs;
-    while ((h = v7_next_prop(h, arg, NULL, NULL, &attrs)) != NULL) {
+    while ((h = obj_next_prop(h, arg, NULL, NULL, &attrs)) != NULL) {
       if (!(attrs & V7_PROPERTY_NON_CONFIGURABLE)) {
         goto clean;
       }
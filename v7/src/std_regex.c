@@ -192,6 +192,40 @@ clean:
   return rcode;
 }
 
+/*
+ * Returns byte offset of the character `rp->lastIndex` in the string `s`
+ * (given its data `str` of `len` bytes), or -1 if it's past the end. The
+ * offset left by the previous match is reused, so iterating over matches
+ * doesn't count characters from the start of the string each time.
+ */
+static long rx_last_index_offset(struct v7 *v7, struct v7_regexp *rp, val_t s,
+                                 const char *str, size_t len) {
+  if (rp->last_str != s || rp->last_str_epoch != v7->str_epoch) {
+    rp->last_str = s;
+    rp->last_str_epoch = v7->str_epoch;
+    rp->last_str_ascii = s_char_len(v7, s, str, len) == len;
+    rp->last_char_index = -1;
+  }
+
+  if (rp->last_char_index != rp->lastIndex) {
+    size_t idx = (size_t) rp->lastIndex;
+    if (rp->last_str_ascii) {
+      if (idx > len) return -1;
+      rp->last_byte_offset = idx;
+    } else {
+      if (idx > s_char_len(v7, s, str, len)) return -1;
+      rp->last_byte_offset = s_char_ptr(v7, s, str, len, idx) - str;
+    }
+    rp->last_char_index = rp->lastIndex;
+  }
+  return (long) rp->last_byte_offset;
+}
+
+/* Returns number of characters in the matched string data */
+static size_t rx_char_cnt(struct v7_regexp *rp, const char *p, size_t n) {
+  return rp->last_str_ascii ? n : s_utf_len(p, n);
+}
+
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err rx_exec(struct v7 *v7, val_t rx, val_t vstr, int lind,
                                val_t *res) {
@@ -206,6 +240,7 @@ V7_PRIVATE enum v7_err rx_exec(struct v7 *v7, val_t rx, val_t vstr, int lind,
     const char *begin = NULL;
     struct v7_regexp *rp = v7_get_regexp_struct(v7, rx);
     int flag_g = slre_get_flags(rp->compiled_regexp) & SLRE_FLAG_G;
+    long offset = 0;
 
     rcode = to_string(v7, vstr, &s, NULL, 0, NULL);
     if (rcode != V7_OK) {
@@ -216,22 +251,42 @@ V7_PRIVATE enum v7_err rx_exec(struct v7 *v7, val_t rx, val_t vstr, int lind,
     begin = str;
 
     if (rp->lastIndex < 0) rp->lastIndex = 0;
-    if (flag_g || lind) begin = utfnshift(str, rp->lastIndex);
+    if (flag_g || lind) {
+      offset = rx_last_index_offset(v7, rp, s, str, len);
+      begin = str + offset;
+    }
 
-    if (!slre_exec(rp->compiled_regexp, 0, begin, end, &sub)) {
+    if (offset >= 0 &&
+        !slre_exec(rp->compiled_regexp, rp->native, 0, begin, end, &sub)) {
       int i;
       val_t arr = v7_mk_array(v7);
-      char *old_mbuf_base = v7->owned_strings.buf;
-      ptrdiff_t rel = 0; /* creating strings might relocate the mbuf */
+      size_t index;
+
+      /* Count characters from `lastIndex` rather than from the beginning */
+      if (flag_g || lind) {
+        index = rp->lastIndex +
+                rx_char_cnt(rp, begin, sub.caps->start - begin);
+      } else {
+        index = s_char_index(v7, s, str, len, sub.caps->start);
+      }
+      if (flag_g) {
+        rp->lastIndex =
+            index + rx_char_cnt(rp, sub.caps->start,
+                                sub.caps->end - sub.caps->start);
+        rp->last_char_index = rp->lastIndex;
+        rp->last_byte_offset = sub.caps->end - str;
+      }
 
+      /* Creating strings might relocate the data, so use offsets */
       for (i = 0; i < sub.num_captures; i++, ptok++) {
-        rel = v7->owned_strings.buf - old_mbuf_base;
-        v7_array_push(v7, arr, v7_mk_string(v7, ptok->start + rel,
-                                            ptok->end - ptok->start, 1));
+        const char *p = NULL;
+        if (ptok->start != NULL) {
+          p = v7_get_string(v7, &s, &len) + (ptok->start - str);
+        }
+        v7_array_push(v7, arr, v7_mk_string(v7, p, ptok->end - ptok->start, 1));
       }
-      if (flag_g) rp->lastIndex = utfnlen(str, sub.caps->end + rel - str);
       v7_def(v7, arr, "index", 5, V7_DESC_WRITABLE(0),
-             v7_mk_number(v7, utfnlen(str + rel, sub.caps->start - str)));
+             v7_mk_number(v7, index));
       *res = arr;
       goto clean;
     } else {
@@ -266,8 +321,31 @@ clean:
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err Regex_test(struct v7 *v7, v7_val_t *res) {
   enum v7_err rcode = V7_OK;
+  val_t this_obj = v7_get_this(v7);
   val_t tmp = V7_UNDEFINED;
 
+  if (v7_argc(v7) > 0 && v7_is_regexp(v7, this_obj)) {
+    struct v7_regexp *rp = v7_get_regexp_struct(v7, this_obj);
+    if (!(slre_get_flags(rp->compiled_regexp) & SLRE_FLAG_G)) {
+      /* No need for captures or `lastIndex` */
+      const char *str;
+      size_t len;
+
+      rcode = to_string(v7, v7_arg(v7, 0), &tmp, NULL, 0, NULL);
+      if (rcode != V7_OK) {
+        goto clean;
+      }
+      str = v7_get_string(v7, &tmp, &len);
+      if (slre_test(rp->compiled_regexp, rp->native, str, str + len)) {
+        rp->lastIndex = 0;
+        *res = v7_mk_boolean(v7, 0);
+      } else {
+        *res = v7_mk_boolean(v7, 1);
+      }
+      goto clean;
+    }
+  }
+
   rcode = Regex_exec(v7, &tmp);
   if (rcode != V7_OK) {
     goto clean;
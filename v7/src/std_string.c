@@ -33,7 +33,7 @@ struct _str_split_ctx {
   union {
 #if V7_ENABLE__RegExp
     struct {
-      struct slre_prog *prog;
+      struct v7_regexp *rp;
       struct slre_loot loot;
     } regexp;
 #endif
@@ -45,6 +45,13 @@ struct _str_split_ctx {
 
   struct v7 *v7;
 
+  /*
+   * String being split, and its data at the time of the last `p_exec()`:
+   * making strings may move the data, see `subs_regexp_split_add_caps()`
+   */
+  val_t str;
+  const char *str_base;
+
   /* start and end of previous match (set by `p_exec()`) */
   const char *match_start;
   const char *match_end;
@@ -66,12 +73,13 @@ struct _str_split_ctx {
 
 #if V7_ENABLE__RegExp
   /*
-   * Add captured data to resulting array (for RegExp-based implementation only)
+   * Add captured data to the resulting elements (for RegExp-based
+   * implementation only)
    *
    * Returns updated `elem` value
    */
-  long (*p_add_caps)(struct _str_split_ctx *ctx, val_t res, long elem,
-                     long limit);
+  long (*p_add_caps)(struct _str_split_ctx *ctx, struct mbuf *elems,
+                     long elem, long limit);
 #endif
 };
 
@@ -80,14 +88,15 @@ struct _str_split_ctx {
 static void subs_regexp_init(struct _str_split_ctx *ctx, struct v7 *v7,
                              val_t sep) {
   ctx->v7 = v7;
-  ctx->impl.regexp.prog = v7_get_regexp_struct(v7, sep)->compiled_regexp;
+  ctx->impl.regexp.rp = v7_get_regexp_struct(v7, sep);
 }
 
 /* RegExp-based implementation of `p_exec` in `struct _str_split_ctx` */
 static int subs_regexp_exec(struct _str_split_ctx *ctx, const char *start,
                             const char *end) {
-  int ret =
-      slre_exec(ctx->impl.regexp.prog, 0, start, end, &ctx->impl.regexp.loot);
+  struct v7_regexp *rp = ctx->impl.regexp.rp;
+  int ret = slre_exec(rp->compiled_regexp, rp->native, 0, start, end,
+                      &ctx->impl.regexp.loot);
 
   ctx->match_start = ctx->impl.regexp.loot.caps[0].start;
   ctx->match_end = ctx->impl.regexp.loot.caps[0].end;
@@ -96,18 +105,20 @@ static int subs_regexp_exec(struct _str_split_ctx *ctx, const char *start,
 }
 
 /* RegExp-based implementation of `p_add_caps` in `struct _str_split_ctx` */
-static long subs_regexp_split_add_caps(struct _str_split_ctx *ctx, val_t res,
-                                       long elem, long limit) {
+static long subs_regexp_split_add_caps(struct _str_split_ctx *ctx,
+                                       struct mbuf *elems, long elem,
+                                       long limit) {
   int i;
   for (i = 1; i < ctx->impl.regexp.loot.num_captures && elem < limit; i++) {
-    size_t cap_len =
-        ctx->impl.regexp.loot.caps[i].end - ctx->impl.regexp.loot.caps[i].start;
-    v7_array_push(
-        ctx->v7, res,
-        (ctx->impl.regexp.loot.caps[i].start != NULL)
-            ? v7_mk_string(ctx->v7, ctx->impl.regexp.loot.caps[i].start,
-                           cap_len, 1)
-            : V7_UNDEFINED);
+    const struct slre_cap *cap = &ctx->impl.regexp.loot.caps[i];
+    val_t v = V7_UNDEFINED;
+    if (cap->start != NULL) {
+      size_t n;
+      const char *p = v7_get_string(ctx->v7, &ctx->str, &n);
+      v = v7_mk_string(ctx->v7, p + (cap->start - ctx->str_base),
+                       cap->end - cap->start, 1);
+    }
+    mbuf_append(elems, &v, sizeof(v));
     elem++;
   }
   return elem;
@@ -134,14 +145,11 @@ static int subs_string_exec(struct _str_split_ctx *ctx, const char *start,
     ctx->match_end = start;
     ret = 0;
   } else {
-    size_t i;
-    for (i = 0; start <= (end - sep_len); ++i, start = utfnshift(start, 1)) {
-      if (memcmp(start, psep, sep_len) == 0) {
-        ret = 0;
-        ctx->match_start = start;
-        ctx->match_end = start + sep_len;
-        break;
-      }
+    const char *match = s_memmem(start, end - start, psep, sep_len);
+    if (match != NULL) {
+      ret = 0;
+      ctx->match_start = match;
+      ctx->match_end = match + sep_len;
     }
   }
 
@@ -150,11 +158,12 @@ static int subs_string_exec(struct _str_split_ctx *ctx, const char *start,
 
 #if V7_ENABLE__RegExp
 /* String-based implementation of `p_add_caps` in `struct _str_split_ctx` */
-static long subs_string_split_add_caps(struct _str_split_ctx *ctx, val_t res,
-                                       long elem, long limit) {
+static long subs_string_split_add_caps(struct _str_split_ctx *ctx,
+                                       struct mbuf *elems, long elem,
+                                       long limit) {
   /* this is a stub function */
   (void) ctx;
-  (void) res;
+  (void) elems;
   (void) limit;
   return elem;
 }
@@ -292,8 +301,8 @@ static enum v7_err s_index_of(struct v7 *v7, int last, val_t *res) {
   double dres = -1;
 
   if (!v7_is_undefined(arg0)) {
-    const char *p1, *p2, *end;
-    size_t i, len1, len2, bytecnt1, bytecnt2;
+    const char *s, *p1, *p2, *end, *match;
+    size_t len1, len2, bytecnt1, bytecnt2;
     val_t sub = V7_UNDEFINED;
 
     rcode = to_string(v7, arg0, &sub, NULL, 0, NULL);
@@ -306,13 +315,13 @@ static enum v7_err s_index_of(struct v7 *v7, int last, val_t *res) {
       goto clean;
     }
 
-    p1 = v7_get_string(v7, &this_obj, &bytecnt1);
+    s = p1 = v7_get_string(v7, &this_obj, &bytecnt1);
     p2 = v7_get_string(v7, &sub, &bytecnt2);
 
     if (bytecnt2 <= bytecnt1) {
       end = p1 + bytecnt1;
-      len1 = utfnlen(p1, bytecnt1);
-      len2 = utfnlen(p2, bytecnt2);
+      len1 = s_char_len(v7, this_obj, p1, bytecnt1);
+      len2 = s_char_len(v7, sub, p2, bytecnt2);
 
       if (v7_argc(v7) > 1) {
         /* `fromIndex` was provided. Normalize it */
@@ -334,27 +343,28 @@ static enum v7_err s_index_of(struct v7 *v7, int last, val_t *res) {
 
         /* adjust pointers accordingly to `fromIndex` */
         if (last) {
-          const char *end_tmp = utfnshift(p1, fromIndex + len2);
+          const char *end_tmp =
+              fromIndex + len2 < len1
+                  ? s_char_ptr(v7, this_obj, p1, bytecnt1, fromIndex + len2)
+                  : end;
           end = (end_tmp < end) ? end_tmp : end;
         } else {
-          p1 = utfnshift(p1, fromIndex);
+          p1 = s_char_ptr(v7, this_obj, p1, bytecnt1, fromIndex);
         }
       }
 
       /*
-       * TODO(dfrank): when `last` is set, start from the end and look
-       * backward. We'll need to improve `utfnshift()` for that, so that it can
-       * handle negative offsets.
+       * Search bytes rather than characters: a valid UTF-8 needle can't match
+       * in the middle of a character, so only the position of the match has
+       * to be converted.
        */
-      for (i = 0; p1 <= (end - bytecnt2); i++, p1 = utfnshift(p1, 1)) {
-        if (memcmp(p1, p2, bytecnt2) == 0) {
-          dres = i;
-          if (!last) break;
-        }
+      match = last ? s_memrmem(p1, end - p1, p2, bytecnt2)
+                   : s_memmem(p1, end - p1, p2, bytecnt2);
+      if (match != NULL) {
+        dres = s_char_index(v7, this_obj, s, bytecnt1, match);
       }
     }
   }
-  if (!last && dres >= 0) dres += fromIndex;
   *res = v7_mk_number(v7, dres);
 
 clean:
@@ -451,17 +461,23 @@ clean:
 #if V7_ENABLE__RegExp
 WARN_UNUSED_RESULT
 enum v7_err call_regex_ctor(struct v7 *v7, val_t arg, val_t *res) {
-  /* TODO(mkm): make general helper out of this */
+  /* Same as `Regex_ctor()` with one argument, without making `arguments` */
   enum v7_err rcode = V7_OK;
-  val_t saved_args = v7->vals.arguments, args = v7_mk_dense_array(v7);
-  v7_array_push(v7, args, arg);
-  v7->vals.arguments = args;
+  val_t ro = V7_UNDEFINED;
+  const char *re;
+  size_t re_len;
+
+  if (v7_is_regexp(v7, arg)) {
+    *res = arg;
+    goto clean;
+  }
 
-  rcode = Regex_ctor(v7, res);
+  rcode = to_string(v7, arg, &ro, NULL, 0, NULL);
   if (rcode != V7_OK) {
     goto clean;
   }
-  v7->vals.arguments = saved_args;
+  re = v7_get_string(v7, &ro, &re_len);
+  rcode = v7_mk_regexp(v7, re, re_len, NULL, 0, res);
 
 clean:
   return rcode;
@@ -554,16 +570,13 @@ V7_PRIVATE enum v7_err Str_replace(struct v7 *v7, v7_val_t *res) {
   const char *s;
   size_t s_len;
   /*
-   * Buffer of temporary strings returned by the replacement funciton.  Will be
-   * allocated below if only the replacement is a function.  We need to store
-   * each string in a separate `val_t`, because string data of length <= 5 is
-   * stored right in `val_t`, so if there's more than one replacement,
-   * each subsequent replacement will overwrite the previous one.
+   * The result is accumulated here. Pieces are copied right away, since the
+   * string data can be moved by the strings made for the replacement function
+   * (that's also why positions are kept as offsets across iterations).
    */
-  val_t *tmp_str_buf = NULL;
-  val_t out_str_o;
-  char *old_owned_mbuf_base = v7->owned_strings.buf;
-  char *old_owned_mbuf_end = v7->owned_strings.buf + v7->owned_strings.len;
+  struct mbuf out;
+
+  mbuf_init(&out, 0);
 
   rcode = to_string(v7, this_obj, &this_obj, NULL, 0, NULL);
   if (rcode != V7_OK) {
@@ -573,14 +586,11 @@ V7_PRIVATE enum v7_err Str_replace(struct v7 *v7, v7_val_t *res) {
   s = v7_get_string(v7, &this_obj, &s_len);
 
   if (s_len != 0 && v7_argc(v7) > 1) {
-    const char *const str_end = s + s_len;
-    char *p = (char *) s;
-    uint32_t out_sub_num = 0;
+    size_t pos = 0, match_start, match_end;
     val_t ro = V7_UNDEFINED, str_func = V7_UNDEFINED;
-    struct slre_prog *prog;
-    struct slre_cap out_sub[V7_RE_MAX_REPL_SUB], *ptok = out_sub;
+    struct v7_regexp *rp = NULL;
     struct slre_loot loot;
-    int flag_g;
+    int flag_g = 0;
 
     rcode = obj_value_of(v7, v7_arg(v7, 0), &ro);
     if (rcode != V7_OK) {
@@ -591,14 +601,19 @@ V7_PRIVATE enum v7_err Str_replace(struct v7 *v7, v7_val_t *res) {
       goto clean;
     }
 
-    if (!v7_is_regexp(v7, ro)) {
-      rcode = call_regex_ctor(v7, ro, &ro);
+    if (v7_is_regexp(v7, ro)) {
+      rp = v7_get_regexp_struct(v7, ro);
+      flag_g = slre_get_flags(rp->compiled_regexp) & SLRE_FLAG_G;
+    } else {
+      /*
+       * A string pattern is not a regexp: its first occurrence is looked up
+       * literally, without compiling anything
+       */
+      rcode = to_string(v7, ro, &ro, NULL, 0, NULL);
       if (rcode != V7_OK) {
         goto clean;
       }
     }
-    prog = v7_get_regexp_struct(v7, ro)->compiled_regexp;
-    flag_g = slre_get_flags(prog) & SLRE_FLAG_G;
 
     if (!v7_is_callable(v7, str_func)) {
       rcode = to_string(v7, str_func, &str_func, NULL, 0, NULL);
@@ -607,32 +622,54 @@ V7_PRIVATE enum v7_err Str_replace(struct v7 *v7, v7_val_t *res) {
       }
     }
 
-    do {
+    for (;;) {
       int i;
-      if (slre_exec(prog, 0, p, str_end, &loot)) break;
-      if (p != loot.caps->start) {
-        ptok->start = p;
-        ptok->end = loot.caps->start;
-        ptok++;
-        out_sub_num++;
+
+      s = v7_get_string(v7, &this_obj, &s_len);
+      if (rp != NULL) {
+        if (slre_exec(rp->compiled_regexp, rp->native, 0, s + pos, s + s_len,
+                      &loot)) {
+          break;
+        }
+      } else {
+        size_t pat_len;
+        const char *pat = v7_get_string(v7, &ro, &pat_len);
+        const char *match = s_memmem(s + pos, s_len - pos, pat, pat_len);
+        if (match == NULL) break;
+        loot.num_captures = 1;
+        loot.caps[0].start = match;
+        loot.caps[0].end = match + pat_len;
+      }
+      match_start = loot.caps[0].start - s;
+      match_end = loot.caps[0].end - s;
+      /* `out.buf` is NULL until something is appended: skip empty pieces */
+      if (match_start > pos) {
+        mbuf_append(&out, s + pos, match_start - pos);
       }
 
       if (v7_is_callable(v7, str_func)) { /* replace function */
+        size_t cap_off[SLRE_MAX_CAPS], cap_len[SLRE_MAX_CAPS];
         const char *rez_str;
         size_t rez_len;
-        val_t arr = v7_mk_dense_array(v7);
+        val_t arr = v7_mk_dense_array(v7), val = V7_UNDEFINED;
 
         for (i = 0; i < loot.num_captures; i++) {
+          cap_off[i] = loot.caps[i].start - s;
+          cap_len[i] = loot.caps[i].end - loot.caps[i].start;
+        }
+        for (i = 0; i < loot.num_captures; i++) {
+          const char *p = v7_get_string(v7, &this_obj, &s_len);
           rcode = v7_array_push_throwing(
-              v7, arr, v7_mk_string(v7, loot.caps[i].start,
-                                    loot.caps[i].end - loot.caps[i].start, 1),
-              NULL);
+              v7, arr, v7_mk_string(v7, p + cap_off[i], cap_len[i], 1), NULL);
           if (rcode != V7_OK) {
             goto clean;
           }
         }
+        s = v7_get_string(v7, &this_obj, &s_len);
         rcode = v7_array_push_throwing(
-            v7, arr, v7_mk_number(v7, utfnlen(s, loot.caps[0].start - s)),
+            v7, arr,
+            v7_mk_number(v7, s_char_index(v7, this_obj, s, s_len,
+                                          s + match_start)),
             NULL);
         if (rcode != V7_OK) {
           goto clean;
@@ -643,75 +680,57 @@ V7_PRIVATE enum v7_err Str_replace(struct v7 *v7, v7_val_t *res) {
           goto clean;
         }
 
-        {
-          val_t val = V7_UNDEFINED;
-
-          rcode = b_apply(v7, str_func, this_obj, arr, 0, &val);
-          if (rcode != V7_OK) {
-            goto clean;
-          }
-
-          if (tmp_str_buf == NULL) {
-            tmp_str_buf = (val_t *) calloc(sizeof(val_t), V7_RE_MAX_REPL_SUB);
-          }
+        rcode = b_apply(v7, str_func, this_obj, arr, 0, &val);
+        if (rcode != V7_OK) {
+          goto clean;
+        }
 
-          rcode = to_string(v7, val, &tmp_str_buf[out_sub_num], NULL, 0, NULL);
-          if (rcode != V7_OK) {
-            goto clean;
-          }
+        rcode = to_string(v7, val, &val, NULL, 0, NULL);
+        if (rcode != V7_OK) {
+          goto clean;
         }
-        rez_str = v7_get_string(v7, &tmp_str_buf[out_sub_num], &rez_len);
-        if (rez_len) {
-          ptok->start = rez_str;
-          ptok->end = rez_str + rez_len;
-          ptok++;
-          out_sub_num++;
+        rez_str = v7_get_string(v7, &val, &rez_len);
+        if (rez_len > 0) {
+          mbuf_append(&out, rez_str, rez_len);
         }
+        s = v7_get_string(v7, &this_obj, &s_len);
       } else { /* replace string */
         struct slre_loot newsub;
         size_t f_len;
         const char *f_str = v7_get_string(v7, &str_func, &f_len);
         slre_replace(&loot, s, s_len, f_str, f_len, &newsub);
         for (i = 0; i < newsub.num_captures; i++) {
-          ptok->start = newsub.caps[i].start;
-          ptok->end = newsub.caps[i].end;
-          ptok++;
-          out_sub_num++;
+          if (newsub.caps[i].end > newsub.caps[i].start) {
+            mbuf_append(&out, newsub.caps[i].start,
+                        newsub.caps[i].end - newsub.caps[i].start);
+          }
         }
       }
-      p = (char *) loot.caps[0].end;
-    } while (flag_g && p < str_end);
-    if (p <= str_end) {
-      ptok->start = p;
-      ptok->end = str_end;
-      ptok++;
-      out_sub_num++;
-    }
-    out_str_o = v7_mk_string(v7, NULL, 0, 1);
-    ptok = out_sub;
-    do {
-      size_t ln = ptok->end - ptok->start;
-      const char *ps = ptok->start;
-      if (ptok->start >= old_owned_mbuf_base &&
-          ptok->start < old_owned_mbuf_end) {
-        ps += v7->owned_strings.buf - old_owned_mbuf_base;
+      pos = match_end;
+
+      if (!flag_g) break;
+      if (match_end == match_start) {
+        /* Empty match: step over the next character to avoid looping */
+        size_t n;
+        if (pos >= s_len) break;
+        n = utfnshift(s + pos, 1) - (s + pos);
+        mbuf_append(&out, s + pos, n);
+        pos += n;
       }
-      out_str_o = s_concat(v7, out_str_o, v7_mk_string(v7, ps, ln, 1));
-      p += ln;
-      ptok++;
-    } while (--out_sub_num);
+    }
+    s = v7_get_string(v7, &this_obj, &s_len);
+    if (s_len > pos) {
+      mbuf_append(&out, s + pos, s_len - pos);
+    }
 
-    *res = out_str_o;
+    *res = v7_mk_string(v7, out.buf, out.len, 1);
     goto clean;
   }
 
   *res = this_obj;
 
 clean:
-  if (tmp_str_buf != NULL) {
-    free(tmp_str_buf);
-    tmp_str_buf = NULL;
-  }
+  mbuf_free(&out);
   return rcode;
 }
 
@@ -725,6 +744,7 @@ V7_PRIVATE enum v7_err Str_search(struct v7 *v7, v7_val_t *res) {
     size_t s_len;
     struct slre_loot sub;
     val_t so = V7_UNDEFINED, ro = V7_UNDEFINED;
+    struct v7_regexp *rp;
     const char *s;
 
     rcode = obj_value_of(v7, v7_arg(v7, 0), &ro);
@@ -745,10 +765,10 @@ V7_PRIVATE enum v7_err Str_search(struct v7 *v7, v7_val_t *res) {
     }
 
     s = v7_get_string(v7, &so, &s_len);
+    rp = v7_get_regexp_struct(v7, ro);
 
-    if (!slre_exec(v7_get_regexp_struct(v7, ro)->compiled_regexp, 0, s,
-                   s + s_len, &sub))
-      utf_shift = utfnlen(s, sub.caps[0].start - s); /* calc shift for UTF-8 */
+    if (!slre_exec(rp->compiled_regexp, rp->native, 0, s, s + s_len, &sub))
+      utf_shift = s_utf_len(s, sub.caps[0].start - s); /* calc shift for UTF-8 */
   } else {
     utf_shift = 0;
   }
@@ -766,7 +786,7 @@ V7_PRIVATE enum v7_err Str_slice(struct v7 *v7, v7_val_t *res) {
   enum v7_err rcode = V7_OK;
   val_t this_obj = v7_get_this(v7);
   long from = 0, to = 0;
-  size_t len;
+  size_t len, blen;
   val_t so = V7_UNDEFINED;
   const char *begin, *end;
   int num_args = v7_argc(v7);
@@ -776,9 +796,9 @@ V7_PRIVATE enum v7_err Str_slice(struct v7 *v7, v7_val_t *res) {
     goto clean;
   }
 
-  begin = v7_get_string(v7, &so, &len);
+  begin = v7_get_string(v7, &so, &blen);
 
-  to = len = utfnlen(begin, len);
+  to = len = s_char_len(v7, so, begin, blen);
   if (num_args > 0) {
     rcode = to_long(v7, v7_arg(v7, 0), 0, &from);
     if (rcode != V7_OK) {
@@ -805,8 +825,8 @@ V7_PRIVATE enum v7_err Str_slice(struct v7 *v7, v7_val_t *res) {
   }
 
   if (from > to) to = from;
-  end = utfnshift(begin, to);
-  begin = utfnshift(begin, from);
+  end = s_char_ptr(v7, so, begin, blen, to);
+  begin = s_char_ptr(v7, so, begin, blen, from);
 
   *res = v7_mk_string(v7, begin, end - begin, 1);
 
@@ -906,7 +926,7 @@ V7_PRIVATE enum v7_err Str_length(struct v7 *v7, v7_val_t *res) {
 
   if (v7_is_string(s)) {
     const char *p = v7_get_string(v7, &s, &len);
-    len = utfnlen(p, len);
+    len = s_char_len(v7, s, p, len);
   }
 
   *res = v7_mk_number(v7, len);
@@ -972,16 +992,16 @@ WARN_UNUSED_RESULT
 static enum v7_err s_substr(struct v7 *v7, val_t s, long start, long len,
                             val_t *res) {
   enum v7_err rcode = V7_OK;
-  size_t n;
-  const char *p;
+  size_t n, blen;
+  const char *p, *end;
 
   rcode = to_string(v7, s, &s, NULL, 0, NULL);
   if (rcode != V7_OK) {
     goto clean;
   }
 
-  p = v7_get_string(v7, &s, &n);
-  n = utfnlen(p, n);
+  p = v7_get_string(v7, &s, &blen);
+  n = s_char_len(v7, s, p, blen);
 
   if (start < (long) n && len > 0) {
     if (start < 0) start = (long) n + start;
@@ -990,7 +1010,9 @@ static enum v7_err s_substr(struct v7 *v7, val_t s, long start, long len,
     if (start > (long) n) start = n;
     if (len < 0) len = 0;
     if (len > (long) n - start) len = n - start;
-    p = utfnshift(p, start);
+    end = s_char_ptr(v7, s, p, blen, start + len);
+    p = s_char_ptr(v7, s, p, blen, start);
+    len = end - p;
   } else {
     len = 0;
   }
@@ -1064,6 +1086,15 @@ V7_PRIVATE enum v7_err Str_split(struct v7 *v7, v7_val_t *res) {
   const char *s, *s_end;
   size_t s_len;
   long num_args = v7_argc(v7);
+  /*
+   * Elements are collected here and added to the resulting array at once,
+   * see `v7_array_push_n()`. Making strings doesn't run the GC, so the values
+   * are safe here until then.
+   */
+  struct mbuf elems;
+
+  mbuf_init(&elems, 0);
+
   rcode = to_string(v7, this_obj, &this_obj, NULL, 0, NULL);
   if (rcode != V7_OK) {
     goto clean;
@@ -1078,10 +1109,7 @@ V7_PRIVATE enum v7_err Str_split(struct v7 *v7, v7_val_t *res) {
      * No arguments were given: resulting array will contain just a single
      * element: the source string
      */
-    rcode = v7_array_push_throwing(v7, *res, this_obj, NULL);
-    if (rcode != V7_OK) {
-      goto clean;
-    }
+    mbuf_append(&elems, &this_obj, sizeof(this_obj));
   } else {
     val_t ro = V7_UNDEFINED;
     long elem, limit;
@@ -1126,6 +1154,12 @@ V7_PRIVATE enum v7_err Str_split(struct v7 *v7, v7_val_t *res) {
     }
     /* initialize context */
     ctx.p_init(&ctx, v7, ro);
+    ctx.str = this_obj;
+
+    /* Converting the separator could have reallocated the string data */
+    s = v7_get_string(v7, &this_obj, &s_len);
+    s_end = s + s_len;
+    ctx.str_base = s;
 
     if (s_len == 0) {
       /*
@@ -1135,35 +1169,35 @@ V7_PRIVATE enum v7_err Str_split(struct v7 *v7, v7_val_t *res) {
        */
       int matches_empty = !ctx.p_exec(&ctx, s, s);
       if (!matches_empty) {
-        rcode = v7_array_push_throwing(v7, *res, this_obj, NULL);
-        if (rcode != V7_OK) {
-          goto clean;
-        }
+        mbuf_append(&elems, &this_obj, sizeof(this_obj));
       }
     } else {
       size_t last_match_len = 0;
 
       for (elem = 0; elem < limit && lookup_idx < s_len;) {
-        size_t substr_len;
+        size_t substr_len, match_end_idx;
         /* find next match, and break if there's no match */
+        ctx.str_base = s;
         if (ctx.p_exec(&ctx, s + lookup_idx, s_end)) break;
 
         last_match_len = ctx.match_end - ctx.match_start;
         substr_len = ctx.match_start - s - substr_idx;
+        match_end_idx = ctx.match_end - s;
 
         /* add next substring to the resulting array, if needed */
         if (substr_len > 0 || last_match_len > 0) {
-          rcode = v7_array_push_throwing(
-              v7, *res, v7_mk_string(v7, s + substr_idx, substr_len, 1), NULL);
-          if (rcode != V7_OK) {
-            goto clean;
-          }
+          val_t substr = v7_mk_string(v7, s + substr_idx, substr_len, 1);
+          mbuf_append(&elems, &substr, sizeof(substr));
           elem++;
 
 #if V7_ENABLE__RegExp
           /* Add captures (for RegExp only) */
-          elem = ctx.p_add_caps(&ctx, *res, elem, limit);
+          elem = ctx.p_add_caps(&ctx, &elems, elem, limit);
 #endif
+
+          /* Making substrings could have reallocated the string data */
+          s = v7_get_string(v7, &this_obj, &s_len);
+          s_end = s + s_len;
         }
 
         /* advance lookup_idx appropriately */
@@ -1173,31 +1207,31 @@ V7_PRIVATE enum v7_err Str_split(struct v7 *v7, v7_val_t *res) {
           lookup_idx += (next - (s + lookup_idx));
         } else {
           /* non-empty match: advance to the end of match */
-          lookup_idx = ctx.match_end - s;
+          lookup_idx = match_end_idx;
         }
 
         /*
          * always remember the end of the match, so that next time we will take
          * substring from that position
          */
-        substr_idx = ctx.match_end - s;
+        substr_idx = match_end_idx;
       }
 
       /* add the last substring to the resulting array, if needed */
       if (elem < limit) {
         size_t substr_len = s_len - substr_idx;
         if (substr_len > 0 || last_match_len > 0) {
-          rcode = v7_array_push_throwing(
-              v7, *res, v7_mk_string(v7, s + substr_idx, substr_len, 1), NULL);
-          if (rcode != V7_OK) {
-            goto clean;
-          }
+          val_t substr = v7_mk_string(v7, s + substr_idx, substr_len, 1);
+          mbuf_append(&elems, &substr, sizeof(substr));
         }
       }
     }
   }
 
+  v7_array_push_n(v7, *res, (val_t *) elems.buf, elems.len / sizeof(val_t));
+
 clean:
+  mbuf_free(&elems);
   return rcode;
 }
 
@@ -9,9 +9,6 @@
 #include "v7/src/internal.h"
 #include "v7/src/core.h"
 
-/* Max captures for String.replace() */
-#define V7_RE_MAX_REPL_SUB 20
-
 #if defined(__cplusplus)
 extern "C" {
 #endif /* __cplusplus */
@@ -18,9 +18,9 @@
 #define GET_VAL_NAN_PAYLOAD(v) ((char *) &(v))
 
 /*
- * Dictionary of read-only strings with length > 5.
- * NOTE(lsm): must be sorted lexicographically, because
- * v_find_string_in_dictionary performs binary search over this list.
+ * Dictionary of read-only strings with length > 5, see `struct
+ * v7_dictionary`. Indices of these strings end up in values, so they should
+ * be kept the same for all instances.
  */
 /* clang-format off */
 static const struct v7_vec_const v_dictionary_strings[] = {
@@ -209,26 +209,470 @@ V7_PRIVATE size_t unescape(const char *s, size_t len, char *to) {
   return n;
 }
 
-static int v_find_string_in_dictionary(const char *s, size_t len) {
-  size_t start = 0, end = ARRAY_SIZE(v_dictionary_strings);
+#define DICT_BUILTIN_CNT ARRAY_SIZE(v_dictionary_strings)
 
-  while (s != NULL && start < end) {
-    size_t mid = start + (end - start) / 2;
-    const struct v7_vec_const *v = &v_dictionary_strings[mid];
-    size_t min_len = len < v->len ? len : v->len;
-    int comparison_result = memcmp(s, v->p, min_len);
-    if (comparison_result == 0) {
-      comparison_result = len - v->len;
+/* Max number of strings in the dictionary, limited by `v7_dictionary::slots` */
+#define DICT_MAX_CNT 0xfffe
+
+static const struct v7_vec_const *dict_get(struct v7 *v7, size_t index) {
+  if (index < DICT_BUILTIN_CNT) {
+    return &v_dictionary_strings[index];
+  }
+  return &v7->dict.user[index - DICT_BUILTIN_CNT];
+}
+
+/* Returns slot (before masking) of the string with the given hash */
+static uint32_t dict_slot(uint32_t hash, uint32_t disp) {
+  uint32_t x = hash ^ (disp * 0x9e3779b9U);
+  x ^= x >> 16;
+  x *= 0x85ebca6bU;
+  x ^= x >> 13;
+  return x;
+}
+
+static int v_find_string_in_dictionary(struct v7 *v7, const char *s,
+                                       size_t len) {
+  struct v7_dictionary *d = &v7->dict;
+  const struct v7_vec_const *v;
+  uint32_t hash, idx;
+
+  if (s == NULL || d->slots == NULL) {
+    return -1;
+  }
+
+  hash = str_hash(s, len);
+  idx = d->slots[dict_slot(hash, d->disp[hash % d->buckets_cnt]) &
+                 d->slots_mask];
+  if (idx == 0) {
+    return -1;
+  }
+  v = dict_get(v7, idx - 1);
+  if (v->len != len || memcmp(v->p, s, len) != 0) {
+    return -1;
+  }
+  return idx - 1;
+}
+
+/*
+ * Tries to find displacements for all buckets, given the number of slots.
+ * Returns 1 on success, 0 if the number of slots should be increased.
+ *
+ * Hashes must be unique, otherwise the strings with equal hashes would
+ * always get the same slot.
+ */
+static int dict_build(struct v7 *v7, uint32_t cnt, const uint32_t *hashes,
+                      uint32_t slots_cnt) {
+  struct v7_dictionary *d = &v7->dict;
+  uint32_t *start, *keys, max_size = 0, size, b, i, j, disp;
+  int ok = 1;
+
+  d->buckets_cnt = cnt / 4 + 1;
+  d->slots_mask = slots_cnt - 1;
+  d->disp = (uint16_t *) calloc(d->buckets_cnt, sizeof(*d->disp));
+  d->slots = (uint16_t *) calloc(slots_cnt, sizeof(*d->slots));
+  start = (uint32_t *) calloc(d->buckets_cnt + 1, sizeof(*start));
+  keys = (uint32_t *) calloc(cnt, sizeof(*keys));
+  if (d->disp == NULL || d->slots == NULL || start == NULL || keys == NULL) {
+    abort();
+  }
+
+  /* Sort strings by buckets: bucket `b` is `keys[start[b]..start[b + 1])` */
+  for (i = 0; i < cnt; i++) {
+    start[hashes[i] % d->buckets_cnt + 1]++;
+  }
+  for (b = 0; b < d->buckets_cnt; b++) {
+    if (start[b + 1] > max_size) max_size = start[b + 1];
+    start[b + 1] += start[b];
+  }
+  for (i = 0; i < cnt; i++) {
+    b = hashes[i] % d->buckets_cnt;
+    keys[start[b]++] = i;
+  }
+  for (b = d->buckets_cnt; b > 0; b--) {
+    start[b] = start[b - 1];
+  }
+  start[0] = 0;
+
+  /* Place the biggest buckets first, while there are many free slots */
+  for (size = max_size; size > 0 && ok; size--) {
+    for (b = 0; b < d->buckets_cnt && ok; b++) {
+      if (start[b + 1] - start[b] != size) continue;
+
+      for (disp = 0; disp <= 0xffff; disp++) {
+        for (i = start[b]; i < start[b + 1]; i++) {
+          uint32_t slot = dict_slot(hashes[keys[i]], disp) & d->slots_mask;
+          if (d->slots[slot] != 0) break;
+          d->slots[slot] = keys[i] + 1;
+        }
+        if (i == start[b + 1]) {
+          d->disp[b] = disp;
+          break;
+        }
+        /* Collision: free the slots taken so far and try another one */
+        for (j = start[b]; j < i; j++) {
+          d->slots[dict_slot(hashes[keys[j]], disp) & d->slots_mask] = 0;
+        }
+      }
+      ok = (disp <= 0xffff);
     }
-    if (comparison_result < 0) {
-      end = mid;
-    } else if (comparison_result > 0) {
-      start = mid + 1;
+  }
+
+  free(start);
+  free(keys);
+  if (!ok) {
+    free(d->disp);
+    free(d->slots);
+    d->disp = d->slots = NULL;
+  }
+  return ok;
+}
+
+/*
+ * Adds hash to the open-addressing set `set` of `mask + 1` slots (zero hashes
+ * are stored as 1, since zero marks empty slots). Returns 0 if it was already
+ * there.
+ */
+static int dict_add_unique_hash(uint32_t *set, uint32_t mask, uint32_t hash) {
+  uint32_t i, h = hash == 0 ? 1 : hash;
+  for (i = h & mask; set[i] != 0; i = (i + 1) & mask) {
+    if (set[i] == h) return 0;
+  }
+  set[i] = h;
+  return 1;
+}
+
+V7_PRIVATE void dict_init(struct v7 *v7, const char *const *strings) {
+  struct v7_dictionary *d = &v7->dict;
+  struct v7_vec_const *user = NULL;
+  uint32_t *hashes, *set, cnt = 0, max_cnt = DICT_BUILTIN_CNT, mask = 1, i;
+  uint32_t slots_cnt = 16;
+
+  if (strings != NULL) {
+    for (i = 0; strings[i] != NULL; i++) {
+    }
+    max_cnt += i;
+    user = (struct v7_vec_const *) calloc(i + 1, sizeof(*user));
+    if (user == NULL) abort();
+  }
+  while (mask < max_cnt * 2) {
+    mask = mask * 2 + 1;
+  }
+  hashes = (uint32_t *) malloc(max_cnt * sizeof(*hashes));
+  set = (uint32_t *) calloc(mask + 1, sizeof(*set));
+  if (hashes == NULL || set == NULL) abort();
+
+  for (i = 0; i < DICT_BUILTIN_CNT; i++) {
+    hashes[cnt] =
+        str_hash(v_dictionary_strings[i].p, v_dictionary_strings[i].len);
+    dict_add_unique_hash(set, mask, hashes[cnt++]);
+  }
+
+  /*
+   * Add the embedder's strings, skipping the short ones and duplicates. The
+   * (very unlikely) strings whose hash matches another string's are skipped
+   * as well, since they can't be told apart by the perfect hash.
+   */
+  d->user = user;
+  for (i = 0; user != NULL && strings[i] != NULL && cnt < DICT_MAX_CNT; i++) {
+    size_t len = strlen(strings[i]);
+    uint32_t hash = str_hash(strings[i], len);
+    if (len > 5 && dict_add_unique_hash(set, mask, hash)) {
+      user[d->user_cnt].p = strings[i];
+      user[d->user_cnt].len = len;
+      d->user_cnt++;
+      hashes[cnt++] = hash;
+    }
+  }
+
+  while (slots_cnt < cnt + cnt / 2) {
+    slots_cnt *= 2;
+  }
+  while (!dict_build(v7, cnt, hashes, slots_cnt)) {
+    slots_cnt *= 2;
+  }
+
+  free(set);
+  free(hashes);
+}
+
+V7_PRIVATE void dict_free(struct v7 *v7) {
+  free((void *) v7->dict.user);
+  free(v7->dict.disp);
+  free(v7->dict.slots);
+  memset(&v7->dict, 0, sizeof(v7->dict));
+}
+
+/*
+ * Returns the header of the string `s` (see `V7_STR_HDR_SIZE`), and sets its
+ * data and length; returns NULL if the string is not owned.
+ */
+static char *s_hdr(struct v7 *v7, val_t s, const char **p, size_t *len) {
+  *p = v7_get_string(v7, &s, len);
+  if ((s & V7_TAG_MASK) != V7_TAG_STRING_O) {
+    return NULL;
+  }
+  return (char *) *p - V7_STR_HDR_SIZE;
+}
+
+/* Distance (in characters) between the offsets recorded in character index */
+#define V7_STR_INDEX_STEP 64
+
+/* Strings shorter than that are not indexed, see `struct v7_str_index` */
+#define V7_STR_INDEX_MIN_LEN 32
+
+/* Returns whether the string data is pure ASCII, checking a word at a time */
+static int s_is_ascii(const char *p, size_t len) {
+  const uintptr_t high_bits = ((uintptr_t) -1 / 0xff) * 0x80;
+  const char *end = p + len;
+  uintptr_t acc = 0;
+
+  for (; p < end && ((uintptr_t) p & (sizeof(uintptr_t) - 1)) != 0; p++) {
+    acc |= (unsigned char) *p;
+  }
+  for (; end - p >= (ptrdiff_t) sizeof(uintptr_t); p += sizeof(uintptr_t)) {
+    uintptr_t w;
+    memcpy(&w, p, sizeof(w));
+    acc |= w;
+  }
+  for (; p < end; p++) {
+    acc |= (unsigned char) *p;
+  }
+  return (acc & high_bits) == 0;
+}
+
+V7_PRIVATE void str_index_reset(struct v7 *v7) {
+  int i;
+  for (i = 0; i < V7_STR_INDEX_CACHE_SIZE; i++) {
+    free(v7->str_index[i].offsets);
+    v7->str_index[i].offsets = NULL;
+    v7->str_index[i].s = V7_UNDEFINED;
+  }
+}
+
+/*
+ * Returns character index of the given string, building it if needed; returns
+ * NULL for short strings, for which indexing is not worth it.
+ */
+static struct v7_str_index *s_index(struct v7 *v7, val_t s, const char *p,
+                                    size_t len) {
+  struct v7_str_index *e;
+  int i;
+
+  if (len < V7_STR_INDEX_MIN_LEN) {
+    return NULL;
+  }
+
+  for (i = 0; i < V7_STR_INDEX_CACHE_SIZE; i++) {
+    if (v7->str_index[i].s == s) {
+      return &v7->str_index[i];
+    }
+  }
+
+  e = &v7->str_index[v7->str_index_next];
+  v7->str_index_next = (v7->str_index_next + 1) % V7_STR_INDEX_CACHE_SIZE;
+  free(e->offsets);
+  e->offsets = NULL;
+  e->s = s;
+  e->is_ascii = s_is_ascii(p, len);
+
+  if (e->is_ascii) {
+    e->char_len = len;
+  } else {
+    const char *cur = p, *end = p + len;
+    size_t n = 0;
+
+    e->offsets = (uint32_t *) malloc((len / V7_STR_INDEX_STEP + 1) *
+                                     sizeof(*e->offsets));
+    if (e->offsets == NULL) abort();
+    while (cur < end) {
+      if (n % V7_STR_INDEX_STEP == 0) {
+        e->offsets[n / V7_STR_INDEX_STEP] = (uint32_t)(cur - p);
+      }
+      cur = utfnshift(cur, 1);
+      n++;
+    }
+    e->char_len = s_utf_len(p, len);
+  }
+  return e;
+}
+
+V7_PRIVATE size_t s_utf_len(const char *p, size_t len) {
+#if CS_ENABLE_UTF8
+  /* `utfnlen()` takes NUL as a single-byte rune, like any other ASCII byte */
+  return (size_t) utfnlen(p, len);
+#else
+  (void) p;
+  return len;
+#endif
+}
+
+V7_PRIVATE size_t s_char_len(struct v7 *v7, val_t s, const char *p,
+                             size_t len) {
+  struct v7_str_index *e;
+  size_t n;
+#if CS_ENABLE_UTF8
+  const char *data;
+  size_t data_len;
+  char *hdr = s_hdr(v7, s, &data, &data_len);
+  uint32_t cnt;
+
+  /* Owned strings cache the number in the header */
+  if (hdr != NULL && data == p && data_len == len &&
+      (hdr[0] & V7_STR_COUNTED)) {
+    memcpy(&cnt, hdr + 5, sizeof(cnt));
+    return cnt;
+  }
+#endif
+
+  e = s_index(v7, s, p, len);
+  if (e != NULL) {
+    n = e->char_len;
+  } else {
+    n = s_is_ascii(p, len) ? len : s_utf_len(p, len);
+  }
+
+#if CS_ENABLE_UTF8
+  cnt = (uint32_t) n;
+  if (hdr != NULL && data == p && data_len == len && cnt == n) {
+    memcpy(hdr + 5, &cnt, sizeof(cnt));
+    hdr[0] |= V7_STR_COUNTED;
+  }
+#endif
+  return n;
+}
+
+V7_PRIVATE const char *s_char_ptr(struct v7 *v7, val_t s, const char *p,
+                                  size_t len, size_t idx) {
+  struct v7_str_index *e = s_index(v7, s, p, len);
+  if (e == NULL) {
+    return utfnshift(p, idx);
+  } else if (e->is_ascii) {
+    return p + idx;
+  } else {
+    return utfnshift(p + e->offsets[idx / V7_STR_INDEX_STEP],
+                     idx % V7_STR_INDEX_STEP);
+  }
+}
+
+V7_PRIVATE size_t s_char_index(struct v7 *v7, val_t s, const char *p,
+                               size_t len, const char *at) {
+  struct v7_str_index *e = s_index(v7, s, p, len);
+  size_t off = at - p, lo = 0, hi;
+  if (e == NULL) {
+    return s_utf_len(p, off);
+  } else if (e->is_ascii) {
+    return off;
+  }
+
+  /* Find the last recorded offset which is not past `at` */
+  hi = (e->char_len + V7_STR_INDEX_STEP - 1) / V7_STR_INDEX_STEP;
+  while (hi - lo > 1) {
+    size_t mid = (lo + hi) / 2;
+    if (e->offsets[mid] <= off) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo * V7_STR_INDEX_STEP +
+         s_utf_len(p + e->offsets[lo], off - e->offsets[lo]);
+}
+
+/*
+ * Returns length of the maximal suffix of the needle, and sets its period,
+ * for the Two-Way algorithm. `rev` selects the reversed alphabet order.
+ */
+static size_t s_max_suffix(const unsigned char *n, size_t len, int rev,
+                           size_t *period) {
+  /* `i` starts at -1, relying on unsigned wraparound */
+  size_t i = (size_t) -1, j = 0, k = 1, p = 1;
+  while (j + k < len) {
+    unsigned char a = n[i + k], b = n[j + k];
+    if (a == b) {
+      if (k == p) {
+        j += p;
+        k = 1;
+      } else {
+        k++;
+      }
+    } else if (rev ? a < b : a > b) {
+      j += k;
+      k = 1;
+      p = j - i;
     } else {
-      return mid;
+      i = j++;
+      k = p = 1;
+    }
+  }
+  *period = p;
+  return i;
+}
+
+V7_PRIVATE const char *s_memmem(const char *s, size_t s_len, const char *sub,
+                                size_t sub_len) {
+  const unsigned char *h = (const unsigned char *) s;
+  const unsigned char *n = (const unsigned char *) sub;
+  size_t ms, ms2, p, p2, mem = 0, mem0, k, pos = 0;
+
+  if (sub_len == 0) {
+    return s;
+  } else if (sub_len > s_len) {
+    return NULL;
+  } else if (sub_len == 1) {
+    return (const char *) memchr(s, *n, s_len);
+  }
+
+  /* Critical factorization: the longer of the two maximal suffixes */
+  ms = s_max_suffix(n, sub_len, 0, &p);
+  ms2 = s_max_suffix(n, sub_len, 1, &p2);
+  if (ms2 + 1 > ms + 1) {
+    ms = ms2;
+    p = p2;
+  }
+
+  if (memcmp(n, n + p, ms + 1) != 0) {
+    /* Not periodic: shift past the longer half on mismatch */
+    mem0 = 0;
+    p = (ms > sub_len - ms - 1 ? ms : sub_len - ms - 1) + 1;
+  } else {
+    mem0 = sub_len - p;
+  }
+
+  while (pos <= s_len - sub_len) {
+    /* Match the right half, then the left one */
+    for (k = (ms + 1 > mem ? ms + 1 : mem); k < sub_len && n[k] == h[pos + k];
+         k++) {
+    }
+    if (k < sub_len) {
+      pos += k - ms;
+      mem = 0;
+      continue;
+    }
+    for (k = ms + 1; k > mem && n[k - 1] == h[pos + k - 1]; k--) {
+    }
+    if (k <= mem) {
+      return s + pos;
     }
+    pos += p;
+    mem = mem0;
   }
-  return -1;
+  return NULL;
+}
+
+V7_PRIVATE const char *s_memrmem(const char *s, size_t s_len, const char *sub,
+                                 size_t sub_len) {
+  size_t i;
+  if (sub_len == 0) {
+    return s + s_len;
+  } else if (sub_len > s_len) {
+    return NULL;
+  }
+  for (i = s_len - sub_len + 1; i-- > 0;) {
+    if (s[i] == *sub && memcmp(s + i, sub, sub_len) == 0) {
+      return s + i;
+    }
+  }
+  return NULL;
 }
 
 WARN_UNUSED_RESULT
@@ -249,10 +693,9 @@ V7_PRIVATE enum v7_err v7_char_code_at(struct v7 *v7, val_t obj, val_t arg,
 
   p = v7_get_string(v7, &s, &n);
 
-  n = utfnlen(p, n);
-  if (v7_is_number(arg) && at >= 0 && at < n) {
+  if (v7_is_number(arg) && at >= 0 && at < s_char_len(v7, s, p, n)) {
     Rune r = 0;
-    p = utfnshift(p, at);
+    p = s_char_ptr(v7, s, p, n, at);
     chartorune(&r, (char *) p);
     *res = r;
     goto clean;
@@ -337,11 +780,12 @@ V7_PRIVATE void embed_string(struct mbuf *m, size_t offset, const char *p,
   uint8_t p_backed_by_mbuf = p >= old_base && p < old_base + m->len;
   size_t n = (flags & EMBSTR_UNESCAPE) ? unescape(p, len, NULL) : len;
 
-  /* Calculate how many bytes length takes */
+  /* Calculate how many bytes length takes, and the header, if any */
   int k = calc_llen(n);
+  size_t hdr = (flags & EMBSTR_STR_HDR) ? V7_STR_HDR_SIZE : 0;
 
-  /* total length: varing length + string len + zero-term */
-  size_t tot_len = k + n + !!(flags & EMBSTR_ZERO_TERM);
+  /* total length: varing length + header + string len + zero-term */
+  size_t tot_len = k + hdr + n + !!(flags & EMBSTR_ZERO_TERM);
 
   /* Allocate buffer */
   heapusage_dont_count(1);
@@ -353,8 +797,10 @@ V7_PRIVATE void embed_string(struct mbuf *m, size_t offset, const char *p,
     p += m->buf - old_base;
   }
 
-  /* Write length */
+  /* Write length, and the header with nothing computed yet */
   encode_varint(n, (unsigned char *) m->buf + offset);
+  memset(m->buf + offset + k, 0, hdr);
+  k += hdr;
 
   /* Write string */
   if (p != 0) {
@@ -398,9 +844,8 @@ v7_val_t v7_mk_string(struct v7 *v7, const char *p, size_t len, int copy) {
       memcpy(s, p, len);
     }
     tag = V7_TAG_STRING_5;
-  } else if ((dict_index = v_find_string_in_dictionary(p, len)) >= 0) {
-    offset = 0;
-    GET_VAL_NAN_PAYLOAD(offset)[0] = dict_index;
+  } else if ((dict_index = v_find_string_in_dictionary(v7, p, len)) >= 0) {
+    offset = dict_index;
     tag = V7_TAG_STRING_D;
   } else if (copy) {
     compute_need_gc(v7);
@@ -411,11 +856,17 @@ v7_val_t v7_mk_string(struct v7 *v7, const char *p, size_t len, int copy) {
      * need to preallocate some extra space (`_V7_STRING_BUF_RESERVE`)
      */
     if ((m->len + len) > m->size) {
+      char *old_base = m->buf;
+      int p_backed_by_mbuf = p >= old_base && p < old_base + m->len;
       heapusage_dont_count(1);
       mbuf_resize(m, m->len + len + _V7_STRING_BUF_RESERVE);
       heapusage_dont_count(0);
+      /* `embed_string()` can't tell `p` was in the buffer anymore */
+      if (p_backed_by_mbuf) {
+        p += m->buf - old_base;
+      }
     }
-    embed_string(m, m->len, p, len, EMBSTR_ZERO_TERM);
+    embed_string(m, m->len, p, len, EMBSTR_ZERO_TERM | EMBSTR_STR_HDR);
     tag = V7_TAG_STRING_O;
 #ifndef V7_DISABLE_STR_ALLOC_SEQ
     /* TODO(imax): panic if offset >= 2^32. */
@@ -446,6 +897,169 @@ v7_val_t v7_mk_string(struct v7 *v7, const char *p, size_t len, int copy) {
   return (offset & ~V7_TAG_MASK) | tag;
 }
 
+V7_PRIVATE uint32_t str_hash(const char *s, size_t len) {
+  /* FNV-1a */
+  uint32_t h = 2166136261U;
+  size_t i;
+  for (i = 0; i < len; i++) {
+    h = (h ^ (unsigned char) s[i]) * 16777619U;
+  }
+  return h;
+}
+
+V7_PRIVATE uint32_t s_hash(struct v7 *v7, val_t s) {
+  const char *p;
+  size_t len;
+  char *hdr = s_hdr(v7, s, &p, &len);
+  uint32_t hash;
+
+  if (hdr != NULL && (hdr[0] & V7_STR_HASHED)) {
+    memcpy(&hash, hdr + 1, sizeof(hash));
+    return hash;
+  }
+  hash = str_hash(p, len);
+  if (hdr != NULL) {
+    memcpy(hdr + 1, &hash, sizeof(hash));
+    hdr[0] |= V7_STR_HASHED;
+  }
+  return hash;
+}
+
+V7_PRIVATE int s_is_interned(struct v7 *v7, val_t s) {
+  const char *p;
+  size_t len;
+  char *hdr = s_hdr(v7, s, &p, &len);
+  return hdr != NULL && (hdr[0] & V7_STR_INTERNED);
+}
+
+/*
+ * Returns the slot holding the interned string with the given contents, or
+ * the empty slot where such a string should be added.
+ */
+static struct v7_interned_string *intern_lookup(struct v7 *v7, uint32_t hash,
+                                                const char *p, size_t len) {
+  uint32_t mask = v7->interned_size - 1, i = hash & mask;
+  for (;; i = (i + 1) & mask) {
+    struct v7_interned_string *e = &v7->interned[i];
+    if (e->s == V7_UNDEFINED) {
+      return e;
+    }
+    if (e->hash == hash) {
+      size_t n;
+      const char *s = v7_get_string(v7, &e->s, &n);
+      if (n == len && memcmp(s, p, len) == 0) {
+        return e;
+      }
+    }
+  }
+}
+
+static void intern_resize(struct v7 *v7, uint32_t size) {
+  struct v7_interned_string *old = v7->interned;
+  uint32_t old_size = v7->interned_size, i, mask = size - 1;
+
+  v7->interned = (struct v7_interned_string *) malloc(size * sizeof(*old));
+  if (v7->interned == NULL) abort();
+  v7->interned_size = size;
+  for (i = 0; i < size; i++) {
+    v7->interned[i].s = V7_UNDEFINED;
+  }
+
+  for (i = 0; i < old_size; i++) {
+    if (old[i].s != V7_UNDEFINED) {
+      uint32_t j = old[i].hash & mask;
+      while (v7->interned[j].s != V7_UNDEFINED) {
+        j = (j + 1) & mask;
+      }
+      v7->interned[j] = old[i];
+    }
+  }
+  free(old);
+}
+
+/* Makes sure there is room for one more interned string */
+static void intern_reserve(struct v7 *v7) {
+  if ((v7->interned_cnt + 1) * 4 > v7->interned_size * 3) {
+    intern_resize(v7, v7->interned_size == 0 ? 64 : v7->interned_size * 2);
+  }
+}
+
+/*
+ * Puts the owned string `s` into the empty slot `e`, and marks it interned in
+ * the string header, caching its hash as well
+ */
+static void intern_add(struct v7 *v7, struct v7_interned_string *e, val_t s,
+                       uint32_t hash) {
+  const char *p;
+  size_t len;
+  char *hdr = s_hdr(v7, s, &p, &len);
+
+  memcpy(hdr + 1, &hash, sizeof(hash));
+  hdr[0] |= V7_STR_HASHED | V7_STR_INTERNED;
+  e->s = s;
+  e->hash = hash;
+  v7->interned_cnt++;
+}
+
+V7_PRIVATE val_t v7_intern_string(struct v7 *v7, val_t s) {
+  struct v7_interned_string *e;
+  const char *p;
+  size_t len;
+  uint32_t hash;
+
+  if ((s & V7_TAG_MASK) != V7_TAG_STRING_O || s_is_interned(v7, s)) {
+    return s;
+  }
+
+  intern_reserve(v7);
+  hash = s_hash(v7, s);
+  p = v7_get_string(v7, &s, &len);
+  e = intern_lookup(v7, hash, p, len);
+  if (e->s == V7_UNDEFINED) {
+    intern_add(v7, e, s, hash);
+  }
+  return e->s;
+}
+
+V7_PRIVATE val_t v7_mk_interned_string(struct v7 *v7, const char *p,
+                                       size_t len) {
+  struct v7_interned_string *e;
+  uint32_t hash;
+
+  if (len == ~((size_t) 0)) len = strlen(p);
+
+  if (len <= 5 || v_find_string_in_dictionary(v7, p, len) >= 0) {
+    /* Such strings are not allocated anyway */
+    return v7_mk_string(v7, p, len, 1);
+  }
+
+  intern_reserve(v7);
+  hash = str_hash(p, len);
+  e = intern_lookup(v7, hash, p, len);
+  if (e->s == V7_UNDEFINED) {
+    intern_add(v7, e, v7_mk_string(v7, p, len, 1), hash);
+  }
+  return e->s;
+}
+
+V7_PRIVATE void intern_table_rehash(struct v7 *v7) {
+  uint32_t size = v7->interned_size;
+  if (size == 0) {
+    return;
+  }
+  /* Shrink the table if it's mostly empty */
+  while (size > 64 && v7->interned_cnt * 8 < size) {
+    size /= 2;
+  }
+  intern_resize(v7, size);
+}
+
+V7_PRIVATE void intern_table_free(struct v7 *v7) {
+  free(v7->interned);
+  v7->interned = NULL;
+  v7->interned_size = v7->interned_cnt = 0;
+}
+
 int v7_is_string(val_t v) {
   uint64_t t = v & V7_TAG_MASK;
   return t == V7_TAG_STRING_I || t == V7_TAG_STRING_F || t == V7_TAG_STRING_O ||
@@ -470,9 +1084,9 @@ const char *v7_get_string(struct v7 *v7, val_t *v, size_t *sizep) {
     p = GET_VAL_NAN_PAYLOAD(*v);
     size = 5;
   } else if (tag == V7_TAG_STRING_D) {
-    int index = ((unsigned char *) GET_VAL_NAN_PAYLOAD(*v))[0];
-    size = v_dictionary_strings[index].len;
-    p = v_dictionary_strings[index].p;
+    const struct v7_vec_const *d = dict_get(v7, (size_t)(*v & 0xffff));
+    size = d->len;
+    p = d->p;
   } else if (tag == V7_TAG_STRING_O) {
     size_t offset = (size_t) gc_string_val_to_offset(*v);
     char *s = v7->owned_strings.buf + offset;
@@ -482,7 +1096,7 @@ const char *v7_get_string(struct v7 *v7, val_t *v, size_t *sizep) {
 #endif
 
     size = decode_varint((uint8_t *) s, &llen);
-    p = s + llen;
+    p = s + llen + V7_STR_HDR_SIZE;
   } else if (tag == V7_TAG_STRING_F) {
     /*
      * short foreign strings on <=32-bit machines can be encoded in a compact
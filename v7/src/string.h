@@ -16,6 +16,25 @@
  */
 #define _V7_STRING_BUF_RESERVE 500
 
+/*
+ * Owned strings are stored in `v7->owned_strings` as
+ *
+ *     varint len | header | char data[len] | '\0'
+ *
+ * The header caches the properties of the data which are computed on demand:
+ * a byte of `V7_STR_*` flags, the `str_hash()` of the data, and (if UTF-8 is
+ * enabled) the number of characters; the latter two are 32-bit, unaligned.
+ */
+#if CS_ENABLE_UTF8
+#define V7_STR_HDR_SIZE 9
+#else
+#define V7_STR_HDR_SIZE 5
+#endif
+
+#define V7_STR_HASHED (1 << 0)   /* The hash is computed */
+#define V7_STR_COUNTED (1 << 1)  /* The number of characters is computed */
+#define V7_STR_INTERNED (1 << 2) /* The string is in the interned table */
+
 #if defined(__cplusplus)
 extern "C" {
 #endif /* __cplusplus */
@@ -48,6 +67,8 @@ V7_PRIVATE unsigned long cstr_to_ulong(const char *s, size_t len, int *ok);
 enum embstr_flags {
   EMBSTR_ZERO_TERM = (1 << 0),
   EMBSTR_UNESCAPE = (1 << 1),
+  /* Leave room for the owned string header, see `V7_STR_HDR_SIZE` */
+  EMBSTR_STR_HDR = (1 << 2),
 };
 
 V7_PRIVATE void embed_string(struct mbuf *m, size_t offset, const char *p,
@@ -55,6 +76,106 @@ V7_PRIVATE void embed_string(struct mbuf *m, size_t offset, const char *p,
 
 V7_PRIVATE size_t unescape(const char *s, size_t len, char *to);
 
+/*
+ * Returns number of characters in the first `len` bytes of `p`. Unlike
+ * `utfnlen()`, which stops at NUL when UTF-8 is disabled, counts NUL bytes as
+ * characters: they are valid in JavaScript strings.
+ */
+V7_PRIVATE size_t s_utf_len(const char *p, size_t len);
+
+/*
+ * Returns number of characters in the string `s`, given its data `p` of `len`
+ * bytes. The number is cached in the header of owned strings; for other long
+ * strings, the character index is used (see `struct v7_str_index`), so
+ * repeated calls take O(1).
+ */
+V7_PRIVATE size_t s_char_len(struct v7 *v7, val_t s, const char *p,
+                             size_t len);
+
+/*
+ * Returns pointer to the character with the given index (which should not be
+ * greater than the number of characters) in the string `s`, given its data
+ * `p` of `len` bytes. Like `s_char_len()`, uses the character index for long
+ * strings.
+ */
+V7_PRIVATE const char *s_char_ptr(struct v7 *v7, val_t s, const char *p,
+                                  size_t len, size_t idx);
+
+/*
+ * Returns index of the character at `at`, which should point to a character
+ * boundary within data `p` of `len` bytes of the string `s`. Like
+ * `s_char_len()`, uses the character index for long strings.
+ */
+V7_PRIVATE size_t s_char_index(struct v7 *v7, val_t s, const char *p,
+                               size_t len, const char *at);
+
+/*
+ * Returns pointer to the first occurrence of `sub` of `sub_len` bytes in `s`
+ * of `s_len` bytes, or NULL. Runs in linear time using the Two-Way algorithm,
+ * so it doesn't degrade on periodic patterns.
+ */
+V7_PRIVATE const char *s_memmem(const char *s, size_t s_len, const char *sub,
+                                size_t sub_len);
+
+/* Like `s_memmem()`, but returns pointer to the last occurrence */
+V7_PRIVATE const char *s_memrmem(const char *s, size_t s_len, const char *sub,
+                                 size_t sub_len);
+
+/* Drops cached character indices, called when strings get moved by GC */
+V7_PRIVATE void str_index_reset(struct v7 *v7);
+
+/* Returns hash of the string data */
+V7_PRIVATE uint32_t str_hash(const char *s, size_t len);
+
+/*
+ * Returns `str_hash()` of the string `s`; for owned strings, it's computed
+ * once and cached in the string header.
+ */
+V7_PRIVATE uint32_t s_hash(struct v7 *v7, val_t s);
+
+/*
+ * Returns whether `s` is an interned string. Two distinct interned strings are
+ * never equal, so they can be compared by identity.
+ */
+V7_PRIVATE int s_is_interned(struct v7 *v7, val_t s);
+
+/*
+ * Builds the dictionary of read-only strings, see `struct v7_dictionary`.
+ * `strings` is a NULL-terminated list of strings to add to the built-in ones,
+ * or NULL.
+ */
+V7_PRIVATE void dict_init(struct v7 *v7, const char *const *strings);
+
+/* Frees the dictionary of read-only strings */
+V7_PRIVATE void dict_free(struct v7 *v7);
+
+/*
+ * Returns interned copy of the given string: if an owned string with the same
+ * contents is already interned, it is returned; otherwise `s` gets interned.
+ * Strings which are not owned are returned as is.
+ *
+ * Interned strings are used as property names, so that objects with the
+ * same keys share one copy of each key, which can also be compared by
+ * identity.
+ */
+V7_PRIVATE val_t v7_intern_string(struct v7 *v7, val_t s);
+
+/*
+ * Like `v7_mk_string(v7, p, len, 1)`, but returns interned string; no new
+ * string is allocated if it is already interned.
+ */
+V7_PRIVATE val_t v7_mk_interned_string(struct v7 *v7, const char *p,
+                                       size_t len);
+
+/*
+ * Rebuilds the interned strings table after GC has dropped unreferenced
+ * strings from it, see `gc_mark_interned_strings()`
+ */
+V7_PRIVATE void intern_table_rehash(struct v7 *v7);
+
+/* Frees the interned strings table */
+V7_PRIVATE void intern_table_free(struct v7 *v7);
+
 #if defined(__cplusplus)
 }
 #endif /* __cplusplus */
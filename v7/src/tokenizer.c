@@ -9,9 +9,17 @@
 #include "v7/src/internal.h"
 #include "v7/src/core.h"
 
+#if !defined(V7_DISABLE_SIMD) && defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define V7_TOK_SSE2
+#elif !defined(V7_DISABLE_SIMD) && defined(__GNUC__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define V7_TOK_NEON
+#endif
+
 /*
- * NOTE(lsm): Must be in the same order as enum for keywords. See comment
- * for function get_tok() for rationale for that.
+ * NOTE(lsm): Must be in the same order as enum for keywords, so that the
+ * keyword of a token `tok` is `s_keywords[tok - TOK_BREAK]`.
  */
 static const struct v7_vec_const s_keywords[] = {
     V7_VEC("break"),      V7_VEC("case"),     V7_VEC("catch"),
@@ -29,31 +37,204 @@ V7_PRIVATE int is_reserved_word_token(enum v7_tok tok) {
   return tok >= TOK_BREAK && tok <= TOK_WITH;
 }
 
+/* Character classes, see `s_char_class` */
+#define CC_SPACE 0x01 /* What `isspace()` matches in the "C" locale */
+#define CC_IDENT 0x02 /* `$`, `_` and ASCII alphanumerics */
+
+/* Classes of all bytes; non-ASCII ones don't belong to any class */
+static const uint8_t s_char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0, /* 0x00 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 0x10 */
+    1, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 0x20 */
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0, /* 0x30 */
+    0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, /* 0x40 */
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 2, /* 0x50 */
+    0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, /* 0x60 */
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, /* 0x70 */
+};
+
+#define CHAR_IS(c, cls) (s_char_class[(uint8_t)(c)] & (cls))
+
+#if defined(V7_TOK_SSE2) || defined(V7_TOK_NEON)
+/*
+ * The scanners below classify 16 bytes at a time. A comparison of a block
+ * yields a mask, in which each byte of the block is represented by
+ * `TOK_MASK_BITS` bits: all set if the byte matches, all clear otherwise.
+ * Blocks are only loaded if they are entirely before `src_end`; the tail is
+ * scanned by the scalar loops.
+ */
+#define TOK_BLOCK 16
+
+#ifdef V7_TOK_SSE2
+#define TOK_MASK_BITS 1
+#define TOK_MASK_ALL ((uint64_t) 0xffff)
+#define TOK_MASK_ONE TOK_MASK_ALL /* One bit of each byte */
+
+typedef __m128i tok_block_t;
+
+static tok_block_t tok_load(const char *p) {
+  return _mm_loadu_si128((const __m128i *) p);
+}
+
+static uint64_t tok_eq(tok_block_t b, char c) {
+  return (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(b, _mm_set1_epi8(c)));
+}
+
+/* Mask of bytes in the range [`lo`, `hi`], both should be ASCII */
+static uint64_t tok_range(tok_block_t b, char lo, char hi) {
+  /* Non-ASCII bytes are negative, so they don't match */
+  return (uint64_t) _mm_movemask_epi8(
+      _mm_and_si128(_mm_cmpgt_epi8(b, _mm_set1_epi8(lo - 1)),
+                    _mm_cmplt_epi8(b, _mm_set1_epi8(hi + 1))));
+}
+
+static tok_block_t tok_lower(tok_block_t b) {
+  return _mm_or_si128(b, _mm_set1_epi8(0x20));
+}
+#else
+#define TOK_MASK_BITS 4
+#define TOK_MASK_ALL (~(uint64_t) 0)
+#define TOK_MASK_ONE ((uint64_t) 0x1111111111111111ULL)
+
+typedef uint8x16_t tok_block_t;
+
+static tok_block_t tok_load(const char *p) {
+  return vld1q_u8((const uint8_t *) p);
+}
+
+/* NEON has no `movemask`: narrow each byte of the comparison to 4 bits */
+static uint64_t tok_movemask(uint8x16_t m) {
+  return vget_lane_u64(
+      vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+}
+
+static uint64_t tok_eq(tok_block_t b, char c) {
+  return tok_movemask(vceqq_u8(b, vdupq_n_u8((uint8_t) c)));
+}
+
+/* Mask of bytes in the range [`lo`, `hi`], both should be ASCII */
+static uint64_t tok_range(tok_block_t b, char lo, char hi) {
+  return tok_movemask(vandq_u8(vcgeq_u8(b, vdupq_n_u8((uint8_t) lo)),
+                               vcleq_u8(b, vdupq_n_u8((uint8_t) hi))));
+}
+
+static tok_block_t tok_lower(tok_block_t b) {
+  return vorrq_u8(b, vdupq_n_u8(0x20));
+}
+#endif
+
+/* Index of the first matching byte in the mask, which should be non-zero */
+static int tok_first(uint64_t mask) {
+  return __builtin_ctzll(mask) / TOK_MASK_BITS;
+}
+
+/*
+ * Number of matching bytes among the first `n` bytes. Used to count new lines,
+ * which are rare enough to be counted one by one.
+ */
+static int tok_count(uint64_t mask, int n) {
+  int cnt = 0;
+  if (n < TOK_BLOCK) {
+    mask &= ((uint64_t) 1 << (n * TOK_MASK_BITS)) - 1;
+  }
+  for (mask &= TOK_MASK_ONE; mask != 0; mask &= mask - 1) {
+    cnt++;
+  }
+  return cnt;
+}
+
+static uint64_t tok_space(tok_block_t b) {
+  return tok_eq(b, ' ') | tok_range(b, '\t', '\r');
+}
+
+static uint64_t tok_ident(tok_block_t b) {
+  return tok_range(tok_lower(b), 'a', 'z') | tok_range(b, '0', '9') |
+         tok_eq(b, '$') | tok_eq(b, '_');
+}
+#endif
+
+/*
+ * Skips whitespace characters, adding the number of new lines to
+ * `*num_lines`. Returns pointer to the first non-whitespace character.
+ */
+static const char *skip_space(const char *s, const char *src_end,
+                              int *num_lines) {
+#if defined(V7_TOK_SSE2) || defined(V7_TOK_NEON)
+  while (src_end - s >= TOK_BLOCK) {
+    tok_block_t b = tok_load(s);
+    uint64_t rest = ~tok_space(b) & TOK_MASK_ALL;
+    int n = rest ? tok_first(rest) : TOK_BLOCK;
+    *num_lines += tok_count(tok_eq(b, '\n'), n);
+    s += n;
+    if (n < TOK_BLOCK) return s;
+  }
+#endif
+  for (; s < src_end && CHAR_IS(*s, CC_SPACE); s++) {
+    if (*s == '\n') (*num_lines)++;
+  }
+  return s;
+}
+
+/*
+ * Returns pointer to the first of the characters `c1`, `c2` or `\0`, or
+ * `src_end` if there is none. If `num_lines` is not NULL, the number of new
+ * lines before the returned pointer is added to it.
+ */
+static const char *find_chars(const char *s, const char *src_end, char c1,
+                              char c2, int *num_lines) {
+#if defined(V7_TOK_SSE2) || defined(V7_TOK_NEON)
+  while (src_end - s >= TOK_BLOCK) {
+    tok_block_t b = tok_load(s);
+    uint64_t found = tok_eq(b, c1) | tok_eq(b, c2) | tok_eq(b, '\0');
+    int n = found ? tok_first(found) : TOK_BLOCK;
+    if (num_lines != NULL) {
+      *num_lines += tok_count(tok_eq(b, '\n'), n);
+    }
+    s += n;
+    if (n < TOK_BLOCK) return s;
+  }
+#endif
+  for (; s < src_end && *s != c1 && *s != c2 && *s != '\0'; s++) {
+    if (*s == '\n' && num_lines != NULL) (*num_lines)++;
+  }
+  return s;
+}
+
+/* Returns pointer past the run of `$`, `_` and ASCII alphanumerics */
+static const char *skip_ident_chars(const char *s, const char *src_end) {
+#if defined(V7_TOK_SSE2) || defined(V7_TOK_NEON)
+  while (src_end - s >= TOK_BLOCK) {
+    uint64_t rest = ~tok_ident(tok_load(s)) & TOK_MASK_ALL;
+    if (rest) return s + tok_first(rest);
+    s += TOK_BLOCK;
+  }
+#endif
+  while (s < src_end && CHAR_IS(*s, CC_IDENT)) s++;
+  return s;
+}
+
 /*
  * Move ptr to the next token, skipping comments and whitespaces.
  * Return number of new line characters detected.
  */
 V7_PRIVATE int skip_to_next_tok(const char **ptr, const char *src_end) {
-  const char *s = *ptr, *p = NULL;
+  const char *s = *ptr;
   int num_lines = 0;
 
-  while (s != p && s < src_end && *s != '\0' &&
-         (isspace((unsigned char) *s) || *s == '/')) {
-    p = s;
-    while (s < src_end && *s != '\0' && isspace((unsigned char) *s)) {
-      if (*s == '\n') num_lines++;
-      s++;
-    }
+  for (;;) {
+    s = skip_space(s, src_end, &num_lines);
     if ((s + 1) < src_end && s[0] == '/' && s[1] == '/') {
+      /* The new line itself is skipped as a whitespace */
+      s = find_chars(s + 2, src_end, '\n', '\n', NULL);
+    } else if ((s + 1) < src_end && s[0] == '/' && s[1] == '*') {
       s += 2;
-      while (s < src_end && s[0] != '\0' && s[0] != '\n') s++;
-    }
-    if ((s + 1) < src_end && s[0] == '/' && s[1] == '*') {
-      s += 2;
-      while (s < src_end && s[0] != '\0' && !(s[-1] == '/' && s[-2] == '*')) {
-        if (s[0] == '\n') num_lines++;
-        s++;
-      }
+      do {
+        s = find_chars(s, src_end, '*', '*', &num_lines);
+        if (s < src_end && *s == '*') s++;
+      } while (s < src_end && *s != '\0' && *s != '/');
+      if (s < src_end && *s == '/') s++;
+    } else {
+      break;
     }
   }
   *ptr = s;
@@ -68,9 +249,10 @@ static void ident(const char **s, const char *src_end) {
   Rune r;
 
   while ((const char *) p < src_end && p[0] != '\0') {
-    if (p[0] == '$' || p[0] == '_' || isalnum(p[0])) {
+    if (CHAR_IS(p[0], CC_IDENT)) {
       /* $, _, or any alphanumeric are valid identifier characters */
-      p++;
+      p = (const unsigned char *) skip_ident_chars((const char *) p + 1,
+                                                   src_end);
     } else if ((const char *) (p + 5) < src_end && p[0] == '\\' &&
                p[1] == 'u' && isxdigit(p[2]) && isxdigit(p[3]) &&
                isxdigit(p[4]) && isxdigit(p[5])) {
@@ -92,16 +274,149 @@ static void ident(const char **s, const char *src_end) {
   *s = (char *) p;
 }
 
-static enum v7_tok kw(const char *s, size_t len, int ntoks, enum v7_tok tok) {
-  int i;
+/*
+ * Keywords are recognized by a perfect hash of the word length and of its
+ * first and last letters: `KW_HASH()` of the length and the association
+ * values of the letters below, which are chosen so that no two keywords
+ * collide. Since case labels in `kw()` are computed from the keywords
+ * themselves, a keyword which collides with another one fails to compile
+ * with a duplicate case value, and the values have to be searched for again.
+ */
+#define KW_B 6
+#define KW_C 21
+#define KW_D 17
+#define KW_E 28
+#define KW_F 10
+#define KW_H 8
+#define KW_I 12
+#define KW_K 31
+#define KW_L 30
+#define KW_N 12
+#define KW_O 14
+#define KW_R 22
+#define KW_S 6
+#define KW_T 13
+#define KW_V 29
+#define KW_W 26
+#define KW_Y 0
+
+#define KW_HASH(len, first, last) (((len) + (first) + (last)) & 0x1f)
+
+/* Association values of letters `a` to `z` */
+static const uint8_t s_kw_asso[26] = {
+    0,    KW_B, KW_C, KW_D, KW_E, KW_F, 0,    KW_H, KW_I, 0, KW_K, KW_L, 0,
+    KW_N, KW_O, 0,    0,    KW_R, KW_S, KW_T, 0,    KW_V, KW_W, 0, KW_Y, 0};
+
+/* Returns keyword token for the word `s`, or `TOK_IDENTIFIER` */
+static enum v7_tok kw(const char *s, size_t len) {
+  const struct v7_vec_const *k;
+  enum v7_tok tok;
+  int first = (unsigned char) s[0], last;
 
-  for (i = 0; i < ntoks; i++) {
-    if (s_keywords[(tok - TOK_BREAK) + i].len == len &&
-        memcmp(s_keywords[(tok - TOK_BREAK) + i].p + 1, s + 1, len - 1) == 0)
+  if (len < 2 || len > 10) return TOK_IDENTIFIER;
+  last = (unsigned char) s[len - 1];
+  if (first < 'a' || first > 'z' || last < 'a' || last > 'z') {
+    return TOK_IDENTIFIER;
+  }
+
+  switch (KW_HASH(len, s_kw_asso[first - 'a'], s_kw_asso[last - 'a'])) {
+    case KW_HASH(5, KW_B, KW_K):
+      tok = TOK_BREAK;
+      break;
+    case KW_HASH(4, KW_C, KW_E):
+      tok = TOK_CASE;
+      break;
+    case KW_HASH(5, KW_C, KW_H):
+      tok = TOK_CATCH;
+      break;
+    case KW_HASH(8, KW_C, KW_E):
+      tok = TOK_CONTINUE;
       break;
+    case KW_HASH(8, KW_D, KW_R):
+      tok = TOK_DEBUGGER;
+      break;
+    case KW_HASH(7, KW_D, KW_T):
+      tok = TOK_DEFAULT;
+      break;
+    case KW_HASH(6, KW_D, KW_E):
+      tok = TOK_DELETE;
+      break;
+    case KW_HASH(2, KW_D, KW_O):
+      tok = TOK_DO;
+      break;
+    case KW_HASH(4, KW_E, KW_E):
+      tok = TOK_ELSE;
+      break;
+    case KW_HASH(5, KW_F, KW_E):
+      tok = TOK_FALSE;
+      break;
+    case KW_HASH(7, KW_F, KW_Y):
+      tok = TOK_FINALLY;
+      break;
+    case KW_HASH(3, KW_F, KW_R):
+      tok = TOK_FOR;
+      break;
+    case KW_HASH(8, KW_F, KW_N):
+      tok = TOK_FUNCTION;
+      break;
+    case KW_HASH(2, KW_I, KW_F):
+      tok = TOK_IF;
+      break;
+    case KW_HASH(2, KW_I, KW_N):
+      tok = TOK_IN;
+      break;
+    case KW_HASH(10, KW_I, KW_F):
+      tok = TOK_INSTANCEOF;
+      break;
+    case KW_HASH(3, KW_N, KW_W):
+      tok = TOK_NEW;
+      break;
+    case KW_HASH(4, KW_N, KW_L):
+      tok = TOK_NULL;
+      break;
+    case KW_HASH(6, KW_R, KW_N):
+      tok = TOK_RETURN;
+      break;
+    case KW_HASH(6, KW_S, KW_H):
+      tok = TOK_SWITCH;
+      break;
+    case KW_HASH(4, KW_T, KW_S):
+      tok = TOK_THIS;
+      break;
+    case KW_HASH(5, KW_T, KW_W):
+      tok = TOK_THROW;
+      break;
+    case KW_HASH(4, KW_T, KW_E):
+      tok = TOK_TRUE;
+      break;
+    case KW_HASH(3, KW_T, KW_Y):
+      tok = TOK_TRY;
+      break;
+    case KW_HASH(6, KW_T, KW_F):
+      tok = TOK_TYPEOF;
+      break;
+    case KW_HASH(3, KW_V, KW_R):
+      tok = TOK_VAR;
+      break;
+    case KW_HASH(4, KW_V, KW_D):
+      tok = TOK_VOID;
+      break;
+    case KW_HASH(5, KW_W, KW_E):
+      tok = TOK_WHILE;
+      break;
+    case KW_HASH(4, KW_W, KW_H):
+      tok = TOK_WITH;
+      break;
+    default:
+      return TOK_IDENTIFIER;
   }
 
-  return i == ntoks ? TOK_IDENTIFIER : (enum v7_tok)(tok + i);
+  /* The only keyword the word can be */
+  k = &s_keywords[tok - TOK_BREAK];
+  if (k->len == len && memcmp(k->p, s, len) == 0) {
+    return tok;
+  }
+  return TOK_IDENTIFIER;
 }
 
 static enum v7_tok punct1(const char **s, const char *src_end, int ch1,
@@ -155,23 +470,24 @@ static enum v7_tok parse_str_literal(const char **p, const char *src_end) {
   }
 
   /* Scan string literal, handle escape sequences */
-  for (; s < src_end && *s != '\0' && *s != quote; s++) {
-    if (*s == '\\') {
-      switch (s[1]) {
-        case 'b':
-        case 'f':
-        case 'n':
-        case 'r':
-        case 't':
-        case 'v':
-        case '\\':
-          s++;
-          break;
-        default:
-          if (s[1] == quote) s++;
-          break;
-      }
+  for (;;) {
+    s = find_chars(s, src_end, (char) quote, '\\', NULL);
+    if (s >= src_end || *s != '\\') break;
+    switch (s[1]) {
+      case 'b':
+      case 'f':
+      case 'n':
+      case 'r':
+      case 't':
+      case 'v':
+      case '\\':
+        s++;
+        break;
+      default:
+        if (s[1] == quote) s++;
+        break;
     }
+    s++;
   }
 
   if (s < src_end && *s == quote) {
@@ -191,9 +507,8 @@ static enum v7_tok parse_str_literal(const char **p, const char *src_end) {
  * character begins with a letter, it could be either keyword or identifier.
  * get_tok() calls ident() which shifts `s` pointer to the end of the word.
  * Now, tokenizer knows that the word begins at `p` and ends at `s`.
- * It calls function kw() to scan over the keywords that start with `p[0]`
- * letter. Therefore, keyword tokens and keyword strings must be in the
- * same order, to let kw() function work properly.
+ * If `p[0]` is a letter some keywords start with, it calls function kw(),
+ * which looks the word up in the keywords perfect hash.
  * If kw() finds a keyword match, it returns keyword token.
  * Otherwise, it returns TOK_IDENTIFIER.
  * NOTE(lsm): `prev_tok` is a previously parsed token. It is needed for
@@ -209,69 +524,35 @@ V7_PRIVATE enum v7_tok get_tok(const char **s, const char *src_end, double *n,
 
   switch (*p) {
     /* Letters */
-    case 'a':
-      ident(s, src_end);
-      return TOK_IDENTIFIER;
     case 'b':
-      ident(s, src_end);
-      return kw(p, *s - p, 1, TOK_BREAK);
     case 'c':
-      ident(s, src_end);
-      return kw(p, *s - p, 3, TOK_CASE);
     case 'd':
-      ident(s, src_end);
-      return kw(p, *s - p, 4, TOK_DEBUGGER);
     case 'e':
-      ident(s, src_end);
-      return kw(p, *s - p, 1, TOK_ELSE);
     case 'f':
+    case 'i':
+    case 'n':
+    case 'r':
+    case 's':
+    case 't':
+    case 'v':
+    case 'w':
       ident(s, src_end);
-      return kw(p, *s - p, 4, TOK_FALSE);
+      return kw(p, *s - p);
+
+    case 'a':
     case 'g':
     case 'h':
-      ident(s, src_end);
-      return TOK_IDENTIFIER;
-    case 'i':
-      ident(s, src_end);
-      return kw(p, *s - p, 3, TOK_IF);
     case 'j':
     case 'k':
     case 'l':
     case 'm':
-      ident(s, src_end);
-      return TOK_IDENTIFIER;
-    case 'n':
-      ident(s, src_end);
-      return kw(p, *s - p, 2, TOK_NEW);
     case 'o':
     case 'p':
     case 'q':
-      ident(s, src_end);
-      return TOK_IDENTIFIER;
-    case 'r':
-      ident(s, src_end);
-      return kw(p, *s - p, 1, TOK_RETURN);
-    case 's':
-      ident(s, src_end);
-      return kw(p, *s - p, 1, TOK_SWITCH);
-    case 't':
-      ident(s, src_end);
-      return kw(p, *s - p, 5, TOK_THIS);
     case 'u':
-      ident(s, src_end);
-      return TOK_IDENTIFIER;
-    case 'v':
-      ident(s, src_end);
-      return kw(p, *s - p, 2, TOK_VAR);
-    case 'w':
-      ident(s, src_end);
-      return kw(p, *s - p, 2, TOK_WHILE);
     case 'x':
     case 'y':
     case 'z':
-      ident(s, src_end);
-      return TOK_IDENTIFIER;
-
     case '_':
     case '$':
     case 'A':